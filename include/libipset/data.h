@@ -59,8 +59,20 @@ enum ipset_opt {
 	IPSET_OPT_BYTES,
 	IPSET_OPT_CREATE_COMMENT,
 	IPSET_OPT_ADT_COMMENT,
+	IPSET_OPT_LPM,
+	IPSET_OPT_BLOOM,
+	IPSET_OPT_EVICT,
+	IPSET_OPT_EVICTED,	/* filled out by the kernel */
+	IPSET_OPT_ADD_FAILED,	/* filled out by the kernel */
+	IPSET_OPT_PCPU_COUNTERS,
+	IPSET_OPT_BUCKET_ALLOCS,	/* filled out by the kernel */
+	IPSET_OPT_BUCKET_FREES,		/* filled out by the kernel */
+	IPSET_OPT_EXPECT,
+	IPSET_OPT_STATS,	/* filled out by the kernel */
+	IPSET_OPT_CACHE,
+	IPSET_OPT_REPLICAS,
 	/* Internal options */
-	IPSET_OPT_FLAGS = 48,	/* IPSET_FLAG_EXIST| */
+	IPSET_OPT_FLAGS = 52,	/* IPSET_FLAG_EXIST| */
 	IPSET_OPT_CADT_FLAGS,	/* IPSET_FLAG_BEFORE| */
 	IPSET_OPT_ELEM,
 	IPSET_OPT_TYPE,
@@ -90,7 +102,14 @@ enum ipset_opt {
 	| IPSET_FLAG(IPSET_OPT_PROBES)	\
 	| IPSET_FLAG(IPSET_OPT_RESIZE)	\
 	| IPSET_FLAG(IPSET_OPT_SIZE)	\
-	| IPSET_FLAG(IPSET_OPT_CREATE_COMMENT))
+	| IPSET_FLAG(IPSET_OPT_CREATE_COMMENT)\
+	| IPSET_FLAG(IPSET_OPT_LPM)	\
+	| IPSET_FLAG(IPSET_OPT_BLOOM)	\
+	| IPSET_FLAG(IPSET_OPT_EVICT)	\
+	| IPSET_FLAG(IPSET_OPT_PCPU_COUNTERS)\
+	| IPSET_FLAG(IPSET_OPT_EXPECT)	\
+	| IPSET_FLAG(IPSET_OPT_CACHE)	\
+	| IPSET_FLAG(IPSET_OPT_REPLICAS))
 
 #define IPSET_ADT_FLAGS			\
 	(IPSET_FLAG(IPSET_OPT_IP)	\
@@ -14,7 +14,9 @@
 #include <linux/types.h>
 
 /* The protocol version */
-#define IPSET_PROTOCOL		6
+#define IPSET_PROTOCOL		7
+/* The minimal protocol version supported */
+#define IPSET_PROTOCOL_MIN	6
 
 /* The max length of strings including NUL: set and type identifiers */
 #define IPSET_MAXNAMELEN	32
@@ -38,17 +40,20 @@ enum ipset_cmd {
 	IPSET_CMD_TEST,		/* 11: Test an element in a set */
 	IPSET_CMD_HEADER,	/* 12: Get set header data only */
 	IPSET_CMD_TYPE,		/* 13: Get set type */
+	IPSET_CMD_COMPACT,	/* 14: Shrink the memory of a set */
+	IPSET_CMD_REPLACE,	/* 15: Start to replace the content of a set */
+	IPSET_CMD_PUBLISH,	/* 16: Publish the replaced content of a set */
 	IPSET_MSG_MAX,		/* Netlink message commands */
 
 	/* Commands in userspace: */
-	IPSET_CMD_RESTORE = IPSET_MSG_MAX, /* 14: Enter restore mode */
-	IPSET_CMD_HELP,		/* 15: Get help */
-	IPSET_CMD_VERSION,	/* 16: Get program version */
-	IPSET_CMD_QUIT,		/* 17: Quit from interactive mode */
+	IPSET_CMD_RESTORE = IPSET_MSG_MAX, /* 17: Enter restore mode */
+	IPSET_CMD_HELP,		/* 18: Get help */
+	IPSET_CMD_VERSION,	/* 19: Get program version */
+	IPSET_CMD_QUIT,		/* 20: Quit from interactive mode */
 
 	IPSET_CMD_MAX,
 
-	IPSET_CMD_COMMIT = IPSET_CMD_MAX, /* 18: Commit buffered commands */
+	IPSET_CMD_COMMIT = IPSET_CMD_MAX, /* 21: Commit buffered commands */
 };
 
 /* Attributes at command level */
@@ -66,10 +71,33 @@ enum {
 	IPSET_ATTR_LINENO,	/* 9: Restore lineno */
 	IPSET_ATTR_PROTOCOL_MIN, /* 10: Minimal supported version number */
 	IPSET_ATTR_REVISION_MIN	= IPSET_ATTR_PROTOCOL_MIN, /* type rev min */
+	IPSET_ATTR_PACKED,	/* 11: Packed array of elements */
 	__IPSET_ATTR_CMD_MAX,
 };
 #define IPSET_ATTR_CMD_MAX	(__IPSET_ATTR_CMD_MAX - 1)
 
+/* The packed array of elements (protocol version 7) is an alternative to
+ * IPSET_ATTR_ADT at add/del, for the set types which support it. The
+ * elements are of fixed size and carry the key fields only, in network
+ * order: the IP address (4 or 16 bytes according to the family of the set),
+ * then for the network types the CIDR (1 byte) and the CADT flags
+ * (1 byte, IPSET_FLAG_NOMATCH only), padded to 4 bytes.
+ * IPSET_ATTR_LINENO is the line number of the first element and the
+ * elements come from consecutive lines.
+ *
+ * When IPSET_FLAG_LIST_PACKED is requested, list/save replies carry the
+ * elements of such sets in IPSET_ATTR_PACKED instead of IPSET_ATTR_ADT.
+ * The array starts with the size of the records (__be16) and the
+ * IPSET_PACKED_* flags (__be16), then each record is the element as above,
+ * followed by the timeout (__be32) and the packets and bytes counters
+ * (__be64 each), when the flags say so. Sets with comments are always
+ * listed with IPSET_ATTR_ADT.
+ */
+enum ipset_packed_flags {
+	IPSET_PACKED_TIMEOUT	= (1 << 0),
+	IPSET_PACKED_COUNTERS	= (1 << 1),
+};
+
 /* CADT specific attributes */
 enum {
 	IPSET_ATTR_IP = IPSET_ATTR_UNSPEC + 1,
@@ -97,6 +125,14 @@ enum {
 	IPSET_ATTR_ELEMENTS,
 	IPSET_ATTR_REFERENCES,
 	IPSET_ATTR_MEMSIZE,
+	IPSET_ATTR_EVICTED,
+	IPSET_ATTR_ADD_FAILED,
+	IPSET_ATTR_BUCKET_ALLOCS,
+	IPSET_ATTR_BUCKET_FREES,
+	/* Create-only, appended to keep the numbering stable */
+	IPSET_ATTR_EXPECT,
+	/* Kernel-only, appended to keep the numbering stable */
+	IPSET_ATTR_STATS,
 
 	__IPSET_ATTR_CREATE_MAX,
 };
@@ -126,6 +162,25 @@ enum {
 };
 #define IPSET_ATTR_IPADDR_MAX	(__IPSET_ATTR_IPADDR_MAX - 1)
 
+/* Runtime statistics attributes */
+enum {
+	IPSET_ATTR_STATS_UNSPEC,
+	IPSET_ATTR_STATS_TESTS,
+	IPSET_ATTR_STATS_HITS,
+	IPSET_ATTR_STATS_MISSES,
+	IPSET_ATTR_STATS_LOOKUPS,
+	IPSET_ATTR_STATS_PROBES,
+	IPSET_ATTR_STATS_PROBE_MAX,
+	IPSET_ATTR_STATS_RESIZES,
+	IPSET_ATTR_STATS_RESIZE_TIME,
+	IPSET_ATTR_STATS_GC_RUNS,
+	IPSET_ATTR_STATS_GC_TIME,
+	IPSET_ATTR_STATS_EXPIRED,
+	IPSET_ATTR_STATS_BUCKET_FULL,
+	__IPSET_ATTR_STATS_MAX,
+};
+#define IPSET_ATTR_STATS_MAX	(__IPSET_ATTR_STATS_MAX - 1)
+
 /* Error codes */
 enum ipset_errno {
 	IPSET_ERR_PRIVATE = 4096,
@@ -145,6 +200,7 @@ enum ipset_errno {
 	IPSET_ERR_IPADDR_IPV6,
 	IPSET_ERR_COUNTER,
 	IPSET_ERR_COMMENT,
+	IPSET_ERR_NO_SHADOW,
 
 	/* Type specific error codes */
 	IPSET_ERR_TYPE_SPECIFIC = 4352,
@@ -166,8 +222,12 @@ enum ipset_cmd_flags {
 		(1 << IPSET_FLAG_BIT_SKIP_SUBCOUNTER_UPDATE),
 	IPSET_FLAG_BIT_MATCH_COUNTERS = 5,
 	IPSET_FLAG_MATCH_COUNTERS = (1 << IPSET_FLAG_BIT_MATCH_COUNTERS),
+	IPSET_FLAG_BIT_SHADOW = 6,
+	IPSET_FLAG_SHADOW	= (1 << IPSET_FLAG_BIT_SHADOW),
 	IPSET_FLAG_BIT_RETURN_NOMATCH = 7,
 	IPSET_FLAG_RETURN_NOMATCH = (1 << IPSET_FLAG_BIT_RETURN_NOMATCH),
+	IPSET_FLAG_BIT_LIST_PACKED = 8,
+	IPSET_FLAG_LIST_PACKED	= (1 << IPSET_FLAG_BIT_LIST_PACKED),
 	IPSET_FLAG_CMD_MAX = 15,
 };
 
@@ -183,6 +243,18 @@ enum ipset_cadt_flags {
 	IPSET_FLAG_WITH_COUNTERS = (1 << IPSET_FLAG_BIT_WITH_COUNTERS),
 	IPSET_FLAG_BIT_WITH_COMMENT = 4,
 	IPSET_FLAG_WITH_COMMENT = (1 << IPSET_FLAG_BIT_WITH_COMMENT),
+	IPSET_FLAG_BIT_WITH_LPM = 5,
+	IPSET_FLAG_WITH_LPM = (1 << IPSET_FLAG_BIT_WITH_LPM),
+	IPSET_FLAG_BIT_WITH_BLOOM = 6,
+	IPSET_FLAG_WITH_BLOOM = (1 << IPSET_FLAG_BIT_WITH_BLOOM),
+	IPSET_FLAG_BIT_WITH_EVICT = 7,
+	IPSET_FLAG_WITH_EVICT = (1 << IPSET_FLAG_BIT_WITH_EVICT),
+	IPSET_FLAG_BIT_WITH_PCPU_COUNTERS = 8,
+	IPSET_FLAG_WITH_PCPU_COUNTERS = (1 << IPSET_FLAG_BIT_WITH_PCPU_COUNTERS),
+	IPSET_FLAG_BIT_WITH_CACHE = 9,
+	IPSET_FLAG_WITH_CACHE = (1 << IPSET_FLAG_BIT_WITH_CACHE),
+	IPSET_FLAG_BIT_WITH_REPLICAS = 10,
+	IPSET_FLAG_WITH_REPLICAS = (1 << IPSET_FLAG_BIT_WITH_REPLICAS),
 	IPSET_FLAG_CADT_MAX	= 15,
 };
 
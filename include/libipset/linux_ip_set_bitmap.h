@@ -7,6 +7,8 @@ enum {
 	IPSET_ERR_BITMAP_RANGE = IPSET_ERR_TYPE_SPECIFIC,
 	/* The range exceeds the size limit of the set type */
 	IPSET_ERR_BITMAP_RANGE_SIZE,
+	/* The set is full */
+	IPSET_ERR_BITMAP_FULL,
 };
 
 
@@ -15,6 +15,8 @@ enum {
 	IPSET_ERR_HASH_RANGE_UNSUPPORTED,
 	/* Invalid range */
 	IPSET_ERR_HASH_RANGE,
+	/* Replicas with timeout */
+	IPSET_ERR_HASH_REPLICAS,
 };
 
 
@@ -0,0 +1,13 @@
+#ifndef _UAPI__IP_SET_INTERVAL_H
+#define _UAPI__IP_SET_INTERVAL_H
+
+/* Interval type specific error codes */
+enum {
+	/* The interval overlaps an element of the set */
+	IPSET_ERR_INTERVAL_OVERLAP = IPSET_ERR_TYPE_SPECIFIC,
+	/* The set is full */
+	IPSET_ERR_INTERVAL_FULL,
+};
+
+
+#endif /* _UAPI__IP_SET_INTERVAL_H */
@@ -79,6 +79,7 @@ struct ipset_type {
 	const struct ipset_arg *args[IPSET_CADT_MAX]; /* create/ADT args besides elem */
 	uint64_t mandatory[IPSET_CADT_MAX];	/* create/ADT mandatory flags */
 	uint64_t full[IPSET_CADT_MAX];		/* full args flags */
+	uint64_t packed;			/* options of packed elements */
 	const char *usage;			/* terse usage */
 	void (*usagefn)(void);			/* additional usage */
 	const char *description;		/* short revision description */
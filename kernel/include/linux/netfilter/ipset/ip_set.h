@@ -12,12 +12,15 @@
 
 #include <linux/ip.h>
 #include <linux/ipv6.h>
+#include <linux/ktime.h>
 #include <linux/netlink.h>
+#include <linux/percpu.h>
 #include <linux/netfilter.h>
 #include <linux/netfilter/x_tables.h>
 #include <linux/stringify.h>
 #include <linux/vmalloc.h>
 #include <net/netlink.h>
+#include <asm/unaligned.h>
 #include <uapi/linux/netfilter/ipset/ip_set.h>
 #include <linux/netfilter/ipset/ip_set_compat.h>
 
@@ -56,6 +59,9 @@ enum ip_set_extension {
 	IPSET_EXT_COUNTER = (1 << IPSET_EXT_BIT_COUNTER),
 	IPSET_EXT_BIT_COMMENT = 2,
 	IPSET_EXT_COMMENT = (1 << IPSET_EXT_BIT_COMMENT),
+	/* Counters are kept per-CPU: not a separate extension slot */
+	IPSET_EXT_BIT_PCPU_COUNTER = 3,
+	IPSET_EXT_PCPU_COUNTER = (1 << IPSET_EXT_BIT_PCPU_COUNTER),
 	/* Mark set with an extension which needs to call destroy */
 	IPSET_EXT_BIT_DESTROY = 7,
 	IPSET_EXT_DESTROY = (1 << IPSET_EXT_BIT_DESTROY),
@@ -64,6 +70,7 @@ enum ip_set_extension {
 #define SET_WITH_TIMEOUT(s)	((s)->extensions & IPSET_EXT_TIMEOUT)
 #define SET_WITH_COUNTER(s)	((s)->extensions & IPSET_EXT_COUNTER)
 #define SET_WITH_COMMENT(s)	((s)->extensions & IPSET_EXT_COMMENT)
+#define SET_WITH_PCPU_COUNTER(s) ((s)->extensions & IPSET_EXT_PCPU_COUNTER)
 
 /* Extension id, in size order */
 enum ip_set_ext_id {
@@ -76,7 +83,7 @@ enum ip_set_ext_id {
 /* Extension type */
 struct ip_set_ext_type {
 	/* Destroy extension private data (can be NULL) */
-	void (*destroy)(void *ext);
+	void (*destroy)(struct ip_set *set, void *ext);
 	enum ip_set_extension type;
 	enum ipset_cadt_flags flag;
 	/* Size and minimal alignment */
@@ -93,19 +100,52 @@ struct ip_set_ext {
 	char *comment;
 };
 
+struct ip_set_counter_cpu {
+	u64 bytes;
+	u64 packets;
+};
+
+/* With per-CPU counters the slot of the counter extension holds the
+ * pointer to the per-CPU copies instead of the shared atomic counters */
 struct ip_set_counter {
-	atomic64_t bytes;
-	atomic64_t packets;
+	union {
+		struct {
+			atomic64_t bytes;
+			atomic64_t packets;
+		};
+		struct ip_set_counter_cpu __percpu *cpu;
+	};
 };
 
+/* The comment strings are interned in a table per network namespace,
+ * the elements store the index of their comment only: 0 means no comment */
 struct ip_set_comment {
-	char *str;
+	u32 id;
+};
+
+struct ip_set_comment_str {
+	struct hlist_node node;	/* in the hash of the table */
+	u32 id;			/* index in the table */
+	u32 ref;		/* number of the elements with the comment */
+	u32 hval;		/* hash value of the string */
+	char str[0];
+};
+
+struct ip_set_comment_table {
+	spinlock_t lock;	/* kernel side adds may run parallel */
+	u32 size;		/* allocated entries */
+	u32 used;		/* entries in use */
+	u32 free;		/* first free entry, 0 if none */
+	unsigned long *entry;	/* strings or (next free entry << 1) | 1 */
+	u8 hbits;		/* size of the hash in bits */
+	struct hlist_head *hash; /* strings by their hash value */
+	size_t memsize;		/* memory size of the table and the strings */
 };
 
 struct ip_set;
 
 #define ext_timeout(e, s)	\
-(unsigned long *)(((void *)(e)) + (s)->offset[IPSET_EXT_ID_TIMEOUT])
+(u32 *)(((void *)(e)) + (s)->offset[IPSET_EXT_ID_TIMEOUT])
 #define ext_counter(e, s)	\
 (struct ip_set_counter *)(((void *)(e)) + (s)->offset[IPSET_EXT_ID_COUNTER])
 #define ext_comment(e, s)	\
@@ -125,6 +165,11 @@ struct ip_set_adt_opt {
 	struct ip_set_ext ext;	/* Extensions */
 };
 
+/* Internal command flag: kernel side add with the set read-locked */
+#define IPSET_FLAG_PARALLEL_ADD	(1 << IPSET_FLAG_CMD_MAX)
+/* Internal command flag: add from the packet path */
+#define IPSET_FLAG_KERNEL_ADD	(1 << (IPSET_FLAG_CMD_MAX + 1))
+
 /* Set type, variant-specific part */
 struct ip_set_type_variant {
 	/* Kernelspace: test/add/del entries
@@ -142,11 +187,20 @@ struct ip_set_type_variant {
 	int (*uadt)(struct ip_set *set, struct nlattr *tb[],
 		    enum ipset_adt adt, u32 *lineno, u32 flags, bool retried);
 
+	/* Userspace: add/del an element of a packed array,
+	 *		the elements are psize bytes long
+	 *		returns negative error code, zero for success */
+	int (*padt)(struct ip_set *set, const void *data,
+		    enum ipset_adt adt, u32 flags);
+	u32 psize;
+
 	/* Low level add/del/test functions */
 	ipset_adtfn adt[IPSET_ADT_MAX];
 
 	/* When adding entries and set is full, try to resize the set */
 	int (*resize)(struct ip_set *set, bool retried);
+	/* Shrink the set to the size required by its elements */
+	int (*compact)(struct ip_set *set);
 	/* Destroy the set */
 	void (*destroy)(struct ip_set *set);
 	/* Flush the elements */
@@ -156,12 +210,19 @@ struct ip_set_type_variant {
 	/* List set header data */
 	int (*head)(struct ip_set *set, struct sk_buff *skb);
 	/* List elements */
-	int (*list)(const struct ip_set *set, struct sk_buff *skb,
+	int (*list)(struct ip_set *set, struct sk_buff *skb,
 		    struct netlink_callback *cb);
+	/* Pin (start) or release the version of the data which is listed:
+	 * the elements of such types are listed without the set locked */
+	int (*uref)(struct ip_set *set, struct netlink_callback *cb,
+		    bool start);
 
 	/* Return true if "b" set is the same as "a"
 	 * according to the create set parameters */
 	bool (*same_set)(const struct ip_set *a, const struct ip_set *b);
+	/* Kernel side adds may run with the set read-locked: the add
+	 * returns -EBUSY when the set must be write-locked */
+	bool parallel_kadd;
 };
 
 /* The core set type structure */
@@ -200,6 +261,22 @@ struct ip_set_type {
 extern int ip_set_type_register(struct ip_set_type *set_type);
 extern void ip_set_type_unregister(struct ip_set_type *set_type);
 
+/* Runtime statistics of a set, kept per CPU. The sets are created with
+ * statistics when the stats parameter of the ip_set module is enabled. */
+struct ip_set_stats {
+	u64 tests;		/* tests from the packet path */
+	u64 hits;		/* tests which matched */
+	u64 lookups;		/* lookups of the hash table */
+	u64 probes;		/* entries compared at the lookups */
+	u64 resizes;		/* resizes of the hash table */
+	u64 resize_time;	/* time spent with resizing, in usecs */
+	u64 gc_runs;		/* runs of the garbage collector */
+	u64 gc_time;		/* time spent with garbage collecting, in usecs */
+	u64 expired;		/* timed out entries deleted */
+	u64 bucket_full;	/* adds failed because the bucket was full */
+	u32 probe_max;		/* max entries compared at a lookup */
+};
+
 /* A generic IP set */
 struct ip_set {
 	/* The name of the set */
@@ -208,6 +285,10 @@ struct ip_set {
 	rwlock_t lock;
 	/* References to the set */
 	u32 ref;
+	/* References to the set by netlink dumps */
+	u32 ref_netlink;
+	/* The new content of the set while it is replaced */
+	struct ip_set *shadow;
 	/* The core set type */
 	struct ip_set_type *type;
 	/* The type variant doing the real job */
@@ -218,8 +299,16 @@ struct ip_set {
 	u8 revision;
 	/* Extensions */
 	u8 extensions;
+	/* Create flags which are not extensions, reported in the header */
+	u32 cadt_flags;
 	/* Default timeout value, if enabled */
 	u32 timeout;
+	/* Creation time in jiffies: element timeouts are relative to it */
+	u64 epoch;
+	/* Comment strings of the namespace, if comments are enabled */
+	struct ip_set_comment_table *comments;
+	/* Runtime statistics, if enabled */
+	struct ip_set_stats __percpu *stats;
 	/* Element data size */
 	size_t dsize;
 	/* Offsets to extensions in elements */
@@ -228,6 +317,50 @@ struct ip_set {
 	void *data;
 };
 
+/* The statistics are updated only while there are sets with them:
+ * otherwise the static key patches the branches out of the packet path */
+extern struct static_key ip_set_stats_key;
+
+#define SET_WITH_STATS(s)	\
+	(static_key_false(&ip_set_stats_key) && (s)->stats)
+
+#define ip_set_stats_add(s, field, n)			\
+do {							\
+	if (SET_WITH_STATS(s))				\
+		this_cpu_add((s)->stats->field, n);	\
+} while (0)
+
+#define ip_set_stats_inc(s, field)	ip_set_stats_add(s, field, 1)
+
+/* A lookup which compared n entries */
+static inline void
+ip_set_stats_lookup(struct ip_set *set, u32 n)
+{
+	if (SET_WITH_STATS(set)) {
+		this_cpu_inc(set->stats->lookups);
+		this_cpu_add(set->stats->probes, n);
+		if (n > this_cpu_read(set->stats->probe_max))
+			this_cpu_write(set->stats->probe_max, n);
+	}
+}
+
+/* Timing of resizing and garbage collecting */
+static inline ktime_t
+ip_set_stats_start(const struct ip_set *set)
+{
+	return SET_WITH_STATS(set) ? ktime_get() : ktime_set(0, 0);
+}
+
+#define ip_set_stats_time(s, field, start)			\
+	ip_set_stats_add(s, field, ktime_us_delta(ktime_get(), start))
+
+static inline void
+ip_set_free_counter(struct ip_set_counter *counter)
+{
+	free_percpu(counter->cpu);
+	counter->cpu = NULL;
+}
+
 static inline void
 ip_set_ext_destroy(struct ip_set *set, void *data)
 {
@@ -235,20 +368,24 @@ ip_set_ext_destroy(struct ip_set *set, void *data)
 	 * call it's destroy function for its extension part in data.
 	 */
 	if (SET_WITH_COMMENT(set))
-		ip_set_extensions[IPSET_EXT_ID_COMMENT].destroy(
+		ip_set_extensions[IPSET_EXT_ID_COMMENT].destroy(set,
 			ext_comment(data, set));
+	if (SET_WITH_PCPU_COUNTER(set))
+		ip_set_free_counter(ext_counter(data, set));
 }
 
 static inline int
 ip_set_put_flags(struct sk_buff *skb, struct ip_set *set)
 {
-	u32 cadt_flags = 0;
+	u32 cadt_flags = set->cadt_flags;
 
 	if (SET_WITH_TIMEOUT(set))
 		if (unlikely(nla_put_net32(skb, IPSET_ATTR_TIMEOUT,
 					   htonl(set->timeout))))
 			return -EMSGSIZE;
-	if (SET_WITH_COUNTER(set))
+	if (SET_WITH_PCPU_COUNTER(set))
+		cadt_flags |= IPSET_FLAG_WITH_PCPU_COUNTERS;
+	else if (SET_WITH_COUNTER(set))
 		cadt_flags |= IPSET_FLAG_WITH_COUNTERS;
 	if (SET_WITH_COMMENT(set))
 		cadt_flags |= IPSET_FLAG_WITH_COMMENT;
@@ -283,38 +420,95 @@ ip_set_get_packets(const struct ip_set_counter *counter)
 }
 
 static inline void
-ip_set_update_counter(struct ip_set_counter *counter,
+ip_set_read_counter(const struct ip_set *set,
+		    const struct ip_set_counter *counter,
+		    u64 *bytes, u64 *packets)
+{
+	const struct ip_set_counter_cpu *c;
+	int cpu;
+
+	if (!SET_WITH_PCPU_COUNTER(set)) {
+		*bytes = ip_set_get_bytes(counter);
+		*packets = ip_set_get_packets(counter);
+		return;
+	}
+	*bytes = *packets = 0;
+	/* The per-CPU copies could not be allocated at adding the element */
+	if (!counter->cpu)
+		return;
+	for_each_possible_cpu(cpu) {
+		c = per_cpu_ptr(counter->cpu, cpu);
+		*bytes += c->bytes;
+		*packets += c->packets;
+	}
+}
+
+static inline void
+ip_set_update_counter(const struct ip_set *set,
+		      struct ip_set_counter *counter,
 		      const struct ip_set_ext *ext,
 		      struct ip_set_ext *mext, u32 flags)
 {
 	if (ext->packets != ULLONG_MAX &&
 	    !(flags & IPSET_FLAG_SKIP_COUNTER_UPDATE)) {
-		ip_set_add_bytes(ext->bytes, counter);
-		ip_set_add_packets(ext->packets, counter);
-	}
-	if (flags & IPSET_FLAG_MATCH_COUNTERS) {
-		mext->packets = ip_set_get_packets(counter);
-		mext->bytes = ip_set_get_bytes(counter);
+		if (!SET_WITH_PCPU_COUNTER(set)) {
+			ip_set_add_bytes(ext->bytes, counter);
+			ip_set_add_packets(ext->packets, counter);
+		} else if (counter->cpu) {
+			this_cpu_add(counter->cpu->bytes, ext->bytes);
+			this_cpu_add(counter->cpu->packets, ext->packets);
+		}
 	}
+	if (flags & IPSET_FLAG_MATCH_COUNTERS)
+		ip_set_read_counter(set, counter, &mext->bytes,
+				    &mext->packets);
 }
 
 static inline bool
-ip_set_put_counter(struct sk_buff *skb, struct ip_set_counter *counter)
+ip_set_put_counter(struct sk_buff *skb, const struct ip_set *set,
+		   const struct ip_set_counter *counter)
 {
-	return nla_put_net64(skb, IPSET_ATTR_BYTES,
-			     cpu_to_be64(ip_set_get_bytes(counter))) ||
-	       nla_put_net64(skb, IPSET_ATTR_PACKETS,
-			     cpu_to_be64(ip_set_get_packets(counter)));
+	u64 bytes, packets;
+
+	ip_set_read_counter(set, counter, &bytes, &packets);
+	return nla_put_net64(skb, IPSET_ATTR_BYTES, cpu_to_be64(bytes)) ||
+	       nla_put_net64(skb, IPSET_ATTR_PACKETS, cpu_to_be64(packets));
 }
 
 static inline void
-ip_set_init_counter(struct ip_set_counter *counter,
+ip_set_init_counter(const struct ip_set *set,
+		    struct ip_set_counter *counter,
 		    const struct ip_set_ext *ext)
 {
+	struct ip_set_counter_cpu *c;
+
+	if (!SET_WITH_PCPU_COUNTER(set)) {
+		if (ext->bytes != ULLONG_MAX)
+			atomic64_set(&(counter)->bytes,
+				     (long long)(ext->bytes));
+		if (ext->packets != ULLONG_MAX)
+			atomic64_set(&(counter)->packets,
+				     (long long)(ext->packets));
+		return;
+	}
+	/* The slot is either new or its counters are already freed by
+	 * ip_set_ext_destroy(): elements may be added from the packet path,
+	 * so the allocation must not sleep. If it fails, the element works
+	 * with zero, not updated counters. */
+#ifdef HAVE_ALLOC_PERCPU_GFP
+	counter->cpu = alloc_percpu_gfp(struct ip_set_counter_cpu,
+					GFP_ATOMIC);
+#else
+	counter->cpu = NULL;
+#endif
+	if (!counter->cpu)
+		return;
+	/* Initial values are stored in the copy of an arbitrary CPU */
+	c = per_cpu_ptr(counter->cpu, raw_smp_processor_id());
 	if (ext->bytes != ULLONG_MAX)
-		atomic64_set(&(counter)->bytes, (long long)(ext->bytes));
+		c->bytes = ext->bytes;
 	if (ext->packets != ULLONG_MAX)
-		atomic64_set(&(counter)->packets, (long long)(ext->packets));
+		c->packets = ext->packets;
 }
 
 /* Netlink CB args */
@@ -327,6 +521,13 @@ enum {
 	IPSET_CB_ARG2,
 };
 
+/* The command flags of a list/save request */
+static inline u32
+ip_set_dump_flags(const struct netlink_callback *cb)
+{
+	return ((u32)cb->args[IPSET_CB_DUMP]) >> 16;
+}
+
 /* register and unregister set references */
 extern ip_set_id_t ip_set_get_byname(struct net *net,
 				     const char *name, struct ip_set **set);
@@ -351,13 +552,27 @@ extern int ip_set_test(ip_set_id_t id, const struct sk_buff *skb,
 /* Utility functions */
 extern void *ip_set_alloc(size_t size);
 extern void ip_set_free(void *members);
+extern void *ip_set_alloc_node(size_t size, int node);
+extern void **ip_set_replicas_alloc(size_t size);
+extern void ip_set_replicas_free(void **replicas);
+extern struct kmem_cache *ip_set_slab_get(size_t size);
+extern void ip_set_slab_put(struct kmem_cache *cache);
 extern int ip_set_get_ipaddr4(struct nlattr *nla,  __be32 *ipaddr);
 extern int ip_set_get_ipaddr6(struct nlattr *nla, union nf_inet_addr *ipaddr);
 extern size_t ip_set_elem_len(struct ip_set *set, struct nlattr *tb[],
 			      size_t len);
+extern int ip_set_put_stats(struct sk_buff *skb, struct ip_set *set);
 extern int ip_set_get_extensions(struct ip_set *set, struct nlattr *tb[],
 				 struct ip_set_ext *ext);
 
+/* The replica of the local NUMA node or NULL, if the node came online
+ * after the replicas were allocated */
+static inline void *
+ip_set_replica(void **replicas)
+{
+	return replicas[numa_node_id()];
+}
+
 static inline int
 ip_set_get_hostipaddr4(struct nlattr *nla, u32 *ipaddr)
 {
@@ -479,22 +694,79 @@ ip_set_put_extensions(struct sk_buff *skb, const struct ip_set *set,
 		      const void *e, bool active)
 {
 	if (SET_WITH_TIMEOUT(set)) {
-		unsigned long *timeout = ext_timeout(e, set);
+		u32 *timeout = ext_timeout(e, set);
 
 		if (nla_put_net32(skb, IPSET_ATTR_TIMEOUT,
-	    		  htonl(active ? ip_set_timeout_get(timeout)
+	    		  htonl(active ? ip_set_timeout_get(timeout, set)
 	    		  	: *timeout)))
 			return -EMSGSIZE;
 	}
 	if (SET_WITH_COUNTER(set) &&
-	    ip_set_put_counter(skb, ext_counter(e, set)))
+	    ip_set_put_counter(skb, set, ext_counter(e, set)))
 		return -EMSGSIZE;
 	if (SET_WITH_COMMENT(set) &&
-	    ip_set_put_comment(skb, ext_comment(e, set)))
+	    ip_set_put_comment(skb, set, ext_comment(e, set)))
+		return -EMSGSIZE;
+	return 0;
+}
+
+/* Packed listing of the elements, with the fixed size extensions only */
+static inline bool
+ip_set_list_packed(const struct ip_set *set, const struct netlink_callback *cb)
+{
+	return (ip_set_dump_flags(cb) & IPSET_FLAG_LIST_PACKED) &&
+	       set->variant->psize && !SET_WITH_COMMENT(set);
+}
+
+static inline u16
+ip_set_packed_flags(const struct ip_set *set)
+{
+	return (SET_WITH_TIMEOUT(set) ? IPSET_PACKED_TIMEOUT : 0) |
+	       (SET_WITH_COUNTER(set) ? IPSET_PACKED_COUNTERS : 0);
+}
+
+static inline u32
+ip_set_packed_rsize(const struct ip_set *set)
+{
+	return set->variant->psize +
+	       (SET_WITH_TIMEOUT(set) ? sizeof(__be32) : 0) +
+	       (SET_WITH_COUNTER(set) ? 2 * sizeof(__be64) : 0);
+}
+
+static inline int
+ip_set_put_packed_header(struct sk_buff *skb, const struct ip_set *set)
+{
+	__be16 *hdr = nla_reserve_nohdr(skb, 2 * sizeof(__be16));
+
+	if (!hdr)
 		return -EMSGSIZE;
+	hdr[0] = htons(ip_set_packed_rsize(set));
+	hdr[1] = htons(ip_set_packed_flags(set));
 	return 0;
 }
 
+/* Store the extensions after the key of a packed record */
+static inline void
+ip_set_pack_extensions(void *rec, const struct ip_set *set,
+		       const void *e, bool active)
+{
+	u64 bytes, packets;
+
+	if (SET_WITH_TIMEOUT(set)) {
+		u32 *timeout = ext_timeout(e, set);
+
+		put_unaligned_be32(active ? ip_set_timeout_get(timeout, set)
+					  : *timeout, rec);
+		rec += sizeof(__be32);
+	}
+	if (SET_WITH_COUNTER(set)) {
+		ip_set_read_counter(set, ext_counter(e, set),
+				    &bytes, &packets);
+		put_unaligned_be64(packets, rec);
+		put_unaligned_be64(bytes, rec + sizeof(__be64));
+	}
+}
+
 #define IP_SET_INIT_KEXT(skb, opt, set)			\
 	{ .bytes = (skb)->len, .packets = 1,		\
 	  .timeout = ip_set_adt_opt_timeout(opt, set) }
@@ -505,6 +777,24 @@ ip_set_put_extensions(struct sk_buff *skb, const struct ip_set *set,
 
 #define IP_SET_INIT_CIDR(a, b) ((a) ? (a) : (b))
 
+/* The element is copied into a new version of the set data, while the
+ * original is kept for a pending listing: the copy gets its own extension
+ * data. The copy of the per-CPU counters loses the updates done after
+ * reading them. */
+static inline void
+ip_set_ext_dup(struct ip_set *set, void *data)
+{
+	struct ip_set_ext ext = IP_SET_INIT_UEXT(set);
+
+	if (SET_WITH_PCPU_COUNTER(set)) {
+		ip_set_read_counter(set, ext_counter(data, set),
+				    &ext.bytes, &ext.packets);
+		ip_set_init_counter(set, ext_counter(data, set), &ext);
+	}
+	if (SET_WITH_COMMENT(set))
+		ip_set_comment_get(set, ext_comment(data, set));
+}
+
 #define IPSET_CONCAT(a, b)		a##b
 #define IPSET_TOKEN(a, b)		IPSET_CONCAT(a, b)
 
@@ -4,6 +4,7 @@
 #include <uapi/linux/netfilter/ipset/ip_set_bitmap.h>
 
 #define IPSET_BITMAP_MAX_RANGE	0x0000FFFF
+#define IPSET_CBITMAP_DEFAULT_MAXELEM	65536
 
 enum {
 	IPSET_ADD_FAILED = 1,
@@ -25,4 +26,11 @@ range_to_mask(u32 from, u32 to, u8 *bits)
 	return mask;
 }
 
+/* Size of the summary of the members: one bit per word */
+static inline size_t
+bitmap_summary_bytes(u32 elements)
+{
+	return BITS_TO_LONGS(BITS_TO_LONGS(elements)) * sizeof(unsigned long);
+}
+
 #endif /* __IP_SET_BITMAP_H */
@@ -16,42 +16,22 @@ ip_set_comment_uget(struct nlattr *tb)
 	return nla_data(tb);
 }
 
-static inline void
-ip_set_init_comment(struct ip_set_comment *comment,
-		    const struct ip_set_ext *ext)
+/* The memory of the interned comments is reported by the sets using them */
+static inline size_t
+ip_set_comment_memsize(const struct ip_set *set)
 {
-	size_t len = ext->comment ? strlen(ext->comment) : 0;
-
-	if (unlikely(comment->str)) {
-		kfree(comment->str);
-		comment->str = NULL;
-	}
-	if (!len)
-		return;
-	if (unlikely(len > IPSET_MAX_COMMENT_SIZE))
-		len = IPSET_MAX_COMMENT_SIZE;
-	comment->str = kzalloc(len + 1, GFP_ATOMIC);
-	if (unlikely(!comment->str))
-		return;
-	strlcpy(comment->str, ext->comment, len + 1);
-}
-
-static inline int
-ip_set_put_comment(struct sk_buff *skb, struct ip_set_comment *comment)
-{
-	if (!comment->str)
-		return 0;
-	return nla_put_string(skb, IPSET_ATTR_COMMENT, comment->str);
+	return set->comments ? set->comments->memsize : 0;
 }
 
-static inline void
-ip_set_comment_free(struct ip_set_comment *comment)
-{
-	if (unlikely(!comment->str))
-		return;
-	kfree(comment->str);
-	comment->str = NULL;
-}
+extern void ip_set_init_comment(struct ip_set *set,
+				struct ip_set_comment *comment,
+				const struct ip_set_ext *ext);
+extern int ip_set_put_comment(struct sk_buff *skb, const struct ip_set *set,
+			      const struct ip_set_comment *comment);
+extern void ip_set_comment_free(struct ip_set *set,
+				struct ip_set_comment *comment);
+extern void ip_set_comment_get(struct ip_set *set,
+			       const struct ip_set_comment *comment);
 
 #endif
 #endif
@@ -0,0 +1,9 @@
+#ifndef __IP_SET_INTERVAL_H
+#define __IP_SET_INTERVAL_H
+
+#include <uapi/linux/netfilter/ipset/ip_set_interval.h>
+
+
+#define IPSET_INTERVAL_DEFAULT_MAXELEM	65536
+
+#endif /* __IP_SET_INTERVAL_H */
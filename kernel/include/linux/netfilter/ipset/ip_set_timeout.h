@@ -10,6 +10,9 @@
 
 #ifdef __KERNEL__
 
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+
 /* How often should the gc be run by default */
 #define IPSET_GC_TIME			(3 * 60)
 
@@ -39,40 +42,108 @@ ip_set_timeout_uget(struct nlattr *tb)
 	return timeout == IPSET_NO_TIMEOUT ? IPSET_NO_TIMEOUT - 1 : timeout;
 }
 
-static inline bool
-ip_set_timeout_test(unsigned long timeout)
+/* The timeout of the elements is stored in 32 bits, as the number of
+ * seconds elapsed from the creation of the set (the epoch of the set)
+ * at which the element expires. */
+static inline u64
+ip_set_timeout_expires(const u32 *timeout, const struct ip_set *set)
 {
-	return timeout == IPSET_ELEM_PERMANENT ||
-	       time_is_after_jiffies(timeout);
+	return set->epoch + (u64)*timeout * HZ;
 }
 
 static inline bool
-ip_set_timeout_expired(unsigned long *timeout)
+ip_set_timeout_expired(const u32 *timeout, const struct ip_set *set)
 {
 	return *timeout != IPSET_ELEM_PERMANENT &&
-	       time_is_before_jiffies(*timeout);
+	       time_after64(get_jiffies_64(),
+			    ip_set_timeout_expires(timeout, set));
 }
 
 static inline void
-ip_set_timeout_set(unsigned long *timeout, u32 t)
+ip_set_timeout_set(u32 *timeout, u32 t, const struct ip_set *set)
 {
+	u64 now;
+
 	if (!t) {
 		*timeout = IPSET_ELEM_PERMANENT;
 		return;
 	}
 
-	*timeout = msecs_to_jiffies(t * 1000) + jiffies;
+	/* Round up: the element must not expire earlier than requested */
+	now = get_jiffies_64() - set->epoch + HZ - 1;
+	*timeout = (u32)div_u64(now, HZ) + t;
 	if (*timeout == IPSET_ELEM_PERMANENT)
 		/* Bingo! :-) */
 		(*timeout)--;
 }
 
 static inline u32
-ip_set_timeout_get(unsigned long *timeout)
+ip_set_timeout_get(const u32 *timeout, const struct ip_set *set)
+{
+	u64 expires, now = get_jiffies_64();
+
+	if (*timeout == IPSET_ELEM_PERMANENT)
+		return 0;
+	expires = ip_set_timeout_expires(timeout, set);
+	return time_after64(now, expires) ? 0 :
+		jiffies_to_msecs((unsigned long)(expires - now))/1000;
+}
+
+/* The timeout of the element in jiffies, for the expiry index */
+static inline unsigned long
+ip_set_timeout_jiffies(u32 timeout, const struct ip_set *set)
 {
-	return *timeout == IPSET_ELEM_PERMANENT ? 0 :
-		jiffies_to_msecs(*timeout - jiffies)/1000;
+	unsigned long expires;
+
+	if (timeout == IPSET_ELEM_PERMANENT)
+		return IPSET_ELEM_PERMANENT;
+	expires = (unsigned long)ip_set_timeout_expires(&timeout, set);
+	return expires == IPSET_ELEM_PERMANENT ? expires - 1 : expires;
 }
 
+/* Expiry index: the buckets of a set (hash buckets, bitmap blocks) are
+ * scheduled in a timer wheel by the earliest timeout of their elements,
+ * so that the garbage collector visits the due buckets only. The tick
+ * a bucket is scheduled at is recorded in its mark: the entries of the
+ * wheel with a different tick are stale and skipped. */
+#define IPSET_EXPIRY_SLOTS	256
+#define IPSET_EXPIRY_CHUNK	126	/* entries in a chunk: fits into 1k */
+#define IPSET_EXPIRY_NONE	0	/* mark of a not scheduled bucket */
+
+struct ip_set_expiry_entry {
+	u32 bucket;
+	u32 tick;
+};
+
+struct ip_set_expiry_chunk {
+	struct ip_set_expiry_chunk *next;
+	u32 len;
+	struct ip_set_expiry_entry entry[IPSET_EXPIRY_CHUNK];
+};
+
+struct ip_set_expiry {
+	spinlock_t lock;	/* kernel side adds may run parallel */
+	unsigned long epoch;	/* start of the next tick in jiffies */
+	unsigned long tick_len;	/* length of a tick in jiffies */
+	u32 next;		/* next tick to process */
+	u32 marks;		/* number of the marks below */
+	bool rescan;		/* index is lost, the whole set must be scanned */
+	size_t memsize;		/* memory size of the index */
+	struct ip_set_expiry_chunk *slot[IPSET_EXPIRY_SLOTS];
+	u32 mark[0];		/* marks, when not stored in the buckets */
+};
+
+extern struct ip_set_expiry *ip_set_expiry_alloc(u32 timeout, u32 marks);
+extern void ip_set_expiry_free(struct ip_set_expiry *e);
+extern void ip_set_expiry_flush(struct ip_set_expiry *e);
+extern void ip_set_expiry_schedule(struct ip_set_expiry *e, u32 *mark,
+				   u32 bucket, unsigned long timeout);
+extern void ip_set_expiry_run(struct ip_set_expiry *e, struct ip_set *set,
+			      void (*expire)(struct ip_set *set, u32 bucket,
+					     u32 tick));
+extern bool ip_set_expiry_evict(struct ip_set_expiry *e, struct ip_set *set,
+				bool (*evict)(struct ip_set *set, u32 bucket,
+					      u32 tick));
+
 #endif	/* __KERNEL__ */
 #endif /* _IP_SET_TIMEOUT_H */
@@ -19,8 +19,13 @@
 #define mtype_adt_elem		IPSET_TOKEN(MTYPE, _adt_elem)
 #define mtype_add_timeout	IPSET_TOKEN(MTYPE, _add_timeout)
 #define mtype_gc_init		IPSET_TOKEN(MTYPE, _gc_init)
+#define mtype_replicas_init	IPSET_TOKEN(MTYPE, _replicas_init)
+#define mtype_sync_member	IPSET_TOKEN(MTYPE, _sync_member)
+#define mtype_next_member	IPSET_TOKEN(MTYPE, _next_member)
+#define mtype_expire_block	IPSET_TOKEN(MTYPE, _expire_block)
 #define mtype_kadt		IPSET_TOKEN(MTYPE, _kadt)
 #define mtype_uadt		IPSET_TOKEN(MTYPE, _uadt)
+#define mtype_free		IPSET_TOKEN(MTYPE, _free)
 #define mtype_destroy		IPSET_TOKEN(MTYPE, _destroy)
 #define mtype_flush		IPSET_TOKEN(MTYPE, _flush)
 #define mtype_head		IPSET_TOKEN(MTYPE, _head)
@@ -35,16 +40,91 @@
 
 #define get_ext(set, map, id)	((map)->extensions + (set)->dsize * (id))
 
-static void
+/* The elements are scheduled in blocks in the expiry index */
+#define EXPIRY_BLOCK		BITS_PER_LONG
+
+static int
 mtype_gc_init(struct ip_set *set, void (*gc)(unsigned long ul_set))
 {
 	struct mtype *map = set->data;
 
 	init_timer(&map->gc);
+	map->expiry = ip_set_expiry_alloc(set->timeout,
+				DIV_ROUND_UP(map->elements, EXPIRY_BLOCK));
+	if (!map->expiry)
+		return -ENOMEM;
 	map->gc.data = (unsigned long) set;
 	map->gc.function = gc;
 	map->gc.expires = jiffies + IPSET_GC_PERIOD(set->timeout) * HZ;
 	add_timer(&map->gc);
+	return 0;
+}
+
+/* Keep a copy of the members on every NUMA node, if requested.
+ * The packet path tests the copy of the local node, the changes
+ * are written through to all of the copies. */
+static int
+mtype_replicas_init(struct ip_set *set, struct nlattr *tb[])
+{
+	struct mtype *map = set->data;
+
+	if (!tb[IPSET_ATTR_CADT_FLAGS] ||
+	    !(ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]) &
+	      IPSET_FLAG_WITH_REPLICAS))
+		return 0;
+	map->replicas = ip_set_replicas_alloc(map->memsize);
+	if (!map->replicas)
+		return -ENOMEM;
+	set->cadt_flags |= IPSET_FLAG_WITH_REPLICAS;
+	return 0;
+}
+
+/* Copy the state of the member to the summary and to the replicas.
+ * The summary bitmap has one bit per word of the members bitmap,
+ * which is set when the word is not empty. */
+static void
+mtype_sync_member(const struct mtype *map, u32 id)
+{
+	const unsigned long *members = map->members;
+	bool member = test_bit(id, map->members);
+	void *r;
+	int node;
+
+	if (members[BIT_WORD(id)])
+		set_bit(BIT_WORD(id), map->summary);
+	else
+		clear_bit(BIT_WORD(id), map->summary);
+	if (!map->replicas)
+		return;
+	for_each_node(node) {
+		r = map->replicas[node];
+		if (!r)
+			continue;
+		if (member)
+			set_bit(id, r);
+		else
+			clear_bit(id, r);
+	}
+}
+
+/* The first member from id on or map->elements, if there is none:
+ * the empty words of the members are skipped by the summary */
+static u32
+mtype_next_member(const struct mtype *map, u32 id)
+{
+	u32 words = BITS_TO_LONGS(map->elements), word, end;
+
+	while (id < map->elements) {
+		word = find_next_bit(map->summary, words, BIT_WORD(id));
+		if (word >= words)
+			break;
+		id = max_t(u32, id, word * BITS_PER_LONG);
+		end = min_t(u32, (word + 1) * BITS_PER_LONG, map->elements);
+		id = find_next_bit(map->members, end, id);
+		if (id < end)
+			return id;
+	}
+	return map->elements;
 }
 
 static void
@@ -53,20 +133,25 @@ mtype_ext_cleanup(struct ip_set *set)
 	struct mtype *map = set->data;
 	u32 id;
 
-	for (id = 0; id < map->elements; id++)
-		if (test_bit(id, map->members))
-			ip_set_ext_destroy(set, get_ext(set, map, id));
+	for (id = mtype_next_member(map, 0); id < map->elements;
+	     id = mtype_next_member(map, id + 1))
+		ip_set_ext_destroy(set, get_ext(set, map, id));
 }
 
+/* Free up the map, without the gc: the create functions call it
+ * directly when they fail before the gc timer is set up */
 static void
-mtype_destroy(struct ip_set *set)
+mtype_free(struct ip_set *set)
 {
 	struct mtype *map = set->data;
 
-	if (SET_WITH_TIMEOUT(set))
-		del_timer_sync(&map->gc);
+	if (map->expiry)
+		ip_set_expiry_free(map->expiry);
 
 	ip_set_free(map->members);
+	ip_set_free(map->summary);
+	if (map->replicas)
+		ip_set_replicas_free(map->replicas);
 	if (set->dsize) {
 		if (set->extensions & IPSET_EXT_DESTROY)
 			mtype_ext_cleanup(set);
@@ -77,6 +162,16 @@ mtype_destroy(struct ip_set *set)
 	set->data = NULL;
 }
 
+static void
+mtype_destroy(struct ip_set *set)
+{
+	struct mtype *map = set->data;
+
+	if (SET_WITH_TIMEOUT(set))
+		del_timer_sync(&map->gc);
+	mtype_free(set);
+}
+
 static void
 mtype_flush(struct ip_set *set)
 {
@@ -85,6 +180,16 @@ mtype_flush(struct ip_set *set)
 	if (set->extensions & IPSET_EXT_DESTROY)
 		mtype_ext_cleanup(set);
 	memset(map->members, 0, map->memsize);
+	memset(map->summary, 0, bitmap_summary_bytes(map->elements));
+	if (map->replicas) {
+		int node;
+
+		for_each_node(node)
+			if (map->replicas[node])
+				memset(map->replicas[node], 0, map->memsize);
+	}
+	if (map->expiry)
+		ip_set_expiry_flush(map->expiry);
 }
 
 static int
@@ -97,13 +202,21 @@ mtype_head(struct ip_set *set, struct sk_buff *skb)
 	if (!nested)
 		goto nla_put_failure;
 	if (mtype_do_head(skb, map) ||
+	    nla_put_net32(skb, IPSET_ATTR_ELEMENTS,
+			  htonl(bitmap_weight(map->members, map->elements))) ||
 	    nla_put_net32(skb, IPSET_ATTR_REFERENCES, htonl(set->ref - 1)) ||
 	    nla_put_net32(skb, IPSET_ATTR_MEMSIZE,
 			  htonl(sizeof(*map) +
 				map->memsize +
-				set->dsize * map->elements)))
+				bitmap_summary_bytes(map->elements) +
+				(map->replicas ?
+				 num_online_nodes() * map->memsize : 0) +
+				set->dsize * map->elements +
+				(map->expiry ? map->expiry->memsize : 0) +
+				ip_set_comment_memsize(set))))
 		goto nla_put_failure;
-	if (unlikely(ip_set_put_flags(skb, set)))
+	if (unlikely(ip_set_put_flags(skb, set) ||
+		     ip_set_put_stats(skb, set)))
 		goto nla_put_failure;
 	ipset_nest_end(skb, nested);
 
@@ -119,15 +232,24 @@ mtype_test(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 	struct mtype *map = set->data;
 	const struct mtype_adt_elem *e = value;
 	void *x = get_ext(set, map, e->id);
-	int ret = mtype_do_test(e, map, set->dsize);
-
+	void *members;
+	int ret;
+
+	if (map->replicas) {
+		members = ip_set_replica(map->replicas);
+		/* Without extensions the local copy decides alone */
+		if (members && (!test_bit(e->id, members) || !set->dsize))
+			return !!test_bit(e->id, members);
+	}
+	ret = mtype_do_test(e, map, set->dsize);
 	if (ret <= 0)
 		return ret;
 	if (SET_WITH_TIMEOUT(set) &&
-	    ip_set_timeout_expired(ext_timeout(x, set)))
+	    ip_set_timeout_expired(ext_timeout(x, set), set))
 		return 0;
 	if (SET_WITH_COUNTER(set))
-		ip_set_update_counter(ext_counter(x, set), ext, mext, flags);
+		ip_set_update_counter(set, ext_counter(x, set), ext, mext,
+				      flags);
 	return 1;
 }
 
@@ -142,7 +264,7 @@ mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 
 	if (ret == IPSET_ADD_FAILED) {
 		if (SET_WITH_TIMEOUT(set) &&
-		    ip_set_timeout_expired(ext_timeout(x, set)))
+		    ip_set_timeout_expired(ext_timeout(x, set), set))
 			ret = 0;
 		else if (!(flags & IPSET_FLAG_EXIST))
 			return -IPSET_ERR_EXIST;
@@ -150,17 +272,24 @@ mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 		ip_set_ext_destroy(set, x);
 	}
 
-	if (SET_WITH_TIMEOUT(set))
+	if (SET_WITH_TIMEOUT(set)) {
 #ifdef IP_SET_BITMAP_STORED_TIMEOUT
 		mtype_add_timeout(ext_timeout(x, set), e, ext, set, map, ret);
 #else
-		ip_set_timeout_set(ext_timeout(x, set), ext->timeout);
+		ip_set_timeout_set(ext_timeout(x, set), ext->timeout, set);
 #endif
+		if (mtype_gc_test(e->id, map, set->dsize))
+			ip_set_expiry_schedule(map->expiry,
+				&map->expiry->mark[e->id / EXPIRY_BLOCK],
+				e->id / EXPIRY_BLOCK,
+				ip_set_timeout_jiffies(*ext_timeout(x, set), set));
+	}
 
 	if (SET_WITH_COUNTER(set))
-		ip_set_init_counter(ext_counter(x, set), ext);
+		ip_set_init_counter(set, ext_counter(x, set), ext);
 	if (SET_WITH_COMMENT(set))
-		ip_set_init_comment(ext_comment(x, set), ext);
+		ip_set_init_comment(set, ext_comment(x, set), ext);
+	mtype_sync_member(map, e->id);
 	return 0;
 }
 
@@ -175,9 +304,10 @@ mtype_del(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 	if (mtype_do_del(e, map))
 		return -IPSET_ERR_EXIST;
 
+	mtype_sync_member(map, e->id);
 	ip_set_ext_destroy(set, x);
 	if (SET_WITH_TIMEOUT(set) &&
-	    ip_set_timeout_expired(ext_timeout(x, set)))
+	    ip_set_timeout_expired(ext_timeout(x, set), set))
 		return -IPSET_ERR_EXIST;
 
 	return 0;
@@ -192,7 +322,7 @@ mtype_is_filled(const struct mtype_elem *x)
 #endif
 
 static int
-mtype_list(const struct ip_set *set,
+mtype_list(struct ip_set *set,
 	   struct sk_buff *skb, struct netlink_callback *cb)
 {
 	struct mtype *map = set->data;
@@ -203,16 +333,15 @@ mtype_list(const struct ip_set *set,
 	adt = ipset_nest_start(skb, IPSET_ATTR_ADT);
 	if (!adt)
 		return -EMSGSIZE;
-	for (; cb->args[IPSET_CB_ARG0] < map->elements;
-	     cb->args[IPSET_CB_ARG0]++) {
-		id = cb->args[IPSET_CB_ARG0];
+	for (id = mtype_next_member(map, first); id < map->elements;
+	     id = mtype_next_member(map, id + 1)) {
+		cb->args[IPSET_CB_ARG0] = id;
 		x = get_ext(set, map, id);
-		if (!test_bit(id, map->members) ||
-		    (SET_WITH_TIMEOUT(set) &&
+		if (SET_WITH_TIMEOUT(set) &&
 #ifdef IP_SET_BITMAP_STORED_TIMEOUT
-		     mtype_is_filled((const struct mtype_elem *) x) &&
+		    mtype_is_filled((const struct mtype_elem *) x) &&
 #endif
-		     ip_set_timeout_expired(ext_timeout(x, set))))
+		    ip_set_timeout_expired(ext_timeout(x, set), set))
 			continue;
 		nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
 		if (!nested) {
@@ -246,26 +375,63 @@ nla_put_failure:
 	return 0;
 }
 
+/* Delete the expired elements of a block which is due in the expiry index
+ * and schedule it again by the earliest timeout of the remaining ones */
+static void
+mtype_expire_block(struct ip_set *set, u32 block, u32 tick)
+{
+	struct mtype *map = set->data;
+	u32 timeout = IPSET_ELEM_PERMANENT, *t;
+	u32 *mark = &map->expiry->mark[block];
+	u32 id, last = min_t(u32, (block + 1) * EXPIRY_BLOCK, map->elements);
+	void *x;
+
+	if (*mark != tick)
+		/* Stale entry: the block is scheduled at another tick */
+		return;
+	*mark = IPSET_EXPIRY_NONE;
+	for (id = find_next_bit(map->members, last, block * EXPIRY_BLOCK);
+	     id < last; id = find_next_bit(map->members, last, id + 1)) {
+		if (!mtype_gc_test(id, map, set->dsize))
+			continue;
+		x = get_ext(set, map, id);
+		t = ext_timeout(x, set);
+		if (ip_set_timeout_expired(t, set)) {
+			clear_bit(id, map->members);
+			mtype_sync_member(map, id);
+			ip_set_ext_destroy(set, x);
+			ip_set_stats_inc(set, expired);
+		} else if (*t != IPSET_ELEM_PERMANENT &&
+			   (timeout == IPSET_ELEM_PERMANENT || *t < timeout))
+			timeout = *t;
+	}
+	ip_set_expiry_schedule(map->expiry, mark, block,
+			       ip_set_timeout_jiffies(timeout, set));
+}
+
 static void
 mtype_gc(unsigned long ul_set)
 {
 	struct ip_set *set = (struct ip_set *) ul_set;
 	struct mtype *map = set->data;
-	void *x;
-	u32 id;
+	ktime_t start = ip_set_stats_start(set);
+	u32 block;
 
 	/* We run parallel with other readers (test element)
 	 * but adding/deleting new entries is locked out */
 	read_lock_bh(&set->lock);
-	for (id = 0; id < map->elements; id++)
-		if (mtype_gc_test(id, map, set->dsize)) {
-			x = get_ext(set, map, id);
-			if (ip_set_timeout_expired(ext_timeout(x, set))) {
-				clear_bit(id, map->members);
-				ip_set_ext_destroy(set, x);
-			}
-		}
+	if (map->expiry->rescan) {
+		/* The flushed marks match the not scheduled blocks.
+		 * A block is a word of the members: the empty ones
+		 * are skipped by the summary. */
+		ip_set_expiry_flush(map->expiry);
+		for_each_set_bit(block, map->summary, map->expiry->marks)
+			mtype_expire_block(set, block, IPSET_EXPIRY_NONE);
+	} else
+		ip_set_expiry_run(map->expiry, set, mtype_expire_block);
 	read_unlock_bh(&set->lock);
+	ip_set_stats_inc(set, gc_runs);
+	ip_set_stats_time(set, gc_time, start);
 
 	map->gc.expires = jiffies + IPSET_GC_PERIOD(set->timeout) * HZ;
 	add_timer(&map->gc);
@@ -27,7 +27,9 @@
 
 #define IPSET_TYPE_REV_MIN	0
 /*				1	   Counter support added */
-#define IPSET_TYPE_REV_MAX	2	/* Comment support added */
+/*				2	   Comment support added */
+/*				3	   Per-CPU counters support added */
+#define IPSET_TYPE_REV_MAX	4	/* Per NUMA node replicas added */
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Jozsef Kadlecsik <kadlec@blackhole.kfki.hu>");
@@ -39,6 +41,8 @@ MODULE_ALIAS("ip_set_bitmap:ip");
 /* Type structure */
 struct bitmap_ip {
 	void *members;		/* the set members */
+	void *summary;		/* non-empty words of members */
+	void **replicas;	/* copies of members per NUMA node */
 	void *extensions;	/* data extensions */
 	u32 first_ip;		/* host byte order, included in range */
 	u32 last_ip;		/* host byte order, included in range */
@@ -47,6 +51,7 @@ struct bitmap_ip {
 	size_t memsize;		/* members size */
 	u8 netmask;		/* subnet netmask */
 	struct timer_list gc;	/* garbage collection */
+	struct ip_set_expiry *expiry; /* elements by timeout */
 };
 
 /* ADT structure for generic function args */
@@ -221,9 +226,15 @@ init_map_ip(struct ip_set *set, struct bitmap_ip *map,
 	map->members = ip_set_alloc(map->memsize);
 	if (!map->members)
 		return false;
+	map->summary = ip_set_alloc(bitmap_summary_bytes(elements));
+	if (!map->summary) {
+		ip_set_free(map->members);
+		return false;
+	}
 	if (set->dsize) {
 		map->extensions = ip_set_alloc(set->dsize * elements);
 		if (!map->extensions) {
+			ip_set_free(map->summary);
 			kfree(map->members);
 			return false;
 		}
@@ -324,9 +335,18 @@ bitmap_ip_create(struct net *net, struct ip_set *set, struct nlattr *tb[],
 		kfree(map);
 		return -ENOMEM;
 	}
+	ret = bitmap_ip_replicas_init(set, tb);
+	if (ret) {
+		bitmap_ip_free(set);
+		return ret;
+	}
 	if (tb[IPSET_ATTR_TIMEOUT]) {
 		set->timeout = ip_set_timeout_uget(tb[IPSET_ATTR_TIMEOUT]);
-		bitmap_ip_gc_init(set, bitmap_ip_gc);
+		ret = bitmap_ip_gc_init(set, bitmap_ip_gc);
+		if (ret) {
+			bitmap_ip_destroy(set);
+			return ret;
+		}
 	}
 	return 0;
 }
@@ -27,7 +27,9 @@
 
 #define IPSET_TYPE_REV_MIN	0
 /*				1	   Counter support added */
-#define IPSET_TYPE_REV_MAX	2	/* Comment support added */
+/*				2	   Comment support added */
+/*				3	   Per-CPU counters support added */
+#define IPSET_TYPE_REV_MAX	4	/* Per NUMA node replicas added */
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Jozsef Kadlecsik <kadlec@blackhole.kfki.hu>");
@@ -45,12 +47,15 @@ enum {
 /* Type structure */
 struct bitmap_ipmac {
 	void *members;		/* the set members */
+	void *summary;		/* non-empty words of members */
+	void **replicas;	/* copies of members per NUMA node */
 	void *extensions;	/* MAC + data extensions */
 	u32 first_ip;		/* host byte order, included in range */
 	u32 last_ip;		/* host byte order, included in range */
 	u32 elements;		/* number of max elements in the set */
 	size_t memsize;		/* members size */
 	struct timer_list gc;	/* garbage collector */
+	struct ip_set_expiry *expiry; /* elements by timeout */
 };
 
 /* ADT structure for generic function args */
@@ -113,7 +118,7 @@ bitmap_ipmac_is_filled(const struct bitmap_ipmac_elem *elem)
 }
 
 static inline int
-bitmap_ipmac_add_timeout(unsigned long *timeout,
+bitmap_ipmac_add_timeout(u32 *timeout,
 			 const struct bitmap_ipmac_adt_elem *e,
 			 const struct ip_set_ext *ext, struct ip_set *set,
 			 struct bitmap_ipmac *map, int mode)
@@ -124,14 +129,14 @@ bitmap_ipmac_add_timeout(unsigned long *timeout,
 		if (t == set->timeout)
 			/* Timeout was not specified, get stored one */
 			t = *timeout;
-		ip_set_timeout_set(timeout, t);
+		ip_set_timeout_set(timeout, t, set);
 	} else {
 		/* If MAC is unset yet, we store plain timeout value
 		 * because the timer is not activated yet
 		 * and we can reuse it later when MAC is filled out,
 		 * possibly by the kernel */
 		if (e->ether)
-			ip_set_timeout_set(timeout, t);
+			ip_set_timeout_set(timeout, t, set);
 		else
 			*timeout = t;
 	}
@@ -290,9 +295,15 @@ init_map_ipmac(struct ip_set *set, struct bitmap_ipmac *map,
 	map->members = ip_set_alloc(map->memsize);
 	if (!map->members)
 		return false;
+	map->summary = ip_set_alloc(bitmap_summary_bytes(elements));
+	if (!map->summary) {
+		ip_set_free(map->members);
+		return false;
+	}
 	if (set->dsize) {
 		map->extensions = ip_set_alloc(set->dsize * elements);
 		if (!map->extensions) {
+			ip_set_free(map->summary);
 			kfree(map->members);
 			return false;
 		}
@@ -362,9 +373,18 @@ bitmap_ipmac_create(struct net *net, struct ip_set *set, struct nlattr *tb[],
 		kfree(map);
 		return -ENOMEM;
 	}
+	ret = bitmap_ipmac_replicas_init(set, tb);
+	if (ret) {
+		bitmap_ipmac_free(set);
+		return ret;
+	}
 	if (tb[IPSET_ATTR_TIMEOUT]) {
 		set->timeout = ip_set_timeout_uget(tb[IPSET_ATTR_TIMEOUT]);
-		bitmap_ipmac_gc_init(set, bitmap_ipmac_gc);
+		ret = bitmap_ipmac_gc_init(set, bitmap_ipmac_gc);
+		if (ret) {
+			bitmap_ipmac_destroy(set);
+			return ret;
+		}
 	}
 	return 0;
 }
@@ -22,7 +22,9 @@
 
 #define IPSET_TYPE_REV_MIN	0
 /*				1	   Counter support added */
-#define IPSET_TYPE_REV_MAX	2	/* Comment support added */
+/*				2	   Comment support added */
+/*				3	   Per-CPU counters support added */
+#define IPSET_TYPE_REV_MAX	4	/* Per NUMA node replicas added */
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Jozsef Kadlecsik <kadlec@blackhole.kfki.hu>");
@@ -34,12 +36,15 @@ MODULE_ALIAS("ip_set_bitmap:port");
 /* Type structure */
 struct bitmap_port {
 	void *members;		/* the set members */
+	void *summary;		/* non-empty words of members */
+	void **replicas;	/* copies of members per NUMA node */
 	void *extensions;	/* data extensions */
 	u16 first_port;		/* host byte order, included in range */
 	u16 last_port;		/* host byte order, included in range */
 	u32 elements;		/* number of max elements in the set */
 	size_t memsize;		/* members size */
 	struct timer_list gc;	/* garbage collection */
+	struct ip_set_expiry *expiry; /* elements by timeout */
 };
 
 /* ADT structure for generic function args */
@@ -210,9 +215,15 @@ init_map_port(struct ip_set *set, struct bitmap_port *map,
 	map->members = ip_set_alloc(map->memsize);
 	if (!map->members)
 		return false;
+	map->summary = ip_set_alloc(bitmap_summary_bytes(map->elements));
+	if (!map->summary) {
+		ip_set_free(map->members);
+		return false;
+	}
 	if (set->dsize) {
 		map->extensions = ip_set_alloc(set->dsize * map->elements);
 		if (!map->extensions) {
+			ip_set_free(map->summary);
 			kfree(map->members);
 			return false;
 		}
@@ -233,6 +244,7 @@ bitmap_port_create(struct net *net, struct ip_set *set, struct nlattr *tb[],
 {
 	struct bitmap_port *map;
 	u16 first_port, last_port;
+	int ret;
 
 	if (unlikely(!ip_set_attr_netorder(tb, IPSET_ATTR_PORT) ||
 		     !ip_set_attr_netorder(tb, IPSET_ATTR_PORT_TO) ||
@@ -261,9 +273,18 @@ bitmap_port_create(struct net *net, struct ip_set *set, struct nlattr *tb[],
 		kfree(map);
 		return -ENOMEM;
 	}
+	ret = bitmap_port_replicas_init(set, tb);
+	if (ret) {
+		bitmap_port_free(set);
+		return ret;
+	}
 	if (tb[IPSET_ATTR_TIMEOUT]) {
 		set->timeout = ip_set_timeout_uget(tb[IPSET_ATTR_TIMEOUT]);
-		bitmap_port_gc_init(set, bitmap_port_gc);
+		ret = bitmap_port_gc_init(set, bitmap_port_gc);
+		if (ret) {
+			bitmap_port_destroy(set);
+			return ret;
+		}
 	}
 	return 0;
 }
@@ -0,0 +1,1231 @@
+/* Copyright (C) 2013 Jozsef Kadlecsik <kadlec@blackhole.kfki.hu>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/* Kernel module implementing an IP set type: the cbitmap:ip type */
+
+#include <linux/module.h>
+#include <linux/ip.h>
+#include <linux/skbuff.h>
+#include <linux/errno.h>
+#include <linux/bitmap.h>
+#include <linux/bitops.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/netlink.h>
+#include <linux/jiffies.h>
+#include <linux/timer.h>
+#include <net/netlink.h>
+
+#include <linux/netfilter/ipset/pfxlen.h>
+#include <linux/netfilter/ipset/ip_set.h>
+#include <linux/netfilter/ipset/ip_set_bitmap.h>
+
+#define IPSET_TYPE_REV_MIN	0
+#define IPSET_TYPE_REV_MAX	0
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Jozsef Kadlecsik <kadlec@blackhole.kfki.hu>");
+IP_SET_MODULE_DESC("cbitmap:ip", IPSET_TYPE_REV_MIN, IPSET_TYPE_REV_MAX);
+MODULE_ALIAS("ip_set_cbitmap:ip");
+
+/* Compressed bitmap of IPv4 addresses
+ *
+ * The range of the set is split into chunks by the upper 16 bits of the
+ * addresses. A chunk with members has a container of the lower 16 bits
+ * of the members, in one of the representations:
+ *
+ * - array: the sorted values, up to CBITMAP_ARRAY_MAX members
+ * - bitmap: one bit for every value of the chunk
+ * - run: the sorted, neither overlapping nor adjacent ranges of values
+ *
+ * Single adds and deletes keep the arrays and the runs within their
+ * limits by converting the container into a bitmap, and a bitmap is
+ * converted back when it becomes small enough. Ranges are added and
+ * deleted in the bitmap form of the containers, then the result is
+ * stored in the smallest representation. The empty containers are freed.
+ *
+ * The extensions are stored out of line: a container of a set with
+ * extensions has a sorted array of the elements with the extension data
+ * of all of its members. Ranges are added to and deleted from such sets
+ * address by address and the containers are never converted into runs,
+ * so deleting a member never needs memory.
+ *
+ * The set is changed with the set write-locked, including the garbage
+ * collector, while the readers hold the read lock, so the containers
+ * are changed in place.
+ */
+
+#define CBITMAP_CHUNK_SIZE	(1 << 16)
+#define CBITMAP_LOW(ip)		((ip) & (CBITMAP_CHUNK_SIZE - 1))
+#define CBITMAP_BITMAP_BYTES	(CBITMAP_CHUNK_SIZE / BITS_PER_BYTE)
+/* The array and the run containers are not larger than a bitmap */
+#define CBITMAP_ARRAY_MAX	(CBITMAP_BITMAP_BYTES / sizeof(u16))
+#define CBITMAP_RUN_MAX		\
+	(CBITMAP_BITMAP_BYTES / sizeof(struct cbitmap_run))
+
+enum {
+	CBITMAP_ARRAY,
+	CBITMAP_BITMAP,
+	CBITMAP_RUN,
+};
+
+/* Inclusive range of values */
+struct cbitmap_run {
+	u16 start;
+	u16 last;
+};
+
+/* The members of a chunk */
+struct cbitmap_container {
+	u8 type;		/* representation of the members */
+	u32 card;		/* number of the members */
+	u32 n;			/* number of the values or runs */
+	u32 size;		/* allocated values or runs */
+	void *data;		/* values, bits or runs */
+	u32 nrec;		/* number of the elements with extensions */
+	u32 rsize;		/* allocated elements */
+	void *recs;		/* elements with extensions, sorted */
+};
+
+#define cbitmap_rec(c, i, dsize)	((c)->recs + (size_t)(i) * (dsize))
+
+/* Type structure */
+struct cbitmap_ip {
+	struct cbitmap_container **chunks; /* containers of the chunks */
+	u32 first_ip;		/* host byte order, included in range */
+	u32 last_ip;		/* host byte order, included in range */
+	u32 nchunks;		/* number of the chunks */
+	u32 elements;		/* number of the members */
+	u32 maxelem;		/* max members with extensions */
+	struct timer_list gc;	/* garbage collection */
+};
+
+/* Member element with extensions: the lower 16 bits of the address */
+struct cbitmap_ip_elem {
+	u16 low;
+};
+
+/* ADT structure for generic function args: the range of addresses */
+struct cbitmap_ip_adt_elem {
+	u32 from;
+	u32 to;
+};
+
+static inline u32
+ip_to_chunk(const struct cbitmap_ip *m, u32 ip)
+{
+	return (ip >> 16) - (m->first_ip >> 16);
+}
+
+/* Container functions */
+
+/* The position of the first value not below v */
+static u32
+cbitmap_array_lb(const u16 *values, u32 n, u32 v)
+{
+	u32 lo = 0, hi = n, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (values[mid] < v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* The position of the first run not ending below v */
+static u32
+cbitmap_run_lb(const struct cbitmap_run *runs, u32 n, u32 v)
+{
+	u32 lo = 0, hi = n, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (runs[mid].last < v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static bool
+cbitmap_test(const struct cbitmap_container *c, u32 v)
+{
+	const struct cbitmap_run *runs;
+	const u16 *values;
+	u32 i;
+
+	switch (c->type) {
+	case CBITMAP_ARRAY:
+		values = c->data;
+		i = cbitmap_array_lb(values, c->n, v);
+		return i < c->n && values[i] == v;
+	case CBITMAP_BITMAP:
+		return test_bit(v, c->data);
+	default:
+		runs = c->data;
+		i = cbitmap_run_lb(runs, c->n, v);
+		return i < c->n && runs[i].start <= v;
+	}
+}
+
+/* The first member from v on, CBITMAP_CHUNK_SIZE if there is none,
+ * and the last one of the consecutive members from it in last */
+static u32
+cbitmap_next(const struct cbitmap_container *c, u32 v, u32 *last)
+{
+	const struct cbitmap_run *runs;
+	const u16 *values;
+	u32 i, first;
+
+	if (v >= CBITMAP_CHUNK_SIZE)
+		return CBITMAP_CHUNK_SIZE;
+	switch (c->type) {
+	case CBITMAP_ARRAY:
+		values = c->data;
+		i = cbitmap_array_lb(values, c->n, v);
+		if (i == c->n)
+			return CBITMAP_CHUNK_SIZE;
+		first = *last = values[i];
+		while (++i < c->n && values[i] == *last + 1)
+			(*last)++;
+		return first;
+	case CBITMAP_BITMAP:
+		first = find_next_bit(c->data, CBITMAP_CHUNK_SIZE, v);
+		if (first < CBITMAP_CHUNK_SIZE)
+			*last = find_next_zero_bit(c->data, CBITMAP_CHUNK_SIZE,
+						   first) - 1;
+		return first;
+	default:
+		runs = c->data;
+		i = cbitmap_run_lb(runs, c->n, v);
+		if (i == c->n)
+			return CBITMAP_CHUNK_SIZE;
+		*last = runs[i].last;
+		return max_t(u32, v, runs[i].start);
+	}
+}
+
+static size_t
+cbitmap_data_size(const struct cbitmap_container *c)
+{
+	switch (c->type) {
+	case CBITMAP_ARRAY:
+		return c->size * sizeof(u16);
+	case CBITMAP_BITMAP:
+		return CBITMAP_BITMAP_BYTES;
+	default:
+		return c->size * sizeof(struct cbitmap_run);
+	}
+}
+
+/* Make room for one more value or run */
+static int
+cbitmap_grow(struct cbitmap_container *c)
+{
+	size_t esize = c->type == CBITMAP_ARRAY ? sizeof(u16)
+						: sizeof(struct cbitmap_run);
+	u32 size = c->size ? 2 * c->size : 4;
+	void *data;
+
+	if (c->n < c->size)
+		return 0;
+	data = krealloc(c->data, size * esize, GFP_ATOMIC);
+	if (!data)
+		return -ENOMEM;
+	c->data = data;
+	c->size = size;
+	return 0;
+}
+
+/* Store the members in a bitmap */
+static int
+cbitmap_to_bitmap(struct cbitmap_container *c)
+{
+	const struct cbitmap_run *runs;
+	const u16 *values;
+	unsigned long *bits;
+	u32 i;
+
+	if (c->type == CBITMAP_BITMAP)
+		return 0;
+	bits = kzalloc(CBITMAP_BITMAP_BYTES, GFP_ATOMIC);
+	if (!bits)
+		return -ENOMEM;
+	if (c->type == CBITMAP_ARRAY) {
+		values = c->data;
+		for (i = 0; i < c->n; i++)
+			__set_bit(values[i], bits);
+	} else {
+		runs = c->data;
+		for (i = 0; i < c->n; i++)
+			bitmap_set(bits, runs[i].start,
+				   runs[i].last - runs[i].start + 1);
+	}
+	kfree(c->data);
+	c->data = bits;
+	c->type = CBITMAP_BITMAP;
+	c->n = c->size = 0;
+	return 0;
+}
+
+/* Store the members of a bitmap container in the smallest representation,
+ * the runs are allowed for the sets without extensions only. The container
+ * is kept as it is if the memory cannot be allocated. */
+static void
+cbitmap_shrink(struct cbitmap_container *c, bool run)
+{
+	const unsigned long *bits = c->data;
+	struct cbitmap_run *runs;
+	u32 n = 0, v, last = 0, i = 0;
+	u16 *values;
+	size_t size;
+
+	if (c->type != CBITMAP_BITMAP || !c->card)
+		return;
+	if (run)
+		for (v = find_next_bit(bits, CBITMAP_CHUNK_SIZE, 0);
+		     v < CBITMAP_CHUNK_SIZE;
+		     v = find_next_bit(bits, CBITMAP_CHUNK_SIZE, last + 1)) {
+			last = find_next_zero_bit(bits, CBITMAP_CHUNK_SIZE,
+						  v) - 1;
+			n++;
+		}
+	size = c->card <= CBITMAP_ARRAY_MAX ? c->card * sizeof(u16)
+					    : CBITMAP_BITMAP_BYTES;
+	if (run && n * sizeof(struct cbitmap_run) < size) {
+		runs = kmalloc(n * sizeof(struct cbitmap_run), GFP_ATOMIC);
+		if (!runs)
+			return;
+		for (v = find_next_bit(bits, CBITMAP_CHUNK_SIZE, 0);
+		     v < CBITMAP_CHUNK_SIZE;
+		     v = find_next_bit(bits, CBITMAP_CHUNK_SIZE, last + 1)) {
+			last = find_next_zero_bit(bits, CBITMAP_CHUNK_SIZE,
+						  v) - 1;
+			runs[i].start = v;
+			runs[i++].last = last;
+		}
+		kfree(c->data);
+		c->data = runs;
+		c->type = CBITMAP_RUN;
+	} else if (c->card <= CBITMAP_ARRAY_MAX) {
+		n = c->card;
+		values = kmalloc(n * sizeof(u16), GFP_ATOMIC);
+		if (!values)
+			return;
+		for_each_set_bit(v, bits, CBITMAP_CHUNK_SIZE)
+			values[i++] = v;
+		kfree(c->data);
+		c->data = values;
+		c->type = CBITMAP_ARRAY;
+	} else
+		return;
+	c->n = c->size = n;
+}
+
+/* Insert v, which is not a member, into the runs */
+static int
+cbitmap_run_add(struct cbitmap_container *c, u32 v)
+{
+	struct cbitmap_run *runs = c->data;
+	u32 i = cbitmap_run_lb(runs, c->n, v);
+	bool prev = i > 0 && runs[i - 1].last + 1 == v;
+	bool next = i < c->n && runs[i].start == v + 1;
+	int ret;
+
+	if (prev && next) {
+		runs[i - 1].last = runs[i].last;
+		memmove(runs + i, runs + i + 1,
+			(c->n - i - 1) * sizeof(struct cbitmap_run));
+		c->n--;
+	} else if (prev)
+		runs[i - 1].last = v;
+	else if (next)
+		runs[i].start = v;
+	else {
+		ret = cbitmap_grow(c);
+		if (ret)
+			return ret;
+		runs = c->data;
+		memmove(runs + i + 1, runs + i,
+			(c->n - i) * sizeof(struct cbitmap_run));
+		runs[i].start = runs[i].last = v;
+		c->n++;
+	}
+	return 0;
+}
+
+/* Delete v, which is a member, from the runs */
+static int
+cbitmap_run_del(struct cbitmap_container *c, u32 v)
+{
+	struct cbitmap_run *runs = c->data;
+	u32 i = cbitmap_run_lb(runs, c->n, v);
+	int ret;
+
+	if (runs[i].start == runs[i].last) {
+		memmove(runs + i, runs + i + 1,
+			(c->n - i - 1) * sizeof(struct cbitmap_run));
+		c->n--;
+	} else if (runs[i].start == v)
+		runs[i].start++;
+	else if (runs[i].last == v)
+		runs[i].last--;
+	else {
+		/* Split the run */
+		ret = c->n < CBITMAP_RUN_MAX ? cbitmap_grow(c) : -ENOMEM;
+		if (ret) {
+			ret = cbitmap_to_bitmap(c);
+			if (!ret)
+				__clear_bit(v, c->data);
+			return ret;
+		}
+		runs = c->data;
+		memmove(runs + i + 1, runs + i,
+			(c->n - i) * sizeof(struct cbitmap_run));
+		runs[i].last = v - 1;
+		runs[i + 1].start = v + 1;
+		c->n++;
+	}
+	return 0;
+}
+
+static int
+cbitmap_add_value(struct cbitmap_container *c, u32 v)
+{
+	u16 *values;
+	u32 i;
+	int ret;
+
+	if ((c->type == CBITMAP_ARRAY && c->n == CBITMAP_ARRAY_MAX) ||
+	    (c->type == CBITMAP_RUN && c->n == CBITMAP_RUN_MAX)) {
+		ret = cbitmap_to_bitmap(c);
+		if (ret)
+			return ret;
+	}
+	switch (c->type) {
+	case CBITMAP_ARRAY:
+		ret = cbitmap_grow(c);
+		if (ret)
+			return ret;
+		values = c->data;
+		i = cbitmap_array_lb(values, c->n, v);
+		memmove(values + i + 1, values + i, (c->n - i) * sizeof(u16));
+		values[i] = v;
+		c->n++;
+		break;
+	case CBITMAP_BITMAP:
+		__set_bit(v, c->data);
+		break;
+	default:
+		ret = cbitmap_run_add(c, v);
+		if (ret)
+			return ret;
+	}
+	c->card++;
+	return 0;
+}
+
+static int
+cbitmap_del_value(struct cbitmap_container *c, u32 v, bool run)
+{
+	u16 *values;
+	u32 i;
+	int ret;
+
+	switch (c->type) {
+	case CBITMAP_ARRAY:
+		values = c->data;
+		i = cbitmap_array_lb(values, c->n, v);
+		memmove(values + i, values + i + 1,
+			(c->n - i - 1) * sizeof(u16));
+		c->n--;
+		break;
+	case CBITMAP_BITMAP:
+		__clear_bit(v, c->data);
+		break;
+	default:
+		ret = cbitmap_run_del(c, v);
+		if (ret)
+			return ret;
+	}
+	c->card--;
+	if (c->type == CBITMAP_BITMAP && c->card <= CBITMAP_ARRAY_MAX)
+		cbitmap_shrink(c, run);
+	return 0;
+}
+
+/* Add or delete the values from lo to hi in the bitmap form */
+static int
+cbitmap_range(struct cbitmap_container *c, u32 lo, u32 hi, bool add)
+{
+	int ret = cbitmap_to_bitmap(c);
+
+	if (ret)
+		return ret;
+	if (add)
+		bitmap_set(c->data, lo, hi - lo + 1);
+	else
+		bitmap_clear(c->data, lo, hi - lo + 1);
+	c->card = bitmap_weight(c->data, CBITMAP_CHUNK_SIZE);
+	cbitmap_shrink(c, true);
+	return 0;
+}
+
+/* The position of the element of v or of its place among the elements
+ * with extensions */
+static u32
+cbitmap_rec_lb(const struct cbitmap_container *c, u32 v, size_t dsize)
+{
+	const struct cbitmap_ip_elem *e;
+	u32 lo = 0, hi = c->nrec, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		e = cbitmap_rec(c, mid, dsize);
+		if (e->low < v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static struct cbitmap_ip_elem *
+cbitmap_rec_find(const struct cbitmap_container *c, u32 v, size_t dsize)
+{
+	u32 i = cbitmap_rec_lb(c, v, dsize);
+	struct cbitmap_ip_elem *e;
+
+	if (i == c->nrec)
+		return NULL;
+	e = cbitmap_rec(c, i, dsize);
+	return e->low == v ? e : NULL;
+}
+
+/* Insert a zeroed element of v */
+static struct cbitmap_ip_elem *
+cbitmap_rec_insert(struct cbitmap_container *c, u32 v, size_t dsize)
+{
+	u32 i = cbitmap_rec_lb(c, v, dsize);
+	u32 rsize = c->rsize ? 2 * c->rsize : 4;
+	struct cbitmap_ip_elem *e;
+	void *recs;
+
+	if (c->nrec == c->rsize) {
+		recs = krealloc(c->recs, rsize * dsize, GFP_ATOMIC);
+		if (!recs)
+			return NULL;
+		c->recs = recs;
+		c->rsize = rsize;
+	}
+	memmove(cbitmap_rec(c, i + 1, dsize), cbitmap_rec(c, i, dsize),
+		(c->nrec - i) * dsize);
+	e = cbitmap_rec(c, i, dsize);
+	memset(e, 0, dsize);
+	e->low = v;
+	c->nrec++;
+	return e;
+}
+
+static void
+cbitmap_rec_del(struct cbitmap_container *c, u32 i, size_t dsize)
+{
+	memmove(cbitmap_rec(c, i, dsize), cbitmap_rec(c, i + 1, dsize),
+		(c->nrec - i - 1) * dsize);
+	c->nrec--;
+}
+
+static void
+cbitmap_container_free(struct ip_set *set, struct cbitmap_container *c)
+{
+	u32 i;
+
+	if (set->extensions & IPSET_EXT_DESTROY)
+		for (i = 0; i < c->nrec; i++)
+			ip_set_ext_destroy(set, cbitmap_rec(c, i, set->dsize));
+	kfree(c->recs);
+	kfree(c->data);
+	kfree(c);
+}
+
+/* Set functions */
+
+static void
+cbitmap_ip_release(struct ip_set *set, u32 id)
+{
+	struct cbitmap_ip *map = set->data;
+
+	cbitmap_container_free(set, map->chunks[id]);
+	map->chunks[id] = NULL;
+}
+
+static int
+cbitmap_ip_test(struct ip_set *set, void *value, const struct ip_set_ext *ext,
+		struct ip_set_ext *mext, u32 flags)
+{
+	struct cbitmap_ip *map = set->data;
+	const struct cbitmap_ip_adt_elem *e = value;
+	const struct cbitmap_container *c = map->chunks[ip_to_chunk(map,
+								     e->from)];
+	u32 v = CBITMAP_LOW(e->from);
+	struct cbitmap_ip_elem *x;
+
+	if (!c || !cbitmap_test(c, v))
+		return 0;
+	if (!set->extensions)
+		return 1;
+	x = cbitmap_rec_find(c, v, set->dsize);
+	if (SET_WITH_TIMEOUT(set) &&
+	    ip_set_timeout_expired(ext_timeout(x, set), set))
+		return 0;
+	if (SET_WITH_COUNTER(set))
+		ip_set_update_counter(set, ext_counter(x, set), ext, mext,
+				      flags);
+	return 1;
+}
+
+/* Add or delete a range of addresses in a set without extensions.
+ * Without -exist the range is checked first, so it is changed as a whole. */
+static int
+cbitmap_ip_range(struct ip_set *set, const struct cbitmap_ip_adt_elem *e,
+		 bool add, u32 flags)
+{
+	struct cbitmap_ip *map = set->data;
+	struct cbitmap_container *c;
+	u32 first = ip_to_chunk(map, e->from), last = ip_to_chunk(map, e->to);
+	u32 id, lo, hi, v, end;
+	int ret;
+
+	for (id = first; id <= last && !(flags & IPSET_FLAG_EXIST); id++) {
+		lo = id == first ? CBITMAP_LOW(e->from) : 0;
+		hi = id == last ? CBITMAP_LOW(e->to) : CBITMAP_CHUNK_SIZE - 1;
+		c = map->chunks[id];
+		if (add) {
+			if (c && cbitmap_next(c, lo, &end) <= hi)
+				return -IPSET_ERR_EXIST;
+			continue;
+		}
+		for (v = lo; v <= hi; v = end + 1)
+			if (!c || cbitmap_next(c, v, &end) != v)
+				return -IPSET_ERR_EXIST;
+	}
+	for (id = first; id <= last; id++) {
+		lo = id == first ? CBITMAP_LOW(e->from) : 0;
+		hi = id == last ? CBITMAP_LOW(e->to) : CBITMAP_CHUNK_SIZE - 1;
+		c = map->chunks[id];
+		if (!c) {
+			if (!add)
+				continue;
+			c = kzalloc(sizeof(*c), GFP_ATOMIC);
+			if (!c)
+				return -ENOMEM;
+			map->chunks[id] = c;
+		}
+		map->elements -= c->card;
+		ret = cbitmap_range(c, lo, hi, add);
+		map->elements += c->card;
+		if (!c->card)
+			cbitmap_ip_release(set, id);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static int
+cbitmap_ip_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
+	       struct ip_set_ext *mext, u32 flags)
+{
+	struct cbitmap_ip *map = set->data;
+	const struct cbitmap_ip_adt_elem *e = value;
+	u32 id = ip_to_chunk(map, e->from), v = CBITMAP_LOW(e->from);
+	struct cbitmap_container *c = map->chunks[id];
+	struct cbitmap_ip_elem *x = NULL;
+	int ret;
+
+	if (e->from != e->to)
+		return cbitmap_ip_range(set, e, true, flags);
+
+	if (c && cbitmap_test(c, v)) {
+		if (set->extensions)
+			x = cbitmap_rec_find(c, v, set->dsize);
+		if (x && SET_WITH_TIMEOUT(set) &&
+		    ip_set_timeout_expired(ext_timeout(x, set), set))
+			/* Timed out element is reused */
+			;
+		else if (!(flags & IPSET_FLAG_EXIST))
+			return -IPSET_ERR_EXIST;
+		if (!x)
+			return 0;
+		/* Element is re-added, cleanup extensions */
+		ip_set_ext_destroy(set, x);
+		goto set_ext;
+	}
+	if (set->extensions && map->elements >= map->maxelem)
+		return -IPSET_ERR_BITMAP_FULL;
+
+	if (!c) {
+		c = kzalloc(sizeof(*c), GFP_ATOMIC);
+		if (!c)
+			return -ENOMEM;
+		map->chunks[id] = c;
+	}
+	if (set->extensions) {
+		x = cbitmap_rec_insert(c, v, set->dsize);
+		if (!x) {
+			ret = -ENOMEM;
+			goto cleanup;
+		}
+	}
+	ret = cbitmap_add_value(c, v);
+	if (ret) {
+		if (x)
+			cbitmap_rec_del(c, cbitmap_rec_lb(c, v, set->dsize),
+					set->dsize);
+		goto cleanup;
+	}
+	map->elements++;
+	if (!x)
+		return 0;
+
+set_ext:
+	if (SET_WITH_TIMEOUT(set))
+		ip_set_timeout_set(ext_timeout(x, set), ext->timeout, set);
+	if (SET_WITH_COUNTER(set))
+		ip_set_init_counter(set, ext_counter(x, set), ext);
+	if (SET_WITH_COMMENT(set))
+		ip_set_init_comment(set, ext_comment(x, set), ext);
+	return 0;
+
+cleanup:
+	if (!c->card)
+		cbitmap_ip_release(set, id);
+	return ret;
+}
+
+static int
+cbitmap_ip_del(struct ip_set *set, void *value, const struct ip_set_ext *ext,
+	       struct ip_set_ext *mext, u32 flags)
+{
+	struct cbitmap_ip *map = set->data;
+	const struct cbitmap_ip_adt_elem *e = value;
+	u32 id = ip_to_chunk(map, e->from), v = CBITMAP_LOW(e->from), i = 0;
+	struct cbitmap_container *c = map->chunks[id];
+	struct cbitmap_ip_elem *x;
+	bool expired = false;
+	int ret;
+
+	if (e->from != e->to)
+		return cbitmap_ip_range(set, e, false, flags);
+
+	if (!c || !cbitmap_test(c, v))
+		return -IPSET_ERR_EXIST;
+	if (set->extensions) {
+		i = cbitmap_rec_lb(c, v, set->dsize);
+		x = cbitmap_rec(c, i, set->dsize);
+		expired = SET_WITH_TIMEOUT(set) &&
+			  ip_set_timeout_expired(ext_timeout(x, set), set);
+	}
+	ret = cbitmap_del_value(c, v, !set->extensions);
+	if (ret)
+		return ret;
+	if (set->extensions) {
+		ip_set_ext_destroy(set, cbitmap_rec(c, i, set->dsize));
+		cbitmap_rec_del(c, i, set->dsize);
+	}
+	map->elements--;
+	if (!c->card)
+		cbitmap_ip_release(set, id);
+
+	return expired ? -IPSET_ERR_EXIST : 0;
+}
+
+/* Delete the timed out elements. Must be called with the set
+ * write-locked. */
+static void
+cbitmap_ip_expire(struct ip_set *set)
+{
+	struct cbitmap_ip *map = set->data;
+	struct cbitmap_container *c;
+	struct cbitmap_ip_elem *x;
+	u32 id, i;
+
+	for (id = 0; id < map->nchunks; id++) {
+		c = map->chunks[id];
+		if (!c)
+			continue;
+		for (i = 0; i < c->nrec;) {
+			x = cbitmap_rec(c, i, set->dsize);
+			if (!ip_set_timeout_expired(ext_timeout(x, set), set) ||
+			    cbitmap_del_value(c, x->low, false)) {
+				i++;
+				continue;
+			}
+			ip_set_ext_destroy(set, x);
+			cbitmap_rec_del(c, i, set->dsize);
+			map->elements--;
+			ip_set_stats_inc(set, expired);
+		}
+		if (!c->card)
+			cbitmap_ip_release(set, id);
+	}
+}
+
+static void
+cbitmap_ip_gc(unsigned long ul_set)
+{
+	struct ip_set *set = (struct ip_set *) ul_set;
+	struct cbitmap_ip *map = set->data;
+	ktime_t start = ip_set_stats_start(set);
+
+	write_lock_bh(&set->lock);
+	cbitmap_ip_expire(set);
+	write_unlock_bh(&set->lock);
+	ip_set_stats_inc(set, gc_runs);
+	ip_set_stats_time(set, gc_time, start);
+
+	map->gc.expires = jiffies + IPSET_GC_PERIOD(set->timeout) * HZ;
+	add_timer(&map->gc);
+}
+
+static void
+cbitmap_ip_gc_init(struct ip_set *set)
+{
+	struct cbitmap_ip *map = set->data;
+
+	init_timer(&map->gc);
+	map->gc.data = (unsigned long) set;
+	map->gc.function = cbitmap_ip_gc;
+	map->gc.expires = jiffies + IPSET_GC_PERIOD(set->timeout) * HZ;
+	add_timer(&map->gc);
+}
+
+static void
+cbitmap_ip_flush(struct ip_set *set)
+{
+	struct cbitmap_ip *map = set->data;
+	u32 id;
+
+	for (id = 0; id < map->nchunks; id++)
+		if (map->chunks[id])
+			cbitmap_ip_release(set, id);
+	map->elements = 0;
+}
+
+static void
+cbitmap_ip_destroy(struct ip_set *set)
+{
+	struct cbitmap_ip *map = set->data;
+
+	if (SET_WITH_TIMEOUT(set))
+		del_timer_sync(&map->gc);
+
+	cbitmap_ip_flush(set);
+	ip_set_free(map->chunks);
+	kfree(map);
+
+	set->data = NULL;
+}
+
+static size_t
+cbitmap_ip_memsize(const struct ip_set *set)
+{
+	const struct cbitmap_ip *map = set->data;
+	const struct cbitmap_container *c;
+	size_t memsize = sizeof(*map) + map->nchunks * sizeof(c) +
+			 ip_set_comment_memsize(set);
+	u32 id;
+
+	for (id = 0; id < map->nchunks; id++) {
+		c = map->chunks[id];
+		if (c)
+			memsize += sizeof(*c) + cbitmap_data_size(c) +
+				   c->rsize * set->dsize;
+	}
+	return memsize;
+}
+
+static int
+cbitmap_ip_head(struct ip_set *set, struct sk_buff *skb)
+{
+	const struct cbitmap_ip *map = set->data;
+	struct nlattr *nested;
+
+	nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
+	if (!nested)
+		goto nla_put_failure;
+	if (nla_put_ipaddr4(skb, IPSET_ATTR_IP, htonl(map->first_ip)) ||
+	    nla_put_ipaddr4(skb, IPSET_ATTR_IP_TO, htonl(map->last_ip)) ||
+	    (set->extensions &&
+	     nla_put_net32(skb, IPSET_ATTR_MAXELEM, htonl(map->maxelem))) ||
+	    nla_put_net32(skb, IPSET_ATTR_ELEMENTS, htonl(map->elements)) ||
+	    nla_put_net32(skb, IPSET_ATTR_REFERENCES, htonl(set->ref - 1)) ||
+	    nla_put_net32(skb, IPSET_ATTR_MEMSIZE,
+			  htonl(cbitmap_ip_memsize(set))))
+		goto nla_put_failure;
+	if (unlikely(ip_set_put_flags(skb, set) ||
+		     ip_set_put_stats(skb, set)))
+		goto nla_put_failure;
+	ipset_nest_end(skb, nested);
+
+	return 0;
+nla_put_failure:
+	return -EMSGSIZE;
+}
+
+/* The consecutive members of a set without extensions are listed as
+ * ranges within the chunks, the members of a set with extensions one by
+ * one. The listing goes on from the chunk in IPSET_CB_ARG0 and from the
+ * value in IPSET_CB_ARG1. */
+static int
+cbitmap_ip_list(struct ip_set *set,
+		struct sk_buff *skb, struct netlink_callback *cb)
+{
+	const struct cbitmap_ip *map = set->data;
+	const struct cbitmap_container *c;
+	struct cbitmap_ip_elem *x = NULL;
+	struct nlattr *adt, *nested;
+	u32 id, v, last = 0, ip;
+	bool listed = false;
+
+	adt = ipset_nest_start(skb, IPSET_ATTR_ADT);
+	if (!adt)
+		return -EMSGSIZE;
+	for (; cb->args[IPSET_CB_ARG0] < map->nchunks;
+	     cb->args[IPSET_CB_ARG0]++, cb->args[IPSET_CB_ARG1] = 0) {
+		id = cb->args[IPSET_CB_ARG0];
+		c = map->chunks[id];
+		if (!c)
+			continue;
+		for (v = cbitmap_next(c, cb->args[IPSET_CB_ARG1], &last);
+		     v < CBITMAP_CHUNK_SIZE;
+		     v = cbitmap_next(c, cb->args[IPSET_CB_ARG1], &last)) {
+			ip = ((map->first_ip >> 16) + id) << 16 | v;
+			if (set->extensions) {
+				last = v;
+				x = cbitmap_rec_find(c, v, set->dsize);
+				if (SET_WITH_TIMEOUT(set) &&
+				    ip_set_timeout_expired(ext_timeout(x, set),
+							   set)) {
+					cb->args[IPSET_CB_ARG1] = v + 1;
+					continue;
+				}
+			}
+			nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
+			if (!nested)
+				goto nla_put_failure;
+			if (nla_put_ipaddr4(skb, IPSET_ATTR_IP, htonl(ip)) ||
+			    (last != v &&
+			     nla_put_ipaddr4(skb, IPSET_ATTR_IP_TO,
+					     htonl(ip + last - v))) ||
+			    (x && ip_set_put_extensions(skb, set, x, true))) {
+				nla_nest_cancel(skb, nested);
+				goto nla_put_failure;
+			}
+			ipset_nest_end(skb, nested);
+			listed = true;
+			cb->args[IPSET_CB_ARG1] = last + 1;
+		}
+	}
+	ipset_nest_end(skb, adt);
+
+	/* Set listing finished */
+	cb->args[IPSET_CB_ARG0] = 0;
+	cb->args[IPSET_CB_ARG1] = 0;
+
+	return 0;
+
+nla_put_failure:
+	if (unlikely(!listed)) {
+		nla_nest_cancel(skb, adt);
+		cb->args[IPSET_CB_ARG0] = 0;
+		cb->args[IPSET_CB_ARG1] = 0;
+		return -EMSGSIZE;
+	}
+	ipset_nest_end(skb, adt);
+	return 0;
+}
+
+/* The first member from ip on in ip, false if there is none up to ip_to */
+static bool
+cbitmap_ip_next(const struct cbitmap_ip *map, u32 *ip, u32 ip_to)
+{
+	const struct cbitmap_container *c;
+	u32 v, last;
+
+	while (true) {
+		c = map->chunks[ip_to_chunk(map, *ip)];
+		v = c ? cbitmap_next(c, CBITMAP_LOW(*ip), &last)
+		      : CBITMAP_CHUNK_SIZE;
+		if (v < CBITMAP_CHUNK_SIZE) {
+			*ip = (*ip & ~(CBITMAP_CHUNK_SIZE - 1)) | v;
+			return *ip <= ip_to;
+		}
+		/* Go on with the next chunk */
+		if ((*ip | (CBITMAP_CHUNK_SIZE - 1)) >= ip_to)
+			return false;
+		*ip = (*ip | (CBITMAP_CHUNK_SIZE - 1)) + 1;
+	}
+}
+
+static int
+cbitmap_ip_kadt(struct ip_set *set, const struct sk_buff *skb,
+		const struct xt_action_param *par,
+		enum ipset_adt adt, struct ip_set_adt_opt *opt)
+{
+	struct cbitmap_ip *map = set->data;
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct cbitmap_ip_adt_elem e = { };
+	struct ip_set_ext ext = IP_SET_INIT_KEXT(skb, opt, set);
+	u32 ip;
+
+	ip = ntohl(ip4addr(skb, opt->flags & IPSET_DIM_ONE_SRC));
+	if (ip < map->first_ip || ip > map->last_ip)
+		return -IPSET_ERR_BITMAP_RANGE;
+
+	e.from = e.to = ip;
+
+	return adtfn(set, &e, &ext, &opt->ext, opt->cmdflags);
+}
+
+static int
+cbitmap_ip_uadt(struct ip_set *set, struct nlattr *tb[],
+		enum ipset_adt adt, u32 *lineno, u32 flags, bool retried)
+{
+	struct cbitmap_ip *map = set->data;
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	u32 ip = 0, ip_to = 0;
+	struct cbitmap_ip_adt_elem e = { };
+	struct ip_set_ext ext = IP_SET_INIT_UEXT(set);
+	int ret = 0;
+
+	if (unlikely(!tb[IPSET_ATTR_IP] ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_TIMEOUT) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_PACKETS) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_BYTES)))
+		return -IPSET_ERR_PROTOCOL;
+
+	if (tb[IPSET_ATTR_LINENO])
+		*lineno = nla_get_u32(tb[IPSET_ATTR_LINENO]);
+
+	ret = ip_set_get_hostipaddr4(tb[IPSET_ATTR_IP], &ip) ||
+	      ip_set_get_extensions(set, tb, &ext);
+	if (ret)
+		return ret;
+
+	if (ip < map->first_ip || ip > map->last_ip)
+		return -IPSET_ERR_BITMAP_RANGE;
+
+	if (adt == IPSET_TEST) {
+		e.from = e.to = ip;
+		return adtfn(set, &e, &ext, &ext, flags);
+	}
+
+	if (tb[IPSET_ATTR_IP_TO]) {
+		ret = ip_set_get_hostipaddr4(tb[IPSET_ATTR_IP_TO], &ip_to);
+		if (ret)
+			return ret;
+		if (ip > ip_to)
+			swap(ip, ip_to);
+	} else if (tb[IPSET_ATTR_CIDR]) {
+		u8 cidr = nla_get_u8(tb[IPSET_ATTR_CIDR]);
+
+		if (!cidr || cidr > 32)
+			return -IPSET_ERR_INVALID_CIDR;
+		ip_set_mask_from_to(ip, ip_to, cidr);
+	} else
+		ip_to = ip;
+
+	if (ip < map->first_ip || ip_to > map->last_ip)
+		return -IPSET_ERR_BITMAP_RANGE;
+
+	if (!set->extensions) {
+		e.from = ip;
+		e.to = ip_to;
+		ret = adtfn(set, &e, &ext, &ext, flags);
+		return ip_set_eexist(ret, flags) ? 0 : ret;
+	}
+	if (adt == IPSET_DEL) {
+		/* Only the members in the range are visited, without -exist
+		 * up to the first missing address */
+		do {
+			e.from = ip;
+			if (!cbitmap_ip_next(map, &e.from, ip_to))
+				return flags & IPSET_FLAG_EXIST ?
+				       0 : -IPSET_ERR_EXIST;
+			if (e.from != ip && !(flags & IPSET_FLAG_EXIST))
+				return -IPSET_ERR_EXIST;
+			e.to = ip = e.from;
+			ret = adtfn(set, &e, &ext, &ext, flags);
+
+			if (ret && !ip_set_eexist(ret, flags))
+				return ret;
+			else
+				ret = 0;
+		} while (ip++ != ip_to);
+		return ret;
+	}
+	/* Every member has its own extensions */
+	do {
+		e.from = e.to = ip;
+		/* Stop at maxelem instead of going through the whole range,
+		 * the members can still be re-added */
+		if (map->elements >= map->maxelem &&
+		    !cbitmap_ip_next(map, &e.from, ip))
+			return -IPSET_ERR_BITMAP_FULL;
+		ret = adtfn(set, &e, &ext, &ext, flags);
+
+		if (ret && !ip_set_eexist(ret, flags))
+			return ret;
+		else
+			ret = 0;
+	} while (ip++ != ip_to);
+	return ret;
+}
+
+static bool
+cbitmap_ip_same_set(const struct ip_set *a, const struct ip_set *b)
+{
+	const struct cbitmap_ip *x = a->data;
+	const struct cbitmap_ip *y = b->data;
+
+	return x->first_ip == y->first_ip &&
+	       x->last_ip == y->last_ip &&
+	       x->maxelem == y->maxelem &&
+	       a->timeout == b->timeout &&
+	       a->extensions == b->extensions;
+}
+
+static const struct ip_set_type_variant cbitmap_ip = {
+	.kadt	= cbitmap_ip_kadt,
+	.uadt	= cbitmap_ip_uadt,
+	.adt	= {
+		[IPSET_ADD] = cbitmap_ip_add,
+		[IPSET_DEL] = cbitmap_ip_del,
+		[IPSET_TEST] = cbitmap_ip_test,
+	},
+	.destroy = cbitmap_ip_destroy,
+	.flush	= cbitmap_ip_flush,
+	.head	= cbitmap_ip_head,
+	.list	= cbitmap_ip_list,
+	.same_set = cbitmap_ip_same_set,
+};
+
+/* Create cbitmap:ip type of sets */
+
+static int
+cbitmap_ip_create(struct net *net, struct ip_set *set, struct nlattr *tb[],
+		  u32 flags)
+{
+	struct cbitmap_ip *map;
+	u32 first_ip = 0, last_ip = 0;
+	u32 maxelem = IPSET_CBITMAP_DEFAULT_MAXELEM;
+	int ret;
+
+	if (unlikely(!tb[IPSET_ATTR_IP] ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_MAXELEM) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_TIMEOUT) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_CADT_FLAGS)))
+		return -IPSET_ERR_PROTOCOL;
+
+	ret = ip_set_get_hostipaddr4(tb[IPSET_ATTR_IP], &first_ip);
+	if (ret)
+		return ret;
+
+	if (tb[IPSET_ATTR_IP_TO]) {
+		ret = ip_set_get_hostipaddr4(tb[IPSET_ATTR_IP_TO], &last_ip);
+		if (ret)
+			return ret;
+		if (first_ip > last_ip)
+			swap(first_ip, last_ip);
+	} else if (tb[IPSET_ATTR_CIDR]) {
+		u8 cidr = nla_get_u8(tb[IPSET_ATTR_CIDR]);
+
+		if (cidr >= 32)
+			return -IPSET_ERR_INVALID_CIDR;
+		ip_set_mask_from_to(first_ip, last_ip, cidr);
+	} else
+		return -IPSET_ERR_PROTOCOL;
+
+	if (tb[IPSET_ATTR_MAXELEM])
+		maxelem = ip_set_get_h32(tb[IPSET_ATTR_MAXELEM]);
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return -ENOMEM;
+
+	map->nchunks = (last_ip >> 16) - (first_ip >> 16) + 1;
+	map->chunks = ip_set_alloc(map->nchunks * sizeof(*map->chunks));
+	if (!map->chunks) {
+		kfree(map);
+		return -ENOMEM;
+	}
+	map->first_ip = first_ip;
+	map->last_ip = last_ip;
+	map->maxelem = maxelem;
+
+	set->variant = &cbitmap_ip;
+	set->dsize = ip_set_elem_len(set, tb, sizeof(struct cbitmap_ip_elem));
+	set->timeout = IPSET_NO_TIMEOUT;
+	set->data = map;
+	set->family = NFPROTO_IPV4;
+
+	if (tb[IPSET_ATTR_TIMEOUT]) {
+		set->timeout = ip_set_timeout_uget(tb[IPSET_ATTR_TIMEOUT]);
+		cbitmap_ip_gc_init(set);
+	}
+	return 0;
+}
+
+static struct ip_set_type cbitmap_ip_type __read_mostly = {
+	.name		= "cbitmap:ip",
+	.protocol	= IPSET_PROTOCOL,
+	.features	= IPSET_TYPE_IP,
+	.dimension	= IPSET_DIM_ONE,
+	.family		= NFPROTO_IPV4,
+	.revision_min	= IPSET_TYPE_REV_MIN,
+	.revision_max	= IPSET_TYPE_REV_MAX,
+	.create		= cbitmap_ip_create,
+	.create_policy	= {
+		[IPSET_ATTR_IP]		= { .type = NLA_NESTED },
+		[IPSET_ATTR_IP_TO]	= { .type = NLA_NESTED },
+		[IPSET_ATTR_CIDR]	= { .type = NLA_U8 },
+		[IPSET_ATTR_MAXELEM]	= { .type = NLA_U32 },
+		[IPSET_ATTR_TIMEOUT]	= { .type = NLA_U32 },
+		[IPSET_ATTR_CADT_FLAGS]	= { .type = NLA_U32 },
+	},
+	.adt_policy	= {
+		[IPSET_ATTR_IP]		= { .type = NLA_NESTED },
+		[IPSET_ATTR_IP_TO]	= { .type = NLA_NESTED },
+		[IPSET_ATTR_CIDR]	= { .type = NLA_U8 },
+		[IPSET_ATTR_TIMEOUT]	= { .type = NLA_U32 },
+		[IPSET_ATTR_LINENO]	= { .type = NLA_U32 },
+		[IPSET_ATTR_BYTES]	= { .type = NLA_U64 },
+		[IPSET_ATTR_PACKETS]	= { .type = NLA_U64 },
+		[IPSET_ATTR_COMMENT]	= { .type = NLA_NUL_STRING },
+	},
+	.me		= THIS_MODULE,
+};
+
+static int __init
+cbitmap_ip_init(void)
+{
+	return ip_set_type_register(&cbitmap_ip_type);
+}
+
+static void __exit
+cbitmap_ip_fini(void)
+{
+	ip_set_type_unregister(&cbitmap_ip_type);
+}
+
+module_init(cbitmap_ip_init);
+module_exit(cbitmap_ip_fini);
@@ -13,8 +13,11 @@
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/ip.h>
+#include <linux/jhash.h>
+#include <linux/hash.h>
 #include <linux/skbuff.h>
 #include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <linux/netlink.h>
 #include <linux/rculist.h>
 #include <net/netlink.h>
@@ -34,6 +37,9 @@ struct ip_set_net {
 	struct ip_set * __rcu *ip_set_list;	/* all individual sets */
 	ip_set_id_t	ip_set_max;	/* max number of sets */
 	int		is_deleted;	/* deleted by ip_set_net_exit */
+	struct ip_set_comment_table comments;	/* interned comments */
+	struct ip_set	*retired;	/* sets replaced by their shadow */
+	struct work_struct retire_work;	/* destroys the retired sets */
 };
 static int ip_set_net_id __read_mostly;
 
@@ -46,6 +52,7 @@ static inline struct ip_set_net *ip_set_pernet(struct net *net)
 #define STREQ(a, b)	(strncmp(a, b, IPSET_MAXNAMELEN) == 0)
 
 static unsigned int max_sets;
+static bool stats;
 
 #define _IP_SET_CORE_MODULE_DESC(a)	\
 	MODULE_DESCRIPTION("core IP set support (v" a ")")
@@ -54,6 +61,8 @@ static unsigned int max_sets;
 
 module_param(max_sets, int, 0600);
 MODULE_PARM_DESC(max_sets, "maximal number of sets");
+module_param(stats, bool, 0644);
+MODULE_PARM_DESC(stats, "create the sets with runtime statistics");
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Jozsef Kadlecsik <kadlec@blackhole.kfki.hu>");
 IP_SET_CORE_MODULE_DESC(PACKAGE_VERSION);
@@ -284,6 +293,353 @@ ip_set_free(void *members)
 }
 EXPORT_SYMBOL_GPL(ip_set_free);
 
+/* Allocate zeroed memory from the given NUMA node, freed by ip_set_free */
+void *
+ip_set_alloc_node(size_t size, int node)
+{
+	void *members = NULL;
+
+	if (size < KMALLOC_MAX_SIZE)
+		members = kzalloc_node(size, GFP_KERNEL | __GFP_NOWARN, node);
+	if (members)
+		return members;
+
+	return vzalloc_node(size, node);
+}
+EXPORT_SYMBOL_GPL(ip_set_alloc_node);
+
+/* Per NUMA node replicas of read-mostly data: the array of the copies
+ * is indexed by the node id, every online node gets its own zeroed copy
+ * allocated from the memory of the node. */
+void
+ip_set_replicas_free(void **replicas)
+{
+	int node;
+
+	for_each_node(node)
+		if (replicas[node])
+			ip_set_free(replicas[node]);
+	kfree(replicas);
+}
+EXPORT_SYMBOL_GPL(ip_set_replicas_free);
+
+void **
+ip_set_replicas_alloc(size_t size)
+{
+	void **replicas;
+	int node;
+
+	replicas = kcalloc(nr_node_ids, sizeof(void *), GFP_KERNEL);
+	if (!replicas)
+		return NULL;
+	for_each_online_node(node) {
+		replicas[node] = ip_set_alloc_node(size, node);
+		if (!replicas[node]) {
+			ip_set_replicas_free(replicas);
+			return NULL;
+		}
+	}
+	return replicas;
+}
+EXPORT_SYMBOL_GPL(ip_set_replicas_alloc);
+
+/* Slab caches of the hash bucket arrays: the sets share the caches
+ * by object size. Must be called from process context. */
+
+struct ip_set_slab {
+	struct list_head list;
+	struct kmem_cache *cache;
+	size_t size;
+	u32 ref;
+	char name[32];
+};
+
+static LIST_HEAD(ip_set_slab_list);
+static DEFINE_MUTEX(ip_set_slab_mutex);	/* protects ip_set_slab_list */
+
+struct kmem_cache *
+ip_set_slab_get(size_t size)
+{
+	struct ip_set_slab *slab;
+	struct kmem_cache *cache = NULL;
+
+	mutex_lock(&ip_set_slab_mutex);
+	list_for_each_entry(slab, &ip_set_slab_list, list) {
+		if (slab->size == size) {
+			slab->ref++;
+			cache = slab->cache;
+			goto out;
+		}
+	}
+	slab = kzalloc(sizeof(*slab), GFP_KERNEL);
+	if (!slab)
+		goto out;
+	snprintf(slab->name, sizeof(slab->name), "ip_set_bucket_%zu", size);
+	slab->cache = kmem_cache_create(slab->name, size, 0, 0, NULL);
+	if (!slab->cache) {
+		kfree(slab);
+		goto out;
+	}
+	slab->size = size;
+	slab->ref = 1;
+	list_add(&slab->list, &ip_set_slab_list);
+	cache = slab->cache;
+out:
+	mutex_unlock(&ip_set_slab_mutex);
+	return cache;
+}
+EXPORT_SYMBOL_GPL(ip_set_slab_get);
+
+void
+ip_set_slab_put(struct kmem_cache *cache)
+{
+	struct ip_set_slab *slab;
+
+	mutex_lock(&ip_set_slab_mutex);
+	list_for_each_entry(slab, &ip_set_slab_list, list) {
+		if (slab->cache != cache)
+			continue;
+		if (--slab->ref == 0) {
+			list_del(&slab->list);
+			kmem_cache_destroy(slab->cache);
+			kfree(slab);
+		}
+		break;
+	}
+	mutex_unlock(&ip_set_slab_mutex);
+}
+EXPORT_SYMBOL_GPL(ip_set_slab_put);
+
+/* Expiry index of the sets with timeout, see ip_set_timeout.h */
+
+struct ip_set_expiry *
+ip_set_expiry_alloc(u32 timeout, u32 marks)
+{
+	struct ip_set_expiry *e;
+	size_t size = sizeof(*e) + marks * sizeof(u32);
+
+	e = ip_set_alloc(size);
+	if (!e)
+		return NULL;
+	spin_lock_init(&e->lock);
+	/* A tick per garbage collection */
+	e->tick_len = IPSET_GC_PERIOD(timeout) * HZ;
+	e->epoch = jiffies + e->tick_len;
+	e->next = 1;
+	e->marks = marks;
+	e->memsize = size;
+
+	return e;
+}
+EXPORT_SYMBOL_GPL(ip_set_expiry_alloc);
+
+static void
+ip_set_expiry_chunks_free(struct ip_set_expiry_chunk *c)
+{
+	struct ip_set_expiry_chunk *next;
+
+	for (; c; c = next) {
+		next = c->next;
+		kfree(c);
+	}
+}
+
+void
+ip_set_expiry_flush(struct ip_set_expiry *e)
+{
+	int i;
+
+	for (i = 0; i < IPSET_EXPIRY_SLOTS; i++) {
+		ip_set_expiry_chunks_free(e->slot[i]);
+		e->slot[i] = NULL;
+	}
+	memset(e->mark, 0, e->marks * sizeof(u32));
+	e->memsize = sizeof(*e) + e->marks * sizeof(u32);
+	e->rescan = false;
+}
+EXPORT_SYMBOL_GPL(ip_set_expiry_flush);
+
+void
+ip_set_expiry_free(struct ip_set_expiry *e)
+{
+	ip_set_expiry_flush(e);
+	ip_set_free(e);
+}
+EXPORT_SYMBOL_GPL(ip_set_expiry_free);
+
+/* The tick when the timeout is due: the ticks before the next one
+ * are processed already */
+static inline u32
+ip_set_expiry_tick(const struct ip_set_expiry *e, unsigned long timeout)
+{
+	unsigned long delta;
+
+	if (!time_after(timeout, e->epoch))
+		return e->next;
+	delta = timeout - e->epoch;
+	return e->next + delta / e->tick_len + !!(delta % e->tick_len);
+}
+
+static int
+ip_set_expiry_push(struct ip_set_expiry *e, u32 bucket, u32 tick)
+{
+	struct ip_set_expiry_chunk **slot, *c;
+
+	slot = &e->slot[tick % IPSET_EXPIRY_SLOTS];
+	c = *slot;
+	if (!c || c->len == IPSET_EXPIRY_CHUNK) {
+		c = kmalloc(sizeof(*c), GFP_ATOMIC);
+		if (!c)
+			return -ENOMEM;
+		c->next = *slot;
+		c->len = 0;
+		*slot = c;
+		e->memsize += sizeof(*c);
+	}
+	c->entry[c->len].bucket = bucket;
+	c->entry[c->len].tick = tick;
+	c->len++;
+
+	return 0;
+}
+
+/* Schedule the bucket by the earliest timeout of its elements, if it
+ * is not scheduled earlier already. When the index cannot be extended,
+ * it is rebuilt by scanning the whole set. */
+void
+ip_set_expiry_schedule(struct ip_set_expiry *e, u32 *mark, u32 bucket,
+		       unsigned long timeout)
+{
+	u32 tick;
+
+	if (timeout == IPSET_ELEM_PERMANENT)
+		return;
+
+	spin_lock(&e->lock);
+	tick = ip_set_expiry_tick(e, timeout);
+	if (*mark == IPSET_EXPIRY_NONE || (s32)(tick - *mark) < 0) {
+		if (ip_set_expiry_push(e, bucket, tick))
+			e->rescan = true;
+		else
+			*mark = tick;
+	}
+	spin_unlock(&e->lock);
+}
+EXPORT_SYMBOL_GPL(ip_set_expiry_schedule);
+
+/* Call expire for the buckets which are due. The set must be locked
+ * against the adds: expire may schedule the buckets again. */
+void
+ip_set_expiry_run(struct ip_set_expiry *e, struct ip_set *set,
+		  void (*expire)(struct ip_set *set, u32 bucket, u32 tick))
+{
+	struct ip_set_expiry_chunk *c, *next;
+	unsigned long ticks;
+	u32 i, j, first, now;
+
+	if (time_before(jiffies, e->epoch))
+		return;
+	ticks = (jiffies - e->epoch) / e->tick_len + 1;
+	first = e->next;
+	now = first + ticks - 1;
+	e->next += ticks;
+	e->epoch += ticks * e->tick_len;
+
+	for (i = 0; i < min_t(unsigned long, ticks, IPSET_EXPIRY_SLOTS); i++) {
+		c = e->slot[(first + i) % IPSET_EXPIRY_SLOTS];
+		e->slot[(first + i) % IPSET_EXPIRY_SLOTS] = NULL;
+		for (; c; c = next) {
+			for (j = 0; j < c->len; j++) {
+				if ((s32)(c->entry[j].tick - now) <= 0)
+					expire(set, c->entry[j].bucket,
+					       c->entry[j].tick);
+				/* Not due in this round of the wheel */
+				else if (ip_set_expiry_push(e,
+						c->entry[j].bucket,
+						c->entry[j].tick))
+					e->rescan = true;
+			}
+			next = c->next;
+			kfree(c);
+			e->memsize -= sizeof(*c);
+		}
+	}
+}
+EXPORT_SYMBOL_GPL(ip_set_expiry_run);
+
+/* Evict an element from a bucket scheduled at the tick: the visited
+ * entries of the tick are removed from the wheel, so that the stale
+ * entries are skipped once only. */
+static bool
+ip_set_expiry_evict_tick(struct ip_set_expiry *e, struct ip_set *set,
+			 bool (*evict)(struct ip_set *set, u32 bucket,
+				       u32 tick),
+			 u32 tick)
+{
+	struct ip_set_expiry_chunk **p, *c;
+	struct ip_set_expiry_entry entry;
+	u32 j;
+
+	for (p = &e->slot[tick % IPSET_EXPIRY_SLOTS]; (c = *p); ) {
+		for (j = 0; j < c->len; ) {
+			if (c->entry[j].tick != tick) {
+				/* Due in another round of the wheel */
+				j++;
+				continue;
+			}
+			entry = c->entry[j];
+			c->entry[j] = c->entry[--c->len];
+			if (evict(set, entry.bucket, entry.tick))
+				return true;
+		}
+		if (c->len) {
+			p = &c->next;
+			continue;
+		}
+		*p = c->next;
+		kfree(c);
+		e->memsize -= sizeof(*c);
+	}
+	return false;
+}
+
+/* Evict an element from the bucket which is scheduled the earliest: the
+ * ticks are walked from the next one on. When none of the buckets is due
+ * in the current round of the wheel, the earliest tick of the later
+ * rounds is looked up. Returns true if evict succeeded. The set must be
+ * locked against the adds. */
+bool
+ip_set_expiry_evict(struct ip_set_expiry *e, struct ip_set *set,
+		    bool (*evict)(struct ip_set *set, u32 bucket, u32 tick))
+{
+	struct ip_set_expiry_chunk *c;
+	u32 i, j, tick;
+	bool found;
+
+	for (i = 0; i < IPSET_EXPIRY_SLOTS; i++)
+		if (ip_set_expiry_evict_tick(e, set, evict, e->next + i))
+			return true;
+
+	/* The entries of the current round are all removed above */
+	do {
+		found = false;
+		tick = 0;
+		for (i = 0; i < IPSET_EXPIRY_SLOTS; i++)
+			for (c = e->slot[i]; c; c = c->next)
+				for (j = 0; j < c->len; j++) {
+					if (found &&
+					    (s32)(c->entry[j].tick - tick) >= 0)
+						continue;
+					tick = c->entry[j].tick;
+					found = true;
+				}
+		if (found && ip_set_expiry_evict_tick(e, set, evict, tick))
+			return true;
+	} while (found);
+	return false;
+}
+EXPORT_SYMBOL_GPL(ip_set_expiry_evict);
+
 static inline bool
 flag_nested(const struct nlattr *nla)
 {
@@ -332,7 +688,215 @@ ip_set_get_ipaddr6(struct nlattr *nla, union nf_inet_addr *ipaddr)
 }
 EXPORT_SYMBOL_GPL(ip_set_get_ipaddr6);
 
-typedef void (*destroyer)(void *);
+/* Interned comment strings of a namespace, see ip_set.h */
+
+#define IPSET_COMMENT_TABLE_INIT	64
+#define IPSET_COMMENT_HASH_INIT_BITS	6
+
+static void
+ip_set_comment_table_init(struct ip_set_comment_table *c)
+{
+	spin_lock_init(&c->lock);
+}
+
+/* The sets of the namespace are already destroyed */
+static void
+ip_set_comment_table_free(struct ip_set_comment_table *c)
+{
+	u32 id;
+
+	for (id = 1; id < c->size; id++)
+		if (!(c->entry[id] & 1))
+			kfree((struct ip_set_comment_str *)c->entry[id]);
+	kfree(c->entry);
+	kfree(c->hash);
+	c->entry = NULL;
+	c->hash = NULL;
+	c->size = c->used = c->free = 0;
+	c->hbits = 0;
+	c->memsize = 0;
+}
+
+/* Double the table and chain the new entries into the free list.
+ * The entry 0 is never used. */
+static int
+ip_set_comment_table_grow(struct ip_set_comment_table *c)
+{
+	u32 id, size = c->size ? c->size * 2 : IPSET_COMMENT_TABLE_INIT;
+	unsigned long *entry;
+
+	if (size <= c->size)
+		return -ENOMEM;
+	entry = krealloc(c->entry, size * sizeof(unsigned long), GFP_ATOMIC);
+	if (!entry)
+		return -ENOMEM;
+	for (id = c->size ? c->size : 1; id < size - 1; id++)
+		entry[id] = ((unsigned long)(id + 1) << 1) | 1;
+	entry[size - 1] = 1;
+	c->free = c->size ? c->size : 1;
+	c->memsize += (size - c->size) * sizeof(unsigned long);
+	c->entry = entry;
+	c->size = size;
+	return 0;
+}
+
+/* Rehash the strings into a hash of the given size */
+static int
+ip_set_comment_hash_resize(struct ip_set_comment_table *c, u8 hbits)
+{
+	struct ip_set_comment_str *s;
+	struct hlist_head *hash;
+	u32 i, id;
+
+	hash = kmalloc(sizeof(*hash) << hbits, GFP_ATOMIC);
+	if (!hash)
+		return -ENOMEM;
+	for (i = 0; i < (1U << hbits); i++)
+		INIT_HLIST_HEAD(&hash[i]);
+	for (id = 1; id < c->size; id++) {
+		if (c->entry[id] & 1)
+			continue;
+		s = (struct ip_set_comment_str *)c->entry[id];
+		hlist_add_head(&s->node, &hash[hash_32(s->hval, hbits)]);
+	}
+	kfree(c->hash);
+	c->memsize += (sizeof(*hash) << hbits) -
+		      (c->hash ? sizeof(*hash) << c->hbits : 0);
+	c->hash = hash;
+	c->hbits = hbits;
+	return 0;
+}
+
+static struct ip_set_comment_str *
+ip_set_comment_lookup(struct ip_set_comment_table *c, const char *str,
+		      size_t len, u32 hval)
+{
+	struct ip_set_comment_str *s;
+	struct hlist_node *n;
+
+	if (!c->hash)
+		return NULL;
+	/* Not hlist_for_each_entry(): its arguments changed in 3.9 */
+	for (n = c->hash[hash_32(hval, c->hbits)].first; n; n = n->next) {
+		s = hlist_entry(n, struct ip_set_comment_str, node);
+		if (s->hval == hval &&
+		    strncmp(s->str, str, len) == 0 && s->str[len] == '\0')
+			return s;
+	}
+	return NULL;
+}
+
+/* The slot of the comment in the element is either new or already freed
+ * by ip_set_ext_destroy(), so its content is not trusted. If the string
+ * cannot be stored, the element is added without comment. */
+void
+ip_set_init_comment(struct ip_set *set, struct ip_set_comment *comment,
+		    const struct ip_set_ext *ext)
+{
+	struct ip_set_comment_table *c = set->comments;
+	size_t len = ext->comment ? strlen(ext->comment) : 0;
+	struct ip_set_comment_str *s;
+	u32 hval;
+
+	comment->id = 0;
+	if (!len)
+		return;
+	if (unlikely(len > IPSET_MAX_COMMENT_SIZE))
+		len = IPSET_MAX_COMMENT_SIZE;
+	hval = jhash(ext->comment, len, 0);
+
+	spin_lock_bh(&c->lock);
+	s = ip_set_comment_lookup(c, ext->comment, len, hval);
+	if (s) {
+		s->ref++;
+		goto out;
+	}
+	/* The hash is doubled when the strings outnumber its buckets;
+	 * if that fails, the chains just get longer */
+	if (!c->hash) {
+		if (ip_set_comment_hash_resize(c,
+					       IPSET_COMMENT_HASH_INIT_BITS))
+			goto unlock;
+	} else if (c->hbits < 31 && c->used >= (1U << c->hbits))
+		ip_set_comment_hash_resize(c, c->hbits + 1);
+	if (!c->free && ip_set_comment_table_grow(c))
+		goto unlock;
+	s = kmalloc(sizeof(*s) + len + 1, GFP_ATOMIC);
+	if (unlikely(!s))
+		goto unlock;
+	strlcpy(s->str, ext->comment, len + 1);
+	s->ref = 1;
+	s->hval = hval;
+	s->id = c->free;
+	c->free = c->entry[s->id] >> 1;
+	c->entry[s->id] = (unsigned long)s;
+	c->used++;
+	c->memsize += sizeof(*s) + len + 1;
+	hlist_add_head(&s->node, &c->hash[hash_32(hval, c->hbits)]);
+out:
+	comment->id = s->id;
+unlock:
+	spin_unlock_bh(&c->lock);
+}
+EXPORT_SYMBOL_GPL(ip_set_init_comment);
+
+int
+ip_set_put_comment(struct sk_buff *skb, const struct ip_set *set,
+		   const struct ip_set_comment *comment)
+{
+	struct ip_set_comment_table *c = set->comments;
+	struct ip_set_comment_str *s;
+	int ret;
+
+	if (!comment->id)
+		return 0;
+	spin_lock_bh(&c->lock);
+	s = (struct ip_set_comment_str *)c->entry[comment->id];
+	ret = nla_put_string(skb, IPSET_ATTR_COMMENT, s->str);
+	spin_unlock_bh(&c->lock);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ip_set_put_comment);
+
+void
+ip_set_comment_free(struct ip_set *set, struct ip_set_comment *comment)
+{
+	struct ip_set_comment_table *c = set->comments;
+	struct ip_set_comment_str *s;
+
+	if (unlikely(!comment->id))
+		return;
+	spin_lock_bh(&c->lock);
+	s = (struct ip_set_comment_str *)c->entry[comment->id];
+	if (--s->ref == 0) {
+		hlist_del(&s->node);
+		c->entry[s->id] = ((unsigned long)c->free << 1) | 1;
+		c->free = s->id;
+		c->used--;
+		c->memsize -= sizeof(*s) + strlen(s->str) + 1;
+	} else
+		s = NULL;
+	spin_unlock_bh(&c->lock);
+	kfree(s);
+	comment->id = 0;
+}
+EXPORT_SYMBOL_GPL(ip_set_comment_free);
+
+/* The element is copied, with a new reference to its comment */
+void
+ip_set_comment_get(struct ip_set *set, const struct ip_set_comment *comment)
+{
+	struct ip_set_comment_table *c = set->comments;
+
+	if (!comment->id)
+		return;
+	spin_lock_bh(&c->lock);
+	((struct ip_set_comment_str *)c->entry[comment->id])->ref++;
+	spin_unlock_bh(&c->lock);
+}
+EXPORT_SYMBOL_GPL(ip_set_comment_get);
+
+typedef void (*destroyer)(struct ip_set *, void *);
 /* ipset data extension types, in size order */
 
 const struct ip_set_ext_type ip_set_extensions[] = {
@@ -344,8 +908,8 @@ const struct ip_set_ext_type ip_set_extensions[] = {
 	},
 	[IPSET_EXT_ID_TIMEOUT] = {
 		.type	= IPSET_EXT_TIMEOUT,
-		.len	= sizeof(unsigned long),
-		.align	= __alignof__(unsigned long),
+		.len	= sizeof(u32),
+		.align	= __alignof__(u32),
 	},
 	[IPSET_EXT_ID_COMMENT] = {
 		.type	 = IPSET_EXT_COMMENT | IPSET_EXT_DESTROY,
@@ -374,6 +938,11 @@ ip_set_elem_len(struct ip_set *set, struct nlattr *tb[], size_t len)
 
 	if (tb[IPSET_ATTR_CADT_FLAGS])
 		cadt_flags = ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]);
+	/* Per-CPU counters are stored in the slot of the counters */
+	if (cadt_flags & IPSET_FLAG_WITH_PCPU_COUNTERS) {
+		cadt_flags |= IPSET_FLAG_WITH_COUNTERS;
+		set->extensions |= IPSET_EXT_PCPU_COUNTER | IPSET_EXT_DESTROY;
+	}
 	for (id = 0; id < IPSET_EXT_ID_MAX; id++) {
 		if (!add_extension(id, cadt_flags, tb))
 			continue;
@@ -415,6 +984,75 @@ ip_set_get_extensions(struct ip_set *set, struct nlattr *tb[],
 }
 EXPORT_SYMBOL_GPL(ip_set_get_extensions);
 
+/* Runtime statistics */
+
+struct static_key ip_set_stats_key = STATIC_KEY_INIT_FALSE;
+EXPORT_SYMBOL_GPL(ip_set_stats_key);
+
+int
+ip_set_put_stats(struct sk_buff *skb, struct ip_set *set)
+{
+	struct ip_set_stats sum = {};
+	struct nlattr *nested;
+	int cpu;
+
+	if (!set->stats)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		const struct ip_set_stats *s = per_cpu_ptr(set->stats, cpu);
+
+		sum.tests += s->tests;
+		sum.hits += s->hits;
+		sum.lookups += s->lookups;
+		sum.probes += s->probes;
+		sum.resizes += s->resizes;
+		sum.resize_time += s->resize_time;
+		sum.gc_runs += s->gc_runs;
+		sum.gc_time += s->gc_time;
+		sum.expired += s->expired;
+		sum.bucket_full += s->bucket_full;
+		if (s->probe_max > sum.probe_max)
+			sum.probe_max = s->probe_max;
+	}
+
+	nested = ipset_nest_start(skb, IPSET_ATTR_STATS);
+	if (!nested)
+		goto nla_put_failure;
+	if (nla_put_net64(skb, IPSET_ATTR_STATS_TESTS,
+			  cpu_to_be64(sum.tests)) ||
+	    nla_put_net64(skb, IPSET_ATTR_STATS_HITS,
+			  cpu_to_be64(sum.hits)) ||
+	    nla_put_net64(skb, IPSET_ATTR_STATS_MISSES,
+			  cpu_to_be64(sum.tests - sum.hits)) ||
+	    nla_put_net64(skb, IPSET_ATTR_STATS_LOOKUPS,
+			  cpu_to_be64(sum.lookups)) ||
+	    nla_put_net64(skb, IPSET_ATTR_STATS_PROBES,
+			  cpu_to_be64(sum.probes)) ||
+	    nla_put_net64(skb, IPSET_ATTR_STATS_PROBE_MAX,
+			  cpu_to_be64(sum.probe_max)) ||
+	    nla_put_net64(skb, IPSET_ATTR_STATS_RESIZES,
+			  cpu_to_be64(sum.resizes)) ||
+	    nla_put_net64(skb, IPSET_ATTR_STATS_RESIZE_TIME,
+			  cpu_to_be64(sum.resize_time)) ||
+	    nla_put_net64(skb, IPSET_ATTR_STATS_GC_RUNS,
+			  cpu_to_be64(sum.gc_runs)) ||
+	    nla_put_net64(skb, IPSET_ATTR_STATS_GC_TIME,
+			  cpu_to_be64(sum.gc_time)) ||
+	    nla_put_net64(skb, IPSET_ATTR_STATS_EXPIRED,
+			  cpu_to_be64(sum.expired)) ||
+	    nla_put_net64(skb, IPSET_ATTR_STATS_BUCKET_FULL,
+			  cpu_to_be64(sum.bucket_full)))
+		goto nla_put_failure;
+	ipset_nest_end(skb, nested);
+
+	return 0;
+
+nla_put_failure:
+	return -EMSGSIZE;
+}
+EXPORT_SYMBOL_GPL(ip_set_put_stats);
+
 /*
  * Creating/destroying/renaming/swapping affect the existence and
  * the properties of a set. All of these can be executed from userspace
@@ -443,6 +1081,27 @@ __ip_set_put(struct ip_set *set)
 	write_unlock_bh(&ip_set_ref_lock);
 }
 
+/* A set being listed cannot be replaced by its shadow,
+ * so the listings are counted separately too. */
+static inline void
+__ip_set_get_netlink(struct ip_set *set)
+{
+	write_lock_bh(&ip_set_ref_lock);
+	set->ref++;
+	set->ref_netlink++;
+	write_unlock_bh(&ip_set_ref_lock);
+}
+
+static inline void
+__ip_set_put_netlink(struct ip_set *set)
+{
+	write_lock_bh(&ip_set_ref_lock);
+	BUG_ON(set->ref == 0 || set->ref_netlink == 0);
+	set->ref--;
+	set->ref_netlink--;
+	write_unlock_bh(&ip_set_ref_lock);
+}
+
 /*
  * Add, del and test set entries from kernel.
  *
@@ -479,6 +1138,8 @@ ip_set_test(ip_set_id_t index, const struct sk_buff *skb,
 	    !(opt->family == set->family || set->family == NFPROTO_UNSPEC))
 		return 0;
 
+	ip_set_stats_inc(set, tests);
+
 	read_lock_bh(&set->lock);
 	ret = set->variant->kadt(set, skb, par, IPSET_TEST, opt);
 	read_unlock_bh(&set->lock);
@@ -486,9 +1147,11 @@ ip_set_test(ip_set_id_t index, const struct sk_buff *skb,
 	if (ret == -EAGAIN) {
 		/* Type requests element to be completed */
 		pr_debug("element must be competed, ADD is triggered\n");
+		opt->cmdflags |= IPSET_FLAG_KERNEL_ADD;
 		write_lock_bh(&set->lock);
 		set->variant->kadt(set, skb, par, IPSET_ADD, opt);
 		write_unlock_bh(&set->lock);
+		opt->cmdflags &= ~IPSET_FLAG_KERNEL_ADD;
 		ret = 1;
 	} else {
 		/* --return-nomatch: invert matched element */
@@ -497,6 +1160,8 @@ ip_set_test(ip_set_id_t index, const struct sk_buff *skb,
 		    (ret > 0 || ret == -ENOTEMPTY))
 			ret = -ret;
 	}
+	if (ret > 0)
+		ip_set_stats_inc(set, hits);
 
 	/* Convert error codes to nomatch */
 	return (ret < 0 ? 0 : ret);
@@ -518,9 +1183,25 @@ ip_set_add(ip_set_id_t index, const struct sk_buff *skb,
 	    !(opt->family == set->family || set->family == NFPROTO_UNSPEC))
 		return 0;
 
+	opt->cmdflags |= IPSET_FLAG_KERNEL_ADD;
+	/* The writes to the replicas need the set write-locked */
+	if (set->variant->parallel_kadd &&
+	    !(set->cadt_flags & IPSET_FLAG_WITH_REPLICAS)) {
+		/* Adds to different parts of the set can run parallel */
+		opt->cmdflags |= IPSET_FLAG_PARALLEL_ADD;
+		read_lock_bh(&set->lock);
+		ret = set->variant->kadt(set, skb, par, IPSET_ADD, opt);
+		read_unlock_bh(&set->lock);
+		opt->cmdflags &= ~IPSET_FLAG_PARALLEL_ADD;
+		if (ret != -EBUSY)
+			goto out;
+	}
+
 	write_lock_bh(&set->lock);
 	ret = set->variant->kadt(set, skb, par, IPSET_ADD, opt);
 	write_unlock_bh(&set->lock);
+out:
+	opt->cmdflags &= ~IPSET_FLAG_KERNEL_ADD;
 
 	return ret;
 }
@@ -714,11 +1395,19 @@ EXPORT_SYMBOL_GPL(ip_set_nfnl_put);
  * The commands are serialized by the nfnl mutex.
  */
 
+static inline u8
+protocol(const struct nlattr * const tb[])
+{
+	return nla_get_u8(tb[IPSET_ATTR_PROTOCOL]);
+}
+
+/* The replies carry the protocol version of the request */
 static inline bool
 protocol_failed(const struct nlattr * const tb[])
 {
 	return !tb[IPSET_ATTR_PROTOCOL] ||
-	       nla_get_u8(tb[IPSET_ATTR_PROTOCOL]) != IPSET_PROTOCOL;
+	       protocol(tb) < IPSET_PROTOCOL_MIN ||
+	       protocol(tb) > IPSET_PROTOCOL;
 }
 
 static inline u32
@@ -818,30 +1507,44 @@ ip_set_none(struct sock *ctnl, struct sk_buff *skb,
 	return -EOPNOTSUPP;
 }
 
+static inline bool
+create_attr_failed(const struct nlattr * const attr[])
+{
+	return protocol_failed(attr) ||
+	       attr[IPSET_ATTR_SETNAME] == NULL ||
+	       attr[IPSET_ATTR_TYPENAME] == NULL ||
+	       attr[IPSET_ATTR_REVISION] == NULL ||
+	       attr[IPSET_ATTR_FAMILY] == NULL ||
+	       (attr[IPSET_ATTR_DATA] != NULL &&
+		!flag_nested(attr[IPSET_ATTR_DATA]));
+}
+
+static void
+ip_set_free_set(struct ip_set *set)
+{
+	/* Must call it without holding any lock */
+	set->variant->destroy(set);
+	module_put(set->type->me);
+	if (set->stats) {
+		static_key_slow_dec(&ip_set_stats_key);
+		free_percpu(set->stats);
+	}
+	kfree(set);
+}
+
+/* Allocate and create a set from the attributes of a create or replace
+ * command, without any locks and without adding it to ip_set_list. */
 static int
-ip_set_create(struct sock *ctnl, struct sk_buff *skb,
-	      const struct nlmsghdr *nlh,
-	      const struct nlattr * const attr[])
+ip_set_alloc_set(struct net *net, const struct nlattr * const attr[],
+		 u32 flags, struct ip_set **rset)
 {
-	struct net *net = sock_net(ctnl);
 	struct ip_set_net *inst = ip_set_pernet(net);
-	struct ip_set *set, *clash = NULL;
-	ip_set_id_t index = IPSET_INVALID_ID;
+	struct ip_set *set;
 	struct nlattr *tb[IPSET_ATTR_CREATE_MAX+1] = {};
 	const char *name, *typename;
 	u8 family, revision;
-	u32 flags = flag_exist(nlh);
 	int ret = 0;
 
-	if (unlikely(protocol_failed(attr) ||
-		     attr[IPSET_ATTR_SETNAME] == NULL ||
-		     attr[IPSET_ATTR_TYPENAME] == NULL ||
-		     attr[IPSET_ATTR_REVISION] == NULL ||
-		     attr[IPSET_ATTR_FAMILY] == NULL ||
-		     (attr[IPSET_ATTR_DATA] != NULL &&
-		      !flag_nested(attr[IPSET_ATTR_DATA]))))
-		return -IPSET_ERR_PROTOCOL;
-
 	name = nla_data(attr[IPSET_ATTR_SETNAME]);
 	typename = nla_data(attr[IPSET_ATTR_TYPENAME]);
 	family = nla_get_u8(attr[IPSET_ATTR_FAMILY]);
@@ -860,6 +1563,13 @@ ip_set_create(struct sock *ctnl, struct sk_buff *skb,
 	strlcpy(set->name, name, IPSET_MAXNAMELEN);
 	set->family = family;
 	set->revision = revision;
+	if (stats) {
+		set->stats = alloc_percpu(struct ip_set_stats);
+		if (!set->stats) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
 
 	/*
 	 * Next, check that we know the type, and take
@@ -882,10 +1592,54 @@ ip_set_create(struct sock *ctnl, struct sk_buff *skb,
 		ret = -IPSET_ERR_PROTOCOL;
 		goto put_out;
 	}
+#ifndef HAVE_ALLOC_PERCPU_GFP
+	/* Per-CPU counters are allocated from the packet path too */
+	if (tb[IPSET_ATTR_CADT_FLAGS] &&
+	    (ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]) &
+	     IPSET_FLAG_WITH_PCPU_COUNTERS)) {
+		ret = -IPSET_ERR_COUNTER;
+		goto put_out;
+	}
+#endif
 
+	set->epoch = get_jiffies_64();
 	ret = set->type->create(net, set, tb, flags);
 	if (ret != 0)
 		goto put_out;
+	if (SET_WITH_COMMENT(set))
+		set->comments = &inst->comments;
+	if (set->stats)
+		static_key_slow_inc(&ip_set_stats_key);
+
+	*rset = set;
+	return 0;
+
+put_out:
+	module_put(set->type->me);
+out:
+	free_percpu(set->stats);
+	kfree(set);
+	return ret;
+}
+
+static int
+ip_set_create(struct sock *ctnl, struct sk_buff *skb,
+	      const struct nlmsghdr *nlh,
+	      const struct nlattr * const attr[])
+{
+	struct net *net = sock_net(ctnl);
+	struct ip_set_net *inst = ip_set_pernet(net);
+	struct ip_set *set, *clash = NULL;
+	ip_set_id_t index = IPSET_INVALID_ID;
+	u32 flags = flag_exist(nlh);
+	int ret = 0;
+
+	if (unlikely(create_attr_failed(attr)))
+		return -IPSET_ERR_PROTOCOL;
+
+	ret = ip_set_alloc_set(net, attr, flags, &set);
+	if (ret != 0)
+		return ret;
 
 	/* BTW, ret==0 here. */
 
@@ -939,11 +1693,7 @@ ip_set_create(struct sock *ctnl, struct sk_buff *skb,
 	return ret;
 
 cleanup:
-	set->variant->destroy(set);
-put_out:
-	module_put(set->type->me);
-out:
-	kfree(set);
+	ip_set_free_set(set);
 	return ret;
 }
 
@@ -964,10 +1714,9 @@ ip_set_destroy_set(struct ip_set_net *inst, ip_set_id_t index)
 	pr_debug("set: %s\n",  set->name);
 	nfnl_set(inst, index) = NULL;
 
-	/* Must call it without holding any lock */
-	set->variant->destroy(set);
-	module_put(set->type->me);
-	kfree(set);
+	if (set->shadow)
+		ip_set_free_set(set->shadow);
+	ip_set_free_set(set);
 }
 
 static int
@@ -1069,6 +1818,47 @@ ip_set_flush(struct sock *ctnl, struct sk_buff *skb,
 	return 0;
 }
 
+/* Compact sets: shrink the memory of the sets which support it */
+
+static int
+ip_set_compact_set(struct ip_set *set)
+{
+	pr_debug("set: %s\n",  set->name);
+
+	/* The set is resized without holding its lock */
+	return set->variant->compact ? set->variant->compact(set) : 0;
+}
+
+static int
+ip_set_compact(struct sock *ctnl, struct sk_buff *skb,
+	       const struct nlmsghdr *nlh,
+	       const struct nlattr * const attr[])
+{
+	struct ip_set_net *inst = ip_set_pernet(sock_net(ctnl));
+	struct ip_set *s;
+	ip_set_id_t i;
+	int ret = 0, r;
+
+	if (unlikely(protocol_failed(attr)))
+		return -IPSET_ERR_PROTOCOL;
+
+	if (!attr[IPSET_ATTR_SETNAME]) {
+		for (i = 0; i < inst->ip_set_max; i++) {
+			s = nfnl_set(inst, i);
+			if (s != NULL && (r = ip_set_compact_set(s)) != 0)
+				ret = r;
+		}
+	} else {
+		s = find_set(inst, nla_data(attr[IPSET_ATTR_SETNAME]));
+		if (s == NULL)
+			return -ENOENT;
+
+		ret = ip_set_compact_set(s);
+	}
+
+	return ret;
+}
+
 /* Rename a set */
 
 static const struct nla_policy
@@ -1162,11 +1952,16 @@ ip_set_swap(struct sock *ctnl, struct sk_buff *skb,
 	      from->family == to->family))
 		return -IPSET_ERR_TYPE_MISMATCH;
 
+	write_lock_bh(&ip_set_ref_lock);
+	/* The listings refer to the sets by index and keep state of them */
+	if (from->ref_netlink || to->ref_netlink) {
+		write_unlock_bh(&ip_set_ref_lock);
+		return -IPSET_ERR_BUSY;
+	}
 	strncpy(from_name, from->name, IPSET_MAXNAMELEN);
 	strncpy(from->name, to->name, IPSET_MAXNAMELEN);
 	strncpy(to->name, from_name, IPSET_MAXNAMELEN);
 
-	write_lock_bh(&ip_set_ref_lock);
 	swap(from->ref, to->ref);
 	nfnl_set(inst, from_id) = to;
 	nfnl_set(inst, to_id) = from;
@@ -1175,6 +1970,120 @@ ip_set_swap(struct sock *ctnl, struct sk_buff *skb,
 	return 0;
 }
 
+/* Replace the content of a set: the new elements are added to a shadow
+ * set, which is not in ip_set_list and cannot be referenced, then the
+ * shadow takes the place of the set at the index of it. The external
+ * references remain valid, as they refer to the index.
+ *
+ * The shadow is created with the same attributes as at create, but the
+ * type and family must be the same as of the set.
+ */
+
+static int
+ip_set_replace(struct sock *ctnl, struct sk_buff *skb,
+	       const struct nlmsghdr *nlh,
+	       const struct nlattr * const attr[])
+{
+	struct net *net = sock_net(ctnl);
+	struct ip_set_net *inst = ip_set_pernet(net);
+	struct ip_set *set, *shadow;
+	int ret;
+
+	if (unlikely(create_attr_failed(attr)))
+		return -IPSET_ERR_PROTOCOL;
+
+	ret = ip_set_alloc_set(net, attr, flag_exist(nlh), &shadow);
+	if (ret != 0)
+		return ret;
+
+	/* The nfnl mutex might be released while loading the type */
+	set = find_set(inst, shadow->name);
+	if (set == NULL) {
+		ret = -ENOENT;
+		goto cleanup;
+	}
+	if (!(shadow->type == set->type && shadow->family == set->family)) {
+		ret = -IPSET_ERR_TYPE_MISMATCH;
+		goto cleanup;
+	}
+	pr_debug("replace: shadow of '%s' created\n", set->name);
+
+	/* An unpublished former shadow is dropped: it is not
+	 * visible from the packet path */
+	swap(set->shadow, shadow);
+	if (shadow == NULL)
+		return 0;
+
+cleanup:
+	ip_set_free_set(shadow);
+	return ret;
+}
+
+/* The sets replaced by their shadow are destroyed from process context
+ * after the packets which may still use them have passed through. */
+static void
+ip_set_retire_work(struct work_struct *work)
+{
+	struct ip_set_net *inst =
+		container_of(work, struct ip_set_net, retire_work);
+	struct ip_set *set, *next;
+
+	lock_nfnl();
+	set = inst->retired;
+	inst->retired = NULL;
+	unlock_nfnl();
+
+	synchronize_net();
+	for (; set != NULL; set = next) {
+		/* The retired sets are chained through the shadow pointer */
+		next = set->shadow;
+		pr_debug("replaced set %s destroyed\n", set->name);
+		ip_set_free_set(set);
+	}
+}
+
+static int
+ip_set_publish(struct sock *ctnl, struct sk_buff *skb,
+	       const struct nlmsghdr *nlh,
+	       const struct nlattr * const attr[])
+{
+	struct ip_set_net *inst = ip_set_pernet(sock_net(ctnl));
+	struct ip_set *set, *shadow;
+	ip_set_id_t index;
+
+	if (unlikely(protocol_failed(attr) ||
+		     attr[IPSET_ATTR_SETNAME] == NULL))
+		return -IPSET_ERR_PROTOCOL;
+
+	set = find_set_and_id(inst, nla_data(attr[IPSET_ATTR_SETNAME]),
+			      &index);
+	if (set == NULL)
+		return -ENOENT;
+	shadow = set->shadow;
+	if (shadow == NULL)
+		return -IPSET_ERR_NO_SHADOW;
+	strncpy(shadow->name, set->name, IPSET_MAXNAMELEN);
+
+	write_lock_bh(&ip_set_ref_lock);
+	if (set->ref_netlink) {
+		write_unlock_bh(&ip_set_ref_lock);
+		return -IPSET_ERR_BUSY;
+	}
+	set->shadow = NULL;
+	swap(set->ref, shadow->ref);
+	/* Pairs with rcu_dereference() in ip_set_rcu_get() */
+	smp_wmb();
+	nfnl_set(inst, index) = shadow;
+	write_unlock_bh(&ip_set_ref_lock);
+	pr_debug("replace: '%s' published\n", shadow->name);
+
+	set->shadow = inst->retired;
+	inst->retired = set;
+	schedule_work(&inst->retire_work);
+
+	return 0;
+}
+
 /* List/save set data */
 
 #define DUMP_INIT	0
@@ -1182,18 +2091,22 @@ ip_set_swap(struct sock *ctnl, struct sk_buff *skb,
 #define DUMP_ONE	2
 #define DUMP_LAST	3
 
-#define DUMP_TYPE(arg)		(((u32)(arg)) & 0x0000FFFF)
+#define DUMP_TYPE(arg)		(((u32)(arg)) & 0x000000FF)
+#define DUMP_PROTO(arg)		((((u32)(arg)) >> 8) & 0x000000FF)
 #define DUMP_FLAGS(arg)		(((u32)(arg)) >> 16)
 
 static int
 ip_set_dump_done(struct netlink_callback *cb)
 {
 	struct ip_set_net *inst = (struct ip_set_net *)cb->args[IPSET_CB_NET];
+	struct ip_set *set;
+
 	if (cb->args[IPSET_CB_ARG0]) {
-		pr_debug("release set %s\n",
-			 nfnl_set(inst, cb->args[IPSET_CB_INDEX])->name);
-		__ip_set_put_byindex(inst,
-			(ip_set_id_t) cb->args[IPSET_CB_INDEX]);
+		set = nfnl_set(inst, cb->args[IPSET_CB_INDEX]);
+		pr_debug("release set %s\n", set->name);
+		if (set->variant->uref)
+			set->variant->uref(set, cb, false);
+		__ip_set_put_netlink(set);
 	}
 	return 0;
 }
@@ -1225,9 +2138,12 @@ dump_init(struct netlink_callback *cb, struct ip_set_net *inst)
 		  attr, nlh->nlmsg_len - min_len, ip_set_setname_policy);
 
 	/* cb->args[IPSET_CB_NET]:	net namespace
-	 *         [IPSET_CB_DUMP]:	dump single set/all sets
+	 *         [IPSET_CB_DUMP]:	dump single set/all sets,
+	 *				protocol version, flags
 	 *         [IPSET_CB_INDEX]: 	set index
-	 *         [IPSET_CB_ARG0]:	type specific
+	 *         [IPSET_CB_ARG0]:	type specific, non-zero while
+	 *				the set is being listed
+	 *         [IPSET_CB_ARG1..2]:	type specific
 	 */
 
 	if (cda[IPSET_ATTR_SETNAME]) {
@@ -1243,6 +2159,7 @@ dump_init(struct netlink_callback *cb, struct ip_set_net *inst)
 	} else
 		dump_type = DUMP_ALL;
 
+	dump_type |= protocol(cda) << 8;
 	if (cda[IPSET_ATTR_FLAGS]) {
 		u32 f = ip_set_get_h32(cda[IPSET_ATTR_FLAGS]);
 		dump_type |= (f << 16);
@@ -1262,6 +2179,7 @@ ip_set_dump_start(struct sk_buff *skb, struct netlink_callback *cb)
 	unsigned int flags = NETLINK_PORTID(cb->skb) ? NLM_F_MULTI : 0;
 	struct ip_set_net *inst = ip_set_pernet(sock_net(skb->sk));
 	u32 dump_type, dump_flags;
+	u8 proto;
 	int ret = 0;
 
 	if (!cb->args[IPSET_CB_DUMP]) {
@@ -1280,6 +2198,7 @@ ip_set_dump_start(struct sk_buff *skb, struct netlink_callback *cb)
 		goto out;
 
 	dump_type = DUMP_TYPE(cb->args[IPSET_CB_DUMP]);
+	proto = DUMP_PROTO(cb->args[IPSET_CB_DUMP]);
 	dump_flags = DUMP_FLAGS(cb->args[IPSET_CB_DUMP]);
 	max = dump_type == DUMP_ONE ? cb->args[IPSET_CB_INDEX] + 1
 				    : inst->ip_set_max;
@@ -1307,7 +2226,7 @@ dump_last:
 		if (!cb->args[IPSET_CB_ARG0]) {
 			/* Start listing: make sure set won't be destroyed */
 			pr_debug("reference set\n");
-			__ip_set_get(set);
+			__ip_set_get_netlink(set);
 		}
 		nlh = start_msg(skb, NETLINK_PORTID(cb->skb),
 				cb->nlh->nlmsg_seq, flags,
@@ -1316,7 +2235,7 @@ dump_last:
 			ret = -EMSGSIZE;
 			goto release_refcount;
 		}
-		if (nla_put_u8(skb, IPSET_ATTR_PROTOCOL, IPSET_PROTOCOL) ||
+		if (nla_put_u8(skb, IPSET_ATTR_PROTOCOL, proto) ||
 		    nla_put_string(skb, IPSET_ATTR_SETNAME, set->name))
 			goto nla_put_failure;
 		if (dump_flags & IPSET_FLAG_LIST_SETNAME)
@@ -1338,9 +2257,18 @@ dump_last:
 				goto next_set;
 			/* Fall through and add elements */
 		default:
-			read_lock_bh(&set->lock);
-			ret = set->variant->list(set, skb, cb);
-			read_unlock_bh(&set->lock);
+			if (!set->variant->uref) {
+				read_lock_bh(&set->lock);
+				ret = set->variant->list(set, skb, cb);
+				read_unlock_bh(&set->lock);
+			} else {
+				/* The type pins the listed version of its
+				 * data and does the locking */
+				if (!cb->args[IPSET_CB_ARG0])
+					ret = set->variant->uref(set, cb, true);
+				if (!ret)
+					ret = set->variant->list(set, skb, cb);
+			}
 			if (!cb->args[IPSET_CB_ARG0])
 				/* Set is done, proceed with next one */
 				goto next_set;
@@ -1350,7 +2278,8 @@ dump_last:
 	/* If we dump all sets, continue with dumping last ones */
 	if (dump_type == DUMP_ALL) {
 		dump_type = DUMP_LAST;
-		cb->args[IPSET_CB_DUMP] = dump_type | (dump_flags << 16);
+		cb->args[IPSET_CB_DUMP] = dump_type | (proto << 8) |
+					  (dump_flags << 16);
 		cb->args[IPSET_CB_INDEX] = 0;
 		goto dump_last;
 	}
@@ -1367,7 +2296,9 @@ release_refcount:
 	/* If there was an error or set is done, release set */
 	if (ret || !cb->args[IPSET_CB_ARG0]) {
 		pr_debug("release set %s\n", nfnl_set(inst, index)->name);
-		__ip_set_put_byindex(inst, index);
+		if (set->variant->uref)
+			set->variant->uref(set, cb, false);
+		__ip_set_put_netlink(set);
 		cb->args[IPSET_CB_ARG0] = 0;
 	}
 out:
@@ -1416,8 +2347,46 @@ static const struct nla_policy ip_set_adt_policy[IPSET_ATTR_CMD_MAX + 1] = {
 	[IPSET_ATTR_LINENO]	= { .type = NLA_U32 },
 	[IPSET_ATTR_DATA]	= { .type = NLA_NESTED },
 	[IPSET_ATTR_ADT]	= { .type = NLA_NESTED },
+	[IPSET_ATTR_PACKED]	= { .type = NLA_BINARY },
+	[IPSET_ATTR_FLAGS]	= { .type = NLA_U32 },
 };
 
+/* Error in restore/batch mode: send back lineno */
+static int
+report_lineno(struct sock *ctnl, struct sk_buff *skb, int ret, u32 lineno)
+{
+	struct nlmsghdr *rep, *nlh = nlmsg_hdr(skb);
+	struct sk_buff *skb2;
+	struct nlmsgerr *errmsg;
+	size_t payload = sizeof(*errmsg) + nlmsg_len(nlh);
+	int min_len = NLMSG_SPACE(sizeof(struct nfgenmsg));
+	struct nlattr *cda[IPSET_ATTR_CMD_MAX+1];
+	struct nlattr *cmdattr;
+	u32 *errline;
+
+	skb2 = nlmsg_new(payload, GFP_KERNEL);
+	if (skb2 == NULL)
+		return -ENOMEM;
+	rep = __nlmsg_put(skb2, NETLINK_PORTID(skb),
+			  nlh->nlmsg_seq, NLMSG_ERROR, payload, 0);
+	errmsg = nlmsg_data(rep);
+	errmsg->error = ret;
+	memcpy(&errmsg->msg, nlh, nlh->nlmsg_len);
+	cmdattr = (void *)&errmsg->msg + min_len;
+
+	nla_parse(cda, IPSET_ATTR_CMD_MAX,
+		  cmdattr, nlh->nlmsg_len - min_len,
+		  ip_set_adt_policy);
+
+	errline = nla_data(cda[IPSET_ATTR_LINENO]);
+
+	*errline = lineno;
+
+	netlink_unicast(ctnl, skb2, NETLINK_PORTID(skb), MSG_DONTWAIT);
+	/* Signal netlink not to send its ACK/errmsg.  */
+	return -EINTR;
+}
+
 static int
 call_ad(struct sock *ctnl, struct sk_buff *skb, struct ip_set *set,
 	struct nlattr *tb[], enum ipset_adt adt,
@@ -1438,47 +2407,56 @@ call_ad(struct sock *ctnl, struct sk_buff *skb, struct ip_set *set,
 
 	if (!ret || (ret == -IPSET_ERR_EXIST && eexist))
 		return 0;
-	if (lineno && use_lineno) {
-		/* Error in restore/batch mode: send back lineno */
-		struct nlmsghdr *rep, *nlh = nlmsg_hdr(skb);
-		struct sk_buff *skb2;
-		struct nlmsgerr *errmsg;
-		size_t payload = sizeof(*errmsg) + nlmsg_len(nlh);
-		int min_len = NLMSG_SPACE(sizeof(struct nfgenmsg));
-		struct nlattr *cda[IPSET_ATTR_CMD_MAX+1];
-		struct nlattr *cmdattr;
-		u32 *errline;
-
-		skb2 = nlmsg_new(payload, GFP_KERNEL);
-		if (skb2 == NULL)
-			return -ENOMEM;
-		rep = __nlmsg_put(skb2, NETLINK_PORTID(skb),
-				  nlh->nlmsg_seq, NLMSG_ERROR, payload, 0);
-		errmsg = nlmsg_data(rep);
-		errmsg->error = ret;
-		memcpy(&errmsg->msg, nlh, nlh->nlmsg_len);
-		cmdattr = (void *)&errmsg->msg + min_len;
-
-		nla_parse(cda, IPSET_ATTR_CMD_MAX,
-			  cmdattr, nlh->nlmsg_len - min_len,
-			  ip_set_adt_policy);
+	if (lineno && use_lineno)
+		return report_lineno(ctnl, skb, ret, lineno);
 
-		errline = nla_data(cda[IPSET_ATTR_LINENO]);
+	return ret;
+}
 
-		*errline = lineno;
+/* Add/del the elements of a packed array: there is no attribute parsing
+ * per element and the set is locked once, except when it must be resized.
+ * The element at index i comes from line lineno + i. */
+static int
+call_ad_packed(struct sock *ctnl, struct sk_buff *skb, struct ip_set *set,
+	       const struct nlattr *nla, enum ipset_adt adt,
+	       u32 flags, u32 lineno)
+{
+	const u8 *data = nla_data(nla);
+	u32 psize = set->variant->psize;
+	u32 i = 0, n = nla_len(nla) / psize;
+	int ret = 0;
 
-		netlink_unicast(ctnl, skb2, NETLINK_PORTID(skb), MSG_DONTWAIT);
-		/* Signal netlink not to send its ACK/errmsg.  */
-		return -EINTR;
+	write_lock_bh(&set->lock);
+	while (i < n) {
+		ret = set->variant->padt(set, data + i * psize, adt, flags);
+		if (ret == -EAGAIN && set->variant->resize) {
+			/* Resize, then retry the same element */
+			write_unlock_bh(&set->lock);
+			ret = set->variant->resize(set, true);
+			write_lock_bh(&set->lock);
+			if (!ret)
+				continue;
+		}
+		if (ret && !ip_set_eexist(ret, flags))
+			break;
+		ret = 0;
+		i++;
 	}
+	write_unlock_bh(&set->lock);
+
+	if (!ret)
+		return 0;
+	if (lineno)
+		return report_lineno(ctnl, skb, ret, htonl(lineno + i));
 
 	return ret;
 }
 
 static int
-ip_set_uadd(struct sock *ctnl, struct sk_buff *skb,
-	    const struct nlmsghdr *nlh,
-	    const struct nlattr * const attr[])
+ip_set_ad(struct sock *ctnl, struct sk_buff *skb,
+	  enum ipset_adt adt,
+	  const struct nlmsghdr *nlh,
+	  const struct nlattr * const attr[])
 {
 	struct ip_set_net *inst = ip_set_pernet(sock_net(ctnl));
 	struct ip_set *set;
@@ -1488,10 +2466,13 @@ ip_set_uadd(struct sock *ctnl, struct sk_buff *skb,
 	bool use_lineno;
 	int ret = 0;
 
+	/* Exactly one of single element, multiple elements
+	 * and packed elements */
 	if (unlikely(protocol_failed(attr) ||
 		     attr[IPSET_ATTR_SETNAME] == NULL ||
-		     !((attr[IPSET_ATTR_DATA] != NULL) ^
-		       (attr[IPSET_ATTR_ADT] != NULL)) ||
+		     (attr[IPSET_ATTR_DATA] != NULL) +
+		     (attr[IPSET_ATTR_ADT] != NULL) +
+		     (attr[IPSET_ATTR_PACKED] != NULL) != 1 ||
 		     (attr[IPSET_ATTR_DATA] != NULL &&
 		      !flag_nested(attr[IPSET_ATTR_DATA])) ||
 		     (attr[IPSET_ATTR_ADT] != NULL &&
@@ -1502,6 +2483,13 @@ ip_set_uadd(struct sock *ctnl, struct sk_buff *skb,
 	set = find_set(inst, nla_data(attr[IPSET_ATTR_SETNAME]));
 	if (set == NULL)
 		return -ENOENT;
+	/* The elements of a replace go to the shadow */
+	if (attr[IPSET_ATTR_FLAGS] &&
+	    (ip_set_get_h32(attr[IPSET_ATTR_FLAGS]) & IPSET_FLAG_SHADOW)) {
+		set = set->shadow;
+		if (set == NULL)
+			return -IPSET_ERR_NO_SHADOW;
+	}
 
 	use_lineno = !!attr[IPSET_ATTR_LINENO];
 	if (attr[IPSET_ATTR_DATA]) {
@@ -1509,8 +2497,16 @@ ip_set_uadd(struct sock *ctnl, struct sk_buff *skb,
 				     attr[IPSET_ATTR_DATA],
 				     set->type->adt_policy))
 			return -IPSET_ERR_PROTOCOL;
-		ret = call_ad(ctnl, skb, set, tb, IPSET_ADD, flags,
+		ret = call_ad(ctnl, skb, set, tb, adt, flags,
 			      use_lineno);
+	} else if (attr[IPSET_ATTR_PACKED]) {
+		nla = attr[IPSET_ATTR_PACKED];
+		if (!set->variant->padt ||
+		    nla_len(nla) % set->variant->psize)
+			return -IPSET_ERR_PROTOCOL;
+		ret = call_ad_packed(ctnl, skb, set, nla, adt, flags,
+				     use_lineno ?
+				     ip_set_get_h32(attr[IPSET_ATTR_LINENO]) : 0);
 	} else {
 		int nla_rem;
 
@@ -1521,7 +2517,7 @@ ip_set_uadd(struct sock *ctnl, struct sk_buff *skb,
 			    nla_parse_nested(tb, IPSET_ATTR_ADT_MAX, nla,
 					     set->type->adt_policy))
 				return -IPSET_ERR_PROTOCOL;
-			ret = call_ad(ctnl, skb, set, tb, IPSET_ADD,
+			ret = call_ad(ctnl, skb, set, tb, adt,
 				      flags, use_lineno);
 			if (ret < 0)
 				return ret;
@@ -1531,58 +2527,19 @@ ip_set_uadd(struct sock *ctnl, struct sk_buff *skb,
 }
 
 static int
-ip_set_udel(struct sock *ctnl, struct sk_buff *skb,
+ip_set_uadd(struct sock *ctnl, struct sk_buff *skb,
 	    const struct nlmsghdr *nlh,
 	    const struct nlattr * const attr[])
 {
-	struct ip_set_net *inst = ip_set_pernet(sock_net(ctnl));
-	struct ip_set *set;
-	struct nlattr *tb[IPSET_ATTR_ADT_MAX+1] = {};
-	const struct nlattr *nla;
-	u32 flags = flag_exist(nlh);
-	bool use_lineno;
-	int ret = 0;
-
-	if (unlikely(protocol_failed(attr) ||
-		     attr[IPSET_ATTR_SETNAME] == NULL ||
-		     !((attr[IPSET_ATTR_DATA] != NULL) ^
-		       (attr[IPSET_ATTR_ADT] != NULL)) ||
-		     (attr[IPSET_ATTR_DATA] != NULL &&
-		      !flag_nested(attr[IPSET_ATTR_DATA])) ||
-		     (attr[IPSET_ATTR_ADT] != NULL &&
-		      (!flag_nested(attr[IPSET_ATTR_ADT]) ||
-		       attr[IPSET_ATTR_LINENO] == NULL))))
-		return -IPSET_ERR_PROTOCOL;
-
-	set = find_set(inst, nla_data(attr[IPSET_ATTR_SETNAME]));
-	if (set == NULL)
-		return -ENOENT;
-
-	use_lineno = !!attr[IPSET_ATTR_LINENO];
-	if (attr[IPSET_ATTR_DATA]) {
-		if (nla_parse_nested(tb, IPSET_ATTR_ADT_MAX,
-				     attr[IPSET_ATTR_DATA],
-				     set->type->adt_policy))
-			return -IPSET_ERR_PROTOCOL;
-		ret = call_ad(ctnl, skb, set, tb, IPSET_DEL, flags,
-			      use_lineno);
-	} else {
-		int nla_rem;
+	return ip_set_ad(ctnl, skb, IPSET_ADD, nlh, attr);
+}
 
-		nla_for_each_nested(nla, attr[IPSET_ATTR_ADT], nla_rem) {
-			memset(tb, 0, sizeof(*tb));
-			if (nla_type(nla) != IPSET_ATTR_DATA ||
-			    !flag_nested(nla) ||
-			    nla_parse_nested(tb, IPSET_ATTR_ADT_MAX, nla,
-					     set->type->adt_policy))
-				return -IPSET_ERR_PROTOCOL;
-			ret = call_ad(ctnl, skb, set, tb, IPSET_DEL,
-				      flags, use_lineno);
-			if (ret < 0)
-				return ret;
-		}
-	}
-	return ret;
+static int
+ip_set_udel(struct sock *ctnl, struct sk_buff *skb,
+	    const struct nlmsghdr *nlh,
+	    const struct nlattr * const attr[])
+{
+	return ip_set_ad(ctnl, skb, IPSET_DEL, nlh, attr);
 }
 
 static int
@@ -1648,7 +2605,7 @@ ip_set_header(struct sock *ctnl, struct sk_buff *skb,
 			 IPSET_CMD_HEADER);
 	if (!nlh2)
 		goto nlmsg_failure;
-	if (nla_put_u8(skb2, IPSET_ATTR_PROTOCOL, IPSET_PROTOCOL) ||
+	if (nla_put_u8(skb2, IPSET_ATTR_PROTOCOL, protocol(attr)) ||
 	    nla_put_string(skb2, IPSET_ATTR_SETNAME, set->name) ||
 	    nla_put_string(skb2, IPSET_ATTR_TYPENAME, set->type->name) ||
 	    nla_put_u8(skb2, IPSET_ATTR_FAMILY, set->family) ||
@@ -1708,7 +2665,7 @@ ip_set_type(struct sock *ctnl, struct sk_buff *skb,
 			 IPSET_CMD_TYPE);
 	if (!nlh2)
 		goto nlmsg_failure;
-	if (nla_put_u8(skb2, IPSET_ATTR_PROTOCOL, IPSET_PROTOCOL) ||
+	if (nla_put_u8(skb2, IPSET_ATTR_PROTOCOL, protocol(attr)) ||
 	    nla_put_string(skb2, IPSET_ATTR_TYPENAME, typename) ||
 	    nla_put_u8(skb2, IPSET_ATTR_FAMILY, family) ||
 	    nla_put_u8(skb2, IPSET_ATTR_REVISION, max) ||
@@ -1757,7 +2714,8 @@ ip_set_protocol(struct sock *ctnl, struct sk_buff *skb,
 			 IPSET_CMD_PROTOCOL);
 	if (!nlh2)
 		goto nlmsg_failure;
-	if (nla_put_u8(skb2, IPSET_ATTR_PROTOCOL, IPSET_PROTOCOL))
+	if (nla_put_u8(skb2, IPSET_ATTR_PROTOCOL, IPSET_PROTOCOL) ||
+	    nla_put_u8(skb2, IPSET_ATTR_PROTOCOL_MIN, IPSET_PROTOCOL_MIN))
 		goto nla_put_failure;
 	nlmsg_end(skb2, nlh2);
 
@@ -1839,6 +2797,21 @@ static const struct nfnl_callback ip_set_netlink_subsys_cb[IPSET_MSG_MAX] = {
 		.attr_count	= IPSET_ATTR_CMD_MAX,
 		.policy		= ip_set_type_policy,
 	},
+	[IPSET_CMD_COMPACT]	= {
+		.call		= ip_set_compact,
+		.attr_count	= IPSET_ATTR_CMD_MAX,
+		.policy		= ip_set_setname_policy,
+	},
+	[IPSET_CMD_REPLACE]	= {
+		.call		= ip_set_replace,
+		.attr_count	= IPSET_ATTR_CMD_MAX,
+		.policy		= ip_set_create_policy,
+	},
+	[IPSET_CMD_PUBLISH]	= {
+		.call		= ip_set_publish,
+		.attr_count	= IPSET_ATTR_CMD_MAX,
+		.policy		= ip_set_setname_policy,
+	},
 	[IPSET_CMD_PROTOCOL]	= {
 		.call		= ip_set_protocol,
 		.attr_count	= IPSET_ATTR_CMD_MAX,
@@ -1883,7 +2856,8 @@ ip_set_sockfn_get(struct sock *sk, int optval, void __user *user, int *len)
 	if (*op < IP_SET_OP_VERSION) {
 		/* Check the version at the beginning of operations */
 		struct ip_set_req_version *req_version = data;
-		if (req_version->version != IPSET_PROTOCOL) {
+		if (req_version->version < IPSET_PROTOCOL_MIN ||
+		    req_version->version > IPSET_PROTOCOL) {
 			ret = -EPROTO;
 			goto done;
 		}
@@ -2004,6 +2978,9 @@ ip_set_net_init(struct net *net)
 		goto err_alloc;
 #endif
 	inst->is_deleted = 0;
+	ip_set_comment_table_init(&inst->comments);
+	inst->retired = NULL;
+	INIT_WORK(&inst->retire_work, ip_set_retire_work);
 	rcu_assign_pointer(inst->ip_set_list, list);
 	pr_notice("ip_set: protocol %u\n", IPSET_PROTOCOL);
 	return 0;
@@ -2024,6 +3001,7 @@ ip_set_net_exit(struct net *net)
 	ip_set_id_t i;
 
 	inst->is_deleted = 1; /* flag for ip_set_nfnl_put */
+	flush_work(&inst->retire_work);
 
 	for (i = 0; i < inst->ip_set_max; i++) {
 		set = nfnl_set(inst, i);
@@ -2031,6 +3009,7 @@ ip_set_net_exit(struct net *net)
 			ip_set_destroy_set(inst, i);
 	}
 	kfree(rcu_dereference_protected(inst->ip_set_list, 1));
+	ip_set_comment_table_free(&inst->comments);
 #ifndef HAVE_NET_OPS_ID
 	kfree(inst);
 #endif
@@ -8,8 +8,15 @@
 #ifndef _IP_SET_HASH_GEN_H
 #define _IP_SET_HASH_GEN_H
 
+#include <linux/cache.h>
+#include <linux/cpumask.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
 #include <linux/rcupdate.h>
 #include <linux/jhash.h>
+#include <linux/workqueue.h>
 #include <linux/netfilter/ipset/ip_set_timeout.h>
 #ifndef rcu_dereference_bh_check
 #define rcu_dereference_bh_check(p,c)	rcu_dereference_bh(p)
@@ -26,10 +33,55 @@
  *
  * Readers and resizing
  *
- * Resizing can be triggered by userspace command only, and those
- * are serialized by the nfnl mutex. During resizing the set is
+ * Resizing can be triggered by userspace command and by the worker which
+ * shrinks lightly loaded tables after deletion or expiry, those are
+ * serialized by h->resize_lock. During resizing the set is
  * read-locked, so the only possible concurrent operations are
  * the kernel side readers. Those must be protected by proper RCU locking.
+ *
+ * Large tables are resized incrementally: the doubled table becomes
+ * the table of the set at once and the elements of the old table are
+ * migrated bucket by bucket by a worker, which write-locks the set for
+ * AHASH_REHASH_STEP buckets at a time. Until the migration is finished
+ * the not yet migrated part of the old table is searched as well.
+ *
+ * Listing
+ *
+ * A listing pins the table of the set (after finishing a pending
+ * migration) and walks it across the dump messages. While it is pinned,
+ * the table is resized in one pass and the elements are copied, so the
+ * listing goes on with the consistent, old version of the set, which is
+ * destroyed by the last listing. See mtype_uref and mtype_list.
+ *
+ * Kernel side adds
+ *
+ * When the prefixes of the elements need not be book-kept, kernel side
+ * adds are first tried with the set read-locked: the buckets are
+ * protected by striped spinlocks then and the element is published to
+ * the readers by incrementing the position in the bucket. Everything
+ * beyond appending to a bucket with free slot or updating the extensions
+ * of an existing element is retried with the set write-locked.
+ * Resizing in one pass stops these adds by setting h->resizing, see
+ * mtype_stripes_barrier.
+ *
+ * Kernel side adds cannot resize the table: when the bucket of the element
+ * is full, the element is stored in the stash of the set and the worker
+ * grows the table, then adds the stashed elements. Until then those are
+ * not part of the set: tests do not match and deletes do not find them.
+ *
+ * Bucket layout
+ *
+ * The buckets are stored in one or two cache line sized blocks, which
+ * contain the bucket header and the first slots of the bucket inline.
+ * Only the buckets which hold more elements than fit into the inline
+ * slots get an overflow array, so a lookup usually costs a single
+ * cache miss.
+ *
+ * The overflow arrays grow and shrink by AHASH_INIT_SIZE slots. They
+ * are allocated from slab caches per array size, shared by the sets
+ * with the same element size, instead of kmalloc: there are no
+ * partially used kmalloc size classes and the allocations/frees are
+ * counted and reported in the header of the set.
  */
 
 /* Number of elements to store in an initial array block */
@@ -37,9 +89,42 @@
 /* Max number of elements to store in an array block */
 #define AHASH_MAX_SIZE			(3*AHASH_INIT_SIZE)
 
+/* Shrink the table when there is less than one element per so many
+ * buckets: it is shrunk to two buckets per element */
+#define AHASH_SHRINK_LOAD		8
+
+/* Elements per bucket when the table is presized from the expected number
+ * of elements: a bucket reaches AHASH_MAX_SIZE with negligible probability,
+ * so no resizing is triggered while the set is filled up */
+#define AHASH_EXPECT_LOAD		2
+
+/* Tables with at least so many buckets are resized incrementally */
+#define AHASH_REHASH_INCREMENTAL	(1 << 14)
+/* Number of buckets migrated at once by incremental resizing */
+#define AHASH_REHASH_STEP		256
+
+/* Max number of striped locks of kernel side adds */
+#define AHASH_MAX_STRIPES		1024
+
+/* Delay in jiffies of building again the replicas which could not be
+ * allocated, the lookups on their nodes use the primary table meanwhile */
+#define AHASH_REPLICAS_RETRY		HZ
+
+/* Max number of kernel side adds waiting for the table to grow */
+#define AHASH_STASH_SIZE		16
+
+/* A kernel side add in the stash: the element follows the header */
+struct ahash_stash_elem {
+	struct ip_set_ext ext;	/* extensions of the add */
+	u32 flags;		/* command flags of the add */
+	u32 data[0];		/* the element */
+};
+
 /* Max number of elements can be tuned */
 #ifdef IP_SET_HASH_WITH_MULTI
 #define AHASH_MAX(h)			((h)->ahash_max)
+/* Upper limit of the tuning */
+#define AHASH_MAX_TUNED			64
 
 static inline u8
 tune_ahash_max(u8 curr, u32 multi)
@@ -53,29 +138,50 @@ tune_ahash_max(u8 curr, u32 multi)
 	/* Currently, at listing one hash bucket must fit into a message.
 	 * Therefore we have a hard limit here.
 	 */
-	return n > curr && n <= 64 ? n : curr;
+	return n > curr && n <= AHASH_MAX_TUNED ? n : curr;
 }
 #define TUNE_AHASH_MAX(h, multi)	\
 	((h)->ahash_max = tune_ahash_max((h)->ahash_max, multi))
 #else
 #define AHASH_MAX(h)			AHASH_MAX_SIZE
+#define AHASH_MAX_TUNED			AHASH_MAX_SIZE
 #define TUNE_AHASH_MAX(h, multi)
 #endif
 
+/* Max number of the array size classes */
+#define AHASH_CLASSES			(64/AHASH_INIT_SIZE)
+
+/* Allocator of the overflow arrays */
+struct ahash_alloc {
+	struct kmem_cache *cache[AHASH_CLASSES]; /* caches per array size */
+	u64 allocs;		/* number of the allocated arrays */
+	u64 frees;		/* number of the freed arrays */
+};
+
 /* A hash bucket */
 struct hbucket {
-	void *value;		/* the array of the values */
-	u8 size;		/* size of the array */
+	void *value;		/* the overflow array of the values */
+	u8 size;		/* size of the inline slots and the array */
 	u8 pos;			/* position of the first free entry */
+	u8 inline_size;		/* number of the inline slots */
+	u32 expiry;		/* scheduled tick in the expiry index */
+	u64 inline_data[0];	/* the inline slots */
 };
 
 /* The hash table: the table size stored here in order to make resizing easy */
 struct htable {
+	atomic_t uref;		/* number of the listings pinning the table */
+	bool retired;		/* replaced, freed by the last listing */
 	u8 htable_bits;		/* size of hash table == 2^htable_bits */
-	struct hbucket bucket[0]; /* hashtable buckets */
+	u8 bucket_shift;	/* size of a bucket == 2^bucket_shift */
+	u8 inline_size;		/* number of the inline slots in a bucket */
+	/* hashtable buckets */
+	struct hbucket bucket[0] ____cacheline_aligned;
 };
 
-#define hbucket(h, i)		(&((h)->bucket[i]))
+#define hbucket(h, i)						\
+	((struct hbucket *)((void *)(h)->bucket +			\
+			    ((size_t)(i) << (h)->bucket_shift)))
 
 #ifndef IPSET_NET_COUNT
 #define IPSET_NET_COUNT		1
@@ -87,9 +193,30 @@ struct net_prefixes {
 	u8 cidr[IPSET_NET_COUNT];  /* the different cidr values in the set */
 };
 
+/* Compute the size of a bucket and the number of the inline slots in it:
+ * one cache line is used when AHASH_INIT_SIZE elements fit into it,
+ * otherwise two. Too large elements are stored out of line only.
+ */
+static u8
+hbucket_shift(size_t dsize, u8 *inline_size)
+{
+	size_t bsize = L1_CACHE_BYTES;
+	size_t slots = (bsize - sizeof(struct hbucket)) / dsize;
+
+	if (slots < AHASH_INIT_SIZE) {
+		bsize *= 2;
+		slots = (bsize - sizeof(struct hbucket)) / dsize;
+	}
+	if (!slots)
+		bsize = roundup_pow_of_two(sizeof(struct hbucket));
+	*inline_size = min_t(size_t, slots, AHASH_MAX_SIZE);
+
+	return ilog2(bsize);
+}
+
 /* Compute the hash table size */
 static size_t
-htable_size(u8 hbits)
+htable_size(u8 hbits, u8 bucket_shift)
 {
 	size_t hsize;
 
@@ -97,13 +224,41 @@ htable_size(u8 hbits)
 	if (hbits > 31)
 		return 0;
 	hsize = jhash_size(hbits);
-	if ((((size_t)-1) - sizeof(struct htable))/sizeof(struct hbucket)
-	    < hsize)
+	if (((((size_t)-1) - sizeof(struct htable)) >> bucket_shift) < hsize)
 		return 0;
 
-	return hsize * sizeof(struct hbucket) + sizeof(struct htable);
+	return (hsize << bucket_shift) + sizeof(struct htable);
+}
+
+/* Allocate a hash table with initialized buckets from the given node */
+static struct htable *
+htable_alloc_node(u8 hbits, size_t dsize, int node)
+{
+	struct htable *t;
+	size_t hsize;
+	u8 bshift, inline_size;
+	u32 i;
+
+	bshift = hbucket_shift(dsize, &inline_size);
+	hsize = htable_size(hbits, bshift);
+	if (hsize == 0)
+		return NULL;
+	t = node == NUMA_NO_NODE ? ip_set_alloc(hsize)
+				 : ip_set_alloc_node(hsize, node);
+	if (!t)
+		return NULL;
+	t->htable_bits = hbits;
+	t->bucket_shift = bshift;
+	t->inline_size = inline_size;
+	for (i = 0; i < jhash_size(hbits); i++)
+		hbucket(t, i)->size = hbucket(t, i)->inline_size = inline_size;
+
+	return t;
 }
 
+#define htable_alloc(hbits, dsize)	\
+	htable_alloc_node(hbits, dsize, NUMA_NO_NODE)
+
 /* Compute htable_bits from the user input parameter hashsize */
 static u8
 htable_bits(u32 hashsize)
@@ -117,8 +272,57 @@ htable_bits(u32 hashsize)
 	return bits;
 }
 
+/* Size of the overflow array of a bucket */
+#define hbucket_overflow(n)	((n)->size - (n)->inline_size)
+
+/* Size class of an overflow array */
+#define ahash_class(slots)	((slots)/AHASH_INIT_SIZE - 1)
+
+/* Create the caches of the arrays up to the given number of slots */
+static int
+ahash_alloc_init(struct ahash_alloc *a, u8 ahash_max, size_t dsize)
+{
+	u8 i;
+
+	for (i = 0; i < ahash_class(ahash_max) + 1; i++) {
+		a->cache[i] = ip_set_slab_get((i + 1) * AHASH_INIT_SIZE * dsize);
+		if (!a->cache[i])
+			return -ENOMEM;
+	}
+	return 0;
+}
+
+static void
+ahash_alloc_destroy(struct ahash_alloc *a)
+{
+	u8 i;
+
+	for (i = 0; i < AHASH_CLASSES && a->cache[i]; i++)
+		ip_set_slab_put(a->cache[i]);
+}
+
+static void *
+ahash_array_alloc(struct ahash_alloc *a, u8 slots)
+{
+	void *array = kmem_cache_zalloc(a->cache[ahash_class(slots)],
+					GFP_ATOMIC);
+
+	if (array)
+		a->allocs++;
+	return array;
+}
+
+static void
+ahash_array_free(struct ahash_alloc *a, struct hbucket *n)
+{
+	kmem_cache_free(a->cache[ahash_class(hbucket_overflow(n))], n->value);
+	n->value = NULL;
+	a->frees++;
+}
+
 static int
-hbucket_elem_add(struct hbucket *n, u8 ahash_max, size_t dsize)
+hbucket_elem_add(struct ahash_alloc *a, struct hbucket *n, u8 ahash_max,
+		 size_t dsize)
 {
 	if (n->pos >= n->size) {
 		void *tmp;
@@ -127,13 +331,13 @@ hbucket_elem_add(struct hbucket *n, u8 ahash_max, size_t dsize)
 			/* Trigger rehashing */
 			return -EAGAIN;
 
-		tmp = kzalloc((n->size + AHASH_INIT_SIZE) * dsize,
-			      GFP_ATOMIC);
+		tmp = ahash_array_alloc(a, hbucket_overflow(n) +
+					   AHASH_INIT_SIZE);
 		if (!tmp)
 			return -ENOMEM;
-		if (n->size) {
-			memcpy(tmp, n->value, n->size * dsize);
-			kfree(n->value);
+		if (hbucket_overflow(n)) {
+			memcpy(tmp, n->value, hbucket_overflow(n) * dsize);
+			ahash_array_free(a, n);
 		}
 		n->value = tmp;
 		n->size += AHASH_INIT_SIZE;
@@ -141,6 +345,203 @@ hbucket_elem_add(struct hbucket *n, u8 ahash_max, size_t dsize)
 	return 0;
 }
 
+/* Shrink the overflow array of a bucket when it is underused */
+static void
+hbucket_elem_shrink(struct ahash_alloc *a, struct hbucket *n, size_t dsize)
+{
+	void *tmp = NULL;
+
+	if (n->pos + AHASH_INIT_SIZE >= n->size ||
+	    hbucket_overflow(n) < AHASH_INIT_SIZE)
+		return;
+	if (hbucket_overflow(n) > AHASH_INIT_SIZE) {
+		tmp = ahash_array_alloc(a, hbucket_overflow(n) -
+					   AHASH_INIT_SIZE);
+		if (!tmp)
+			/* Keep the larger array */
+			return;
+		memcpy(tmp, n->value,
+		       (hbucket_overflow(n) - AHASH_INIT_SIZE) * dsize);
+	}
+	ahash_array_free(a, n);
+	n->value = tmp;
+	n->size -= AHASH_INIT_SIZE;
+}
+
+/* Read replicas of the hash table per NUMA node: the buckets hold the
+ * same elements at the same positions as in the primary table, but the
+ * overflow arrays are allocated with the exact size from the memory of
+ * the node. The set lock protects them like the primary table. */
+
+/* Copy the bucket n of the primary table into the bucket m of a replica */
+static int
+hbucket_replica_copy(struct hbucket *m, const struct hbucket *n,
+		     size_t dsize, int node)
+{
+	u8 overflow = n->pos > n->inline_size ? n->pos - n->inline_size : 0;
+	void *tmp = NULL;
+
+	if (overflow != hbucket_overflow(m)) {
+		if (overflow) {
+			tmp = kmalloc_node(overflow * dsize, GFP_ATOMIC, node);
+			if (!tmp)
+				return -ENOMEM;
+		}
+		kfree(m->value);
+		m->value = tmp;
+		m->size = m->inline_size + overflow;
+	}
+	memcpy(m->inline_data, n->inline_data,
+	       min(n->pos, n->inline_size) * dsize);
+	if (overflow)
+		memcpy(m->value, n->value, overflow * dsize);
+	m->pos = n->pos;
+
+	return 0;
+}
+
+/* Empty the buckets of a replica */
+static void
+htable_replica_flush(struct htable *r)
+{
+	struct hbucket *m;
+	u32 i;
+
+	for (i = 0; i < jhash_size(r->htable_bits); i++) {
+		m = hbucket(r, i);
+		kfree(m->value);
+		m->value = NULL;
+		m->size = m->inline_size;
+		m->pos = 0;
+	}
+}
+
+static void
+htable_replica_free(struct htable *r)
+{
+	htable_replica_flush(r);
+	ip_set_free(r);
+}
+
+/* Allocate empty replicas for the online nodes: the array is indexed
+ * by the node id, a node is left out when its memory is exhausted */
+static struct htable **
+htable_replicas_alloc(u8 hbits, size_t dsize)
+{
+	struct htable **rt;
+	int node;
+
+	rt = kcalloc(nr_node_ids, sizeof(*rt), GFP_KERNEL);
+	if (!rt)
+		return NULL;
+	for_each_online_node(node)
+		rt[node] = htable_alloc_node(hbits, dsize, node);
+
+	return rt;
+}
+
+static void
+htable_replicas_free(struct htable **rt)
+{
+	int node;
+
+	for_each_node(node)
+		if (rt[node])
+			htable_replica_free(rt[node]);
+	kfree(rt);
+}
+
+#if IPSET_NET_COUNT > 1
+/* Tuple space of the two networks types
+ *
+ * The different (cidr[0], cidr[1]) pairs of the elements are stored
+ * in decreasing cidr[0], then decreasing cidr[1] order. Host lookups
+ * walk this array, so only the prefix pairs present in the set are
+ * probed, in the same order as the nested loop over the prefixes would
+ * probe them.
+ */
+#define AHASH_PAIRS_STEP	16
+
+struct net_pair {
+	u32 nets;		/* number of elements with the pair */
+	u8 cidr[IPSET_NET_COUNT];
+};
+
+struct net_pairs {
+	struct net_pair *pair;	/* the probe order */
+	u32 len;		/* number of the different pairs */
+	u32 size;		/* size of the pair array */
+};
+
+/* Return the position of the pair or where it should be inserted */
+static u32
+net_pairs_find(const struct net_pairs *p, u8 cidr0, u8 cidr1, bool *found)
+{
+	u32 key = (cidr0 << 8) | cidr1, k;
+	u32 lo = 0, hi = p->len, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		k = (p->pair[mid].cidr[0] << 8) | p->pair[mid].cidr[1];
+		if (k == key) {
+			*found = true;
+			return mid;
+		}
+		if (k > key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*found = false;
+	return lo;
+}
+
+static int
+net_pairs_add(struct net_pairs *p, u8 cidr0, u8 cidr1)
+{
+	struct net_pair *tmp;
+	bool found;
+	u32 i = net_pairs_find(p, cidr0, cidr1, &found);
+
+	if (found) {
+		p->pair[i].nets++;
+		return 0;
+	}
+	if (p->len == p->size) {
+		tmp = kmalloc((p->size + AHASH_PAIRS_STEP) *
+			      sizeof(struct net_pair), GFP_ATOMIC);
+		if (!tmp)
+			return -ENOMEM;
+		if (p->size) {
+			memcpy(tmp, p->pair, p->size * sizeof(struct net_pair));
+			kfree(p->pair);
+		}
+		p->pair = tmp;
+		p->size += AHASH_PAIRS_STEP;
+	}
+	memmove(&p->pair[i + 1], &p->pair[i],
+		(p->len - i) * sizeof(struct net_pair));
+	p->pair[i].nets = 1;
+	p->pair[i].cidr[0] = cidr0;
+	p->pair[i].cidr[1] = cidr1;
+	p->len++;
+	return 0;
+}
+
+static void
+net_pairs_del(struct net_pairs *p, u8 cidr0, u8 cidr1)
+{
+	bool found;
+	u32 i = net_pairs_find(p, cidr0, cidr1, &found);
+
+	if (!found || --p->pair[i].nets)
+		return;
+	p->len--;
+	memmove(&p->pair[i], &p->pair[i + 1],
+		(p->len - i) * sizeof(struct net_pair));
+}
+#endif /* IPSET_NET_COUNT > 1 */
+
 #ifdef IP_SET_HASH_WITH_NETS
 #if IPSET_NET_COUNT > 1
 #define __CIDR(cidr, i)		(cidr[i])
@@ -166,8 +567,302 @@ hbucket_elem_add(struct hbucket *n, u8 ahash_max, size_t dsize)
 #define NLEN(family)		0
 #endif /* IP_SET_HASH_WITH_NETS */
 
+#ifdef IP_SET_HASH_WITH_LPM
+/* Longest prefix match index of the network types
+ *
+ * The prefixes stored in the set are indexed by a multibit trie with
+ * 8 bits strides. A prefix of length 8 * d + l (1 <= l <= 8) is counted
+ * in a node at depth d, at the l bits long value v of the byte d of the
+ * network address. The slots of the node which are covered by at least
+ * one prefix are marked in the lens bitmaps (bit l - 1 for length l),
+ * so a host lookup reads one bitmap and one child pointer per byte of
+ * the address and returns exactly the prefix lengths which cover it.
+ * The trie is modified under the write-locked set only.
+ */
+#define AHASH_LPM_SLOTS		256
+/* Index of the counter of the l bits long value v */
+#define AHASH_LPM_COUNT(l, v)	((1 << (l)) - 2 + (v))
+#define AHASH_LPM_CHILDREN_SIZE	\
+	(AHASH_LPM_SLOTS * sizeof(struct ahash_lpm_node *))
+
+struct ahash_lpm_node {
+	u32 refs;		/* number of stored prefixes and children */
+	u8 lens[AHASH_LPM_SLOTS];	/* covering prefix lengths per slot */
+	u32 count[2 * AHASH_LPM_SLOTS - 2];	/* elements per prefix */
+	struct ahash_lpm_node **child;	/* allocated by the first child */
+};
+
+struct ahash_lpm {
+	size_t memsize;		/* memory used by the nodes below the root */
+	struct ahash_lpm_node root;
+};
+
+/* Free the nodes below the node */
+static void
+ahash_lpm_free(struct ahash_lpm_node *node)
+{
+	u32 i;
+
+	if (!node->child)
+		return;
+	for (i = 0; i < AHASH_LPM_SLOTS; i++) {
+		if (!node->child[i])
+			continue;
+		ahash_lpm_free(node->child[i]);
+		kfree(node->child[i]);
+	}
+	kfree(node->child);
+}
+
+static void
+ahash_lpm_flush(struct ahash_lpm *lpm)
+{
+	ahash_lpm_free(&lpm->root);
+	memset(lpm, 0, sizeof(*lpm));
+}
+
+/* Release the unused nodes on the path of the address, bottom up */
+static void
+ahash_lpm_prune(struct ahash_lpm *lpm, struct ahash_lpm_node **path,
+		const u8 *addr, u8 depth)
+{
+	for (; depth > 0 && !path[depth]->refs; depth--) {
+		if (path[depth]->child) {
+			kfree(path[depth]->child);
+			lpm->memsize -= AHASH_LPM_CHILDREN_SIZE;
+		}
+		kfree(path[depth]);
+		path[depth - 1]->child[addr[depth - 1]] = NULL;
+		path[depth - 1]->refs--;
+		lpm->memsize -= sizeof(struct ahash_lpm_node);
+	}
+}
+
+/* Count the prefix in (add) or out of the index */
+static int
+ahash_lpm_update(struct ahash_lpm *lpm, const u8 *addr, u8 cidr, bool add)
+{
+	struct ahash_lpm_node *path[16], *node = &lpm->root;
+	u8 depth = (cidr - 1) / 8, l = cidr - depth * 8;
+	u32 i, v = addr[depth] >> (8 - l);
+	u32 *count;
+
+	for (i = 0; i < depth; i++) {
+		path[i] = node;
+		if (node->child && node->child[addr[i]]) {
+			node = node->child[addr[i]];
+			continue;
+		}
+		if (!add)
+			/* Not indexed: cannot happen */
+			return 0;
+		if (!node->child) {
+			node->child = kzalloc(AHASH_LPM_CHILDREN_SIZE,
+					      GFP_ATOMIC);
+			if (!node->child)
+				goto nomem;
+			lpm->memsize += AHASH_LPM_CHILDREN_SIZE;
+		}
+		node->child[addr[i]] = kzalloc(sizeof(struct ahash_lpm_node),
+					       GFP_ATOMIC);
+		if (!node->child[addr[i]])
+			goto nomem;
+		node->refs++;
+		lpm->memsize += sizeof(struct ahash_lpm_node);
+		node = node->child[addr[i]];
+	}
+	path[depth] = node;
+
+	count = &node->count[AHASH_LPM_COUNT(l, v)];
+	if (add) {
+		if ((*count)++)
+			return 0;
+		node->refs++;
+	} else {
+		if (!*count || --(*count))
+			return 0;
+		node->refs--;
+	}
+	/* First or last element with the prefix: update the covered slots */
+	for (i = v << (8 - l); i < (v + 1) << (8 - l); i++) {
+		if (add)
+			node->lens[i] |= 1 << (l - 1);
+		else
+			node->lens[i] &= ~(1 << (l - 1));
+	}
+	if (!add)
+		ahash_lpm_prune(lpm, path, addr, depth);
+	return 0;
+
+nomem:
+	ahash_lpm_prune(lpm, path, addr, i);
+	return -ENOMEM;
+}
+
+/* Collect the lengths of the prefixes which cover the address
+ * in increasing order and return their number */
+static u8
+ahash_lpm_lookup(const struct ahash_lpm *lpm, const u8 *addr, u8 bytes,
+		 u8 *cidrs)
+{
+	const struct ahash_lpm_node *node = &lpm->root;
+	u8 i, l, lens, n = 0;
+
+	for (i = 0; node && i < bytes; i++) {
+		lens = node->lens[addr[i]];
+		for (l = 1; lens; l++, lens >>= 1)
+			if (lens & 1)
+				cidrs[n++] = i * 8 + l;
+		node = node->child ? node->child[addr[i]] : NULL;
+	}
+	return n;
+}
+#endif /* IP_SET_HASH_WITH_LPM */
+
+#ifdef IP_SET_HASH_WITH_BLOOM
+/* Negative lookup prefilter
+ *
+ * A counting blocked Bloom filter: every element sets AHASH_BLOOM_PROBES
+ * four bits wide counters in a single 64 bytes block, so testing a miss
+ * costs one cache line instead of a bucket. The filter is sized at create
+ * time from maxelem and it does not depend on the hash table, so resizing
+ * leaves it intact. Saturated counters are never decremented.
+ * The counters are updated atomically, because the kernel side adds may
+ * run in parallel with the set read-locked.
+ */
+#define AHASH_BLOOM_PROBES	4
+#define AHASH_BLOOM_COUNTERS	128	/* counters in a block */
+#define AHASH_BLOOM_ELEMS	16	/* elements in a block at maxelem */
+
+struct ahash_bloom_block {
+	u32 word[AHASH_BLOOM_COUNTERS / 8];
+};
+
+struct ahash_bloom {
+	u32 blocks;		/* number of the blocks */
+	u32 initval;		/* random jhash init value of the filter */
+	size_t size;		/* size of the filter */
+	struct ahash_bloom_block block[0] ____cacheline_aligned;
+};
+
+/* Probe i of the hash value */
+#define bloom_probe(hash, i)	\
+	(((hash) >> (7 * (i))) & (AHASH_BLOOM_COUNTERS - 1))
+#define bloom_shift(p)		(((p) % 8) * 4)
+
+static struct ahash_bloom *
+ahash_bloom_alloc(u32 maxelem)
+{
+	struct ahash_bloom *b;
+	u32 blocks = roundup_pow_of_two(max_t(u32, 1,
+			DIV_ROUND_UP(maxelem, AHASH_BLOOM_ELEMS)));
+	size_t size = sizeof(*b) + blocks * sizeof(struct ahash_bloom_block);
+
+	b = ip_set_alloc(size);
+	if (!b)
+		return NULL;
+	b->blocks = blocks;
+	b->size = size;
+	get_random_bytes(&b->initval, sizeof(b->initval));
+
+	return b;
+}
+
+static void
+ahash_bloom_flush(struct ahash_bloom *b)
+{
+	memset(b->block, 0, b->blocks * sizeof(struct ahash_bloom_block));
+}
+
+static inline struct ahash_bloom_block *
+ahash_bloom_block(const struct ahash_bloom *b, u32 hash)
+{
+	/* The probes use the low bits, so select the block by all of them */
+	return (struct ahash_bloom_block *)
+		&b->block[((u64)hash_32(hash, 32) * b->blocks) >> 32];
+}
+
+/* Returns false when the element is definitely not in the set */
+static inline bool
+ahash_bloom_test(const struct ahash_bloom *b, u32 hash)
+{
+	const struct ahash_bloom_block *blk = ahash_bloom_block(b, hash);
+	u32 i, p;
+
+	for (i = 0; i < AHASH_BLOOM_PROBES; i++) {
+		p = bloom_probe(hash, i);
+		if (!((ACCESS_ONCE(blk->word[p / 8]) >> bloom_shift(p)) & 0xf))
+			return false;
+	}
+	return true;
+}
+
+static void
+ahash_bloom_update(struct ahash_bloom *b, u32 hash, bool add)
+{
+	struct ahash_bloom_block *blk = ahash_bloom_block(b, hash);
+	u32 i, p, c, old, new, *w;
+
+	for (i = 0; i < AHASH_BLOOM_PROBES; i++) {
+		p = bloom_probe(hash, i);
+		w = &blk->word[p / 8];
+		do {
+			old = ACCESS_ONCE(*w);
+			c = (old >> bloom_shift(p)) & 0xf;
+			if (c == 0xf || (!add && !c))
+				break;
+			new = add ? old + (1U << bloom_shift(p))
+				  : old - (1U << bloom_shift(p));
+		} while (cmpxchg(w, old, new) != old);
+	}
+}
+#endif /* IP_SET_HASH_WITH_BLOOM */
+
+#ifdef IP_SET_HASH_WITH_CACHE
+/* Recent lookup cache
+ *
+ * A small direct-mapped cache per CPU in front of the probing of the
+ * network prefixes: a tested address is mapped to the matching element
+ * or to a miss. The entries are valid in the generation of the set they
+ * were stored in. Every change of the elements or of the table bumps the
+ * generation, so a cached element is never moved or freed. The timeout
+ * of a cached element is checked at every hit.
+ */
+#define AHASH_CACHE_BITS	8
+
+/* Invalidate the cached lookups. With the set write-locked it can be
+ * called before the change, otherwise the changed table must be
+ * published first and then the generation bumped after smp_wmb() */
+#define ahash_cache_invalidate(h)	atomic_inc(&(h)->gen)
+#else
+#define ahash_cache_invalidate(h)
+#endif
+
+/* Allocate the striped locks of kernel side adds */
+static spinlock_t *
+ahash_stripes_alloc(u32 *mask)
+{
+	spinlock_t *stripes;
+	u32 i, n = min_t(u32, roundup_pow_of_two(num_possible_cpus() * 4),
+			 AHASH_MAX_STRIPES);
+
+	stripes = kcalloc(n, sizeof(spinlock_t), GFP_KERNEL);
+	if (!stripes)
+		return NULL;
+	for (i = 0; i < n; i++)
+		spin_lock_init(&stripes[i]);
+	*mask = n - 1;
+
+	return stripes;
+}
+
 #endif /* _IP_SET_HASH_GEN_H */
 
+/* Kernel side adds run parallel unless prefixes must be book-kept */
+#ifndef IP_SET_HASH_WITH_NETS
+#define IP_SET_HASH_WITH_STRIPES
+#endif
+
 /* Family dependent templates */
 
 #undef ahash_data
@@ -177,13 +872,18 @@ hbucket_elem_add(struct hbucket *n, u8 ahash_max, size_t dsize)
 #undef mtype_data_reset_flags
 #undef mtype_data_netmask
 #undef mtype_data_list
+#undef mtype_data_pack
 #undef mtype_data_next
 #undef mtype_elem
 
+#undef mtype_hbucket
 #undef mtype_ahash_destroy
+#undef mtype_ahash_flush
 #undef mtype_ext_cleanup
 #undef mtype_add_cidr
 #undef mtype_del_cidr
+#undef mtype_lpm_add
+#undef mtype_lpm_del
 #undef mtype_ahash_memsize
 #undef mtype_flush
 #undef mtype_destroy
@@ -191,22 +891,52 @@ hbucket_elem_add(struct hbucket *n, u8 ahash_max, size_t dsize)
 #undef mtype_same_set
 #undef mtype_kadt
 #undef mtype_uadt
+#undef mtype_padt
+#undef mtype_packed
 #undef mtype
 
 #undef mtype_add
+#undef mtype_add_striped
+#undef mtype_stripes_barrier
 #undef mtype_del
-#undef mtype_test_cidrs
+#undef mtype_lookup
+#undef mtype_lookup_cidrs
+#undef mtype_cache_entry
+#undef mtype_cache_lookup
 #undef mtype_test
 #undef mtype_expire
+#undef mtype_expire_buckets
+#undef mtype_expire_hbucket
+#undef mtype_expire_due
+#undef mtype_hbucket_del
+#undef mtype_evict_due
+#undef mtype_expiry_update
+#undef mtype_rehash_step
+#undef mtype_rehash_finish
+#undef mtype_rehash_work
+#undef mtype_stash_add
+#undef mtype_stash_drain
 #undef mtype_resize
+#undef mtype_rehash
+#undef mtype_shrink_bits
+#undef mtype_shrink_needed
+#undef mtype_compact
 #undef mtype_head
 #undef mtype_list
+#undef mtype_uref
 #undef mtype_gc
 #undef mtype_gc_init
 #undef mtype_variant
 #undef mtype_data_match
+#undef mtype_replica
+#undef mtype_replica_primary
+#undef mtype_replicas_publish
+#undef mtype_replicas_sync
+#undef mtype_replicas_build
+#undef mtype_replicas_missing
 
 #undef HKEY
+#undef BKEY
 
 #define mtype_data_equal	IPSET_TOKEN(MTYPE, _data_equal)
 #ifdef IP_SET_HASH_WITH_NETS
@@ -219,12 +949,17 @@ hbucket_elem_add(struct hbucket *n, u8 ahash_max, size_t dsize)
 #define mtype_data_reset_flags	IPSET_TOKEN(MTYPE, _data_reset_flags)
 #define mtype_data_netmask	IPSET_TOKEN(MTYPE, _data_netmask)
 #define mtype_data_list		IPSET_TOKEN(MTYPE, _data_list)
+#define mtype_data_pack		IPSET_TOKEN(MTYPE, _data_pack)
 #define mtype_data_next		IPSET_TOKEN(MTYPE, _data_next)
 #define mtype_elem		IPSET_TOKEN(MTYPE, _elem)
+#define mtype_hbucket		IPSET_TOKEN(MTYPE, _hbucket)
 #define mtype_ahash_destroy	IPSET_TOKEN(MTYPE, _ahash_destroy)
+#define mtype_ahash_flush	IPSET_TOKEN(MTYPE, _ahash_flush)
 #define mtype_ext_cleanup	IPSET_TOKEN(MTYPE, _ext_cleanup)
 #define mtype_add_cidr		IPSET_TOKEN(MTYPE, _add_cidr)
 #define mtype_del_cidr		IPSET_TOKEN(MTYPE, _del_cidr)
+#define mtype_lpm_add		IPSET_TOKEN(MTYPE, _lpm_add)
+#define mtype_lpm_del		IPSET_TOKEN(MTYPE, _lpm_del)
 #define mtype_ahash_memsize	IPSET_TOKEN(MTYPE, _ahash_memsize)
 #define mtype_flush		IPSET_TOKEN(MTYPE, _flush)
 #define mtype_destroy		IPSET_TOKEN(MTYPE, _destroy)
@@ -232,20 +967,49 @@ hbucket_elem_add(struct hbucket *n, u8 ahash_max, size_t dsize)
 #define mtype_same_set		IPSET_TOKEN(MTYPE, _same_set)
 #define mtype_kadt		IPSET_TOKEN(MTYPE, _kadt)
 #define mtype_uadt		IPSET_TOKEN(MTYPE, _uadt)
+#define mtype_padt		IPSET_TOKEN(MTYPE, _padt)
+#define mtype_packed		IPSET_TOKEN(MTYPE, _packed)
 #define mtype			MTYPE
 
 #define mtype_elem		IPSET_TOKEN(MTYPE, _elem)
 #define mtype_add		IPSET_TOKEN(MTYPE, _add)
+#define mtype_add_striped	IPSET_TOKEN(MTYPE, _add_striped)
+#define mtype_stripes_barrier	IPSET_TOKEN(MTYPE, _stripes_barrier)
 #define mtype_del		IPSET_TOKEN(MTYPE, _del)
-#define mtype_test_cidrs	IPSET_TOKEN(MTYPE, _test_cidrs)
+#define mtype_lookup		IPSET_TOKEN(MTYPE, _lookup)
+#define mtype_lookup_cidrs	IPSET_TOKEN(MTYPE, _lookup_cidrs)
+#define mtype_cache_entry	IPSET_TOKEN(MTYPE, _cache_entry)
+#define mtype_cache_lookup	IPSET_TOKEN(MTYPE, _cache_lookup)
 #define mtype_test		IPSET_TOKEN(MTYPE, _test)
 #define mtype_expire		IPSET_TOKEN(MTYPE, _expire)
+#define mtype_expire_buckets	IPSET_TOKEN(MTYPE, _expire_buckets)
+#define mtype_expire_hbucket	IPSET_TOKEN(MTYPE, _expire_hbucket)
+#define mtype_expire_due	IPSET_TOKEN(MTYPE, _expire_due)
+#define mtype_hbucket_del	IPSET_TOKEN(MTYPE, _hbucket_del)
+#define mtype_evict_due		IPSET_TOKEN(MTYPE, _evict_due)
+#define mtype_expiry_update	IPSET_TOKEN(MTYPE, _expiry_update)
+#define mtype_rehash_step	IPSET_TOKEN(MTYPE, _rehash_step)
+#define mtype_rehash_finish	IPSET_TOKEN(MTYPE, _rehash_finish)
+#define mtype_rehash_work	IPSET_TOKEN(MTYPE, _rehash_work)
+#define mtype_stash_add		IPSET_TOKEN(MTYPE, _stash_add)
+#define mtype_stash_drain	IPSET_TOKEN(MTYPE, _stash_drain)
 #define mtype_resize		IPSET_TOKEN(MTYPE, _resize)
+#define mtype_rehash		IPSET_TOKEN(MTYPE, _rehash)
+#define mtype_shrink_bits	IPSET_TOKEN(MTYPE, _shrink_bits)
+#define mtype_shrink_needed	IPSET_TOKEN(MTYPE, _shrink_needed)
+#define mtype_compact		IPSET_TOKEN(MTYPE, _compact)
 #define mtype_head		IPSET_TOKEN(MTYPE, _head)
 #define mtype_list		IPSET_TOKEN(MTYPE, _list)
+#define mtype_uref		IPSET_TOKEN(MTYPE, _uref)
 #define mtype_gc		IPSET_TOKEN(MTYPE, _gc)
 #define mtype_variant		IPSET_TOKEN(MTYPE, _variant)
 #define mtype_data_match	IPSET_TOKEN(MTYPE, _data_match)
+#define mtype_replica		IPSET_TOKEN(MTYPE, _replica)
+#define mtype_replica_primary	IPSET_TOKEN(MTYPE, _replica_primary)
+#define mtype_replicas_publish	IPSET_TOKEN(MTYPE, _replicas_publish)
+#define mtype_replicas_sync	IPSET_TOKEN(MTYPE, _replicas_sync)
+#define mtype_replicas_build	IPSET_TOKEN(MTYPE, _replicas_build)
+#define mtype_replicas_missing	IPSET_TOKEN(MTYPE, _replicas_missing)
 
 #ifndef HKEY_DATALEN
 #define HKEY_DATALEN		sizeof(struct mtype_elem)
@@ -254,6 +1018,15 @@ hbucket_elem_add(struct hbucket *n, u8 ahash_max, size_t dsize)
 #define HKEY(data, initval, htable_bits)			\
 (jhash2((u32 *)(data), HKEY_DATALEN/sizeof(u32), initval)	\
 	& jhash_mask(htable_bits))
+/* Hash value of the element in the Bloom filter */
+#define BKEY(data, bloom)					\
+	jhash2((u32 *)(data), HKEY_DATALEN/sizeof(u32), (bloom)->initval)
+/* Size of an element in the stash and the element at the given position */
+#define STASH_ELEM_SIZE						\
+	ALIGN(sizeof(struct ahash_stash_elem) + sizeof(struct mtype_elem), \
+	      __alignof__(struct ahash_stash_elem))
+#define stash_elem(h, i)					\
+	((struct ahash_stash_elem *)((char *)(h)->stash + (i) * STASH_ELEM_SIZE))
 
 #ifndef htype
 #define htype			HTYPE
@@ -261,10 +1034,29 @@ hbucket_elem_add(struct hbucket *n, u8 ahash_max, size_t dsize)
 /* The generic hash structure */
 struct htype {
 	struct htable __rcu *table; /* the hash table */
+	struct htable __rcu *rehash; /* the table under incremental resizing */
+	struct htable __rcu **replicas; /* read replicas per node, if enabled */
+	unsigned long replicas_retry; /* no rebuild of the replicas before */
+	u32 rehash_pos;		/* next bucket to migrate from rehash */
 	u32 maxelem;		/* max elements in the hash */
-	u32 elements;		/* current element (vs timeout) */
+	atomic_t elements;	/* current element (vs timeout) */
 	u32 initval;		/* random jhash init value */
 	struct timer_list gc;	/* garbage collection when timeout enabled */
+	struct ip_set_expiry *expiry; /* buckets by the earliest timeout */
+	u64 evicted;		/* number of the evicted elements */
+	struct work_struct rehash_work; /* incremental resizing, shrinking */
+	struct mutex resize_lock; /* serializes the resizes */
+	struct ip_set *set;	/* back pointer for the worker */
+	u8 htable_bits_min;	/* the table is not shrunk below its initial size */
+	void *stash;		/* kernel side adds waiting for a larger table */
+	u32 stash_len;		/* number of the adds in the stash */
+	u64 add_failed;		/* kernel side adds lost at full buckets */
+	struct ahash_alloc alloc; /* allocator of the bucket arrays */
+#ifdef IP_SET_HASH_WITH_STRIPES
+	spinlock_t *stripes;	/* striped locks of kernel side adds */
+	u32 stripes_mask;	/* number of striped locks - 1 */
+	bool resizing;		/* kernel side adds must write-lock the set */
+#endif
 	struct mtype_elem next; /* temporary storage for uadd */
 #ifdef IP_SET_HASH_WITH_MULTI
 	u8 ahash_max;		/* max elements in an array block */
@@ -275,6 +1067,19 @@ struct htype {
 #ifdef IP_SET_HASH_WITH_RBTREE
 	struct rb_root rbtree;
 #endif
+#ifdef IP_SET_HASH_WITH_LPM
+	struct ahash_lpm *lpm;	/* longest prefix match index, if enabled */
+#endif
+#if IPSET_NET_COUNT > 1
+	struct net_pairs pairs;	/* probe order of the prefix pairs */
+#endif
+#ifdef IP_SET_HASH_WITH_BLOOM
+	struct ahash_bloom *bloom; /* negative lookup filter, if enabled */
+#endif
+#ifdef IP_SET_HASH_WITH_CACHE
+	void __percpu *cache;	/* recent lookups, if enabled */
+	atomic_t gen;		/* generation of the cached lookups */
+#endif
 #ifdef IP_SET_HASH_WITH_NETS
 	struct net_prefixes nets[0]; /* book-keeping of prefixes */
 #endif
@@ -333,28 +1138,99 @@ mtype_del_cidr(struct htype *h, u8 cidr, u8 nets_length, u8 n)
 }
 #endif
 
+#ifdef IP_SET_HASH_WITH_LPM
+/* Index the prefix of the element, when the index is enabled */
+static inline int
+mtype_lpm_add(struct htype *h, const struct mtype_elem *d)
+{
+	return h->lpm ? ahash_lpm_update(h->lpm, (const u8 *)&d->ip,
+					 CIDR(d->cidr, 0), true) : 0;
+}
+
+static inline void
+mtype_lpm_del(struct htype *h, const struct mtype_elem *d)
+{
+	if (h->lpm)
+		ahash_lpm_update(h->lpm, (const u8 *)&d->ip,
+				 CIDR(d->cidr, 0), false);
+}
+#endif
+
 /* Calculate the actual memory size of the set data */
 static size_t
 mtype_ahash_memsize(const struct htype *h, const struct htable *t,
 		    u8 nets_length, size_t dsize)
 {
+	const struct htable *r;
 	u32 i;
+	int node;
 	size_t memsize = sizeof(*h)
-			 + sizeof(*t)
 #ifdef IP_SET_HASH_WITH_NETS
 			 + sizeof(struct net_prefixes) * nets_length
 #endif
-			 + jhash_size(t->htable_bits) * sizeof(struct hbucket);
+			 + htable_size(t->htable_bits, t->bucket_shift);
+
+#ifdef IP_SET_HASH_WITH_LPM
+	if (h->lpm)
+		memsize += sizeof(*h->lpm) + h->lpm->memsize;
+#endif
+#if IPSET_NET_COUNT > 1
+	memsize += h->pairs.size * sizeof(struct net_pair);
+#endif
+#ifdef IP_SET_HASH_WITH_BLOOM
+	if (h->bloom)
+		memsize += h->bloom->size;
+#endif
+	if (h->expiry)
+		memsize += h->expiry->memsize;
+	if (h->stash)
+		memsize += AHASH_STASH_SIZE * STASH_ELEM_SIZE;
+	for_each_node(node) {
+		r = h->replicas ? rcu_dereference_bh_nfnl(h->replicas[node])
+				: NULL;
+		if (!r)
+			continue;
+		memsize += htable_size(r->htable_bits, r->bucket_shift);
+		for (i = 0; i < jhash_size(r->htable_bits); i++)
+			memsize += hbucket_overflow(hbucket(r, i)) * dsize;
+	}
 
 	for (i = 0; i < jhash_size(t->htable_bits); i++)
-		memsize += t->bucket[i].size * dsize;
+		memsize += hbucket_overflow(hbucket(t, i)) * dsize;
+
+	t = rcu_dereference_bh_nfnl(h->rehash);
+	if (!t)
+		return memsize;
+	memsize += htable_size(t->htable_bits, t->bucket_shift);
+	for (i = h->rehash_pos; i < jhash_size(t->htable_bits); i++)
+		memsize += hbucket_overflow(hbucket(t, i)) * dsize;
 
 	return memsize;
 }
 
-/* Get the ith element from the array block n */
-#define ahash_data(n, i, dsize)	\
-	((struct mtype_elem *)((n)->value + ((i) * (dsize))))
+/* Get the ith element from the bucket n: inline slots come first */
+#define ahash_data(n, i, dsize)					\
+	((struct mtype_elem *)((i) < (n)->inline_size ?		\
+		(void *)(n)->inline_data + (i) * (dsize) :		\
+		(n)->value + ((i) - (n)->inline_size) * (dsize)))
+
+/* Get the bucket of the element in the table (k == 0) or in the not yet
+ * migrated part of the table under incremental resizing (k == 1) */
+static inline struct hbucket *
+mtype_hbucket(const struct htype *h, const struct htable *t,
+	      const struct mtype_elem *d, u8 k)
+{
+	const struct htable *r;
+	u32 key;
+
+	if (!k)
+		return hbucket(t, HKEY(d, h->initval, t->htable_bits));
+	r = k == 1 ? rcu_dereference_bh(h->rehash) : NULL;
+	if (!r)
+		return NULL;
+	key = HKEY(d, h->initval, r->htable_bits);
+	return key >= h->rehash_pos ? hbucket(r, key) : NULL;
+}
 
 static void
 mtype_ext_cleanup(struct ip_set *set, struct hbucket *n)
@@ -365,47 +1241,81 @@ mtype_ext_cleanup(struct ip_set *set, struct hbucket *n)
 		ip_set_ext_destroy(set, ahash_data(n, i, set->dsize));
 }
 
-/* Flush a hash type of set: destroy all elements */
+/* Destroy the elements of the buckets of a table, starting from first */
 static void
-mtype_flush(struct ip_set *set)
+mtype_ahash_flush(struct ip_set *set, struct htable *t, u32 first)
 {
 	struct htype *h = set->data;
-	struct htable *t;
 	struct hbucket *n;
 	u32 i;
 
-	t = rcu_dereference_bh_nfnl(h->table);
-	for (i = 0; i < jhash_size(t->htable_bits); i++) {
+	for (i = first; i < jhash_size(t->htable_bits); i++) {
 		n = hbucket(t, i);
-		if (n->size) {
-			if (set->extensions & IPSET_EXT_DESTROY)
-				mtype_ext_cleanup(set, n);
-			n->size = n->pos = 0;
-			/* FIXME: use slab cache */
-			kfree(n->value);
-		}
+		if (n->pos && set->extensions & IPSET_EXT_DESTROY)
+			mtype_ext_cleanup(set, n);
+		if (hbucket_overflow(n))
+			ahash_array_free(&h->alloc, n);
+		n->size = n->inline_size;
+		n->pos = 0;
+		n->expiry = IPSET_EXPIRY_NONE;
 	}
-#ifdef IP_SET_HASH_WITH_NETS
-	memset(h->nets, 0, sizeof(struct net_prefixes) * NLEN(set->family));
-#endif
-	h->elements = 0;
+}
+
+/* Flush a hash type of set: destroy all elements */
+static void
+mtype_flush(struct ip_set *set)
+{
+	struct htype *h = set->data;
+	struct htable *t;
+	int node;
+
+	mtype_ahash_flush(set, rcu_dereference_bh_nfnl(h->table), 0);
+	/* The worker finishes the migration of the emptied buckets */
+	t = rcu_dereference_bh_nfnl(h->rehash);
+	if (t)
+		mtype_ahash_flush(set, t, h->rehash_pos);
+	for_each_node(node) {
+		t = h->replicas ? rcu_dereference_bh_nfnl(h->replicas[node])
+				: NULL;
+		if (t)
+			htable_replica_flush(t);
+	}
+#ifdef IP_SET_HASH_WITH_NETS
+	memset(h->nets, 0, sizeof(struct net_prefixes) * NLEN(set->family));
+#endif
+#ifdef IP_SET_HASH_WITH_LPM
+	if (h->lpm)
+		ahash_lpm_flush(h->lpm);
+#endif
+#if IPSET_NET_COUNT > 1
+	h->pairs.len = 0;
+#endif
+#ifdef IP_SET_HASH_WITH_BLOOM
+	if (h->bloom)
+		ahash_bloom_flush(h->bloom);
+#endif
+	if (h->expiry)
+		ip_set_expiry_flush(h->expiry);
+	h->stash_len = 0;
+	atomic_set(&h->elements, 0);
+	ahash_cache_invalidate(h);
 }
 
 /* Destroy the hashtable part of the set */
 static void
 mtype_ahash_destroy(struct ip_set *set, struct htable *t, bool ext_destroy)
 {
+	struct htype *h = set->data;
 	struct hbucket *n;
 	u32 i;
 
 	for (i = 0; i < jhash_size(t->htable_bits); i++) {
 		n = hbucket(t, i);
-		if (n->size) {
-			if (set->extensions & IPSET_EXT_DESTROY && ext_destroy)
-				mtype_ext_cleanup(set, n);
-			/* FIXME: use slab cache */
-			kfree(n->value);
-		}
+		if (n->pos && set->extensions & IPSET_EXT_DESTROY &&
+		    ext_destroy)
+			mtype_ext_cleanup(set, n);
+		if (hbucket_overflow(n))
+			ahash_array_free(&h->alloc, n);
 	}
 
 	ip_set_free(t);
@@ -416,14 +1326,53 @@ static void
 mtype_destroy(struct ip_set *set)
 {
 	struct htype *h = set->data;
+	struct htable *t;
+	int node;
 
 	if (set->extensions & IPSET_EXT_TIMEOUT)
 		del_timer_sync(&h->gc);
+	cancel_work_sync(&h->rehash_work);
+#ifdef IP_SET_HASH_WITH_STRIPES
+	kfree(h->stripes);
+#endif
 
 	mtype_ahash_destroy(set, rcu_dereference_bh_nfnl(h->table), true);
+	t = rcu_dereference_bh_nfnl(h->rehash);
+	if (t) {
+		/* The migrated buckets are empty */
+		mtype_ahash_destroy(set, t, true);
+	}
+	if (h->replicas) {
+		for_each_node(node) {
+			t = rcu_dereference_bh_nfnl(h->replicas[node]);
+			if (t)
+				htable_replica_free(t);
+		}
+		kfree(h->replicas);
+	}
 #ifdef IP_SET_HASH_WITH_RBTREE
 	rbtree_destroy(&h->rbtree);
 #endif
+#ifdef IP_SET_HASH_WITH_LPM
+	if (h->lpm) {
+		ahash_lpm_free(&h->lpm->root);
+		kfree(h->lpm);
+	}
+#endif
+#if IPSET_NET_COUNT > 1
+	kfree(h->pairs.pair);
+#endif
+#ifdef IP_SET_HASH_WITH_BLOOM
+	if (h->bloom)
+		ip_set_free(h->bloom);
+#endif
+#ifdef IP_SET_HASH_WITH_CACHE
+	free_percpu(h->cache);
+#endif
+	if (h->expiry)
+		ip_set_expiry_free(h->expiry);
+	ahash_alloc_destroy(&h->alloc);
+	kfree(h->stash);
 	kfree(h);
 
 	set->data = NULL;
@@ -455,58 +1404,183 @@ mtype_same_set(const struct ip_set *a, const struct ip_set *b)
 #ifdef IP_SET_HASH_WITH_NETMASK
 	       x->netmask == y->netmask &&
 #endif
-	       a->extensions == b->extensions;
+	       a->extensions == b->extensions &&
+	       a->cadt_flags == b->cadt_flags;
+}
+
+/* The size of the table, where every element has two buckets */
+static u8
+mtype_shrink_bits(const struct htype *h)
+{
+	u32 elements = atomic_read(&h->elements);
+	u8 bits = elements ? htable_bits(elements * 2) : 0;
+
+	return max(bits, h->htable_bits_min);
+}
+
+/* Check whether the table is loaded so lightly that it is worth to shrink */
+static inline bool
+mtype_shrink_needed(const struct htype *h, const struct htable *t)
+{
+	return t->htable_bits > h->htable_bits_min &&
+	       atomic_read(&h->elements) <
+			jhash_size(t->htable_bits) / AHASH_SHRINK_LOAD;
 }
 
-/* Delete expired elements from the hashtable */
+/* Delete the element at the given position of a bucket: the last element
+ * of the bucket is moved into its place */
 static void
-mtype_expire(struct ip_set *set, struct htype *h, u8 nets_length, size_t dsize)
+mtype_hbucket_del(struct ip_set *set, struct htype *h, struct hbucket *n,
+		  int j, u8 nets_length, size_t dsize)
 {
-	struct htable *t;
-	struct hbucket *n;
-	struct mtype_elem *data;
-	u32 i;
-	int j;
+	struct mtype_elem *data = ahash_data(n, j, dsize);
 #ifdef IP_SET_HASH_WITH_NETS
 	u8 k;
+
+	for (k = 0; k < IPSET_NET_COUNT; k++)
+		mtype_del_cidr(h, CIDR(data->cidr, k), nets_length, k);
+#endif
+#ifdef IP_SET_HASH_WITH_LPM
+	mtype_lpm_del(h, data);
+#endif
+#if IPSET_NET_COUNT > 1
+	net_pairs_del(&h->pairs, CIDR(data->cidr, 0), CIDR(data->cidr, 1));
+#endif
+#ifdef IP_SET_HASH_WITH_BLOOM
+	if (h->bloom)
+		ahash_bloom_update(h->bloom, BKEY(data, h->bloom), false);
 #endif
+	ip_set_ext_destroy(set, data);
+	if (j != n->pos - 1)
+		/* Not last one */
+		memcpy(data, ahash_data(n, n->pos - 1, dsize), dsize);
+	n->pos--;
+	atomic_dec(&h->elements);
+	ahash_cache_invalidate(h);
+}
 
-	rcu_read_lock_bh();
-	t = rcu_dereference_bh(h->table);
-	for (i = 0; i < jhash_size(t->htable_bits); i++) {
-		n = hbucket(t, i);
-		for (j = 0; j < n->pos; j++) {
-			data = ahash_data(n, j, dsize);
-			if (ip_set_timeout_expired(ext_timeout(data, set))) {
-				pr_debug("expired %u/%u\n", i, j);
-#ifdef IP_SET_HASH_WITH_NETS
-				for (k = 0; k < IPSET_NET_COUNT; k++)
-					mtype_del_cidr(h, CIDR(data->cidr, k),
-						       nets_length, k);
-#endif
-				ip_set_ext_destroy(set, data);
-				if (j != n->pos - 1)
-					/* Not last one */
-					memcpy(data,
-					       ahash_data(n, n->pos - 1, dsize),
-					       dsize);
-				n->pos--;
-				h->elements--;
-			}
+/* Delete the expired elements of a bucket */
+static void
+mtype_expire_hbucket(struct ip_set *set, struct htype *h, struct hbucket *n,
+		     u8 nets_length, size_t dsize)
+{
+	int j;
+
+	for (j = 0; j < n->pos; j++) {
+		if (ip_set_timeout_expired(ext_timeout(ahash_data(n, j, dsize),
+						       set), set)) {
+			pr_debug("expired %p/%u\n", n, j);
+			mtype_hbucket_del(set, h, n, j, nets_length, dsize);
+			ip_set_stats_inc(set, expired);
 		}
-		if (n->pos + AHASH_INIT_SIZE < n->size) {
-			void *tmp = kzalloc((n->size - AHASH_INIT_SIZE)
-					    * dsize,
-					    GFP_ATOMIC);
-			if (!tmp)
-				/* Still try to delete expired elements */
-				continue;
-			n->size -= AHASH_INIT_SIZE;
-			memcpy(tmp, n->value, n->size * dsize);
-			kfree(n->value);
-			n->value = tmp;
+	}
+	hbucket_elem_shrink(&h->alloc, n, dsize);
+}
+
+/* Schedule the bucket with the given key of the table in the expiry index
+ * by the earliest timeout of its elements. The set must be write-locked. */
+static void
+mtype_expiry_update(struct ip_set *set, struct htype *h, struct hbucket *n,
+		    u32 key)
+{
+	u32 timeout = IPSET_ELEM_PERMANENT, *t;
+	int j;
+
+	n->expiry = IPSET_EXPIRY_NONE;
+	for (j = 0; j < n->pos; j++) {
+		t = ext_timeout(ahash_data(n, j, set->dsize), set);
+		if (*t != IPSET_ELEM_PERMANENT &&
+		    (timeout == IPSET_ELEM_PERMANENT || *t < timeout))
+			timeout = *t;
+	}
+	ip_set_expiry_schedule(h->expiry, &n->expiry, key,
+			       ip_set_timeout_jiffies(timeout, set));
+}
+
+/* Delete expired elements from the buckets of a table, starting from first.
+ * The buckets of the table are scheduled again in the expiry index when
+ * it is rebuilt. */
+static void
+mtype_expire_buckets(struct ip_set *set, struct htype *h, struct htable *t,
+		     u32 first, bool rebuild, u8 nets_length, size_t dsize)
+{
+	struct hbucket *n;
+	u32 i;
+
+	for (i = first; i < jhash_size(t->htable_bits); i++) {
+		n = hbucket(t, i);
+		mtype_expire_hbucket(set, h, n, nets_length, dsize);
+		if (rebuild)
+			mtype_expiry_update(set, h, n, i);
+	}
+}
+
+/* Delete expired elements from a bucket which is due in the expiry index */
+static void
+mtype_expire_due(struct ip_set *set, u32 key, u32 tick)
+{
+	struct htype *h = set->data;
+	struct hbucket *n = hbucket(rcu_dereference_bh(h->table), key);
+
+	if (n->expiry != tick)
+		/* Stale entry: the bucket is scheduled at another tick */
+		return;
+	mtype_expire_hbucket(set, h, n, NLEN(set->family), set->dsize);
+	mtype_expiry_update(set, h, n, key);
+}
+
+/* Evict the element with the earliest timeout from a bucket which is
+ * scheduled the earliest in the expiry index. Returns false if the entry
+ * is stale or the bucket stores permanent elements only. */
+static bool
+mtype_evict_due(struct ip_set *set, u32 key, u32 tick)
+{
+	struct htype *h = set->data;
+	struct hbucket *n = hbucket(rcu_dereference_bh(h->table), key);
+	u32 *t, *timeout = NULL;
+	int j, k = -1;
+
+	if (n->expiry != tick)
+		return false;
+	for (j = 0; j < n->pos; j++) {
+		t = ext_timeout(ahash_data(n, j, set->dsize), set);
+		if (*t != IPSET_ELEM_PERMANENT &&
+		    (!timeout || *t < *timeout)) {
+			timeout = t;
+			k = j;
 		}
 	}
+	if (k < 0) {
+		n->expiry = IPSET_EXPIRY_NONE;
+		return false;
+	}
+	pr_debug("evicted %p/%u\n", n, k);
+	mtype_hbucket_del(set, h, n, k, NLEN(set->family), set->dsize);
+	hbucket_elem_shrink(&h->alloc, n, set->dsize);
+	mtype_expiry_update(set, h, n, key);
+	h->evicted++;
+
+	return true;
+}
+
+/* Delete expired elements from the hashtable: the buckets of the table are
+ * looked up in the expiry index, the not yet migrated ones are scanned. */
+static void
+mtype_expire(struct ip_set *set, struct htype *h, u8 nets_length, size_t dsize)
+{
+	struct htable *t;
+
+	rcu_read_lock_bh();
+	t = rcu_dereference_bh(h->table);
+	if (h->expiry->rescan) {
+		ip_set_expiry_flush(h->expiry);
+		mtype_expire_buckets(set, h, t, 0, true, nets_length, dsize);
+	} else
+		ip_set_expiry_run(h->expiry, set, mtype_expire_due);
+	t = rcu_dereference_bh(h->rehash);
+	if (t)
+		mtype_expire_buckets(set, h, t, h->rehash_pos, false,
+				     nets_length, dsize);
 	rcu_read_unlock_bh();
 }
 
@@ -515,99 +1589,560 @@ mtype_gc(unsigned long ul_set)
 {
 	struct ip_set *set = (struct ip_set *) ul_set;
 	struct htype *h = set->data;
+	ktime_t start = ip_set_stats_start(set);
 
 	pr_debug("called\n");
 	write_lock_bh(&set->lock);
 	mtype_expire(set, h, NLEN(set->family), set->dsize);
+	if (mtype_shrink_needed(h, rcu_dereference_bh_nfnl(h->table)))
+		schedule_work(&h->rehash_work);
 	write_unlock_bh(&set->lock);
+	ip_set_stats_inc(set, gc_runs);
+	ip_set_stats_time(set, gc_time, start);
 
 	h->gc.expires = jiffies + IPSET_GC_PERIOD(set->timeout) * HZ;
 	add_timer(&h->gc);
 }
 
-/* Resize a hash: create a new hash table with doubling the hashsize
- * and inserting the elements to it. Repeat until we succeed or
- * fail due to memory pressures. */
+/* Migrate the elements of the next count buckets of the table under
+ * incremental resizing into the new table. The set must be write-locked.
+ * Returns 1 when there are buckets left, 0 when the migration is finished
+ * and a negative error code when the new table cannot store an element:
+ * then the migration is completed by the next resize.
+ */
 static int
-mtype_resize(struct ip_set *set, bool retried)
+mtype_rehash_step(struct ip_set *set, struct htype *h, u32 count)
 {
-	struct htype *h = set->data;
-	struct htable *t, *orig = rcu_dereference_bh_nfnl(h->table);
-	u8 htable_bits = orig->htable_bits;
+	struct htable *t = rcu_dereference_bh_nfnl(h->table);
+	struct htable *orig = rcu_dereference_bh_nfnl(h->rehash);
 #ifdef IP_SET_HASH_WITH_NETS
 	u8 flags;
 #endif
 	struct mtype_elem *data;
 	struct mtype_elem *d;
 	struct hbucket *n, *m;
-	u32 i, j;
+	u32 key;
 	int ret;
 
-	/* Try to cleanup once */
-	if (SET_WITH_TIMEOUT(set) && !retried) {
-		i = h->elements;
+	ahash_cache_invalidate(h);
+	for (; count && h->rehash_pos < jhash_size(orig->htable_bits);
+	     count--) {
+		n = hbucket(orig, h->rehash_pos);
+		/* Move the elements one by one, so that every element
+		 * is stored in exactly one of the tables */
+		while (n->pos) {
+			data = ahash_data(n, n->pos - 1, set->dsize);
+#ifdef IP_SET_HASH_WITH_NETS
+			flags = 0;
+			mtype_data_reset_flags(data, &flags);
+#endif
+			key = HKEY(data, h->initval, t->htable_bits);
+			m = hbucket(t, key);
+			ret = hbucket_elem_add(&h->alloc, m, AHASH_MAX(h),
+					       set->dsize);
+			if (ret < 0) {
+#ifdef IP_SET_HASH_WITH_NETS
+				mtype_data_reset_flags(data, &flags);
+#endif
+				return ret;
+			}
+			d = ahash_data(m, m->pos++, set->dsize);
+			memcpy(d, data, set->dsize);
+#ifdef IP_SET_HASH_WITH_NETS
+			mtype_data_reset_flags(d, &flags);
+#endif
+			if (h->expiry)
+				ip_set_expiry_schedule(h->expiry, &m->expiry, key,
+					ip_set_timeout_jiffies(*ext_timeout(d, set),
+							       set));
+			n->pos--;
+		}
+		if (hbucket_overflow(n)) {
+			ahash_array_free(&h->alloc, n);
+			n->size = n->inline_size;
+		}
+		h->rehash_pos++;
+	}
+	return h->rehash_pos < jhash_size(orig->htable_bits);
+}
+
+/* Finish the pending incremental resizing, if there is any.
+ * Must be called from process context.
+ */
+static int
+mtype_rehash_finish(struct ip_set *set, struct htype *h)
+{
+	struct htable *orig;
+	int ret;
+
+	do {
 		write_lock_bh(&set->lock);
-		mtype_expire(set, set->data, NLEN(set->family), set->dsize);
+		orig = rcu_dereference_bh_nfnl(h->rehash);
+		ret = orig ? mtype_rehash_step(set, h, AHASH_REHASH_STEP) : 0;
+		if (orig && ret == 0)
+			rcu_assign_pointer(h->rehash, NULL);
 		write_unlock_bh(&set->lock);
-		if (h->elements < i)
-			return 0;
+		cond_resched();
+	} while (ret > 0);
+
+	if (orig && ret == 0) {
+		/* Give time to other readers of the set */
+		synchronize_rcu_bh();
+		pr_debug("set %s migrated from %u (%p)\n", set->name,
+			 orig->htable_bits, orig);
+		mtype_ahash_destroy(set, orig, false);
 	}
+	return ret;
+}
 
-retry:
-	ret = 0;
-	htable_bits++;
-	pr_debug("attempt to resize set %s from %u to %u, t %p\n",
-		 set->name, orig->htable_bits, htable_bits, orig);
-	if (!htable_bits) {
-		/* In case we have plenty of memory :-) */
-		pr_warning("Cannot increase the hashsize of set %s further\n",
-			   set->name);
-		return -IPSET_ERR_HASH_FULL;
+/* Stop (or let go) the kernel side adds running with the set read-locked.
+ * Taking every striped lock once guarantees that the adds which did not
+ * see h->resizing yet are finished. */
+static void
+mtype_stripes_barrier(struct htype *h, bool resizing)
+{
+#ifdef IP_SET_HASH_WITH_STRIPES
+	u32 i;
+
+	h->resizing = resizing;
+	for (i = 0; resizing && i <= h->stripes_mask; i++) {
+		spin_lock(&h->stripes[i]);
+		spin_unlock(&h->stripes[i]);
+	}
+#endif
+}
+
+/* Fill up the replicas allocated by htable_replicas_alloc from the table
+ * and publish them: the replaced replicas are returned in rt and must be
+ * freed after a grace period. A replica which cannot be filled up is left
+ * out, the lookups on its node use the primary table.
+ * Must be called with the set locked against the writers. */
+static void
+mtype_replicas_publish(struct ip_set *set, const struct htable *t,
+		       struct htable **rt)
+{
+	struct htype *h = set->data;
+	struct htable *r;
+	u32 i;
+	int node;
+
+	for_each_node(node) {
+		r = rt[node];
+		for (i = 0; r && i < jhash_size(t->htable_bits); i++) {
+			if (hbucket_replica_copy(hbucket(r, i), hbucket(t, i),
+						 set->dsize, node)) {
+				htable_replica_free(r);
+				r = NULL;
+			}
+		}
+		rt[node] = rcu_dereference_bh_nfnl(h->replicas[node]);
+		rcu_assign_pointer(h->replicas[node], r);
 	}
-	t = ip_set_alloc(sizeof(*t)
-			 + jhash_size(htable_bits) * sizeof(struct hbucket));
+	/* Pairs with smp_rmb() in mtype_cache_lookup: the lookups cached
+	 * with the new generation do not point into the replaced replicas */
+	smp_wmb();
+	ahash_cache_invalidate(h);
+}
+
+/* Are there online nodes without replica? */
+static bool
+mtype_replicas_missing(const struct htype *h)
+{
+	int node;
+
+	for_each_online_node(node)
+		if (!rcu_access_pointer(h->replicas[node]))
+			return true;
+	return false;
+}
+
+/* Write the bucket of the changed element through to the replicas.
+ * A replica which cannot be updated is dropped and the worker builds
+ * the missing ones again, but not more often than AHASH_REPLICAS_RETRY
+ * when they cannot be built. Must be called with the set write-locked. */
+static void
+mtype_replicas_sync(struct ip_set *set, struct htype *h,
+		    const struct htable *t, const struct mtype_elem *d)
+{
+	struct htable *r;
+	bool dropped = false;
+	u32 key;
+	int node;
+
+	if (!h->replicas)
+		return;
+	key = HKEY(d, h->initval, t->htable_bits);
+	for_each_node(node) {
+		r = rcu_dereference_bh_nfnl(h->replicas[node]);
+		if (!r)
+			continue;
+		if (r->htable_bits == t->htable_bits &&
+		    !hbucket_replica_copy(hbucket(r, key), hbucket(t, key),
+					  set->dsize, node))
+			continue;
+		/* The lookups are locked out by the set lock */
+		RCU_INIT_POINTER(h->replicas[node], NULL);
+		htable_replica_free(r);
+		dropped = true;
+	}
+	if (dropped)
+		h->replicas_retry = jiffies;
+	if (!time_before(jiffies, h->replicas_retry) &&
+	    mtype_replicas_missing(h))
+		schedule_work(&h->rehash_work);
+}
+
+/* Build the replicas again from the table.
+ * Must be called with h->resize_lock held. */
+static void
+mtype_replicas_build(struct ip_set *set)
+{
+	struct htype *h = set->data;
+	struct htable *t, **rt;
+
+	/* The table is not replaced while we hold h->resize_lock */
+	t = rcu_dereference_bh_nfnl(h->table);
+	rt = htable_replicas_alloc(t->htable_bits, set->dsize);
+	if (!rt) {
+		h->replicas_retry = jiffies + AHASH_REPLICAS_RETRY;
+		return;
+	}
+	read_lock_bh(&set->lock);
+	mtype_replicas_publish(set, t, rt);
+	read_unlock_bh(&set->lock);
+	if (mtype_replicas_missing(h))
+		h->replicas_retry = jiffies + AHASH_REPLICAS_RETRY;
+
+	/* Give time to other readers of the set */
+	synchronize_rcu_bh();
+	htable_replicas_free(rt);
+}
+
+/* Rehash the elements of the set into a new table with the given size.
+ * Large tables are migrated incrementally, see mtype_rehash_step, unless
+ * the pending migration is stuck: then both tables are copied at once.
+ * The tables of sets with replicas are always copied at once.
+ * Returns -EAGAIN when the new table cannot store all elements.
+ * Must be called with h->resize_lock held. */
+static int
+mtype_rehash(struct ip_set *set, struct htable *orig, u8 htable_bits,
+	     int stuck)
+{
+	struct htype *h = set->data;
+	struct htable *t, *prev, **rt = NULL;
+#ifdef IP_SET_HASH_WITH_NETS
+	u8 flags;
+#endif
+	struct mtype_elem *data;
+	struct mtype_elem *d;
+	struct hbucket *n, *m;
+	u32 i, j, key;
+	bool pinned;
+	int ret;
+
+	t = htable_alloc(htable_bits, set->dsize);
 	if (!t)
 		return -ENOMEM;
-	t->htable_bits = htable_bits;
+	if (h->replicas) {
+		rt = htable_replicas_alloc(htable_bits, set->dsize);
+		if (!rt) {
+			ip_set_free(t);
+			return -ENOMEM;
+		}
+	}
+
+	/* No new listing can pin orig while we hold h->resize_lock */
+	atomic_inc(&orig->uref);
+	pinned = atomic_read(&orig->uref) > 1;
+
+	if (!stuck && !pinned && !h->replicas &&
+	    jhash_size(orig->htable_bits) >= AHASH_REHASH_INCREMENTAL) {
+		atomic_dec(&orig->uref);
+		write_lock_bh(&set->lock);
+		rcu_assign_pointer(h->rehash, orig);
+		h->rehash_pos = 0;
+		rcu_assign_pointer(h->table, t);
+		/* The elements are scheduled again when migrated */
+		if (h->expiry)
+			ip_set_expiry_flush(h->expiry);
+		write_unlock_bh(&set->lock);
+
+		pr_debug("set %s migrates from %u (%p) to %u (%p)\n", set->name,
+			 orig->htable_bits, orig, t->htable_bits, t);
+		schedule_work(&h->rehash_work);
+		return 0;
+	}
 
 	read_lock_bh(&set->lock);
-	for (i = 0; i < jhash_size(orig->htable_bits); i++) {
-		n = hbucket(orig, i);
+	mtype_stripes_barrier(h, true);
+	/* The expiry index is rebuilt for the new table: the gc
+	 * and the adds are locked out */
+	if (h->expiry)
+		ip_set_expiry_flush(h->expiry);
+	/* The worker may still proceed when elements were deleted */
+	prev = rcu_dereference_bh_nfnl(h->rehash);
+	for (i = 0; i < jhash_size(orig->htable_bits) +
+			(prev ? jhash_size(prev->htable_bits) : 0); i++) {
+		if (i < jhash_size(orig->htable_bits))
+			n = hbucket(orig, i);
+		else if (i - jhash_size(orig->htable_bits) >= h->rehash_pos)
+			n = hbucket(prev, i - jhash_size(orig->htable_bits));
+		else
+			/* Already migrated */
+			continue;
 		for (j = 0; j < n->pos; j++) {
 			data = ahash_data(n, j, set->dsize);
 #ifdef IP_SET_HASH_WITH_NETS
 			flags = 0;
 			mtype_data_reset_flags(data, &flags);
 #endif
-			m = hbucket(t, HKEY(data, h->initval, htable_bits));
-			ret = hbucket_elem_add(m, AHASH_MAX(h), set->dsize);
-			if (ret < 0) {
+			key = HKEY(data, h->initval, htable_bits);
 #ifdef IP_SET_HASH_WITH_NETS
-				mtype_data_reset_flags(data, &flags);
+			/* orig may be kept for the listings */
+			mtype_data_reset_flags(data, &flags);
 #endif
+			m = hbucket(t, key);
+			ret = hbucket_elem_add(&h->alloc, m, AHASH_MAX(h),
+					       set->dsize);
+			if (ret < 0) {
+				/* The gc rebuilds the index of orig */
+				if (h->expiry)
+					h->expiry->rescan = true;
+				mtype_stripes_barrier(h, false);
 				read_unlock_bh(&set->lock);
-				mtype_ahash_destroy(set, t, false);
-				if (ret == -EAGAIN)
-					goto retry;
+				atomic_dec(&orig->uref);
+				mtype_ahash_destroy(set, t, pinned);
+				if (rt)
+					htable_replicas_free(rt);
 				return ret;
 			}
 			d = ahash_data(m, m->pos++, set->dsize);
 			memcpy(d, data, set->dsize);
-#ifdef IP_SET_HASH_WITH_NETS
-			mtype_data_reset_flags(d, &flags);
-#endif
+			/* orig is kept intact for the listings */
+			if (pinned)
+				ip_set_ext_dup(set, d);
+			if (h->expiry)
+				ip_set_expiry_schedule(h->expiry, &m->expiry, key,
+					ip_set_timeout_jiffies(*ext_timeout(d, set),
+							       set));
 		}
 	}
 
 	rcu_assign_pointer(h->table, t);
+	rcu_assign_pointer(h->rehash, NULL);
+	if (rt)
+		mtype_replicas_publish(set, t, rt);
+	/* The tests run in parallel: pairs with smp_rmb() in
+	 * mtype_cache_lookup, the lookups cached with the new generation
+	 * do not point into orig */
+	smp_wmb();
+	ahash_cache_invalidate(h);
+	mtype_stripes_barrier(h, false);
 	read_unlock_bh(&set->lock);
 
 	/* Give time to other readers of the set */
 	synchronize_rcu_bh();
+	if (rt)
+		htable_replicas_free(rt);
 
 	pr_debug("set %s resized from %u (%p) to %u (%p)\n", set->name,
 		 orig->htable_bits, orig, t->htable_bits, t);
-	mtype_ahash_destroy(set, orig, false);
+	/* Otherwise the last listing destroys orig, see mtype_uref */
+	orig->retired = true;
+	if (atomic_dec_and_test(&orig->uref))
+		mtype_ahash_destroy(set, orig, pinned);
+	if (prev)
+		mtype_ahash_destroy(set, prev, false);
+
+	return 0;
+}
+
+/* Resize a hash: create a new hash table with doubling the hashsize
+ * and inserting the elements to it. Repeat until we succeed or
+ * fail due to memory pressures. */
+static int
+mtype_resize(struct ip_set *set, bool retried)
+{
+	struct htype *h = set->data;
+	struct htable *orig;
+	ktime_t start;
+	u8 htable_bits;
+	u32 i;
+	int ret, stuck;
+
+	/* Try to cleanup once */
+	if (SET_WITH_TIMEOUT(set) && !retried) {
+		i = atomic_read(&h->elements);
+		write_lock_bh(&set->lock);
+		mtype_expire(set, set->data, NLEN(set->family), set->dsize);
+		write_unlock_bh(&set->lock);
+		if (atomic_read(&h->elements) < i)
+			return 0;
+	}
+
+	start = ip_set_stats_start(set);
+	mutex_lock(&h->resize_lock);
+	/* A pending migration must be finished before resizing again.
+	 * If the new table cannot store all elements of the old one,
+	 * both are rehashed. */
+	stuck = mtype_rehash_finish(set, h);
+	orig = rcu_dereference_bh_nfnl(h->table);
+	htable_bits = orig->htable_bits;
+
+	do {
+		htable_bits++;
+		pr_debug("attempt to resize set %s from %u to %u, t %p\n",
+			 set->name, orig->htable_bits, htable_bits, orig);
+		if (!htable_bits) {
+			/* In case we have plenty of memory :-) */
+			pr_warning("Cannot increase the hashsize of set %s "
+				   "further\n", set->name);
+			ret = -IPSET_ERR_HASH_FULL;
+			break;
+		}
+		ret = mtype_rehash(set, orig, htable_bits, stuck);
+	} while (ret == -EAGAIN);
+	mutex_unlock(&h->resize_lock);
+	ip_set_stats_inc(set, resizes);
+	ip_set_stats_time(set, resize_time, start);
+
+	return ret;
+}
+
+/* Shrink a hash: rehash the elements into the smallest table,
+ * which can store them. Must be called from process context. */
+static int
+mtype_compact(struct ip_set *set)
+{
+	struct htype *h = set->data;
+	struct htable *orig;
+	u8 htable_bits;
+	int ret = 0, stuck;
+
+	mutex_lock(&h->resize_lock);
+	stuck = mtype_rehash_finish(set, h);
+	orig = rcu_dereference_bh_nfnl(h->table);
+	/* A stuck migration is completed at any size */
+	for (htable_bits = mtype_shrink_bits(h);
+	     htable_bits && (stuck || htable_bits < orig->htable_bits);
+	     htable_bits++) {
+		pr_debug("attempt to shrink set %s from %u to %u, t %p\n",
+			 set->name, orig->htable_bits, htable_bits, orig);
+		ret = mtype_rehash(set, orig, htable_bits, stuck);
+		if (ret != -EAGAIN)
+			break;
+	}
+	mutex_unlock(&h->resize_lock);
+
+	/* The table is as small as possible */
+	return ret == -EAGAIN ? 0 : ret;
+}
+
+#ifdef IP_SET_HASH_WITH_STRIPES
+/* Add an element with the set read-locked: append it to a bucket with
+ * free slot or update the extensions of the existing element. Everything
+ * else is left to the write-locked add by returning -EBUSY. */
+static int
+mtype_add_striped(struct ip_set *set, const struct mtype_elem *d,
+		  const struct ip_set_ext *ext, u32 flags)
+{
+	struct htype *h = set->data;
+	struct htable *t;
+	struct mtype_elem *data;
+	struct hbucket *n;
+	spinlock_t *lock;
+	int i, ret = -EBUSY;
+	u32 key, multi = 0;
+
+	rcu_read_lock_bh();
+	t = rcu_dereference_bh(h->table);
+	key = HKEY(d, h->initval, t->htable_bits);
+	lock = &h->stripes[key & h->stripes_mask];
+	spin_lock(lock);
+	if (h->resizing)
+		goto out;
+	/* The element may not be migrated yet */
+	n = mtype_hbucket(h, t, d, 1);
+	for (i = 0; n && i < n->pos; i++) {
+		if (mtype_data_equal(ahash_data(n, i, set->dsize), d, &multi))
+			goto out;
+	}
+	n = hbucket(t, key);
+	for (i = 0; i < n->pos; i++) {
+		data = ahash_data(n, i, set->dsize);
+		if (!mtype_data_equal(data, d, &multi))
+			continue;
+		if (!(flags & IPSET_FLAG_EXIST ||
+		      (SET_WITH_TIMEOUT(set) &&
+		       ip_set_timeout_expired(ext_timeout(data, set), set)))) {
+			ret = -IPSET_ERR_EXIST;
+			goto out;
+		}
+		/* The comment and the per-CPU counters can't be replaced
+		 * under the readers */
+		if (SET_WITH_COMMENT(set) || SET_WITH_PCPU_COUNTER(set))
+			goto out;
+		goto set_ext;
+	}
+	if (n->pos >= n->size ||
+	    !atomic_add_unless(&h->elements, 1, h->maxelem))
+		goto out;
+	data = ahash_data(n, n->pos, set->dsize);
+	memcpy(data, d, sizeof(struct mtype_elem));
+#ifdef IP_SET_HASH_WITH_BLOOM
+	if (h->bloom)
+		ahash_bloom_update(h->bloom, BKEY(d, h->bloom), true);
+#endif
+	if (SET_WITH_COMMENT(set))
+		ip_set_init_comment(set, ext_comment(data, set), ext);
+set_ext:
+	if (SET_WITH_TIMEOUT(set)) {
+		ip_set_timeout_set(ext_timeout(data, set), ext->timeout, set);
+		ip_set_expiry_schedule(h->expiry, &n->expiry, key,
+			ip_set_timeout_jiffies(*ext_timeout(data, set), set));
+	}
+	if (SET_WITH_COUNTER(set))
+		ip_set_init_counter(set, ext_counter(data, set), ext);
+	if (i == n->pos) {
+		/* Publish the new element to the readers */
+		smp_wmb();
+		n->pos++;
+	}
+	ret = 0;
+out:
+	spin_unlock(lock);
+	rcu_read_unlock_bh();
+	return ret;
+}
+#endif
+
+/* Store a kernel side add which found its bucket full in the stash and
+ * let the worker grow the table. The set must be write-locked. */
+static int
+mtype_stash_add(struct ip_set *set, struct htype *h,
+		const struct mtype_elem *d, const struct ip_set_ext *ext,
+		u32 flags)
+{
+	struct ahash_stash_elem *e;
+	u32 i, multi = 0;
+
+	for (i = 0; i < h->stash_len; i++)
+		if (mtype_data_equal((struct mtype_elem *)stash_elem(h, i)->data,
+				     d, &multi))
+			return 0;
+	if (!h->stash)
+		h->stash = kzalloc(AHASH_STASH_SIZE * STASH_ELEM_SIZE,
+				   GFP_ATOMIC);
+	if (!h->stash || h->stash_len == AHASH_STASH_SIZE) {
+		h->add_failed++;
+		schedule_work(&h->rehash_work);
+		return -IPSET_ERR_HASH_FULL;
+	}
+	e = stash_elem(h, h->stash_len++);
+	e->ext = *ext;
+	e->flags = flags & ~IPSET_FLAG_KERNEL_ADD;
+	memcpy(e->data, d, sizeof(struct mtype_elem));
+	schedule_work(&h->rehash_work);
 
 	return 0;
 }
@@ -628,11 +2163,22 @@ mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 	bool flag_exist = flags & IPSET_FLAG_EXIST;
 	u32 key, multi = 0;
 
-	if (SET_WITH_TIMEOUT(set) && h->elements >= h->maxelem)
-		/* FIXME: when set is full, we slow down here */
+#ifdef IP_SET_HASH_WITH_STRIPES
+	if (flags & IPSET_FLAG_PARALLEL_ADD)
+		return mtype_add_striped(set, d, ext, flags);
+#endif
+	if (SET_WITH_TIMEOUT(set) && atomic_read(&h->elements) >= h->maxelem) {
+		/* Just the due buckets are visited */
 		mtype_expire(set, h, NLEN(set->family), set->dsize);
+		if (atomic_read(&h->elements) >= h->maxelem &&
+		    set->cadt_flags & IPSET_FLAG_WITH_EVICT) {
+			rcu_read_lock_bh();
+			ip_set_expiry_evict(h->expiry, set, mtype_evict_due);
+			rcu_read_unlock_bh();
+		}
+	}
 
-	if (h->elements >= h->maxelem) {
+	if (atomic_read(&h->elements) >= h->maxelem) {
 		if (net_ratelimit())
 			pr_warning("Set %s is full, maxelem %u reached\n",
 				   set->name, h->maxelem);
@@ -641,32 +2187,61 @@ mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 
 	rcu_read_lock_bh();
 	t = rcu_dereference_bh(h->table);
-	key = HKEY(value, h->initval, t->htable_bits);
-	n = hbucket(t, key);
+	/* The element may not be migrated yet */
+	n = mtype_hbucket(h, t, d, 1);
+	for (i = 0; n && i < n->pos; i++) {
+		data = ahash_data(n, i, set->dsize);
+		if (mtype_data_equal(data, d, &multi))
+			goto found;
+	}
+	multi = 0;
+	n = mtype_hbucket(h, t, d, 0);
 	for (i = 0; i < n->pos; i++) {
 		data = ahash_data(n, i, set->dsize);
-		if (mtype_data_equal(data, d, &multi)) {
-			if (flag_exist ||
-			    (SET_WITH_TIMEOUT(set) &&
-			     ip_set_timeout_expired(ext_timeout(data, set)))) {
-				/* Just the extensions could be overwritten */
-				j = i;
-				goto reuse_slot;
-			} else {
-				ret = -IPSET_ERR_EXIST;
-				goto out;
-			}
-		}
+		if (mtype_data_equal(data, d, &multi))
+			goto found;
 		/* Reuse first timed out entry */
 		if (SET_WITH_TIMEOUT(set) &&
-		    ip_set_timeout_expired(ext_timeout(data, set)) &&
+		    ip_set_timeout_expired(ext_timeout(data, set), set) &&
 		    j != AHASH_MAX(h) + 1)
 			j = i;
 	}
+	goto reuse_slot;
+found:
+	if (!(flag_exist ||
+	      (SET_WITH_TIMEOUT(set) &&
+	       ip_set_timeout_expired(ext_timeout(data, set), set)))) {
+		ret = -IPSET_ERR_EXIST;
+		goto out;
+	}
+	/* Just the extensions could be overwritten */
+	j = i;
 reuse_slot:
+	ahash_cache_invalidate(h);
 	if (j != AHASH_MAX(h) + 1) {
 		/* Fill out reused slot */
 		data = ahash_data(n, j, set->dsize);
+#ifdef IP_SET_HASH_WITH_BLOOM
+		if (h->bloom && BKEY(d, h->bloom) != BKEY(data, h->bloom)) {
+			ahash_bloom_update(h->bloom, BKEY(d, h->bloom), true);
+			ahash_bloom_update(h->bloom, BKEY(data, h->bloom),
+					   false);
+		}
+#endif
+#ifdef IP_SET_HASH_WITH_LPM
+		ret = mtype_lpm_add(h, d);
+		if (ret)
+			goto out;
+		mtype_lpm_del(h, data);
+#endif
+#if IPSET_NET_COUNT > 1
+		ret = net_pairs_add(&h->pairs, CIDR(d->cidr, 0),
+				    CIDR(d->cidr, 1));
+		if (ret)
+			goto out;
+		net_pairs_del(&h->pairs, CIDR(data->cidr, 0),
+			      CIDR(data->cidr, 1));
+#endif
 #ifdef IP_SET_HASH_WITH_NETS
 		for (i = 0; i < IPSET_NET_COUNT; i++) {
 			mtype_del_cidr(h, CIDR(data->cidr, i),
@@ -679,10 +2254,27 @@ reuse_slot:
 	} else {
 		/* Use/create a new slot */
 		TUNE_AHASH_MAX(h, multi);
-		ret = hbucket_elem_add(n, AHASH_MAX(h), set->dsize);
+		ret = hbucket_elem_add(&h->alloc, n, AHASH_MAX(h), set->dsize);
+#ifdef IP_SET_HASH_WITH_LPM
+		if (ret == 0)
+			ret = mtype_lpm_add(h, d);
+#endif
+#if IPSET_NET_COUNT > 1
+		if (ret == 0)
+			ret = net_pairs_add(&h->pairs, CIDR(d->cidr, 0),
+					    CIDR(d->cidr, 1));
+#endif
 		if (ret != 0) {
-			if (ret == -EAGAIN)
-				mtype_data_next(&h->next, d);
+			if (ret == -EAGAIN) {
+				ip_set_stats_inc(set, bucket_full);
+				/* The stashed element is not stored in the
+				 * full bucket */
+				if (flags & IPSET_FLAG_KERNEL_ADD)
+					ret = mtype_stash_add(set, h, d, ext,
+							      flags);
+				else
+					mtype_data_next(&h->next, d);
+			}
 			goto out;
 		}
 		data = ahash_data(n, n->pos++, set->dsize);
@@ -691,24 +2283,82 @@ reuse_slot:
 			mtype_add_cidr(h, CIDR(d->cidr, i), NLEN(set->family),
 				       i);
 #endif
-		h->elements++;
+#ifdef IP_SET_HASH_WITH_BLOOM
+		if (h->bloom)
+			ahash_bloom_update(h->bloom, BKEY(d, h->bloom), true);
+#endif
+		atomic_inc(&h->elements);
 	}
 	memcpy(data, d, sizeof(struct mtype_elem));
 #ifdef IP_SET_HASH_WITH_NETS
 	mtype_data_set_flags(data, flags);
 #endif
-	if (SET_WITH_TIMEOUT(set))
-		ip_set_timeout_set(ext_timeout(data, set), ext->timeout);
+	if (SET_WITH_TIMEOUT(set)) {
+		ip_set_timeout_set(ext_timeout(data, set), ext->timeout, set);
+		key = HKEY(d, h->initval, t->htable_bits);
+		/* The not yet migrated buckets are scanned by the gc */
+		if (n == hbucket(t, key))
+			ip_set_expiry_schedule(h->expiry, &n->expiry, key,
+				ip_set_timeout_jiffies(*ext_timeout(data, set),
+						       set));
+	}
 	if (SET_WITH_COUNTER(set))
-		ip_set_init_counter(ext_counter(data, set), ext);
+		ip_set_init_counter(set, ext_counter(data, set), ext);
 	if (SET_WITH_COMMENT(set))
-		ip_set_init_comment(ext_comment(data, set), ext);
+		ip_set_init_comment(set, ext_comment(data, set), ext);
+	mtype_replicas_sync(set, h, t, d);
 
 out:
 	rcu_read_unlock_bh();
 	return ret;
 }
 
+/* Add the elements of the stash to the grown table */
+static void
+mtype_stash_drain(struct ip_set *set, struct htype *h)
+{
+	struct ahash_stash_elem *e;
+	struct ip_set_ext mext;
+	u32 i;
+	int ret;
+
+	write_lock_bh(&set->lock);
+	for (i = 0; i < h->stash_len; i++) {
+		e = stash_elem(h, i);
+		ret = mtype_add(set, e->data, &e->ext, &mext, e->flags);
+		if (ret == -EAGAIN || ret == -IPSET_ERR_HASH_FULL)
+			h->add_failed++;
+	}
+	h->stash_len = 0;
+	write_unlock_bh(&set->lock);
+}
+
+/* Grow the table for the stashed kernel side adds, finish the incremental
+ * resizing, shrink the table after mass deletion or expiry and build the
+ * missing replicas */
+static void
+mtype_rehash_work(struct work_struct *work)
+{
+	struct htype *h = container_of(work, struct htype, rehash_work);
+	bool grown = false;
+
+	if (ACCESS_ONCE(h->stash_len)) {
+		mtype_resize(h->set, true);
+		mtype_stash_drain(h->set, h);
+		grown = true;
+	}
+	if (mtype_rehash_finish(h->set, h) < 0 ||
+	    (!grown &&
+	     mtype_shrink_needed(h, rcu_dereference_bh_nfnl(h->table))))
+		mtype_compact(h->set);
+	if (h->replicas && !time_before(jiffies, h->replicas_retry) &&
+	    mtype_replicas_missing(h)) {
+		mutex_lock(&h->resize_lock);
+		mtype_replicas_build(h->set);
+		mutex_unlock(&h->resize_lock);
+	}
+}
+
 /* Delete an element from the hash: swap it with the last element
  * and free up space if possible.
  */
@@ -725,48 +2375,54 @@ mtype_del(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 #ifdef IP_SET_HASH_WITH_NETS
 	u8 j;
 #endif
-	u32 key, multi = 0;
+	u8 k;
+	u32 multi = 0;
 
 	rcu_read_lock_bh();
 	t = rcu_dereference_bh(h->table);
-	key = HKEY(value, h->initval, t->htable_bits);
-	n = hbucket(t, key);
-	for (i = 0; i < n->pos; i++) {
-		data = ahash_data(n, i, set->dsize);
-		if (!mtype_data_equal(data, d, &multi))
-			continue;
-		if (SET_WITH_TIMEOUT(set) &&
-		    ip_set_timeout_expired(ext_timeout(data, set)))
-			goto out;
-		if (i != n->pos - 1)
-			/* Not last one */
-			memcpy(data, ahash_data(n, n->pos - 1, set->dsize),
-			       set->dsize);
+	for (k = 0; (n = mtype_hbucket(h, t, d, k)) != NULL; k++) {
+		for (i = 0; i < n->pos; i++) {
+			data = ahash_data(n, i, set->dsize);
+			if (mtype_data_equal(data, d, &multi))
+				goto found;
+		}
+		multi = 0;
+	}
+	goto out;
 
-		n->pos--;
-		h->elements--;
+found:
+	if (SET_WITH_TIMEOUT(set) &&
+	    ip_set_timeout_expired(ext_timeout(data, set), set))
+		goto out;
+	if (i != n->pos - 1)
+		/* Not last one */
+		memcpy(data, ahash_data(n, n->pos - 1, set->dsize),
+		       set->dsize);
+
+	n->pos--;
+	atomic_dec(&h->elements);
+	ahash_cache_invalidate(h);
 #ifdef IP_SET_HASH_WITH_NETS
-		for (j = 0; j < IPSET_NET_COUNT; j++)
-			mtype_del_cidr(h, CIDR(d->cidr, j), NLEN(set->family),
-				       j);
+	for (j = 0; j < IPSET_NET_COUNT; j++)
+		mtype_del_cidr(h, CIDR(d->cidr, j), NLEN(set->family), j);
 #endif
-		ip_set_ext_destroy(set, data);
-		if (n->pos + AHASH_INIT_SIZE < n->size) {
-			void *tmp = kzalloc((n->size - AHASH_INIT_SIZE)
-					    * set->dsize,
-					    GFP_ATOMIC);
-			if (!tmp) {
-				ret = 0;
-				goto out;
-			}
-			n->size -= AHASH_INIT_SIZE;
-			memcpy(tmp, n->value, n->size * set->dsize);
-			kfree(n->value);
-			n->value = tmp;
-		}
-		ret = 0;
-		goto out;
-	}
+#ifdef IP_SET_HASH_WITH_LPM
+	mtype_lpm_del(h, d);
+#endif
+#if IPSET_NET_COUNT > 1
+	net_pairs_del(&h->pairs, CIDR(d->cidr, 0), CIDR(d->cidr, 1));
+#endif
+#ifdef IP_SET_HASH_WITH_BLOOM
+	if (h->bloom)
+		ahash_bloom_update(h->bloom, BKEY(d, h->bloom), false);
+#endif
+	ip_set_ext_destroy(set, data);
+	hbucket_elem_shrink(&h->alloc, n, set->dsize);
+	mtype_replicas_sync(set, h, t, d);
+	if (mtype_shrink_needed(h, t))
+		/* The worker shrinks the table */
+		schedule_work(&h->rehash_work);
+	ret = 0;
 
 out:
 	rcu_read_unlock_bh();
@@ -778,67 +2434,159 @@ mtype_data_match(struct mtype_elem *data, const struct ip_set_ext *ext,
 		 struct ip_set_ext *mext, struct ip_set *set, u32 flags)
 {
 	if (SET_WITH_COUNTER(set))
-		ip_set_update_counter(ext_counter(data, set),
+		ip_set_update_counter(set, ext_counter(data, set),
 				      ext, mext, flags);
 	return mtype_do_data_match(data);
 }
 
+/* Look up the element in the set: return the matching, not timed out
+ * element or NULL */
+static inline struct mtype_elem *
+mtype_lookup(struct ip_set *set, const struct htype *h,
+	     const struct htable *t, const struct mtype_elem *d, u32 *multi)
+{
+	struct hbucket *n;
+	struct mtype_elem *data;
+	u32 probes = 0;
+	int i, pos;
+	u8 k;
+
+	for (k = 0; (n = mtype_hbucket(h, t, d, k)) != NULL; k++) {
+		pos = ACCESS_ONCE(n->pos);
+		/* Pairs with smp_wmb() in mtype_add_striped */
+		smp_rmb();
+		for (i = 0; i < pos; i++) {
+			data = ahash_data(n, i, set->dsize);
+			if (!mtype_data_equal(data, d, multi))
+				continue;
+			if (!(SET_WITH_TIMEOUT(set) &&
+			      ip_set_timeout_expired(ext_timeout(data, set),
+						     set))) {
+				ip_set_stats_lookup(set, probes + i + 1);
+				return data;
+			}
+#ifdef IP_SET_HASH_WITH_MULTI
+			*multi = 0;
+#endif
+		}
+		probes += pos;
+	}
+	ip_set_stats_lookup(set, probes);
+	return NULL;
+}
+
+/* The replica of the local node or NULL */
+static inline const struct htable *
+mtype_replica(const struct htype *h)
+{
+	return h->replicas ? rcu_dereference_bh(h->replicas[numa_node_id()])
+			   : NULL;
+}
+
+/* The counters are updated in the primary table: look up the element
+ * matched in a replica there */
+static struct mtype_elem *
+mtype_replica_primary(struct ip_set *set, const struct htype *h,
+		      const struct htable *t, const struct mtype_elem *data)
+{
+	struct mtype_elem e = *data;
+	u32 multi = 0;
 #ifdef IP_SET_HASH_WITH_NETS
-/* Special test function which takes into account the different network
- * sizes added to the set */
-static int
-mtype_test_cidrs(struct ip_set *set, struct mtype_elem *d,
-		 const struct ip_set_ext *ext,
-		 struct ip_set_ext *mext, u32 flags)
+	u8 flags = 0;
+
+	/* The flags are not hashed */
+	mtype_data_reset_flags(&e, &flags);
+#endif
+	return mtype_lookup(set, h, t, &e, &multi);
+}
+
+#ifdef IP_SET_HASH_WITH_NETS
+/* Special lookup function which takes into account the different network
+ * sizes added to the set: return the matching element or NULL */
+static struct mtype_elem *
+mtype_lookup_cidrs(struct ip_set *set, const struct htable *t,
+		   struct mtype_elem *d)
 {
 	struct htype *h = set->data;
-	struct htable *t = rcu_dereference_bh(h->table);
-	struct hbucket *n;
 	struct mtype_elem *data;
 #if IPSET_NET_COUNT == 2
 	struct mtype_elem orig = *d;
-	int i, j = 0, k;
+	u32 j = 0;
 #else
-	int i, j = 0;
-#endif
-	u32 key, multi = 0;
+	int j = 0;
 	u8 nets_length = NLEN(set->family);
+#endif
+	u32 multi = 0;
+#ifdef IP_SET_HASH_WITH_LPM
+	u8 cidrs[SET_HOST_MASK(AF_INET6)];
+
+	if (h->lpm) {
+		/* Probe the covering prefixes only, longest first */
+		j = ahash_lpm_lookup(h->lpm, (const u8 *)&d->ip,
+				     SET_HOST_MASK(set->family) / 8, cidrs);
+		while (j--) {
+			mtype_data_netmask(d, cidrs[j]);
+			data = mtype_lookup(set, h, t, d, &multi);
+			if (data)
+				return data;
+		}
+		return NULL;
+	}
+#endif
 
 	pr_debug("test by nets\n");
-	for (; j < nets_length && h->nets[j].nets[0] && !multi; j++) {
 #if IPSET_NET_COUNT == 2
+	/* Only the prefix pairs present in the set can match */
+	for (; j < h->pairs.len; j++) {
 		mtype_data_reset_elem(d, &orig);
-		mtype_data_netmask(d, h->nets[j].cidr[0], false);
-		for (k = 0; k < nets_length && h->nets[k].nets[1] && !multi;
-		     k++) {
-			mtype_data_netmask(d, h->nets[k].cidr[1], true);
+		mtype_data_netmask(d, h->pairs.pair[j].cidr[0], false);
+		mtype_data_netmask(d, h->pairs.pair[j].cidr[1], true);
 #else
+	for (; j < nets_length && h->nets[j].nets[0] && !multi; j++) {
 		mtype_data_netmask(d, h->nets[j].cidr[0]);
 #endif
-		key = HKEY(d, h->initval, t->htable_bits);
-		n = hbucket(t, key);
-		for (i = 0; i < n->pos; i++) {
-			data = ahash_data(n, i, set->dsize);
-			if (!mtype_data_equal(data, d, &multi))
-				continue;
-			if (SET_WITH_TIMEOUT(set)) {
-				if (!ip_set_timeout_expired(
-						ext_timeout(data, set)))
-					return mtype_data_match(data, ext,
-								mext, set,
-								flags);
-#ifdef IP_SET_HASH_WITH_MULTI
-				multi = 0;
-#endif
-			} else
-				return mtype_data_match(data, ext,
-							mext, set, flags);
-		}
-#if IPSET_NET_COUNT == 2
-		}
-#endif
+		data = mtype_lookup(set, h, t, d, &multi);
+		if (data)
+			return data;
 	}
-	return 0;
+	return NULL;
+}
+#endif
+
+#ifdef IP_SET_HASH_WITH_CACHE
+/* An entry of the recent lookup cache */
+struct mtype_cache_entry {
+	u32 gen;			/* generation of the set at storing */
+	struct mtype_elem *data;	/* the matching element or NULL */
+	struct mtype_elem key;		/* the tested element */
+};
+
+/* Look up the tested element in the cache of the CPU first and store
+ * the result of the lookup of the prefixes at a miss */
+static struct mtype_elem *
+mtype_cache_lookup(struct ip_set *set, struct mtype_elem *d)
+{
+	struct htype *h = set->data;
+	const struct htable *t;
+	struct mtype_cache_entry *c;
+	u32 gen = atomic_read(&h->gen), multi = 0;
+
+	/* The generation is read before the table */
+	smp_rmb();
+	t = mtype_replica(h);
+	if (!t)
+		t = rcu_dereference_bh(h->table);
+	c = (struct mtype_cache_entry *)this_cpu_ptr(h->cache) +
+	    HKEY(d, h->initval, AHASH_CACHE_BITS);
+	if (c->gen == gen && mtype_data_equal(&c->key, d, &multi) &&
+	    !(c->data && SET_WITH_TIMEOUT(set) &&
+	      ip_set_timeout_expired(ext_timeout(c->data, set), set)))
+		return c->data;
+
+	c->key = *d;
+	c->data = mtype_lookup_cidrs(set, t, d);
+	c->gen = gen;
+	return c->data;
 }
 #endif
 
@@ -848,15 +2596,19 @@ mtype_test(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 	   struct ip_set_ext *mext, u32 flags)
 {
 	struct htype *h = set->data;
-	struct htable *t;
+	const struct htable *t, *r;
 	struct mtype_elem *d = value;
-	struct hbucket *n;
 	struct mtype_elem *data;
-	int i, ret = 0;
-	u32 key, multi = 0;
+	int ret = 0;
+#ifdef IP_SET_HASH_WITH_NETS
+	int i;
+#endif
+	u32 multi = 0;
 
 	rcu_read_lock_bh();
 	t = rcu_dereference_bh(h->table);
+	/* The lookups use the replica of the local node, if there is any */
+	r = mtype_replica(h);
 #ifdef IP_SET_HASH_WITH_NETS
 	/* If we test an IP address and not a network address,
 	 * try all possible network sizes */
@@ -864,23 +2616,33 @@ mtype_test(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 		if (CIDR(d->cidr, i) != SET_HOST_MASK(set->family))
 			break;
 	if (i == IPSET_NET_COUNT) {
-		ret = mtype_test_cidrs(set, d, ext, mext, flags);
-		goto out;
+#ifdef IP_SET_HASH_WITH_CACHE
+		if (h->cache)
+			data = mtype_cache_lookup(set, d);
+		else
+#endif
+		data = mtype_lookup_cidrs(set, r ? r : t, d);
+		goto match;
 	}
 #endif
+#ifdef IP_SET_HASH_WITH_BLOOM
+	/* A definite miss does not touch the table */
+	if (h->bloom && !ahash_bloom_test(h->bloom, BKEY(d, h->bloom)))
+		goto out;
+#endif
 
-	key = HKEY(d, h->initval, t->htable_bits);
-	n = hbucket(t, key);
-	for (i = 0; i < n->pos; i++) {
-		data = ahash_data(n, i, set->dsize);
-		if (mtype_data_equal(data, d, &multi) &&
-		    !(SET_WITH_TIMEOUT(set) &&
-		      ip_set_timeout_expired(ext_timeout(data, set)))) {
-			ret = mtype_data_match(data, ext, mext, set, flags);
-			goto out;
-		}
-	}
+	data = mtype_lookup(set, h, r ? r : t, d, &multi);
+#ifdef IP_SET_HASH_WITH_NETS
+match:
+#endif
+	/* The cached lookup may come from a replica as well */
+	if (data && h->replicas && SET_WITH_COUNTER(set))
+		data = mtype_replica_primary(set, h, t, data);
+	if (data)
+		ret = mtype_data_match(data, ext, mext, set, flags);
+#ifdef IP_SET_HASH_WITH_BLOOM
 out:
+#endif
 	rcu_read_unlock_bh();
 	return ret;
 }
@@ -895,7 +2657,13 @@ mtype_head(struct ip_set *set, struct sk_buff *skb)
 	size_t memsize;
 
 	t = rcu_dereference_bh_nfnl(h->table);
-	memsize = mtype_ahash_memsize(h, t, NLEN(set->family), set->dsize);
+	memsize = mtype_ahash_memsize(h, t, NLEN(set->family), set->dsize) +
+		  ip_set_comment_memsize(set);
+#ifdef IP_SET_HASH_WITH_CACHE
+	if (h->cache)
+		memsize += num_possible_cpus() *
+			   (sizeof(struct mtype_cache_entry) << AHASH_CACHE_BITS);
+#endif
 
 	nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
 	if (!nested)
@@ -909,10 +2677,25 @@ mtype_head(struct ip_set *set, struct sk_buff *skb)
 	    nla_put_u8(skb, IPSET_ATTR_NETMASK, h->netmask))
 		goto nla_put_failure;
 #endif
-	if (nla_put_net32(skb, IPSET_ATTR_REFERENCES, htonl(set->ref - 1)) ||
+	if (nla_put_net32(skb, IPSET_ATTR_ELEMENTS,
+			  htonl(atomic_read(&h->elements))) ||
+	    nla_put_net32(skb, IPSET_ATTR_REFERENCES, htonl(set->ref - 1)) ||
 	    nla_put_net32(skb, IPSET_ATTR_MEMSIZE, htonl(memsize)))
 		goto nla_put_failure;
-	if (unlikely(ip_set_put_flags(skb, set)))
+	if (h->add_failed &&
+	    nla_put_net64(skb, IPSET_ATTR_ADD_FAILED,
+			  cpu_to_be64(h->add_failed)))
+		goto nla_put_failure;
+	if (nla_put_net64(skb, IPSET_ATTR_BUCKET_ALLOCS,
+			  cpu_to_be64(h->alloc.allocs)) ||
+	    nla_put_net64(skb, IPSET_ATTR_BUCKET_FREES,
+			  cpu_to_be64(h->alloc.frees)))
+		goto nla_put_failure;
+	if (set->cadt_flags & IPSET_FLAG_WITH_EVICT &&
+	    nla_put_net64(skb, IPSET_ATTR_EVICTED, cpu_to_be64(h->evicted)))
+		goto nla_put_failure;
+	if (unlikely(ip_set_put_flags(skb, set) ||
+		     ip_set_put_stats(skb, set)))
 		goto nla_put_failure;
 	ipset_nest_end(skb, nested);
 
@@ -921,52 +2704,136 @@ nla_put_failure:
 	return -EMSGSIZE;
 }
 
-/* Reply a LIST/SAVE request: dump the elements of the specified set */
+/* Pin the table for listing, or release it. A pending migration is
+ * finished first, so that the elements are in one table: while the table
+ * is pinned, it is not migrated incrementally and when it is replaced by
+ * resizing, the elements are copied and the table is left intact to the
+ * listings, the last of which destroys it. */
+static int
+mtype_uref(struct ip_set *set, struct netlink_callback *cb, bool start)
+{
+	struct htype *h = set->data;
+	struct htable *t;
+	int ret;
+
+	if (!start) {
+		t = (struct htable *)cb->args[IPSET_CB_ARG1];
+		if (!t)
+			return 0;
+		cb->args[IPSET_CB_ARG1] = 0;
+		if (atomic_dec_and_test(&t->uref) && t->retired) {
+			pr_debug("set %s listed from %u (%p) destroyed\n",
+				 set->name, t->htable_bits, t);
+			mtype_ahash_destroy(set, t, true);
+		}
+		return 0;
+	}
+
+	cb->args[IPSET_CB_ARG1] = 0;
+	mutex_lock(&h->resize_lock);
+	while (mtype_rehash_finish(set, h) < 0) {
+		/* The migration is stuck: both tables are copied
+		 * into a larger one */
+		mutex_unlock(&h->resize_lock);
+		ret = mtype_resize(set, true);
+		if (ret < 0)
+			return ret;
+		mutex_lock(&h->resize_lock);
+	}
+	t = rcu_dereference_bh_nfnl(h->table);
+	atomic_inc(&t->uref);
+	mutex_unlock(&h->resize_lock);
+
+	cb->args[IPSET_CB_ARG1] = (unsigned long)t;
+	return 0;
+}
+
+/* Put one element into the listing: a nested attribute or a packed record */
+static int
+mtype_list_elem(struct sk_buff *skb, const struct ip_set *set,
+		const struct mtype_elem *e, bool packed)
+{
+	struct nlattr *nested;
+
+#ifdef IP_SET_HASH_WITH_PACKED_ADT
+	if (packed) {
+		void *rec = nla_reserve_nohdr(skb, ip_set_packed_rsize(set));
+
+		if (!rec)
+			return -EMSGSIZE;
+		mtype_data_pack(rec, e);
+		ip_set_pack_extensions(rec + sizeof(struct mtype_packed),
+				       set, e, true);
+		return 0;
+	}
+#endif
+	nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
+	if (!nested ||
+	    mtype_data_list(skb, e) ||
+	    ip_set_put_extensions(skb, set, e, true))
+		return -EMSGSIZE;
+	ipset_nest_end(skb, nested);
+	return 0;
+}
+
+/* Reply a LIST/SAVE request: dump the elements of the table pinned by
+ * mtype_uref. cb->args[IPSET_CB_ARG0] is the next bucket plus one: the
+ * elements are moved inside the buckets by the deletes, so a bucket is
+ * never split between messages. The buckets of the table of the set are
+ * read with the set read-locked one by one, a replaced table is not
+ * modified anymore and is read without locking. */
 static int
-mtype_list(const struct ip_set *set,
+mtype_list(struct ip_set *set,
 	   struct sk_buff *skb, struct netlink_callback *cb)
 {
-	const struct htype *h = set->data;
-	const struct htable *t = rcu_dereference_bh_nfnl(h->table);
-	struct nlattr *atd, *nested;
+	const struct htable *t = (const struct htable *)cb->args[IPSET_CB_ARG1];
+	u32 size = jhash_size(t->htable_bits);
+	bool packed = ip_set_list_packed(set, cb);
+	struct nlattr *atd;
 	const struct hbucket *n;
 	const struct mtype_elem *e;
-	u32 first = cb->args[IPSET_CB_ARG0];
-	/* We assume that one hash bucket fills into one page */
+	u32 first;
 	void *incomplete;
-	int i;
-
-	atd = ipset_nest_start(skb, IPSET_ATTR_ADT);
+	bool locked;
+	int i, pos;
+
+	if (packed) {
+		atd = nla_nest_start(skb, IPSET_ATTR_PACKED);
+		if (atd && ip_set_put_packed_header(skb, set)) {
+			nla_nest_cancel(skb, atd);
+			atd = NULL;
+		}
+	} else
+		atd = ipset_nest_start(skb, IPSET_ATTR_ADT);
 	if (!atd)
 		return -EMSGSIZE;
 	pr_debug("list hash set %s\n", set->name);
-	for (; cb->args[IPSET_CB_ARG0] < jhash_size(t->htable_bits);
-	     cb->args[IPSET_CB_ARG0]++) {
-		incomplete = skb_tail_pointer(skb);
-		n = hbucket(t, cb->args[IPSET_CB_ARG0]);
+	if (!cb->args[IPSET_CB_ARG0])
+		cb->args[IPSET_CB_ARG0] = 1;
+	first = cb->args[IPSET_CB_ARG0];
+	for (; cb->args[IPSET_CB_ARG0] <= size; cb->args[IPSET_CB_ARG0]++) {
+		n = hbucket(t, cb->args[IPSET_CB_ARG0] - 1);
 		pr_debug("cb->arg bucket: %lu, t %p n %p\n",
-			 cb->args[IPSET_CB_ARG0], t, n);
-		for (i = 0; i < n->pos; i++) {
+			 cb->args[IPSET_CB_ARG0] - 1, t, n);
+		incomplete = skb_tail_pointer(skb);
+		locked = !ACCESS_ONCE(t->retired);
+		if (locked)
+			read_lock_bh(&set->lock);
+		pos = ACCESS_ONCE(n->pos);
+		/* Pairs with smp_wmb() in mtype_add_striped */
+		smp_rmb();
+		for (i = 0; i < pos; i++) {
 			e = ahash_data(n, i, set->dsize);
 			if (SET_WITH_TIMEOUT(set) &&
-			    ip_set_timeout_expired(ext_timeout(e, set)))
+			    ip_set_timeout_expired(ext_timeout(e, set), set))
 				continue;
 			pr_debug("list hash %lu hbucket %p i %u, data %p\n",
-				 cb->args[IPSET_CB_ARG0], n, i, e);
-			nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
-			if (!nested) {
-				if (cb->args[IPSET_CB_ARG0] == first) {
-					nla_nest_cancel(skb, atd);
-					return -EMSGSIZE;
-				} else
-					goto nla_put_failure;
-			}
-			if (mtype_data_list(skb, e))
+				 cb->args[IPSET_CB_ARG0] - 1, n, i, e);
+			if (mtype_list_elem(skb, set, e, packed))
 				goto nla_put_failure;
-			if (ip_set_put_extensions(skb, set, e, true))
-				goto nla_put_failure;
-			ipset_nest_end(skb, nested);
 		}
+		if (locked)
+			read_unlock_bh(&set->lock);
 	}
 	ipset_nest_end(skb, atd);
 	/* Set listing finished */
@@ -975,13 +2842,17 @@ mtype_list(const struct ip_set *set,
 	return 0;
 
 nla_put_failure:
+	if (locked)
+		read_unlock_bh(&set->lock);
 	nlmsg_trim(skb, incomplete);
 	if (unlikely(first == cb->args[IPSET_CB_ARG0])) {
 		pr_warning("Can't list set %s: one bucket does not fit into "
 			   "a message. Please report it!\n", set->name);
+		nla_nest_cancel(skb, atd);
 		cb->args[IPSET_CB_ARG0] = 0;
 		return -EMSGSIZE;
 	}
+	/* Continue with the bucket in the next message */
 	ipset_nest_end(skb, atd);
 	return 0;
 }
@@ -995,9 +2866,19 @@ static int
 IPSET_TOKEN(MTYPE, _uadt)(struct ip_set *set, struct nlattr *tb[],
 	    enum ipset_adt adt, u32 *lineno, u32 flags, bool retried);
 
+#ifdef IP_SET_HASH_WITH_PACKED_ADT
+static int
+IPSET_TOKEN(MTYPE, _padt)(struct ip_set *set, const void *data,
+	    enum ipset_adt adt, u32 flags);
+#endif
+
 static const struct ip_set_type_variant mtype_variant = {
 	.kadt	= mtype_kadt,
 	.uadt	= mtype_uadt,
+#ifdef IP_SET_HASH_WITH_PACKED_ADT
+	.padt	= mtype_padt,
+	.psize	= sizeof(struct mtype_packed),
+#endif
 	.adt	= {
 		[IPSET_ADD] = mtype_add,
 		[IPSET_DEL] = mtype_del,
@@ -1007,8 +2888,13 @@ static const struct ip_set_type_variant mtype_variant = {
 	.flush	= mtype_flush,
 	.head	= mtype_head,
 	.list	= mtype_list,
+	.uref	= mtype_uref,
 	.resize	= mtype_resize,
+	.compact = mtype_compact,
 	.same_set = mtype_same_set,
+#ifdef IP_SET_HASH_WITH_STRIPES
+	.parallel_kadd = true,
+#endif
 };
 
 #ifdef IP_SET_EMIT_CREATE
@@ -1017,11 +2903,12 @@ IPSET_TOKEN(HTYPE, _create)(struct net *net, struct ip_set *set,
 			    struct nlattr *tb[], u32 flags)
 {
 	u32 hashsize = IPSET_DEFAULT_HASHSIZE, maxelem = IPSET_DEFAULT_MAXELEM;
-	u8 hbits;
+	u32 expect = 0;
 #ifdef IP_SET_HASH_WITH_NETMASK
 	u8 netmask;
 #endif
 	size_t hsize;
+	u8 hbits;
 	struct HTYPE *h;
 	struct htable *t;
 
@@ -1034,6 +2921,7 @@ IPSET_TOKEN(HTYPE, _create)(struct net *net, struct ip_set *set,
 #endif
 
 	if (unlikely(!ip_set_optattr_netorder(tb, IPSET_ATTR_HASHSIZE) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_EXPECT) ||
 		     !ip_set_optattr_netorder(tb, IPSET_ATTR_MAXELEM) ||
 		     !ip_set_optattr_netorder(tb, IPSET_ATTR_TIMEOUT) ||
 		     !ip_set_optattr_netorder(tb, IPSET_ATTR_CADT_FLAGS)))
@@ -1048,6 +2936,20 @@ IPSET_TOKEN(HTYPE, _create)(struct net *net, struct ip_set *set,
 	if (tb[IPSET_ATTR_MAXELEM])
 		maxelem = ip_set_get_h32(tb[IPSET_ATTR_MAXELEM]);
 
+	if (tb[IPSET_ATTR_EXPECT])
+		expect = min(ip_set_get_h32(tb[IPSET_ATTR_EXPECT]), maxelem);
+
+	/* Just the elements with timeout can be evicted */
+	if (tb[IPSET_ATTR_CADT_FLAGS] &&
+	    (ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]) &
+	     IPSET_FLAG_WITH_EVICT) && !tb[IPSET_ATTR_TIMEOUT])
+		return -IPSET_ERR_TIMEOUT;
+	/* The gc does not write the expiry through to the replicas */
+	if (tb[IPSET_ATTR_CADT_FLAGS] &&
+	    (ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]) &
+	     IPSET_FLAG_WITH_REPLICAS) && tb[IPSET_ATTR_TIMEOUT])
+		return -IPSET_ERR_HASH_REPLICAS;
+
 #ifdef IP_SET_HASH_WITH_NETMASK
 	if (tb[IPSET_ATTR_NETMASK]) {
 		netmask = nla_get_u8(tb[IPSET_ATTR_NETMASK]);
@@ -1069,38 +2971,191 @@ IPSET_TOKEN(HTYPE, _create)(struct net *net, struct ip_set *set,
 		return -ENOMEM;
 
 	h->maxelem = maxelem;
+#ifdef IP_SET_HASH_WITH_STRIPES
+	h->stripes = ahash_stripes_alloc(&h->stripes_mask);
+	if (!h->stripes) {
+		kfree(h);
+		return -ENOMEM;
+	}
+#endif
 #ifdef IP_SET_HASH_WITH_NETMASK
 	h->netmask = netmask;
 #endif
 	get_random_bytes(&h->initval, sizeof(h->initval));
 	set->timeout = IPSET_NO_TIMEOUT;
 
-	hbits = htable_bits(hashsize);
-	hsize = htable_size(hbits);
-	if (hsize == 0) {
-		kfree(h);
-		return -ENOMEM;
-	}
-	t = ip_set_alloc(hsize);
-	if (!t) {
-		kfree(h);
-		return -ENOMEM;
-	}
-	t->htable_bits = hbits;
-	rcu_assign_pointer(h->table, t);
-
 	set->data = h;
+	h->set = set;
+	mutex_init(&h->resize_lock);
 	if (set->family == NFPROTO_IPV4) {
+		INIT_WORK(&h->rehash_work, IPSET_TOKEN(HTYPE, 4_rehash_work));
 		set->variant = &IPSET_TOKEN(HTYPE, 4_variant);
 		set->dsize = ip_set_elem_len(set, tb,
 				sizeof(struct IPSET_TOKEN(HTYPE, 4_elem)));
 	} else {
+		INIT_WORK(&h->rehash_work, IPSET_TOKEN(HTYPE, 6_rehash_work));
 		set->variant = &IPSET_TOKEN(HTYPE, 6_variant);
 		set->dsize = ip_set_elem_len(set, tb,
 				sizeof(struct IPSET_TOKEN(HTYPE, 6_elem)));
 	}
+
+#ifdef IP_SET_HASH_WITH_MULTI
+	h->ahash_max = AHASH_MAX_SIZE;
+#endif
+	if (ahash_alloc_init(&h->alloc, AHASH_MAX_TUNED, set->dsize)) {
+		ahash_alloc_destroy(&h->alloc);
+#ifdef IP_SET_HASH_WITH_STRIPES
+		kfree(h->stripes);
+#endif
+		kfree(h);
+		set->data = NULL;
+		return -ENOMEM;
+	}
+
+	/* Presize the table for the expected number of elements: it is
+	 * not shrunk below, so deletes and expiry while the set is being
+	 * filled up do not undo it */
+	hbits = htable_bits(hashsize);
+	if (expect)
+		hbits = max_t(u8, hbits,
+			      htable_bits(DIV_ROUND_UP(expect,
+						       AHASH_EXPECT_LOAD)));
+	/* The bucket layout depends on the element size */
+	t = htable_alloc(hbits, set->dsize);
+	if (!t) {
+#ifdef IP_SET_HASH_WITH_STRIPES
+		kfree(h->stripes);
+#endif
+		ahash_alloc_destroy(&h->alloc);
+		kfree(h);
+		set->data = NULL;
+		return -ENOMEM;
+	}
+	rcu_assign_pointer(h->table, t);
+	h->htable_bits_min = t->htable_bits;
+
+#ifdef IP_SET_HASH_WITH_LPM
+	if (tb[IPSET_ATTR_CADT_FLAGS] &&
+	    (ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]) & IPSET_FLAG_WITH_LPM)) {
+		h->lpm = kzalloc(sizeof(*h->lpm), GFP_KERNEL);
+		if (!h->lpm) {
+			ip_set_free(t);
+			ahash_alloc_destroy(&h->alloc);
+			kfree(h);
+			set->data = NULL;
+			return -ENOMEM;
+		}
+		set->cadt_flags |= IPSET_FLAG_WITH_LPM;
+	}
+#endif
+#ifdef IP_SET_HASH_WITH_BLOOM
+	if (tb[IPSET_ATTR_CADT_FLAGS] &&
+	    (ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]) &
+	     IPSET_FLAG_WITH_BLOOM)) {
+		h->bloom = ahash_bloom_alloc(maxelem);
+		if (!h->bloom) {
+			ip_set_free(t);
+#ifdef IP_SET_HASH_WITH_STRIPES
+			kfree(h->stripes);
+#endif
+			ahash_alloc_destroy(&h->alloc);
+			kfree(h);
+			set->data = NULL;
+			return -ENOMEM;
+		}
+		set->cadt_flags |= IPSET_FLAG_WITH_BLOOM;
+	}
+#endif
+#ifdef IP_SET_HASH_WITH_CACHE
+	if (tb[IPSET_ATTR_CADT_FLAGS] &&
+	    (ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]) &
+	     IPSET_FLAG_WITH_CACHE)) {
+		if (set->family == NFPROTO_IPV4)
+			h->cache = __alloc_percpu(
+			    sizeof(struct IPSET_TOKEN(HTYPE, 4_cache_entry)) <<
+			    AHASH_CACHE_BITS,
+			    __alignof__(struct IPSET_TOKEN(HTYPE, 4_cache_entry)));
+		else
+			h->cache = __alloc_percpu(
+			    sizeof(struct IPSET_TOKEN(HTYPE, 6_cache_entry)) <<
+			    AHASH_CACHE_BITS,
+			    __alignof__(struct IPSET_TOKEN(HTYPE, 6_cache_entry)));
+		if (!h->cache) {
+#ifdef IP_SET_HASH_WITH_LPM
+			kfree(h->lpm);
+#endif
+			ip_set_free(t);
+			ahash_alloc_destroy(&h->alloc);
+			kfree(h);
+			set->data = NULL;
+			return -ENOMEM;
+		}
+		/* The zeroed entries are invalid */
+		atomic_set(&h->gen, 1);
+		set->cadt_flags |= IPSET_FLAG_WITH_CACHE;
+	}
+#endif
+	if (tb[IPSET_ATTR_CADT_FLAGS] &&
+	    (ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]) &
+	     IPSET_FLAG_WITH_REPLICAS)) {
+		/* Every online node gets its replica of the empty table */
+		h->replicas = (struct htable __rcu **)
+			htable_replicas_alloc(t->htable_bits, set->dsize);
+		if (!h->replicas ||
+		    IPSET_TOKEN(HTYPE, 4_replicas_missing)(h)) {
+			if (h->replicas)
+				htable_replicas_free(
+					(struct htable **)h->replicas);
+#ifdef IP_SET_HASH_WITH_CACHE
+			free_percpu(h->cache);
+#endif
+#ifdef IP_SET_HASH_WITH_BLOOM
+			if (h->bloom)
+				ip_set_free(h->bloom);
+#endif
+#ifdef IP_SET_HASH_WITH_LPM
+			kfree(h->lpm);
+#endif
+			ip_set_free(t);
+#ifdef IP_SET_HASH_WITH_STRIPES
+			kfree(h->stripes);
+#endif
+			ahash_alloc_destroy(&h->alloc);
+			kfree(h);
+			set->data = NULL;
+			return -ENOMEM;
+		}
+		h->replicas_retry = jiffies;
+		set->cadt_flags |= IPSET_FLAG_WITH_REPLICAS;
+	}
+
 	if (tb[IPSET_ATTR_TIMEOUT]) {
 		set->timeout = ip_set_timeout_uget(tb[IPSET_ATTR_TIMEOUT]);
+		h->expiry = ip_set_expiry_alloc(set->timeout, 0);
+		if (!h->expiry) {
+#ifdef IP_SET_HASH_WITH_BLOOM
+			if (h->bloom)
+				ip_set_free(h->bloom);
+#endif
+#ifdef IP_SET_HASH_WITH_LPM
+			kfree(h->lpm);
+#endif
+#ifdef IP_SET_HASH_WITH_CACHE
+			free_percpu(h->cache);
+#endif
+			ip_set_free(t);
+#ifdef IP_SET_HASH_WITH_STRIPES
+			kfree(h->stripes);
+#endif
+			ahash_alloc_destroy(&h->alloc);
+			kfree(h);
+			set->data = NULL;
+			return -ENOMEM;
+		}
+		if (tb[IPSET_ATTR_CADT_FLAGS] &&
+		    (ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]) &
+		     IPSET_FLAG_WITH_EVICT))
+			set->cadt_flags |= IPSET_FLAG_WITH_EVICT;
 		if (set->family == NFPROTO_IPV4)
 			IPSET_TOKEN(HTYPE, 4_gc_init)(set,
 				IPSET_TOKEN(HTYPE, 4_gc));
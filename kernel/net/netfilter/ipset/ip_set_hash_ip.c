@@ -25,7 +25,12 @@
 
 #define IPSET_TYPE_REV_MIN	0
 /*				1	   Counters support */
-#define IPSET_TYPE_REV_MAX	2	/* Comments support */
+/*				2	   Comments support */
+/*				3	   Bloom filter support */
+/*				4	   Eviction support */
+/*				5	   Per-CPU counters support added */
+/*				6	   Presizing from expected elements added */
+#define IPSET_TYPE_REV_MAX	7	/* NUMA node replicas added */
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Jozsef Kadlecsik <kadlec@blackhole.kfki.hu>");
@@ -35,6 +40,8 @@ MODULE_ALIAS("ip_set_hash:ip");
 /* Type specific function prefix */
 #define HTYPE		hash_ip
 #define IP_SET_HASH_WITH_NETMASK
+#define IP_SET_HASH_WITH_BLOOM
+#define IP_SET_HASH_WITH_PACKED_ADT
 
 /* IPv4 variant */
 
@@ -44,6 +51,11 @@ struct hash_ip4_elem {
 	__be32 ip;
 };
 
+/* Packed elements at add/del and in packed listings */
+struct hash_ip4_packed {
+	__be32 ip;
+};
+
 /* Common functions */
 
 static inline bool
@@ -65,6 +77,12 @@ nla_put_failure:
 	return 1;
 }
 
+static inline void
+hash_ip4_data_pack(struct hash_ip4_packed *p, const struct hash_ip4_elem *e)
+{
+	p->ip = e->ip;
+}
+
 static inline void
 hash_ip4_data_next(struct hash_ip4_elem *next, const struct hash_ip4_elem *e)
 {
@@ -163,6 +181,23 @@ hash_ip4_uadt(struct ip_set *set, struct nlattr *tb[],
 	return ret;
 }
 
+static int
+hash_ip4_padt(struct ip_set *set, const void *data,
+	      enum ipset_adt adt, u32 flags)
+{
+	const struct hash_ip *h = set->data;
+	const struct hash_ip4_packed *p = data;
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct hash_ip4_elem e = {};
+	struct ip_set_ext ext = IP_SET_INIT_UEXT(set);
+
+	e.ip = p->ip & ip_set_netmask(h->netmask);
+	if (e.ip == 0)
+		return -IPSET_ERR_HASH_ELEM;
+
+	return adtfn(set, &e, &ext, &ext, flags);
+}
+
 /* IPv6 variant */
 
 /* Member elements */
@@ -170,6 +205,11 @@ struct hash_ip6_elem {
 	union nf_inet_addr ip;
 };
 
+/* Packed elements at add/del and in packed listings */
+struct hash_ip6_packed {
+	struct in6_addr ip;
+};
+
 /* Common functions */
 
 static inline bool
@@ -197,6 +237,12 @@ nla_put_failure:
 	return 1;
 }
 
+static inline void
+hash_ip6_data_pack(struct hash_ip6_packed *p, const struct hash_ip6_elem *e)
+{
+	p->ip = e->ip.in6;
+}
+
 static inline void
 hash_ip6_data_next(struct hash_ip4_elem *next, const struct hash_ip6_elem *e)
 {
@@ -267,6 +313,24 @@ hash_ip6_uadt(struct ip_set *set, struct nlattr *tb[],
 	return ip_set_eexist(ret, flags) ? 0 : ret;
 }
 
+static int
+hash_ip6_padt(struct ip_set *set, const void *data,
+	      enum ipset_adt adt, u32 flags)
+{
+	const struct hash_ip *h = set->data;
+	const struct hash_ip6_packed *p = data;
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct hash_ip6_elem e = {};
+	struct ip_set_ext ext = IP_SET_INIT_UEXT(set);
+
+	memcpy(&e.ip.in6, &p->ip, sizeof(e.ip.in6));
+	hash_ip6_netmask(&e.ip, h->netmask);
+	if (ipv6_addr_any(&e.ip.in6))
+		return -IPSET_ERR_HASH_ELEM;
+
+	return adtfn(set, &e, &ext, &ext, flags);
+}
+
 static struct ip_set_type hash_ip_type __read_mostly = {
 	.name		= "hash:ip",
 	.protocol	= IPSET_PROTOCOL,
@@ -278,6 +342,7 @@ static struct ip_set_type hash_ip_type __read_mostly = {
 	.create		= hash_ip_create,
 	.create_policy	= {
 		[IPSET_ATTR_HASHSIZE]	= { .type = NLA_U32 },
+		[IPSET_ATTR_EXPECT]	= { .type = NLA_U32 },
 		[IPSET_ATTR_MAXELEM]	= { .type = NLA_U32 },
 		[IPSET_ATTR_PROBES]	= { .type = NLA_U8 },
 		[IPSET_ATTR_RESIZE]	= { .type = NLA_U8  },
@@ -26,7 +26,13 @@
 /*				1    Range as input support for IPv4 added */
 /*				2    nomatch flag support added */
 /*				3    Counters support added */
-#define IPSET_TYPE_REV_MAX	4 /* Comments support added */
+/*				4    Comments support added */
+/*				5    Longest prefix match index added */
+/*				6	   Eviction support added */
+/*				7	   Per-CPU counters support added */
+/*				8	   Presizing from expected elements added */
+/*				9	   Recent lookup cache added */
+#define IPSET_TYPE_REV_MAX	10 /* NUMA node replicas added */
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Jozsef Kadlecsik <kadlec@blackhole.kfki.hu>");
@@ -36,6 +42,9 @@ MODULE_ALIAS("ip_set_hash:net");
 /* Type specific function prefix */
 #define HTYPE		hash_net
 #define IP_SET_HASH_WITH_NETS
+#define IP_SET_HASH_WITH_LPM
+#define IP_SET_HASH_WITH_PACKED_ADT
+#define IP_SET_HASH_WITH_CACHE
 
 /* IPv4 variant */
 
@@ -47,6 +56,14 @@ struct hash_net4_elem {
 	u8 cidr;
 };
 
+/* Packed elements at add/del and in packed listings */
+struct hash_net4_packed {
+	__be32 ip;
+	u8 cidr;
+	u8 flags;
+	u8 padding[2];
+};
+
 /* Common functions */
 
 static inline bool
@@ -99,6 +116,16 @@ nla_put_failure:
 	return 1;
 }
 
+static inline void
+hash_net4_data_pack(struct hash_net4_packed *p,
+		    const struct hash_net4_elem *data)
+{
+	p->ip = data->ip;
+	p->cidr = data->cidr;
+	p->flags = data->nomatch ? IPSET_FLAG_NOMATCH : 0;
+	p->padding[0] = p->padding[1] = 0;
+}
+
 static inline void
 hash_net4_data_next(struct hash_net4_elem *next,
 		    const struct hash_net4_elem *d)
@@ -204,6 +231,24 @@ hash_net4_uadt(struct ip_set *set, struct nlattr *tb[],
 	return ret;
 }
 
+static int
+hash_net4_padt(struct ip_set *set, const void *data,
+	       enum ipset_adt adt, u32 flags)
+{
+	const struct hash_net4_packed *p = data;
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct hash_net4_elem e = { .cidr = p->cidr };
+	struct ip_set_ext ext = IP_SET_INIT_UEXT(set);
+
+	if (!e.cidr || e.cidr > HOST_MASK)
+		return -IPSET_ERR_INVALID_CIDR;
+	e.ip = p->ip & ip_set_netmask(e.cidr);
+	if (p->flags & IPSET_FLAG_NOMATCH)
+		flags |= (IPSET_FLAG_NOMATCH << 16);
+
+	return adtfn(set, &e, &ext, &ext, flags);
+}
+
 /* IPv6 variant */
 
 struct hash_net6_elem {
@@ -213,6 +258,14 @@ struct hash_net6_elem {
 	u8 cidr;
 };
 
+/* Packed elements at add/del and in packed listings */
+struct hash_net6_packed {
+	struct in6_addr ip;
+	u8 cidr;
+	u8 flags;
+	u8 padding[2];
+};
+
 /* Common functions */
 
 static inline bool
@@ -265,6 +318,16 @@ nla_put_failure:
 	return 1;
 }
 
+static inline void
+hash_net6_data_pack(struct hash_net6_packed *p,
+		    const struct hash_net6_elem *data)
+{
+	p->ip = data->ip.in6;
+	p->cidr = data->cidr;
+	p->flags = data->nomatch ? IPSET_FLAG_NOMATCH : 0;
+	p->padding[0] = p->padding[1] = 0;
+}
+
 static inline void
 hash_net6_data_next(struct hash_net4_elem *next,
 		    const struct hash_net6_elem *d)
@@ -350,6 +413,25 @@ hash_net6_uadt(struct ip_set *set, struct nlattr *tb[],
 	       ip_set_eexist(ret, flags) ? 0 : ret;
 }
 
+static int
+hash_net6_padt(struct ip_set *set, const void *data,
+	       enum ipset_adt adt, u32 flags)
+{
+	const struct hash_net6_packed *p = data;
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct hash_net6_elem e = { .cidr = p->cidr };
+	struct ip_set_ext ext = IP_SET_INIT_UEXT(set);
+
+	if (!e.cidr || e.cidr > HOST_MASK)
+		return -IPSET_ERR_INVALID_CIDR;
+	memcpy(&e.ip.in6, &p->ip, sizeof(e.ip.in6));
+	ip6_netmask(&e.ip, e.cidr);
+	if (p->flags & IPSET_FLAG_NOMATCH)
+		flags |= (IPSET_FLAG_NOMATCH << 16);
+
+	return adtfn(set, &e, &ext, &ext, flags);
+}
+
 static struct ip_set_type hash_net_type __read_mostly = {
 	.name		= "hash:net",
 	.protocol	= IPSET_PROTOCOL,
@@ -361,6 +443,7 @@ static struct ip_set_type hash_net_type __read_mostly = {
 	.create		= hash_net_create,
 	.create_policy	= {
 		[IPSET_ATTR_HASHSIZE]	= { .type = NLA_U32 },
+		[IPSET_ATTR_EXPECT]	= { .type = NLA_U32 },
 		[IPSET_ATTR_MAXELEM]	= { .type = NLA_U32 },
 		[IPSET_ATTR_PROBES]	= { .type = NLA_U8 },
 		[IPSET_ATTR_RESIZE]	= { .type = NLA_U8  },
@@ -28,7 +28,12 @@
 /*				2    Range as input support for IPv4 added */
 /*				3    nomatch flag support added */
 /*				4    Counters support added */
-#define IPSET_TYPE_REV_MAX	5 /* Comments support added */
+/*				5    Comments support added */
+/*				6    Longest prefix match index added */
+/*				7	   Eviction support added */
+/*				8	   Per-CPU counters support added */
+/*				9	   Presizing from expected elements added */
+#define IPSET_TYPE_REV_MAX	10 /* NUMA node replicas added */
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Jozsef Kadlecsik <kadlec@blackhole.kfki.hu>");
@@ -39,6 +44,7 @@ MODULE_ALIAS("ip_set_hash:net,port");
 #define HTYPE		hash_netport
 #define IP_SET_HASH_WITH_PROTO
 #define IP_SET_HASH_WITH_NETS
+#define IP_SET_HASH_WITH_LPM
 
 /* We squeeze the "nomatch" flag into cidr: we don't support cidr == 0
  * However this way we have to store internally cidr - 1,
@@ -468,6 +474,7 @@ static struct ip_set_type hash_netport_type __read_mostly = {
 	.create		= hash_netport_create,
 	.create_policy	= {
 		[IPSET_ATTR_HASHSIZE]	= { .type = NLA_U32 },
+		[IPSET_ATTR_EXPECT]	= { .type = NLA_U32 },
 		[IPSET_ATTR_MAXELEM]	= { .type = NLA_U32 },
 		[IPSET_ATTR_PROBES]	= { .type = NLA_U8 },
 		[IPSET_ATTR_RESIZE]	= { .type = NLA_U8  },
@@ -0,0 +1,1033 @@
+/* Copyright (C) 2013 Jozsef Kadlecsik <kadlec@blackhole.kfki.hu>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _IP_SET_INTERVAL_GEN_H
+#define _IP_SET_INTERVAL_GEN_H
+
+#include <linux/cache.h>
+#include <linux/mutex.h>
+#include <linux/prefetch.h>
+#include <linux/rbtree.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/netfilter/ipset/ip_set_timeout.h>
+#ifndef rcu_dereference_bh_check
+#define rcu_dereference_bh_check(p,c)	rcu_dereference_bh(p)
+#endif
+
+#define rcu_dereference_bh_nfnl(p)	rcu_dereference_bh_check(p, 1)
+
+/* The elements are non-overlapping intervals, stored in an array sorted
+ * by the lower bounds and laid out in Eytzinger (breadth first) order:
+ * the children of position k are at 2k and 2k + 1. Looking up an address
+ * is a branch free descent over the dense array of the lower bounds, in
+ * which the keys a few levels below are prefetched, so it costs a cache
+ * miss for the last levels only. The elements with their extensions are
+ * stored in a parallel array at the same positions.
+ *
+ * Updating
+ *
+ * The array is not modified, except that deleted elements are marked
+ * in it. The adds are stored in an rbtree of pending elements, which is
+ * searched after the array. The pending adds and the deleted elements
+ * are merged into a new array by a worker shortly after the changes,
+ * by the adds when too many are pending, and before listing the set.
+ * Rebuilding is serialized by map->rebuild_lock: the new array is built
+ * with the set read-locked, then published by rcu_assign_pointer, so the
+ * kernel side readers see either the old array with the pending tree or
+ * the new one. The old version is freed after an RCU grace period.
+ *
+ * Listing
+ *
+ * A listing pins the array, after merging the pending changes, and walks
+ * it in order across the dump messages. If the array is replaced in the
+ * meantime, the elements are copied with their own extension data and
+ * the listing goes on with the old version, destroyed by the last
+ * listing. See mtype_uref and mtype_list.
+ */
+
+/* The adds are merged into a new array when more than this are pending */
+#define INTERVAL_PENDING_MIN		64
+#define INTERVAL_PENDING_MAX(t)		\
+	max_t(u32, INTERVAL_PENDING_MIN, (t)->size / 4)
+/* The changes are merged by the worker after this delay, in jiffies */
+#define INTERVAL_MERGE_DELAY		(HZ / 10)
+
+/* A version of the elements of the set */
+struct interval_table {
+	atomic_t uref;		/* number of the listings pinning the table */
+	bool retired;		/* replaced, freed by the last listing */
+	u32 size;		/* number of the elements in the array */
+	u32 deleted;		/* number of the elements marked deleted */
+	size_t memsize;		/* size of the arrays */
+	void *keys;		/* the lower bounds, from position 1 */
+	void *elems;		/* the elements, from position 1 */
+};
+
+#define interval_key(t, k, ksize)	((t)->keys + (size_t)(k) * (ksize))
+#define interval_elem(t, k, dsize)	((t)->elems + (size_t)(k) * (dsize))
+
+/* In-order walk of the Eytzinger layout of size elements: the first
+ * position and the position after and before k, zero at the ends */
+static inline u32
+interval_first(u32 size)
+{
+	u32 k = 1;
+
+	if (!size)
+		return 0;
+	while (k <= size / 2)
+		k *= 2;
+	return k;
+}
+
+static inline u32
+interval_next(u32 k, u32 size)
+{
+	if (k <= (size - 1) / 2) {
+		/* Leftmost element of the right subtree */
+		k = 2 * k + 1;
+		while (k <= size / 2)
+			k *= 2;
+		return k;
+	}
+	/* Up until coming from a left subtree */
+	while (k & 1)
+		k >>= 1;
+	return k >> 1;
+}
+
+static inline u32
+interval_prev(u32 k, u32 size)
+{
+	if (k <= size / 2) {
+		/* Rightmost element of the left subtree */
+		k = 2 * k;
+		while (k <= (size - 1) / 2)
+			k = 2 * k + 1;
+		return k;
+	}
+	/* Up until coming from a right subtree */
+	while (k && !(k & 1))
+		k >>= 1;
+	return k >> 1;
+}
+
+/* The keys are aligned to the cache lines, so the descendants of
+ * a position at some level below are in one line */
+static struct interval_table *
+interval_table_alloc(u32 size, size_t ksize, size_t dsize)
+{
+	struct interval_table *t;
+	size_t koff = L1_CACHE_ALIGN((size_t)(size + 1) * ksize);
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return NULL;
+	t->memsize = koff + (size_t)(size + 1) * dsize;
+	t->keys = ip_set_alloc(t->memsize);
+	if (!t->keys) {
+		kfree(t);
+		return NULL;
+	}
+	t->elems = t->keys + koff;
+	return t;
+}
+
+#endif /* _IP_SET_INTERVAL_GEN_H */
+
+#ifndef ITYPE
+#error "ITYPE is not defined!"
+#endif
+
+#undef mtype_key_le
+#undef mtype_key_eq
+#undef mtype_data_list
+#undef mtype_key
+#undef mtype_elem
+#undef mtype_node
+#undef mtype_search
+#undef mtype_live
+#undef mtype_kept
+#undef mtype_lookup
+#undef mtype_pending_find
+#undef mtype_pending_insert
+#undef mtype_pending_del
+#undef mtype_pending_flush
+#undef mtype_table_free
+#undef mtype_elem_del
+#undef mtype_overlap
+#undef mtype_test
+#undef mtype_add
+#undef mtype_del
+#undef mtype_rebuild
+#undef mtype_rebuild_needed
+#undef mtype_expired
+#undef mtype_merge
+#undef mtype_gc
+#undef mtype_gc_init
+#undef mtype_resize
+#undef mtype_flush
+#undef mtype_destroy
+#undef mtype_head
+#undef mtype_uref
+#undef mtype_list
+#undef mtype_same_set
+#undef mtype_kadt
+#undef mtype_uadt
+#undef mtype_variant
+#undef mtype
+#undef INTERVAL_PREFETCH
+
+#define mtype_key_le		IPSET_TOKEN(MTYPE, _key_le)
+#define mtype_key_eq		IPSET_TOKEN(MTYPE, _key_eq)
+#define mtype_data_list		IPSET_TOKEN(MTYPE, _data_list)
+#define mtype_key		IPSET_TOKEN(MTYPE, _key)
+#define mtype_elem		IPSET_TOKEN(MTYPE, _elem)
+#define mtype_node		IPSET_TOKEN(MTYPE, _node)
+#define mtype_search		IPSET_TOKEN(MTYPE, _search)
+#define mtype_live		IPSET_TOKEN(MTYPE, _live)
+#define mtype_kept		IPSET_TOKEN(MTYPE, _kept)
+#define mtype_lookup		IPSET_TOKEN(MTYPE, _lookup)
+#define mtype_pending_find	IPSET_TOKEN(MTYPE, _pending_find)
+#define mtype_pending_insert	IPSET_TOKEN(MTYPE, _pending_insert)
+#define mtype_pending_del	IPSET_TOKEN(MTYPE, _pending_del)
+#define mtype_pending_flush	IPSET_TOKEN(MTYPE, _pending_flush)
+#define mtype_table_free	IPSET_TOKEN(MTYPE, _table_free)
+#define mtype_elem_del		IPSET_TOKEN(MTYPE, _elem_del)
+#define mtype_overlap		IPSET_TOKEN(MTYPE, _overlap)
+#define mtype_test		IPSET_TOKEN(MTYPE, _test)
+#define mtype_add		IPSET_TOKEN(MTYPE, _add)
+#define mtype_del		IPSET_TOKEN(MTYPE, _del)
+#define mtype_rebuild		IPSET_TOKEN(MTYPE, _rebuild)
+#define mtype_rebuild_needed	IPSET_TOKEN(MTYPE, _rebuild_needed)
+#define mtype_expired		IPSET_TOKEN(MTYPE, _expired)
+#define mtype_merge		IPSET_TOKEN(MTYPE, _merge)
+#define mtype_gc		IPSET_TOKEN(MTYPE, _gc)
+#define mtype_gc_init		IPSET_TOKEN(MTYPE, _gc_init)
+#define mtype_resize		IPSET_TOKEN(MTYPE, _resize)
+#define mtype_flush		IPSET_TOKEN(MTYPE, _flush)
+#define mtype_destroy		IPSET_TOKEN(MTYPE, _destroy)
+#define mtype_head		IPSET_TOKEN(MTYPE, _head)
+#define mtype_uref		IPSET_TOKEN(MTYPE, _uref)
+#define mtype_list		IPSET_TOKEN(MTYPE, _list)
+#define mtype_same_set		IPSET_TOKEN(MTYPE, _same_set)
+#define mtype_kadt		IPSET_TOKEN(MTYPE, _kadt)
+#define mtype_uadt		IPSET_TOKEN(MTYPE, _uadt)
+#define mtype_variant		IPSET_TOKEN(MTYPE, _variant)
+#define mtype			MTYPE
+
+/* The keys prefetched ahead of the descent */
+#define INTERVAL_PREFETCH	(L1_CACHE_BYTES / sizeof(struct mtype_key))
+
+#ifndef itype
+#define itype			ITYPE
+
+/* The generic interval structure */
+struct itype {
+	struct interval_table __rcu *table; /* searched by the readers */
+	struct rb_root pending;	/* adds not merged into the table yet */
+	u32 npending;		/* number of the pending adds */
+	u32 elements;		/* number of the elements, with timed out ones */
+	u32 maxelem;		/* max elements in the set */
+	struct mutex rebuild_lock; /* serializes the rebuilds */
+	struct delayed_work merge; /* merges the pending changes */
+	struct delayed_work gc;	/* drops the timed out elements */
+	struct ip_set *set;	/* back pointer for the workers */
+};
+#endif
+
+/* Member elements: the inclusive range of from-to */
+struct mtype_elem {
+	struct mtype_key from;
+	struct mtype_key to;
+	u8 deleted;
+};
+
+/* Element added, but not merged into the table yet */
+struct mtype_node {
+	struct rb_node node;
+	struct mtype_elem e __aligned(__alignof__(u64)); /* + extensions */
+};
+
+/* Put the range of the element into the listing */
+static inline bool
+mtype_data_list(struct sk_buff *skb, const struct mtype_elem *e);
+
+/* The position of the element with the largest lower bound not above
+ * the key, zero if there is none: the path of the descent records
+ * a right turn for every lower bound not above the key, the last one
+ * is at the lowest set bit. */
+static inline u32
+mtype_search(const struct interval_table *t, const struct mtype_key *key)
+{
+	const struct mtype_key *keys = t->keys;
+	unsigned long k = 1;
+
+	while (k <= t->size) {
+		prefetch(keys + INTERVAL_PREFETCH * k);
+		k = 2 * k + mtype_key_le(&keys[k], key);
+	}
+	return k >> (__ffs(k) + 1);
+}
+
+static inline bool
+mtype_live(const struct ip_set *set, const struct mtype_elem *e)
+{
+	return !e->deleted &&
+	       !(SET_WITH_TIMEOUT(set) &&
+		 ip_set_timeout_expired(ext_timeout(e, set), set));
+}
+
+/* Whether the element is copied into the new table: the timeouts are
+ * checked against the time the rebuild started */
+static inline bool
+mtype_kept(const struct ip_set *set, const struct mtype_elem *e, u64 now)
+{
+	const u32 *timeout;
+
+	if (e->deleted)
+		return false;
+	if (!SET_WITH_TIMEOUT(set))
+		return true;
+	timeout = ext_timeout(e, set);
+	return *timeout == IPSET_ELEM_PERMANENT ||
+	       !time_after64(now, ip_set_timeout_expires(timeout, set));
+}
+
+/* The pending element with the largest lower bound not above the key */
+static struct mtype_node *
+mtype_pending_find(struct rb_node *n, const struct mtype_key *key)
+{
+	struct mtype_node *node, *found = NULL;
+
+	while (n) {
+		node = rb_entry(n, struct mtype_node, node);
+		if (mtype_key_le(&node->e.from, key)) {
+			found = node;
+			n = n->rb_right;
+		} else
+			n = n->rb_left;
+	}
+	return found;
+}
+
+static void
+mtype_pending_insert(struct itype *map, struct mtype_node *new)
+{
+	struct rb_node **p = &map->pending.rb_node, *parent = NULL;
+	struct mtype_node *node;
+
+	while (*p) {
+		parent = *p;
+		node = rb_entry(parent, struct mtype_node, node);
+		if (mtype_key_le(&new->e.from, &node->e.from))
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&new->node, parent, p);
+	rb_insert_color(&new->node, &map->pending);
+	map->npending++;
+}
+
+/* Must be called with the set write-locked */
+static void
+mtype_pending_del(struct ip_set *set, struct mtype_node *node)
+{
+	struct itype *map = set->data;
+
+	rb_erase(&node->node, &map->pending);
+	map->npending--;
+	map->elements--;
+	ip_set_ext_destroy(set, &node->e);
+	kfree(node);
+}
+
+static void
+mtype_pending_flush(struct ip_set *set)
+{
+	struct itype *map = set->data;
+	struct rb_node *n;
+
+	while ((n = rb_first(&map->pending)) != NULL)
+		mtype_pending_del(set, rb_entry(n, struct mtype_node, node));
+}
+
+/* Mark an element of the table deleted. Must be called with the set
+ * write-locked. */
+static void
+mtype_elem_del(struct ip_set *set, struct interval_table *t,
+	       struct mtype_elem *e)
+{
+	struct itype *map = set->data;
+
+	e->deleted = 1;
+	ip_set_ext_destroy(set, e);
+	t->deleted++;
+	map->elements--;
+	schedule_delayed_work(&map->merge, INTERVAL_MERGE_DELAY);
+}
+
+/* Free a table, with the extension data of its elements, if those
+ * were not taken over by a new table */
+static void
+mtype_table_free(struct ip_set *set, struct interval_table *t, bool ext)
+{
+	struct mtype_elem *e;
+	u32 k;
+
+	if (ext && (SET_WITH_COMMENT(set) || SET_WITH_PCPU_COUNTER(set))) {
+		for (k = 1; k <= t->size; k++) {
+			e = interval_elem(t, k, set->dsize);
+			if (!e->deleted)
+				ip_set_ext_destroy(set, e);
+		}
+	}
+	ip_set_free(t->keys);
+	kfree(t);
+}
+
+/* Look up the live element containing the range of d. As the elements
+ * do not overlap, only the one with the largest lower bound not above
+ * d->from can contain it, both in the table and in the pending adds.
+ * The pending tree is read first: if it is emptied by a rebuild, the
+ * new table is already published. */
+static struct mtype_elem *
+mtype_lookup(struct ip_set *set, const struct mtype_elem *d)
+{
+	struct itype *map = set->data;
+	const struct interval_table *t;
+	struct mtype_node *node;
+	struct mtype_elem *e;
+	struct rb_node *root;
+	u32 k;
+
+	root = ACCESS_ONCE(map->pending.rb_node);
+	smp_rmb();
+	t = rcu_dereference_bh(map->table);
+	k = mtype_search(t, &d->from);
+	if (k) {
+		e = interval_elem(t, k, set->dsize);
+		if (mtype_key_le(&d->to, &e->to) && mtype_live(set, e))
+			return e;
+	}
+	if (!root)
+		return NULL;
+	node = mtype_pending_find(root, &d->from);
+	if (node && mtype_key_le(&d->to, &node->e.to) &&
+	    mtype_live(set, &node->e))
+		return &node->e;
+	return NULL;
+}
+
+/* Find a live element overlapping the range of d and return the pending
+ * node if it is not in the table. The timed out elements in the way are
+ * deleted. Must be called with the set write-locked. */
+static struct mtype_elem *
+mtype_overlap(struct ip_set *set, const struct mtype_elem *d,
+	      struct mtype_node **pnode)
+{
+	struct itype *map = set->data;
+	struct interval_table *t = rcu_dereference_bh_nfnl(map->table);
+	struct mtype_node *node;
+	struct mtype_elem *e;
+	struct rb_node *prev;
+	u32 k;
+
+	*pnode = NULL;
+	/* The candidates start at or before d->to, in reverse order,
+	 * until one ends before d->from */
+	for (k = mtype_search(t, &d->to); k; k = interval_prev(k, t->size)) {
+		e = interval_elem(t, k, set->dsize);
+		if (!mtype_key_le(&d->from, &e->to))
+			break;
+		if (e->deleted)
+			continue;
+		if (mtype_live(set, e))
+			return e;
+		mtype_elem_del(set, t, e);
+	}
+	node = mtype_pending_find(map->pending.rb_node, &d->to);
+	while (node && mtype_key_le(&d->from, &node->e.to)) {
+		if (mtype_live(set, &node->e)) {
+			*pnode = node;
+			return &node->e;
+		}
+		prev = rb_prev(&node->node);
+		mtype_pending_del(set, node);
+		node = prev ? rb_entry(prev, struct mtype_node, node) : NULL;
+	}
+	return NULL;
+}
+
+/* Test whether the range of the element is contained by an element */
+static int
+mtype_test(struct ip_set *set, void *value, const struct ip_set_ext *ext,
+	   struct ip_set_ext *mext, u32 flags)
+{
+	struct mtype_elem *e;
+	int ret = 0;
+
+	rcu_read_lock_bh();
+	e = mtype_lookup(set, value);
+	if (e) {
+		if (SET_WITH_COUNTER(set))
+			ip_set_update_counter(set, ext_counter(e, set), ext,
+					      mext, flags);
+		ret = 1;
+	}
+	rcu_read_unlock_bh();
+
+	return ret;
+}
+
+/* Add an element into the pending tree. An existing element with the
+ * same range gets the new extensions with -exist, any other overlapping
+ * one is an error. */
+static int
+mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
+	  struct ip_set_ext *mext, u32 flags)
+{
+	struct itype *map = set->data;
+	const struct mtype_elem *d = value;
+	struct interval_table *t;
+	struct mtype_node *node;
+	struct mtype_elem *e;
+
+	e = mtype_overlap(set, d, &node);
+	if (e) {
+		if (!mtype_key_eq(&e->from, &d->from) ||
+		    !mtype_key_eq(&e->to, &d->to))
+			return -IPSET_ERR_INTERVAL_OVERLAP;
+		if (!(flags & IPSET_FLAG_EXIST))
+			return -IPSET_ERR_EXIST;
+		ip_set_ext_destroy(set, e);
+		goto set_ext;
+	}
+	if (map->elements >= map->maxelem)
+		return -IPSET_ERR_INTERVAL_FULL;
+	t = rcu_dereference_bh_nfnl(map->table);
+	if (map->npending >= INTERVAL_PENDING_MAX(t) &&
+	    !(flags & IPSET_FLAG_KERNEL_ADD))
+		/* Merge the pending adds first, see mtype_resize */
+		return -EAGAIN;
+
+	node = kzalloc(offsetof(struct mtype_node, e) + set->dsize,
+		       GFP_ATOMIC);
+	if (!node)
+		return -ENOMEM;
+	e = &node->e;
+	e->from = d->from;
+	e->to = d->to;
+	mtype_pending_insert(map, node);
+	map->elements++;
+	schedule_delayed_work(&map->merge, INTERVAL_MERGE_DELAY);
+
+set_ext:
+	if (SET_WITH_TIMEOUT(set))
+		ip_set_timeout_set(ext_timeout(e, set), ext->timeout, set);
+	if (SET_WITH_COUNTER(set))
+		ip_set_init_counter(set, ext_counter(e, set), ext);
+	if (SET_WITH_COMMENT(set))
+		ip_set_init_comment(set, ext_comment(e, set), ext);
+	return 0;
+}
+
+/* Delete the element with exactly the same range */
+static int
+mtype_del(struct ip_set *set, void *value, const struct ip_set_ext *ext,
+	  struct ip_set_ext *mext, u32 flags)
+{
+	struct itype *map = set->data;
+	const struct mtype_elem *d = value;
+	struct mtype_node *node;
+	struct mtype_elem *e;
+
+	e = mtype_overlap(set, d, &node);
+	if (!e ||
+	    !mtype_key_eq(&e->from, &d->from) ||
+	    !mtype_key_eq(&e->to, &d->to))
+		return -IPSET_ERR_EXIST;
+	if (node)
+		mtype_pending_del(set, node);
+	else
+		mtype_elem_del(set, rcu_dereference_bh_nfnl(map->table), e);
+	return 0;
+}
+
+/* Merge the elements of the table and the pending adds into a new table,
+ * leaving out the deleted and timed out ones. Must be called with
+ * map->rebuild_lock held, from process context. */
+static int
+mtype_rebuild(struct ip_set *set)
+{
+	struct itype *map = set->data;
+	struct interval_table *orig, *t;
+	struct mtype_elem *e, *x = NULL, *d;
+	struct mtype_node *node;
+	struct rb_node *n;
+	struct rb_root pending;
+	u32 size, count, i, j, k;
+	bool pinned;
+	u64 now;
+
+	orig = rcu_dereference_bh_nfnl(map->table);
+retry:
+	size = ACCESS_ONCE(map->elements);
+	t = interval_table_alloc(size, sizeof(struct mtype_key), set->dsize);
+	if (!t)
+		return -ENOMEM;
+
+	read_lock_bh(&set->lock);
+	if (map->elements > size) {
+		/* Kernel side adds won the race */
+		read_unlock_bh(&set->lock);
+		mtype_table_free(set, t, false);
+		goto retry;
+	}
+	/* No new listing can pin orig while we hold map->rebuild_lock */
+	atomic_inc(&orig->uref);
+	pinned = atomic_read(&orig->uref) > 1;
+	now = get_jiffies_64();
+
+	/* Count the elements kept, then place them in order */
+	count = 0;
+	for (i = 1; i <= orig->size; i++)
+		count += mtype_kept(set, interval_elem(orig, i, set->dsize),
+				    now);
+	for (n = rb_first(&map->pending); n; n = rb_next(n))
+		count += mtype_kept(set, &rb_entry(n, struct mtype_node,
+						   node)->e, now);
+
+	i = interval_first(orig->size);
+	n = rb_first(&map->pending);
+	k = interval_first(count);
+	while (i || n) {
+		e = i ? interval_elem(orig, i, set->dsize) : NULL;
+		node = n ? rb_entry(n, struct mtype_node, node) : NULL;
+		if (e && (!node || mtype_key_le(&e->from, &node->e.from))) {
+			j = i;
+			i = interval_next(i, orig->size);
+		} else {
+			e = &node->e;
+			j = 0;
+			n = rb_next(n);
+		}
+		if (!mtype_kept(set, e, now)) {
+			/* A listing may still show the ones in orig */
+			if (!e->deleted && (!j || !pinned))
+				ip_set_ext_destroy(set, e);
+			continue;
+		}
+		d = interval_elem(t, k, set->dsize);
+		memcpy(d, e, set->dsize);
+		memcpy(interval_key(t, k, sizeof(struct mtype_key)),
+		       &e->from, sizeof(struct mtype_key));
+		/* orig is kept intact for the listings */
+		if (j && pinned)
+			ip_set_ext_dup(set, d);
+		x = d;
+		k = interval_next(k, count);
+	}
+	t->size = count;
+
+	rcu_assign_pointer(map->table, t);
+	/* Pairs with smp_rmb() in mtype_lookup */
+	smp_wmb();
+	pending = map->pending;
+	map->pending = RB_ROOT;
+	map->npending = 0;
+	map->elements = count;
+	read_unlock_bh(&set->lock);
+
+	/* Give time to other readers of the set */
+	synchronize_rcu_bh();
+
+	pr_debug("set %s rebuilt from %u (%p) to %u (%p), last %p\n",
+		 set->name, orig->size, orig, t->size, t, x);
+	/* The extensions of the pending adds are taken over by t */
+	while ((n = rb_first(&pending)) != NULL) {
+		rb_erase(n, &pending);
+		kfree(rb_entry(n, struct mtype_node, node));
+	}
+	/* Otherwise the last listing destroys orig, see mtype_uref */
+	orig->retired = true;
+	if (atomic_dec_and_test(&orig->uref))
+		mtype_table_free(set, orig, pinned);
+
+	return 0;
+}
+
+static bool
+mtype_rebuild_needed(struct ip_set *set)
+{
+	struct itype *map = set->data;
+
+	return map->npending || rcu_dereference_bh_nfnl(map->table)->deleted;
+}
+
+/* Merge the pending changes after the adds and deletes */
+static void
+mtype_merge(struct work_struct *work)
+{
+	struct itype *map = container_of(to_delayed_work(work),
+					 struct itype, merge);
+
+	mutex_lock(&map->rebuild_lock);
+	if (mtype_rebuild_needed(map->set))
+		mtype_rebuild(map->set);
+	mutex_unlock(&map->rebuild_lock);
+}
+
+/* Whether any element is timed out */
+static bool
+mtype_expired(struct ip_set *set)
+{
+	struct itype *map = set->data;
+	struct interval_table *t;
+	struct mtype_elem *e;
+	struct rb_node *n;
+	bool expired = false;
+	u32 k;
+
+	read_lock_bh(&set->lock);
+	t = rcu_dereference_bh_nfnl(map->table);
+	for (k = 1; k <= t->size && !expired; k++) {
+		e = interval_elem(t, k, set->dsize);
+		expired = !e->deleted &&
+			  ip_set_timeout_expired(ext_timeout(e, set), set);
+	}
+	for (n = rb_first(&map->pending); n && !expired; n = rb_next(n)) {
+		e = &rb_entry(n, struct mtype_node, node)->e;
+		expired = ip_set_timeout_expired(ext_timeout(e, set), set);
+	}
+	read_unlock_bh(&set->lock);
+
+	return expired;
+}
+
+/* Drop the timed out elements by rebuilding the table */
+static void
+mtype_gc(struct work_struct *work)
+{
+	struct itype *map = container_of(to_delayed_work(work),
+					 struct itype, gc);
+	struct ip_set *set = map->set;
+	ktime_t start = ip_set_stats_start(set);
+
+	mutex_lock(&map->rebuild_lock);
+	if (mtype_rebuild_needed(set) || mtype_expired(set))
+		mtype_rebuild(set);
+	mutex_unlock(&map->rebuild_lock);
+	ip_set_stats_inc(set, gc_runs);
+	ip_set_stats_time(set, gc_time, start);
+
+	schedule_delayed_work(&map->gc, IPSET_GC_PERIOD(set->timeout) * HZ);
+}
+
+static void
+mtype_gc_init(struct ip_set *set)
+{
+	struct itype *map = set->data;
+
+	INIT_DELAYED_WORK(&map->gc, mtype_gc);
+	schedule_delayed_work(&map->gc, IPSET_GC_PERIOD(set->timeout) * HZ);
+}
+
+/* Too many adds are pending: merge them into a new table */
+static int
+mtype_resize(struct ip_set *set, bool retried)
+{
+	struct itype *map = set->data;
+	int ret;
+
+	mutex_lock(&map->rebuild_lock);
+	ret = mtype_rebuild(set);
+	mutex_unlock(&map->rebuild_lock);
+
+	return ret;
+}
+
+/* Flush an interval type of set: the elements are marked deleted and
+ * the empty table is built by the worker */
+static void
+mtype_flush(struct ip_set *set)
+{
+	struct itype *map = set->data;
+	struct interval_table *t = rcu_dereference_bh_nfnl(map->table);
+	struct mtype_elem *e;
+	u32 k;
+
+	for (k = 1; k <= t->size; k++) {
+		e = interval_elem(t, k, set->dsize);
+		if (!e->deleted)
+			mtype_elem_del(set, t, e);
+	}
+	mtype_pending_flush(set);
+}
+
+/* Destroy an interval type of set */
+static void
+mtype_destroy(struct ip_set *set)
+{
+	struct itype *map = set->data;
+
+	if (SET_WITH_TIMEOUT(set))
+		cancel_delayed_work_sync(&map->gc);
+	cancel_delayed_work_sync(&map->merge);
+
+	mtype_pending_flush(set);
+	mtype_table_free(set, rcu_dereference_bh_nfnl(map->table), true);
+	kfree(map);
+
+	set->data = NULL;
+}
+
+static bool
+mtype_same_set(const struct ip_set *a, const struct ip_set *b)
+{
+	const struct itype *x = a->data;
+	const struct itype *y = b->data;
+
+	return x->maxelem == y->maxelem &&
+	       a->timeout == b->timeout &&
+	       a->extensions == b->extensions;
+}
+
+/* Reply a HEADER request: fill out the header part of the set */
+static int
+mtype_head(struct ip_set *set, struct sk_buff *skb)
+{
+	const struct itype *map = set->data;
+	const struct interval_table *t;
+	struct nlattr *nested;
+	size_t memsize;
+	u32 elements;
+
+	rcu_read_lock_bh();
+	t = rcu_dereference_bh(map->table);
+	memsize = sizeof(*map) + t->memsize +
+		  map->npending * (offsetof(struct mtype_node, e) +
+				   set->dsize) +
+		  ip_set_comment_memsize(set);
+	elements = t->size - t->deleted + map->npending;
+	rcu_read_unlock_bh();
+
+	nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
+	if (!nested)
+		goto nla_put_failure;
+	if (nla_put_net32(skb, IPSET_ATTR_MAXELEM, htonl(map->maxelem)) ||
+	    nla_put_net32(skb, IPSET_ATTR_ELEMENTS, htonl(elements)) ||
+	    nla_put_net32(skb, IPSET_ATTR_REFERENCES, htonl(set->ref - 1)) ||
+	    nla_put_net32(skb, IPSET_ATTR_MEMSIZE, htonl(memsize)))
+		goto nla_put_failure;
+	if (unlikely(ip_set_put_flags(skb, set) ||
+		     ip_set_put_stats(skb, set)))
+		goto nla_put_failure;
+	ipset_nest_end(skb, nested);
+
+	return 0;
+nla_put_failure:
+	return -EMSGSIZE;
+}
+
+/* Pin the table for listing, or release it. The pending changes are
+ * merged first, so that all elements are listed from the table. */
+static int
+mtype_uref(struct ip_set *set, struct netlink_callback *cb, bool start)
+{
+	struct itype *map = set->data;
+	struct interval_table *t;
+	int ret = 0;
+
+	if (!start) {
+		t = (struct interval_table *)cb->args[IPSET_CB_ARG1];
+		if (!t)
+			return 0;
+		cb->args[IPSET_CB_ARG1] = 0;
+		if (atomic_dec_and_test(&t->uref) && t->retired) {
+			pr_debug("set %s listed from %u (%p) destroyed\n",
+				 set->name, t->size, t);
+			mtype_table_free(set, t, true);
+		}
+		return 0;
+	}
+
+	cb->args[IPSET_CB_ARG1] = 0;
+	mutex_lock(&map->rebuild_lock);
+	if (mtype_rebuild_needed(set))
+		ret = mtype_rebuild(set);
+	if (!ret) {
+		t = rcu_dereference_bh_nfnl(map->table);
+		atomic_inc(&t->uref);
+		cb->args[IPSET_CB_ARG1] = (unsigned long)t;
+	}
+	mutex_unlock(&map->rebuild_lock);
+
+	return ret;
+}
+
+/* Reply a LIST/SAVE request: dump the elements of the table pinned by
+ * mtype_uref in order. cb->args[IPSET_CB_ARG0] is the position of the
+ * next element. The table of the set is read with the set read-locked,
+ * a replaced table is not modified anymore and is read without locking. */
+static int
+mtype_list(struct ip_set *set,
+	   struct sk_buff *skb, struct netlink_callback *cb)
+{
+	const struct interval_table *t =
+		(const struct interval_table *)cb->args[IPSET_CB_ARG1];
+	struct nlattr *atd, *nested;
+	const struct mtype_elem *e;
+	u32 listed = 0;
+	bool locked;
+
+	atd = ipset_nest_start(skb, IPSET_ATTR_ADT);
+	if (!atd)
+		return -EMSGSIZE;
+	pr_debug("list interval set %s\n", set->name);
+	if (!cb->args[IPSET_CB_ARG0])
+		cb->args[IPSET_CB_ARG0] = interval_first(t->size);
+	locked = !ACCESS_ONCE(t->retired);
+	if (locked)
+		read_lock_bh(&set->lock);
+	for (; cb->args[IPSET_CB_ARG0];
+	     cb->args[IPSET_CB_ARG0] = interval_next(cb->args[IPSET_CB_ARG0],
+						      t->size)) {
+		e = interval_elem(t, cb->args[IPSET_CB_ARG0], set->dsize);
+		if (!mtype_live(set, e))
+			continue;
+		nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
+		if (!nested)
+			goto nla_put_failure;
+		if (mtype_data_list(skb, e) ||
+		    ip_set_put_extensions(skb, set, e, true)) {
+			nla_nest_cancel(skb, nested);
+			goto nla_put_failure;
+		}
+		ipset_nest_end(skb, nested);
+		listed++;
+	}
+	if (locked)
+		read_unlock_bh(&set->lock);
+	ipset_nest_end(skb, atd);
+	/* Set listing finished */
+	cb->args[IPSET_CB_ARG0] = 0;
+
+	return 0;
+
+nla_put_failure:
+	if (locked)
+		read_unlock_bh(&set->lock);
+	if (unlikely(!listed)) {
+		pr_warning("Can't list set %s: one element does not fit into "
+			   "a message. Please report it!\n", set->name);
+		nla_nest_cancel(skb, atd);
+		cb->args[IPSET_CB_ARG0] = 0;
+		return -EMSGSIZE;
+	}
+	/* Continue with the element in the next message */
+	ipset_nest_end(skb, atd);
+	return 0;
+}
+
+static int
+IPSET_TOKEN(MTYPE, _kadt)(struct ip_set *set, const struct sk_buff *skb,
+	    const struct xt_action_param *par,
+	    enum ipset_adt adt, struct ip_set_adt_opt *opt);
+
+static int
+IPSET_TOKEN(MTYPE, _uadt)(struct ip_set *set, struct nlattr *tb[],
+	    enum ipset_adt adt, u32 *lineno, u32 flags, bool retried);
+
+static const struct ip_set_type_variant mtype_variant = {
+	.kadt	= mtype_kadt,
+	.uadt	= mtype_uadt,
+	.adt	= {
+		[IPSET_ADD] = mtype_add,
+		[IPSET_DEL] = mtype_del,
+		[IPSET_TEST] = mtype_test,
+	},
+	.destroy = mtype_destroy,
+	.flush	= mtype_flush,
+	.head	= mtype_head,
+	.list	= mtype_list,
+	.uref	= mtype_uref,
+	.resize	= mtype_resize,
+	.compact = mtype_resize,
+	.same_set = mtype_same_set,
+};
+
+#ifdef IP_SET_EMIT_CREATE
+static int
+IPSET_TOKEN(ITYPE, _create)(struct net *net, struct ip_set *set,
+			    struct nlattr *tb[], u32 flags)
+{
+	u32 maxelem = IPSET_INTERVAL_DEFAULT_MAXELEM;
+	struct ITYPE *map;
+	struct interval_table *t;
+	size_t ksize;
+
+	if (!(set->family == NFPROTO_IPV4 || set->family == NFPROTO_IPV6))
+		return -IPSET_ERR_INVALID_FAMILY;
+
+	if (unlikely(!ip_set_optattr_netorder(tb, IPSET_ATTR_MAXELEM) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_TIMEOUT) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_CADT_FLAGS)))
+		return -IPSET_ERR_PROTOCOL;
+
+	if (tb[IPSET_ATTR_MAXELEM])
+		maxelem = ip_set_get_h32(tb[IPSET_ATTR_MAXELEM]);
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return -ENOMEM;
+
+	map->maxelem = maxelem;
+	map->pending = RB_ROOT;
+	mutex_init(&map->rebuild_lock);
+	set->timeout = IPSET_NO_TIMEOUT;
+	set->data = map;
+	map->set = set;
+	if (set->family == NFPROTO_IPV4) {
+		INIT_DELAYED_WORK(&map->merge, IPSET_TOKEN(ITYPE, 4_merge));
+		set->variant = &IPSET_TOKEN(ITYPE, 4_variant);
+		set->dsize = ip_set_elem_len(set, tb,
+				sizeof(struct IPSET_TOKEN(ITYPE, 4_elem)));
+		ksize = sizeof(struct IPSET_TOKEN(ITYPE, 4_key));
+	} else {
+		INIT_DELAYED_WORK(&map->merge, IPSET_TOKEN(ITYPE, 6_merge));
+		set->variant = &IPSET_TOKEN(ITYPE, 6_variant);
+		set->dsize = ip_set_elem_len(set, tb,
+				sizeof(struct IPSET_TOKEN(ITYPE, 6_elem)));
+		ksize = sizeof(struct IPSET_TOKEN(ITYPE, 6_key));
+	}
+
+	t = interval_table_alloc(0, ksize, set->dsize);
+	if (!t) {
+		kfree(map);
+		set->data = NULL;
+		return -ENOMEM;
+	}
+	rcu_assign_pointer(map->table, t);
+
+	if (tb[IPSET_ATTR_TIMEOUT]) {
+		set->timeout = ip_set_timeout_uget(tb[IPSET_ATTR_TIMEOUT]);
+		if (set->family == NFPROTO_IPV4)
+			IPSET_TOKEN(ITYPE, 4_gc_init)(set);
+		else
+			IPSET_TOKEN(ITYPE, 6_gc_init)(set);
+	}
+
+	pr_debug("create %s maxelem %u: %p(%p)\n",
+		 set->name, map->maxelem, set->data, t);
+
+	return 0;
+}
+#endif /* IP_SET_EMIT_CREATE */
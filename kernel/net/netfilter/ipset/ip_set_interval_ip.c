@@ -0,0 +1,308 @@
+/* Copyright (C) 2013 Jozsef Kadlecsik <kadlec@blackhole.kfki.hu>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/* Kernel module implementing an IP set type: the interval:ip type */
+
+#include <linux/module.h>
+#include <linux/ip.h>
+#include <linux/skbuff.h>
+#include <linux/errno.h>
+#include <net/ip.h>
+#include <net/ipv6.h>
+#include <net/netlink.h>
+
+#include <linux/netfilter.h>
+#include <linux/netfilter/ipset/pfxlen.h>
+#include <linux/netfilter/ipset/ip_set.h>
+#include <linux/netfilter/ipset/ip_set_interval.h>
+
+#define IPSET_TYPE_REV_MIN	0
+#define IPSET_TYPE_REV_MAX	0
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Jozsef Kadlecsik <kadlec@blackhole.kfki.hu>");
+IP_SET_MODULE_DESC("interval:ip", IPSET_TYPE_REV_MIN, IPSET_TYPE_REV_MAX);
+MODULE_ALIAS("ip_set_interval:ip");
+
+/* Type specific function prefix */
+#define ITYPE		interval_ip
+
+/* IPv4 variant */
+
+/* The addresses are compared in host order */
+struct interval_ip4_key {
+	u32 ip;
+};
+
+static inline bool
+interval_ip4_key_le(const struct interval_ip4_key *k1,
+		    const struct interval_ip4_key *k2)
+{
+	return k1->ip <= k2->ip;
+}
+
+static inline bool
+interval_ip4_key_eq(const struct interval_ip4_key *k1,
+		    const struct interval_ip4_key *k2)
+{
+	return k1->ip == k2->ip;
+}
+
+#define MTYPE		interval_ip4
+#include "ip_set_interval_gen.h"
+
+static inline bool
+interval_ip4_data_list(struct sk_buff *skb, const struct interval_ip4_elem *e)
+{
+	if (nla_put_ipaddr4(skb, IPSET_ATTR_IP, htonl(e->from.ip)) ||
+	    (e->to.ip != e->from.ip &&
+	     nla_put_ipaddr4(skb, IPSET_ATTR_IP_TO, htonl(e->to.ip))))
+		goto nla_put_failure;
+	return 0;
+
+nla_put_failure:
+	return 1;
+}
+
+static int
+interval_ip4_kadt(struct ip_set *set, const struct sk_buff *skb,
+		  const struct xt_action_param *par,
+		  enum ipset_adt adt, struct ip_set_adt_opt *opt)
+{
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct interval_ip4_elem e = {};
+	struct ip_set_ext ext = IP_SET_INIT_KEXT(skb, opt, set);
+	__be32 ip;
+
+	ip4addrptr(skb, opt->flags & IPSET_DIM_ONE_SRC, &ip);
+	e.from.ip = e.to.ip = ntohl(ip);
+
+	return adtfn(set, &e, &ext, &opt->ext, opt->cmdflags);
+}
+
+static int
+interval_ip4_uadt(struct ip_set *set, struct nlattr *tb[],
+		  enum ipset_adt adt, u32 *lineno, u32 flags, bool retried)
+{
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct interval_ip4_elem e = {};
+	struct ip_set_ext ext = IP_SET_INIT_UEXT(set);
+	u32 ip = 0, ip_to = 0;
+	int ret;
+
+	if (unlikely(!tb[IPSET_ATTR_IP] ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_TIMEOUT) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_PACKETS) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_BYTES)))
+		return -IPSET_ERR_PROTOCOL;
+
+	if (tb[IPSET_ATTR_LINENO])
+		*lineno = nla_get_u32(tb[IPSET_ATTR_LINENO]);
+
+	ret = ip_set_get_hostipaddr4(tb[IPSET_ATTR_IP], &ip) ||
+	      ip_set_get_extensions(set, tb, &ext);
+	if (ret)
+		return ret;
+
+	ip_to = ip;
+	if (tb[IPSET_ATTR_IP_TO]) {
+		ret = ip_set_get_hostipaddr4(tb[IPSET_ATTR_IP_TO], &ip_to);
+		if (ret)
+			return ret;
+		if (ip > ip_to)
+			swap(ip, ip_to);
+	} else if (tb[IPSET_ATTR_CIDR]) {
+		u8 cidr = nla_get_u8(tb[IPSET_ATTR_CIDR]);
+
+		if (!cidr || cidr > 32)
+			return -IPSET_ERR_INVALID_CIDR;
+		ip_set_mask_from_to(ip, ip_to, cidr);
+	}
+	e.from.ip = ip;
+	e.to.ip = ip_to;
+
+	ret = adtfn(set, &e, &ext, &ext, flags);
+
+	return ip_set_eexist(ret, flags) ? 0 : ret;
+}
+
+/* IPv6 variant */
+
+/* The addresses are compared in host order, as two halves */
+struct interval_ip6_key {
+	u64 hi;
+	u64 lo;
+};
+
+static inline bool
+interval_ip6_key_le(const struct interval_ip6_key *k1,
+		    const struct interval_ip6_key *k2)
+{
+	return k1->hi < k2->hi || (k1->hi == k2->hi && k1->lo <= k2->lo);
+}
+
+static inline bool
+interval_ip6_key_eq(const struct interval_ip6_key *k1,
+		    const struct interval_ip6_key *k2)
+{
+	return k1->hi == k2->hi && k1->lo == k2->lo;
+}
+
+static inline void
+interval_ip6_key_set(struct interval_ip6_key *k, const union nf_inet_addr *ip)
+{
+	k->hi = (u64)ntohl(ip->ip6[0]) << 32 | ntohl(ip->ip6[1]);
+	k->lo = (u64)ntohl(ip->ip6[2]) << 32 | ntohl(ip->ip6[3]);
+}
+
+static inline void
+interval_ip6_key_get(union nf_inet_addr *ip, const struct interval_ip6_key *k)
+{
+	ip->ip6[0] = htonl(k->hi >> 32);
+	ip->ip6[1] = htonl((u32)k->hi);
+	ip->ip6[2] = htonl(k->lo >> 32);
+	ip->ip6[3] = htonl((u32)k->lo);
+}
+
+#undef MTYPE
+
+#define MTYPE		interval_ip6
+
+#define IP_SET_EMIT_CREATE
+#include "ip_set_interval_gen.h"
+
+static inline bool
+interval_ip6_data_list(struct sk_buff *skb, const struct interval_ip6_elem *e)
+{
+	union nf_inet_addr ip;
+
+	interval_ip6_key_get(&ip, &e->from);
+	if (nla_put_ipaddr6(skb, IPSET_ATTR_IP, &ip.in6))
+		goto nla_put_failure;
+	if (!interval_ip6_key_eq(&e->to, &e->from)) {
+		interval_ip6_key_get(&ip, &e->to);
+		if (nla_put_ipaddr6(skb, IPSET_ATTR_IP_TO, &ip.in6))
+			goto nla_put_failure;
+	}
+	return 0;
+
+nla_put_failure:
+	return 1;
+}
+
+static int
+interval_ip6_kadt(struct ip_set *set, const struct sk_buff *skb,
+		  const struct xt_action_param *par,
+		  enum ipset_adt adt, struct ip_set_adt_opt *opt)
+{
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct interval_ip6_elem e = {};
+	struct ip_set_ext ext = IP_SET_INIT_KEXT(skb, opt, set);
+	union nf_inet_addr ip;
+
+	ip6addrptr(skb, opt->flags & IPSET_DIM_ONE_SRC, &ip.in6);
+	interval_ip6_key_set(&e.from, &ip);
+	e.to = e.from;
+
+	return adtfn(set, &e, &ext, &opt->ext, opt->cmdflags);
+}
+
+static int
+interval_ip6_uadt(struct ip_set *set, struct nlattr *tb[],
+		  enum ipset_adt adt, u32 *lineno, u32 flags, bool retried)
+{
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct interval_ip6_elem e = {};
+	struct ip_set_ext ext = IP_SET_INIT_UEXT(set);
+	union nf_inet_addr ip, ip_to;
+	int ret;
+
+	if (unlikely(!tb[IPSET_ATTR_IP] ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_TIMEOUT) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_PACKETS) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_BYTES)))
+		return -IPSET_ERR_PROTOCOL;
+
+	if (tb[IPSET_ATTR_LINENO])
+		*lineno = nla_get_u32(tb[IPSET_ATTR_LINENO]);
+
+	ret = ip_set_get_ipaddr6(tb[IPSET_ATTR_IP], &ip) ||
+	      ip_set_get_extensions(set, tb, &ext);
+	if (ret)
+		return ret;
+
+	interval_ip6_key_set(&e.from, &ip);
+	e.to = e.from;
+	if (tb[IPSET_ATTR_IP_TO]) {
+		ret = ip_set_get_ipaddr6(tb[IPSET_ATTR_IP_TO], &ip_to);
+		if (ret)
+			return ret;
+		interval_ip6_key_set(&e.to, &ip_to);
+		if (!interval_ip6_key_le(&e.from, &e.to))
+			swap(e.from, e.to);
+	} else if (tb[IPSET_ATTR_CIDR]) {
+		u8 cidr = nla_get_u8(tb[IPSET_ATTR_CIDR]);
+		const __be32 *mask;
+
+		if (!cidr || cidr > 128)
+			return -IPSET_ERR_INVALID_CIDR;
+		mask = ip_set_netmask6(cidr);
+		ip6_netmask(&ip, cidr);
+		interval_ip6_key_set(&e.from, &ip);
+		ip.ip6[0] |= ~mask[0];
+		ip.ip6[1] |= ~mask[1];
+		ip.ip6[2] |= ~mask[2];
+		ip.ip6[3] |= ~mask[3];
+		interval_ip6_key_set(&e.to, &ip);
+	}
+
+	ret = adtfn(set, &e, &ext, &ext, flags);
+
+	return ip_set_eexist(ret, flags) ? 0 : ret;
+}
+
+static struct ip_set_type interval_ip_type __read_mostly = {
+	.name		= "interval:ip",
+	.protocol	= IPSET_PROTOCOL,
+	.features	= IPSET_TYPE_IP,
+	.dimension	= IPSET_DIM_ONE,
+	.family		= NFPROTO_UNSPEC,
+	.revision_min	= IPSET_TYPE_REV_MIN,
+	.revision_max	= IPSET_TYPE_REV_MAX,
+	.create		= interval_ip_create,
+	.create_policy	= {
+		[IPSET_ATTR_MAXELEM]	= { .type = NLA_U32 },
+		[IPSET_ATTR_TIMEOUT]	= { .type = NLA_U32 },
+		[IPSET_ATTR_CADT_FLAGS]	= { .type = NLA_U32 },
+	},
+	.adt_policy	= {
+		[IPSET_ATTR_IP]		= { .type = NLA_NESTED },
+		[IPSET_ATTR_IP_TO]	= { .type = NLA_NESTED },
+		[IPSET_ATTR_CIDR]	= { .type = NLA_U8 },
+		[IPSET_ATTR_TIMEOUT]	= { .type = NLA_U32 },
+		[IPSET_ATTR_LINENO]	= { .type = NLA_U32 },
+		[IPSET_ATTR_BYTES]	= { .type = NLA_U64 },
+		[IPSET_ATTR_PACKETS]	= { .type = NLA_U64 },
+		[IPSET_ATTR_COMMENT]	= { .type = NLA_NUL_STRING },
+	},
+	.me		= THIS_MODULE,
+};
+
+static int __init
+interval_ip_init(void)
+{
+	return ip_set_type_register(&interval_ip_type);
+}
+
+static void __exit
+interval_ip_fini(void)
+{
+	ip_set_type_unregister(&interval_ip_type);
+}
+
+module_init(interval_ip_init);
+module_exit(interval_ip_fini);
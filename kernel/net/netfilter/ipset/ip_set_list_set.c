@@ -17,7 +17,8 @@
 
 #define IPSET_TYPE_REV_MIN	0
 /*				1    Counters support added */
-#define IPSET_TYPE_REV_MAX	2 /* Comments support added */
+/*				2	   Comments support added */
+#define IPSET_TYPE_REV_MAX	3 /* Per-CPU counters support added */
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Jozsef Kadlecsik <kadlec@blackhole.kfki.hu>");
@@ -65,12 +66,12 @@ list_set_ktest(struct ip_set *set, const struct sk_buff *skb,
 		if (e->id == IPSET_INVALID_ID)
 			return 0;
 		if (SET_WITH_TIMEOUT(set) &&
-		    ip_set_timeout_expired(ext_timeout(e, set)))
+		    ip_set_timeout_expired(ext_timeout(e, set), set))
 			continue;
 		ret = ip_set_test(e->id, skb, par, opt);
 		if (ret > 0) {
 			if (SET_WITH_COUNTER(set))
-				ip_set_update_counter(ext_counter(e, set),
+				ip_set_update_counter(set, ext_counter(e, set),
 						      ext, &opt->ext,
 						      cmdflags);
 			return ret;
@@ -94,7 +95,7 @@ list_set_kadd(struct ip_set *set, const struct sk_buff *skb,
 		if (e->id == IPSET_INVALID_ID)
 			return 0;
 		if (SET_WITH_TIMEOUT(set) &&
-		    ip_set_timeout_expired(ext_timeout(e, set)))
+		    ip_set_timeout_expired(ext_timeout(e, set), set))
 			continue;
 		ret = ip_set_add(e->id, skb, par, opt);
 		if (ret == 0)
@@ -118,7 +119,7 @@ list_set_kdel(struct ip_set *set, const struct sk_buff *skb,
 		if (e->id == IPSET_INVALID_ID)
 			return 0;
 		if (SET_WITH_TIMEOUT(set) &&
-		    ip_set_timeout_expired(ext_timeout(e, set)))
+		    ip_set_timeout_expired(ext_timeout(e, set), set))
 			continue;
 		ret = ip_set_del(e->id, skb, par, opt);
 		if (ret == 0)
@@ -159,7 +160,7 @@ id_eq(const struct ip_set *set, u32 i, ip_set_id_t id)
 	e = list_set_elem(set, map, i);
 	return !!(e->id == id &&
 		 !(SET_WITH_TIMEOUT(set) &&
-		   ip_set_timeout_expired(ext_timeout(e, set))));
+		   ip_set_timeout_expired(ext_timeout(e, set), set)));
 }
 
 static int
@@ -192,11 +193,11 @@ list_set_add(struct ip_set *set, u32 i, struct set_adt_elem *d,
 
 	e->id = d->id;
 	if (SET_WITH_TIMEOUT(set))
-		ip_set_timeout_set(ext_timeout(e, set), ext->timeout);
+		ip_set_timeout_set(ext_timeout(e, set), ext->timeout, set);
 	if (SET_WITH_COUNTER(set))
-		ip_set_init_counter(ext_counter(e, set), ext);
+		ip_set_init_counter(set, ext_counter(e, set), ext);
 	if (SET_WITH_COMMENT(set))
-		ip_set_init_comment(ext_comment(e, set), ext);
+		ip_set_init_comment(set, ext_comment(e, set), ext);
 	return 0;
 }
 
@@ -229,7 +230,7 @@ set_cleanup_entries(struct ip_set *set)
 	while (i < map->size) {
 		e = list_set_elem(set, map, i);
 		if (e->id != IPSET_INVALID_ID &&
-		    ip_set_timeout_expired(ext_timeout(e, set)))
+		    ip_set_timeout_expired(ext_timeout(e, set), set))
 			list_set_del(set, i);
 			/* Check element moved to position i in next loop */
 		else
@@ -252,7 +253,7 @@ list_set_utest(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 		if (e->id == IPSET_INVALID_ID)
 			return 0;
 		else if (SET_WITH_TIMEOUT(set) &&
-			 ip_set_timeout_expired(ext_timeout(e, set)))
+			 ip_set_timeout_expired(ext_timeout(e, set), set))
 			continue;
 		else if (e->id != d->id)
 			continue;
@@ -302,11 +303,11 @@ list_set_uadd(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 		ip_set_ext_destroy(set, e);
 
 		if (SET_WITH_TIMEOUT(set))
-			ip_set_timeout_set(ext_timeout(e, set), ext->timeout);
+			ip_set_timeout_set(ext_timeout(e, set), ext->timeout, set);
 		if (SET_WITH_COUNTER(set))
-			ip_set_init_counter(ext_counter(e, set), ext);
+			ip_set_init_counter(set, ext_counter(e, set), ext);
 		if (SET_WITH_COMMENT(set))
-			ip_set_init_comment(ext_comment(e, set), ext);
+			ip_set_init_comment(set, ext_comment(e, set), ext);
 		/* Set is already added to the list */
 		ip_set_put_byindex(map->net, d->id);
 		return 0;
@@ -344,7 +345,7 @@ list_set_udel(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 			return d->before != 0 ? -IPSET_ERR_REF_EXIST
 					      : -IPSET_ERR_EXIST;
 		else if (SET_WITH_TIMEOUT(set) &&
-			 ip_set_timeout_expired(ext_timeout(e, set)))
+			 ip_set_timeout_expired(ext_timeout(e, set), set))
 			continue;
 		else if (e->id != d->id)
 			continue;
@@ -466,16 +467,25 @@ list_set_head(struct ip_set *set, struct sk_buff *skb)
 {
 	const struct list_set *map = set->data;
 	struct nlattr *nested;
+	u32 n;
+
+	/* The members are stored from the beginning of the array */
+	for (n = 0; n < map->size; n++)
+		if (list_set_elem(set, map, n)->id == IPSET_INVALID_ID)
+			break;
 
 	nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
 	if (!nested)
 		goto nla_put_failure;
 	if (nla_put_net32(skb, IPSET_ATTR_SIZE, htonl(map->size)) ||
+	    nla_put_net32(skb, IPSET_ATTR_ELEMENTS, htonl(n)) ||
 	    nla_put_net32(skb, IPSET_ATTR_REFERENCES, htonl(set->ref - 1)) ||
 	    nla_put_net32(skb, IPSET_ATTR_MEMSIZE,
-			  htonl(sizeof(*map) + map->size * set->dsize)))
+			  htonl(sizeof(*map) + map->size * set->dsize +
+				ip_set_comment_memsize(set))))
 		goto nla_put_failure;
-	if (unlikely(ip_set_put_flags(skb, set)))
+	if (unlikely(ip_set_put_flags(skb, set) ||
+		     ip_set_put_stats(skb, set)))
 		goto nla_put_failure;
 	ipset_nest_end(skb, nested);
 
@@ -485,7 +495,7 @@ nla_put_failure:
 }
 
 static int
-list_set_list(const struct ip_set *set,
+list_set_list(struct ip_set *set,
 	      struct sk_buff *skb, struct netlink_callback *cb)
 {
 	const struct list_set *map = set->data;
@@ -503,7 +513,7 @@ list_set_list(const struct ip_set *set,
 		if (e->id == IPSET_INVALID_ID)
 			goto finish;
 		if (SET_WITH_TIMEOUT(set) &&
-		    ip_set_timeout_expired(ext_timeout(e, set)))
+		    ip_set_timeout_expired(ext_timeout(e, set), set))
 			continue;
 		nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
 		if (!nested) {
@@ -55,10 +55,16 @@ struct ipset_data {
 			uint32_t maxelem;
 			uint32_t gc;
 			uint32_t size;
+			uint32_t expect;
 			/* Filled out by kernel */
 			uint32_t references;
 			uint32_t elements;
 			uint32_t memsize;
+			uint64_t evicted;
+			uint64_t add_failed;
+			uint64_t bucket_allocs;
+			uint64_t bucket_frees;
+			uint64_t stats[IPSET_ATTR_STATS_MAX + 1];
 			char typename[IPSET_MAXNAMELEN];
 			uint8_t revision_min;
 			uint8_t revision;
@@ -295,12 +301,33 @@ ipset_data_set(struct ipset_data *data, enum ipset_opt opt, const void *value)
 	case IPSET_OPT_SIZE:
 		data->create.size = *(const uint32_t *) value;
 		break;
+	case IPSET_OPT_EXPECT:
+		data->create.expect = *(const uint32_t *) value;
+		break;
 	case IPSET_OPT_COUNTERS:
 		cadt_flag_type_attr(data, opt, IPSET_FLAG_WITH_COUNTERS);
 		break;
 	case IPSET_OPT_CREATE_COMMENT:
 		cadt_flag_type_attr(data, opt, IPSET_FLAG_WITH_COMMENT);
 		break;
+	case IPSET_OPT_LPM:
+		cadt_flag_type_attr(data, opt, IPSET_FLAG_WITH_LPM);
+		break;
+	case IPSET_OPT_BLOOM:
+		cadt_flag_type_attr(data, opt, IPSET_FLAG_WITH_BLOOM);
+		break;
+	case IPSET_OPT_EVICT:
+		cadt_flag_type_attr(data, opt, IPSET_FLAG_WITH_EVICT);
+		break;
+	case IPSET_OPT_PCPU_COUNTERS:
+		cadt_flag_type_attr(data, opt, IPSET_FLAG_WITH_PCPU_COUNTERS);
+		break;
+	case IPSET_OPT_CACHE:
+		cadt_flag_type_attr(data, opt, IPSET_FLAG_WITH_CACHE);
+		break;
+	case IPSET_OPT_REPLICAS:
+		cadt_flag_type_attr(data, opt, IPSET_FLAG_WITH_REPLICAS);
+		break;
 	/* Create-specific options, filled out by the kernel */
 	case IPSET_OPT_ELEMENTS:
 		data->create.elements = *(const uint32_t *) value;
@@ -311,6 +338,21 @@ ipset_data_set(struct ipset_data *data, enum ipset_opt opt, const void *value)
 	case IPSET_OPT_MEMSIZE:
 		data->create.memsize = *(const uint32_t *) value;
 		break;
+	case IPSET_OPT_EVICTED:
+		data->create.evicted = *(const uint64_t *) value;
+		break;
+	case IPSET_OPT_ADD_FAILED:
+		data->create.add_failed = *(const uint64_t *) value;
+		break;
+	case IPSET_OPT_BUCKET_ALLOCS:
+		data->create.bucket_allocs = *(const uint64_t *) value;
+		break;
+	case IPSET_OPT_BUCKET_FREES:
+		data->create.bucket_frees = *(const uint64_t *) value;
+		break;
+	case IPSET_OPT_STATS:
+		memcpy(data->create.stats, value, sizeof(data->create.stats));
+		break;
 	/* Create-specific options, type */
 	case IPSET_OPT_TYPENAME:
 		ipset_strlcpy(data->create.typename, value,
@@ -400,6 +442,24 @@ ipset_data_set(struct ipset_data *data, enum ipset_opt opt, const void *value)
 		if (data->cadt_flags & IPSET_FLAG_WITH_COMMENT)
 			ipset_data_flags_set(data,
 					  IPSET_FLAG(IPSET_OPT_CREATE_COMMENT));
+		if (data->cadt_flags & IPSET_FLAG_WITH_LPM)
+			ipset_data_flags_set(data,
+					     IPSET_FLAG(IPSET_OPT_LPM));
+		if (data->cadt_flags & IPSET_FLAG_WITH_BLOOM)
+			ipset_data_flags_set(data,
+					     IPSET_FLAG(IPSET_OPT_BLOOM));
+		if (data->cadt_flags & IPSET_FLAG_WITH_EVICT)
+			ipset_data_flags_set(data,
+					     IPSET_FLAG(IPSET_OPT_EVICT));
+		if (data->cadt_flags & IPSET_FLAG_WITH_PCPU_COUNTERS)
+			ipset_data_flags_set(data,
+				IPSET_FLAG(IPSET_OPT_PCPU_COUNTERS));
+		if (data->cadt_flags & IPSET_FLAG_WITH_CACHE)
+			ipset_data_flags_set(data,
+					     IPSET_FLAG(IPSET_OPT_CACHE));
+		if (data->cadt_flags & IPSET_FLAG_WITH_REPLICAS)
+			ipset_data_flags_set(data,
+					     IPSET_FLAG(IPSET_OPT_REPLICAS));
 		break;
 	default:
 		return -1;
@@ -469,6 +529,8 @@ ipset_data_get(const struct ipset_data *data, enum ipset_opt opt)
 		return &data->create.resize;
 	case IPSET_OPT_SIZE:
 		return &data->create.size;
+	case IPSET_OPT_EXPECT:
+		return &data->create.expect;
 	/* Create-specific options, filled out by the kernel */
 	case IPSET_OPT_ELEMENTS:
 		return &data->create.elements;
@@ -476,6 +538,16 @@ ipset_data_get(const struct ipset_data *data, enum ipset_opt opt)
 		return &data->create.references;
 	case IPSET_OPT_MEMSIZE:
 		return &data->create.memsize;
+	case IPSET_OPT_EVICTED:
+		return &data->create.evicted;
+	case IPSET_OPT_ADD_FAILED:
+		return &data->create.add_failed;
+	case IPSET_OPT_BUCKET_ALLOCS:
+		return &data->create.bucket_allocs;
+	case IPSET_OPT_BUCKET_FREES:
+		return &data->create.bucket_frees;
+	case IPSET_OPT_STATS:
+		return data->create.stats;
 	/* Create-specific options, TYPE */
 	case IPSET_OPT_REVISION:
 		return &data->create.revision;
@@ -517,6 +589,12 @@ ipset_data_get(const struct ipset_data *data, enum ipset_opt opt)
 	case IPSET_OPT_NOMATCH:
 	case IPSET_OPT_COUNTERS:
 	case IPSET_OPT_CREATE_COMMENT:
+	case IPSET_OPT_LPM:
+	case IPSET_OPT_BLOOM:
+	case IPSET_OPT_EVICT:
+	case IPSET_OPT_PCPU_COUNTERS:
+	case IPSET_OPT_CACHE:
+	case IPSET_OPT_REPLICAS:
 		return &data->cadt_flags;
 	default:
 		return NULL;
@@ -554,13 +632,20 @@ ipset_data_sizeof(enum ipset_opt opt, uint8_t family)
 	case IPSET_OPT_HASHSIZE:
 	case IPSET_OPT_MAXELEM:
 	case IPSET_OPT_SIZE:
+	case IPSET_OPT_EXPECT:
 	case IPSET_OPT_ELEMENTS:
 	case IPSET_OPT_REFERENCES:
 	case IPSET_OPT_MEMSIZE:
 		return sizeof(uint32_t);
 	case IPSET_OPT_PACKETS:
 	case IPSET_OPT_BYTES:
+	case IPSET_OPT_EVICTED:
+	case IPSET_OPT_ADD_FAILED:
+	case IPSET_OPT_BUCKET_ALLOCS:
+	case IPSET_OPT_BUCKET_FREES:
 		return sizeof(uint64_t);
+	case IPSET_OPT_STATS:
+		return (IPSET_ATTR_STATS_MAX + 1) * sizeof(uint64_t);
 	case IPSET_OPT_CIDR:
 	case IPSET_OPT_CIDR2:
 	case IPSET_OPT_NETMASK:
@@ -575,6 +660,12 @@ ipset_data_sizeof(enum ipset_opt opt, uint8_t family)
 	case IPSET_OPT_PHYSDEV:
 	case IPSET_OPT_NOMATCH:
 	case IPSET_OPT_COUNTERS:
+	case IPSET_OPT_LPM:
+	case IPSET_OPT_BLOOM:
+	case IPSET_OPT_EVICT:
+	case IPSET_OPT_PCPU_COUNTERS:
+	case IPSET_OPT_CACHE:
+	case IPSET_OPT_REPLICAS:
 		return sizeof(uint32_t);
 	case IPSET_OPT_ADT_COMMENT:
 		return IPSET_MAX_COMMENT_SIZE + 1;
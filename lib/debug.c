@@ -23,6 +23,7 @@ static const struct ipset_attrname cmdattr2name[] = {
 	[IPSET_ATTR_ADT]	= { .name = "ADT" },
 	[IPSET_ATTR_LINENO]	= { .name = "LINENO" },
 	[IPSET_ATTR_PROTOCOL_MIN] = { .name = "PROTO_MIN" },
+	[IPSET_ATTR_PACKED]	= { .name = "PACKED" },
 };
 
 static const struct ipset_attrname createattr2name[] = {
@@ -45,6 +46,12 @@ static const struct ipset_attrname createattr2name[] = {
 	[IPSET_ATTR_ELEMENTS]	= { .name = "ELEMENTS" },
 	[IPSET_ATTR_REFERENCES]	= { .name = "REFERENCES" },
 	[IPSET_ATTR_MEMSIZE]	= { .name = "MEMSIZE" },
+	[IPSET_ATTR_EVICTED]	= { .name = "EVICTED" },
+	[IPSET_ATTR_ADD_FAILED]	= { .name = "ADD_FAILED" },
+	[IPSET_ATTR_BUCKET_ALLOCS] = { .name = "BUCKET_ALLOCS" },
+	[IPSET_ATTR_BUCKET_FREES] = { .name = "BUCKET_FREES" },
+	[IPSET_ATTR_EXPECT]	= { .name = "EXPECT" },
+	[IPSET_ATTR_STATS]	= { .name = "STATS" },
 };
 
 static const struct ipset_attrname adtattr2name[] = {
@@ -222,6 +229,11 @@ debug_cmd_attrs(int cmd, struct nlattr *nla[])
 				}
 			}
 			break;
+		case MNL_TYPE_BINARY:
+			fprintf(stderr, "\t%s: %u bytes\n",
+				cmdattr2name[i].name,
+				mnl_attr_get_payload_len(nla[i]));
+			break;
 		default:
 			fprintf(stderr, "\t%s: unresolved!\n",
 				cmdattr2name[i].name);
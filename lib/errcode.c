@@ -16,6 +16,7 @@
 #include <libipset/errcode.h>			/* prototypes */
 #include <libipset/linux_ip_set_bitmap.h>	/* bitmap specific errcodes */
 #include <libipset/linux_ip_set_hash.h>		/* hash specific errcodes */
+#include <libipset/linux_ip_set_interval.h>	/* interval specific errcodes */
 #include <libipset/linux_ip_set_list.h>		/* list specific errcodes */
 
 /* Core kernel error codes */
@@ -58,18 +59,32 @@ static const struct ipset_errcode_table core_errcode_table[] = {
 	  "Sets cannot be swapped: the second set does not exist" },
 	{ IPSET_ERR_TYPE_MISMATCH, IPSET_CMD_SWAP,
 	  "The sets cannot be swapped: their type does not match" },
+	{ IPSET_ERR_BUSY, IPSET_CMD_SWAP,
+	  "The sets cannot be swapped: one of them is being listed" },
+
+	/* REPLACE/PUBLISH specific error codes */
+	{ IPSET_ERR_TYPE_MISMATCH, IPSET_CMD_REPLACE,
+	  "The set cannot be replaced: the type of the new content does not match" },
+	{ IPSET_ERR_BUSY, IPSET_CMD_PUBLISH,
+	  "The new content cannot be published: the set is being listed" },
+	{ IPSET_ERR_NO_SHADOW, 0,
+	  "The content of the set is not being replaced" },
 
 	/* LIST/SAVE specific error codes */
 
 	/* Generic (CADT) error codes */
 	{ IPSET_ERR_INVALID_CIDR, 0,
 	  "The value of the CIDR parameter of the IP address is invalid" },
+	{ IPSET_ERR_TIMEOUT, IPSET_CMD_CREATE,
+	  "Eviction cannot be used: set must be created with timeout support" },
 	{ IPSET_ERR_TIMEOUT, 0,
 	  "Timeout cannot be used: set was created without timeout support" },
 	{ IPSET_ERR_IPADDR_IPV4, 0,
 	  "An IPv4 address is expected, but not received" },
 	{ IPSET_ERR_IPADDR_IPV6, 0,
 	  "An IPv6 address is expected, but not received" },
+	{ IPSET_ERR_COUNTER, IPSET_CMD_CREATE,
+	  "Per-CPU counters are not supported by the kernel" },
 	{ IPSET_ERR_COUNTER, 0,
 	  "Packet/byte counters cannot be used: set was created without counter support" },
 	{ IPSET_ERR_COMMENT, 0,
@@ -103,6 +118,8 @@ static const struct ipset_errcode_table bitmap_errcode_table[] = {
 	  "Element is out of the range of the set" },
 	{ IPSET_ERR_BITMAP_RANGE_SIZE, IPSET_CMD_CREATE,
 	  "The range you specified exceeds the size limit of the set type" },
+	{ IPSET_ERR_BITMAP_FULL, 0,
+	  "The set is full, more elements with extensions cannot be added" },
 	{ },
 };
 
@@ -121,6 +138,18 @@ static const struct ipset_errcode_table hash_errcode_table[] = {
 	  "Range is not supported in the \"net\" component of the element" },
 	{ IPSET_ERR_HASH_RANGE, 0,
 	  "Invalid range, covers the whole address space" },
+	{ IPSET_ERR_HASH_REPLICAS, IPSET_CMD_CREATE,
+	  "Replicas cannot be used together with timeout" },
+	{ },
+};
+
+/* Interval type-specific error codes */
+static const struct ipset_errcode_table interval_errcode_table[] = {
+	/* Generic (CADT) error codes */
+	{ IPSET_ERR_INTERVAL_OVERLAP, 0,
+	  "The range overlaps an element of the set" },
+	{ IPSET_ERR_INTERVAL_FULL, 0,
+	  "The set is full, more elements cannot be added." },
 	{ },
 };
 
@@ -167,10 +196,13 @@ ipset_errcode(struct ipset_session *session, enum ipset_cmd cmd, int errcode)
 
 		type = ipset_saved_type(session);
 		if (type) {
-			if (MATCH_TYPENAME(type->name, "bitmap:"))
+			if (MATCH_TYPENAME(type->name, "bitmap:") ||
+			    MATCH_TYPENAME(type->name, "cbitmap:"))
 				table = bitmap_errcode_table;
 			else if (MATCH_TYPENAME(type->name, "hash:"))
 				table = hash_errcode_table;
+			else if (MATCH_TYPENAME(type->name, "interval:"))
+				table = interval_errcode_table;
 			else if (MATCH_TYPENAME(type->name, "list:"))
 				table = list_errcode_table;
 		}
@@ -47,6 +47,9 @@ static const uint16_t cmdflags[] = {
 	[IPSET_CMD_TEST-1]	= NLM_F_REQUEST|NLM_F_ACK,
 	[IPSET_CMD_HEADER-1]	= NLM_F_REQUEST,
 	[IPSET_CMD_TYPE-1]	= NLM_F_REQUEST,
+	[IPSET_CMD_COMPACT-1]	= NLM_F_REQUEST|NLM_F_ACK,
+	[IPSET_CMD_REPLACE-1]	= NLM_F_REQUEST|NLM_F_ACK,
+	[IPSET_CMD_PUBLISH-1]	= NLM_F_REQUEST|NLM_F_ACK,
 	[IPSET_CMD_PROTOCOL-1]	= NLM_F_REQUEST,
 };
 
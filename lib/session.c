@@ -39,10 +39,14 @@ struct ipset_session {
 	uint32_t lineno;			/* Current lineno in restore mode */
 	uint32_t printed_set;			/* Printed sets so far */
 	char saved_setname[IPSET_MAXNAMELEN];	/* Saved setname */
+	char replaced_setname[IPSET_MAXNAMELEN]; /* Set being replaced */
 	const struct ipset_type *saved_type;	/* Saved type */
 	struct nlattr *nested[IPSET_NEST_MAX];	/* Pointer to nest levels */
 	uint8_t nestid;				/* Current nest level */
+	struct nlattr *packed;			/* Packed elements attribute */
+	uint32_t packed_lineno;			/* Lineno of last packed elem */
 	bool version_checked;			/* Version checked */
+	uint8_t protocol;			/* Protocol version in use */
 	/* Output buffer */
 	char outbuf[IPSET_OUTBUFLEN];		/* Output buffer */
 	enum ipset_output_mode mode;		/* Output mode */
@@ -334,6 +338,9 @@ static const struct ipset_attr_policy cmd_attrs[] = {
 		.type = MNL_TYPE_U32,
 		.opt = IPSET_OPT_LINENO,
 	},
+	[IPSET_ATTR_PACKED] = {
+		.type = MNL_TYPE_BINARY,
+	},
 };
 
 static const struct ipset_attr_policy create_attrs[] = {
@@ -409,6 +416,30 @@ static const struct ipset_attr_policy create_attrs[] = {
 		.type = MNL_TYPE_U32,
 		.opt = IPSET_OPT_MEMSIZE,
 	},
+	[IPSET_ATTR_EVICTED] = {
+		.type = MNL_TYPE_U64,
+		.opt = IPSET_OPT_EVICTED,
+	},
+	[IPSET_ATTR_ADD_FAILED] = {
+		.type = MNL_TYPE_U64,
+		.opt = IPSET_OPT_ADD_FAILED,
+	},
+	[IPSET_ATTR_BUCKET_ALLOCS] = {
+		.type = MNL_TYPE_U64,
+		.opt = IPSET_OPT_BUCKET_ALLOCS,
+	},
+	[IPSET_ATTR_BUCKET_FREES] = {
+		.type = MNL_TYPE_U64,
+		.opt = IPSET_OPT_BUCKET_FREES,
+	},
+	[IPSET_ATTR_EXPECT] = {
+		.type = MNL_TYPE_U32,
+		.opt = IPSET_OPT_EXPECT,
+	},
+	[IPSET_ATTR_STATS] = {
+		.type = MNL_TYPE_NESTED,
+		.opt = IPSET_OPT_STATS,
+	},
 };
 
 static const struct ipset_attr_policy adt_attrs[] = {
@@ -505,6 +536,12 @@ static const struct ipset_attr_policy ipaddr_attrs[] = {
 	},
 };
 
+static const struct ipset_attr_policy stats_attrs[] = {
+	[IPSET_ATTR_STATS_TESTS ... IPSET_ATTR_STATS_MAX] = {
+		.type = MNL_TYPE_U64,
+	},
+};
+
 #ifdef IPSET_DEBUG
 static int debug = 1;
 #endif
@@ -554,9 +591,34 @@ ipaddr_attr_cb(const struct nlattr *attr, void *data)
 				    IPSET_ATTR_IPADDR_MAX, ipaddr_attrs);
 }
 
+static int
+stats_attr_cb(const struct nlattr *attr, void *data)
+{
+	return generic_data_attr_cb(attr, data,
+				    IPSET_ATTR_STATS_MAX, stats_attrs);
+}
+
 #define FAILURE(format, args...) \
 	{ ipset_err(session, format  , ## args); return MNL_CB_ERROR; }
 
+/* The runtime statistics of a set are stored as an array */
+static int
+stats2data(struct ipset_session *session, const struct nlattr *nla)
+{
+	struct nlattr *sattr[IPSET_ATTR_STATS_MAX+1] = {};
+	uint64_t stats[IPSET_ATTR_STATS_MAX+1] = {};
+	int i;
+
+	if (mnl_attr_parse_nested(nla, stats_attr_cb, sattr) < 0)
+		FAILURE("Broken kernel message, cannot validate "
+			"statistics attribute!");
+	for (i = IPSET_ATTR_STATS_UNSPEC + 1; i <= IPSET_ATTR_STATS_MAX; i++)
+		if (sattr[i])
+			stats[i] = be64toh(mnl_attr_get_u64(sattr[i]));
+
+	return ipset_data_set(session->data, IPSET_OPT_STATS, stats);
+}
+
 static int
 attr2data(struct ipset_session *session, struct nlattr *nla[],
 	  int type, const struct ipset_attr_policy attrs[])
@@ -572,6 +634,8 @@ attr2data(struct ipset_session *session, struct nlattr *nla[],
 	attr = &attrs[type];
 	d = mnl_attr_get_payload(nla[type]);
 
+	if (attr->opt == IPSET_OPT_STATS)
+		return stats2data(session, nla[type]);
 	if (attr->type == MNL_TYPE_NESTED && attr->opt) {
 		/* IP addresses */
 		struct nlattr *ipattr[IPSET_ATTR_IPADDR_MAX+1] = {};
@@ -666,6 +730,9 @@ static const char cmd2name[][9] = {
 	[IPSET_CMD_TEST]	= "TEST",
 	[IPSET_CMD_HEADER]	= "HEADER",
 	[IPSET_CMD_TYPE]	= "TYPE",
+	[IPSET_CMD_COMPACT]	= "COMPACT",
+	[IPSET_CMD_REPLACE]	= "REPLACE",
+	[IPSET_CMD_PUBLISH]	= "PUBLISH",
 	[IPSET_CMD_PROTOCOL]	= "PROTOCOL",
 };
 
@@ -752,32 +819,22 @@ retry:
 	return ret;
 }
 
-static int
-list_adt(struct ipset_session *session, struct nlattr *nla[])
+static const struct ipset_type *
+list_type(struct ipset_session *session)
 {
 	const struct ipset_data *data = session->data;
-	const struct ipset_type *type;
-	const struct ipset_arg *arg;
-	int i, found = 0;
 
-	D("enter");
 	/* Check and load type, family */
 	if (!ipset_data_test(data, IPSET_OPT_TYPE))
-		type = ipset_type_get(session, IPSET_CMD_ADD);
-	else
-		type = ipset_data_get(data, IPSET_OPT_TYPE);
-
-	if (type == NULL)
-		return MNL_CB_ERROR;
+		return ipset_type_get(session, IPSET_CMD_ADD);
+	return ipset_data_get(data, IPSET_OPT_TYPE);
+}
 
-	for (i = IPSET_ATTR_UNSPEC + 1; i <= IPSET_ATTR_ADT_MAX; i++)
-		if (nla[i]) {
-			found++;
-			ATTR2DATA(session, nla, i, adt_attrs);
-	}
-	D("attr found %u", found);
-	if (!found)
-		return MNL_CB_OK;
+static int
+list_elem(struct ipset_session *session, const struct ipset_type *type)
+{
+	const struct ipset_data *data = session->data;
+	const struct ipset_arg *arg;
 
 	switch (session->mode) {
 	case IPSET_LIST_SAVE:
@@ -833,6 +890,168 @@ list_adt(struct ipset_session *session, struct nlattr *nla[])
 	return MNL_CB_OK;
 }
 
+static int
+list_adt(struct ipset_session *session, struct nlattr *nla[])
+{
+	const struct ipset_type *type;
+	int i, found = 0;
+
+	D("enter");
+	type = list_type(session);
+	if (type == NULL)
+		return MNL_CB_ERROR;
+
+	for (i = IPSET_ATTR_UNSPEC + 1; i <= IPSET_ATTR_ADT_MAX; i++)
+		if (nla[i]) {
+			found++;
+			ATTR2DATA(session, nla, i, adt_attrs);
+	}
+	D("attr found %u", found);
+	if (!found)
+		return MNL_CB_OK;
+
+	return list_elem(session, type);
+}
+
+/* The packed records are decoded straight into the session data,
+ * see IPSET_ATTR_PACKED in linux_ip_set.h for the layout */
+static int
+list_packed(struct ipset_session *session, const struct nlattr *nla,
+	    enum ipset_cmd cmd)
+{
+	struct ipset_data *data = session->data;
+	const struct ipset_type *type;
+	const uint8_t *rec = mnl_attr_get_payload(nla);
+	size_t len = mnl_attr_get_payload_len(nla);
+	size_t iplen, klen;
+	uint16_t rsize, pflags;
+	uint32_t v32;
+	uint64_t v64;
+
+	type = list_type(session);
+	if (type == NULL)
+		return MNL_CB_ERROR;
+
+	iplen = ipset_data_family(data) == NFPROTO_IPV4
+		? sizeof(uint32_t) : sizeof(struct in6_addr);
+	klen = iplen;
+	if (type->packed & IPSET_FLAG(IPSET_OPT_CIDR))
+		klen += sizeof(uint32_t);
+	if (len < 2 * sizeof(uint16_t))
+		goto broken;
+	rsize = ntohs(*(const uint16_t *)rec);
+	pflags = ntohs(*(const uint16_t *)(rec + sizeof(uint16_t)));
+	rec += 2 * sizeof(uint16_t);
+	len -= 2 * sizeof(uint16_t);
+	if (rsize != klen
+		     + (pflags & IPSET_PACKED_TIMEOUT ? sizeof(uint32_t) : 0)
+		     + (pflags & IPSET_PACKED_COUNTERS
+			? 2 * sizeof(uint64_t) : 0) ||
+	    len % rsize)
+		goto broken;
+
+	for (; len > 0; len -= rsize, rec += rsize) {
+		const uint8_t *ext = rec + klen;
+
+		/* Reset ADT specific flags */
+		ipset_data_flags_unset(data, IPSET_ADT_FLAGS);
+		ipset_data_set(data, IPSET_OPT_IP, rec);
+		if (type->packed & IPSET_FLAG(IPSET_OPT_CIDR)) {
+			ipset_data_set(data, IPSET_OPT_CIDR, &rec[iplen]);
+			if (rec[iplen + 1]) {
+				v32 = rec[iplen + 1];
+				ipset_data_set(data, IPSET_OPT_CADT_FLAGS, &v32);
+			}
+		}
+		if (pflags & IPSET_PACKED_TIMEOUT) {
+			memcpy(&v32, ext, sizeof(v32));
+			v32 = ntohl(v32);
+			ipset_data_set(data, IPSET_OPT_TIMEOUT, &v32);
+			ext += sizeof(v32);
+		}
+		if (pflags & IPSET_PACKED_COUNTERS) {
+			memcpy(&v64, ext, sizeof(v64));
+			v64 = be64toh(v64);
+			ipset_data_set(data, IPSET_OPT_PACKETS, &v64);
+			memcpy(&v64, ext + sizeof(v64), sizeof(v64));
+			v64 = be64toh(v64);
+			ipset_data_set(data, IPSET_OPT_BYTES, &v64);
+		}
+		if (list_elem(session, type) != MNL_CB_OK)
+			return MNL_CB_ERROR;
+	}
+	return MNL_CB_OK;
+
+broken:
+	FAILURE("Broken %s kernel message: "
+		"packed elements of wrong size!", cmd2name[cmd]);
+}
+
+/* Print a/b with two decimals */
+static void
+list_ratio(struct ipset_session *session, uint64_t a, uint64_t b)
+{
+	uint64_t r = b ? a * 100 / b : 0;
+
+	safe_snprintf(session, "%llu.%02u",
+		      (long long unsigned) (r / 100), (unsigned) (r % 100));
+}
+
+/* Runtime statistics are listed with the header only */
+static void
+list_stats(struct ipset_session *session)
+{
+	const struct ipset_data *data = session->data;
+	const uint64_t *s;
+
+	if (ipset_data_test(data, IPSET_OPT_ELEMENTS)) {
+		safe_snprintf(session,
+			      session->mode == IPSET_LIST_XML ?
+			      "<entries>" : "\nNumber of entries: ");
+		safe_dprintf(session, ipset_print_number, IPSET_OPT_ELEMENTS);
+		if (session->mode == IPSET_LIST_XML)
+			safe_snprintf(session, "</entries>\n");
+	}
+	if (!ipset_data_test(data, IPSET_OPT_STATS))
+		return;
+
+	s = ipset_data_get(data, IPSET_OPT_STATS);
+#define STAT(x)	((long long unsigned) s[IPSET_ATTR_STATS_##x])
+	if (session->mode == IPSET_LIST_XML) {
+		safe_snprintf(session, "<stats><tests>%llu</tests>"
+			      "<hits>%llu</hits><misses>%llu</misses>"
+			      "<lookups>%llu</lookups><probes>%llu</probes>"
+			      "<probemax>%llu</probemax>"
+			      "<resizes>%llu</resizes>"
+			      "<resizetime>%llu</resizetime>"
+			      "<gcruns>%llu</gcruns><gctime>%llu</gctime>"
+			      "<expired>%llu</expired>"
+			      "<bucketfull>%llu</bucketfull></stats>\n",
+			      STAT(TESTS), STAT(HITS), STAT(MISSES),
+			      STAT(LOOKUPS), STAT(PROBES), STAT(PROBE_MAX),
+			      STAT(RESIZES), STAT(RESIZE_TIME),
+			      STAT(GC_RUNS), STAT(GC_TIME), STAT(EXPIRED),
+			      STAT(BUCKET_FULL));
+		return;
+	}
+	safe_snprintf(session, "\nTests: %llu (hits %llu, misses %llu)",
+		      STAT(TESTS), STAT(HITS), STAT(MISSES));
+	safe_snprintf(session, "\nLookups: %llu (probes average ",
+		      STAT(LOOKUPS));
+	list_ratio(session, STAT(PROBES), STAT(LOOKUPS));
+	safe_snprintf(session, ", max %llu)\nLookups per test: ",
+		      STAT(PROBE_MAX));
+	list_ratio(session, STAT(LOOKUPS), STAT(TESTS));
+	safe_snprintf(session, "\nResizes: %llu (time %llu usecs)",
+		      STAT(RESIZES), STAT(RESIZE_TIME));
+	safe_snprintf(session, "\nGarbage collections: %llu "
+		      "(time %llu usecs, expired %llu)",
+		      STAT(GC_RUNS), STAT(GC_TIME), STAT(EXPIRED));
+	safe_snprintf(session, "\nAdds to full buckets: %llu",
+		      STAT(BUCKET_FULL));
+#undef STAT
+}
+
 #define FAMILY_TO_STR(f)		\
 	((f) == NFPROTO_IPV4 ? "inet" :	\
 	 (f) == NFPROTO_IPV6 ? "inet6" : "any")
@@ -922,6 +1141,28 @@ list_create(struct ipset_session *session, struct nlattr *nla[])
 		safe_dprintf(session, ipset_print_number, IPSET_OPT_MEMSIZE);
 		safe_snprintf(session, "\nReferences: ");
 		safe_dprintf(session, ipset_print_number, IPSET_OPT_REFERENCES);
+		if (ipset_data_test(data, IPSET_OPT_EVICTED)) {
+			safe_snprintf(session, "\nEvictions: ");
+			safe_dprintf(session, ipset_print_number,
+				     IPSET_OPT_EVICTED);
+		}
+		if (ipset_data_test(data, IPSET_OPT_ADD_FAILED)) {
+			safe_snprintf(session, "\nFailed adds: ");
+			safe_dprintf(session, ipset_print_number,
+				     IPSET_OPT_ADD_FAILED);
+		}
+		/* Allocator statistics are listed with the header only */
+		if (session->envopts & IPSET_ENV_LIST_HEADER &&
+		    ipset_data_test(data, IPSET_OPT_BUCKET_ALLOCS)) {
+			safe_snprintf(session, "\nBucket allocations: ");
+			safe_dprintf(session, ipset_print_number,
+				     IPSET_OPT_BUCKET_ALLOCS);
+			safe_snprintf(session, "\nBucket frees: ");
+			safe_dprintf(session, ipset_print_number,
+				     IPSET_OPT_BUCKET_FREES);
+		}
+		if (session->envopts & IPSET_ENV_LIST_HEADER)
+			list_stats(session);
 		safe_snprintf(session,
 			session->envopts & IPSET_ENV_LIST_HEADER ?
 			"\n" : "\nMembers:\n");
@@ -931,10 +1172,36 @@ list_create(struct ipset_session *session, struct nlattr *nla[])
 		safe_dprintf(session, ipset_print_number, IPSET_OPT_MEMSIZE);
 		safe_snprintf(session, "</memsize>\n<references>");
 		safe_dprintf(session, ipset_print_number, IPSET_OPT_REFERENCES);
+		safe_snprintf(session, "</references>\n");
+		if (ipset_data_test(data, IPSET_OPT_EVICTED)) {
+			safe_snprintf(session, "<evictions>");
+			safe_dprintf(session, ipset_print_number,
+				     IPSET_OPT_EVICTED);
+			safe_snprintf(session, "</evictions>\n");
+		}
+		if (ipset_data_test(data, IPSET_OPT_ADD_FAILED)) {
+			safe_snprintf(session, "<failedadds>");
+			safe_dprintf(session, ipset_print_number,
+				     IPSET_OPT_ADD_FAILED);
+			safe_snprintf(session, "</failedadds>\n");
+		}
+		/* Allocator statistics are listed with the header only */
+		if (session->envopts & IPSET_ENV_LIST_HEADER &&
+		    ipset_data_test(data, IPSET_OPT_BUCKET_ALLOCS)) {
+			safe_snprintf(session, "<bucketallocs>");
+			safe_dprintf(session, ipset_print_number,
+				     IPSET_OPT_BUCKET_ALLOCS);
+			safe_snprintf(session, "</bucketallocs>\n<bucketfrees>");
+			safe_dprintf(session, ipset_print_number,
+				     IPSET_OPT_BUCKET_FREES);
+			safe_snprintf(session, "</bucketfrees>\n");
+		}
+		if (session->envopts & IPSET_ENV_LIST_HEADER)
+			list_stats(session);
 		safe_snprintf(session,
 			session->envopts & IPSET_ENV_LIST_HEADER ?
-			"</references>\n</header>\n" :
-			"</references>\n</header>\n<members>\n");
+			"</header>\n" :
+			"</header>\n<members>\n");
 		break;
 	default:
 		break;
@@ -1027,7 +1294,13 @@ callback_list(struct ipset_session *session, struct nlattr *nla[],
 				"revision");
 
 		/* Reset CREATE specific flags */
-		ipset_data_flags_unset(data, IPSET_CREATE_FLAGS);
+		ipset_data_flags_unset(data, IPSET_CREATE_FLAGS
+					     | IPSET_FLAG(IPSET_OPT_EVICTED)
+					     | IPSET_FLAG(IPSET_OPT_ADD_FAILED)
+					     | IPSET_FLAG(IPSET_OPT_BUCKET_ALLOCS)
+					     | IPSET_FLAG(IPSET_OPT_BUCKET_FREES)
+					     | IPSET_FLAG(IPSET_OPT_ELEMENTS)
+					     | IPSET_FLAG(IPSET_OPT_STATS));
 		D("nla typename %s",
 		  (char *) mnl_attr_get_payload(nla[IPSET_ATTR_TYPENAME]));
 		D("nla typename %s",
@@ -1064,6 +1337,9 @@ callback_list(struct ipset_session *session, struct nlattr *nla[],
 				return MNL_CB_ERROR;
 		}
 	}
+	if (nla[IPSET_ATTR_PACKED] != NULL &&
+	    list_packed(session, nla[IPSET_ATTR_PACKED], cmd) != MNL_CB_OK)
+		return MNL_CB_ERROR;
 	return call_outfn(session) ? MNL_CB_ERROR : MNL_CB_OK;
 }
 
@@ -1075,6 +1351,9 @@ callback_list(struct ipset_session *session, struct nlattr *nla[],
 #define IPSET_PROTOCOL_MAX	IPSET_PROTOCOL
 #endif
 
+/* The first protocol version with packed elements */
+#define IPSET_PROTOCOL_PACKED	7
+
 static int
 callback_version(struct ipset_session *session, struct nlattr *nla[])
 {
@@ -1100,6 +1379,8 @@ callback_version(struct ipset_session *session, struct nlattr *nla[])
 			   "while userspace supports protocol versions %u-%u",
 			   min, max, IPSET_PROTOCOL_MIN, IPSET_PROTOCOL_MAX);
 
+	/* Talk the highest version supported by both sides */
+	session->protocol = MIN(max, IPSET_PROTOCOL_MAX);
 	session->version_checked = true;
 
 	return MNL_CB_STOP;
@@ -1227,10 +1508,10 @@ callback_data(const struct nlmsghdr *nlh, void *data)
 	proto = mnl_attr_get_u8(nla[IPSET_ATTR_PROTOCOL]);
 
 	/* Check protocol */
-	if (cmd != IPSET_CMD_PROTOCOL && proto != IPSET_PROTOCOL)
+	if (cmd != IPSET_CMD_PROTOCOL && proto != session->protocol)
 		FAILURE("Giving up: kernel protocol version %u "
 			"does not match our protocol version %u",
-			proto, IPSET_PROTOCOL);
+			proto, session->protocol);
 
 	D("Message: %s", cmd2name[cmd]);
 	switch (cmd) {
@@ -1341,6 +1622,17 @@ callback_error(const struct nlmsghdr *nlh, void *cbdata)
 			ipset_cache_del(ipset_data_setname(data));
 			/* Fall through */
 		case IPSET_CMD_FLUSH:
+		case IPSET_CMD_COMPACT:
+			break;
+		case IPSET_CMD_REPLACE:
+			/* The following adds/dels go to the shadow */
+			strcpy(session->replaced_setname,
+			       ipset_data_setname(data));
+			break;
+		case IPSET_CMD_PUBLISH:
+			if (STREQ(ipset_data_setname(data),
+				  session->replaced_setname))
+				session->replaced_setname[0] = '\0';
 			break;
 		case IPSET_CMD_RENAME:
 			ipset_cache_rename(ipset_data_setname(data),
@@ -1533,7 +1825,7 @@ data2attr(struct ipset_session *session, struct nlmsghdr *nlh,
 }
 
 #define ADDATTR_PROTOCOL(nlh)						\
-	mnl_attr_put_u8(nlh, IPSET_ATTR_PROTOCOL, IPSET_PROTOCOL)
+	mnl_attr_put_u8(nlh, IPSET_ATTR_PROTOCOL, session->protocol)
 
 #define ADDATTR(session, nlh, data, type, family, attrs)		\
 	data2attr(session, nlh, data, type, family, attrs)
@@ -1633,6 +1925,59 @@ may_aggregate_ad(struct ipset_session *session, enum ipset_cmd cmd)
 	       STREQ(ipset_data_setname(session->data), session->saved_setname);
 }
 
+/* The options which cannot be carried by packed elements, unless
+ * the type packs them */
+#define IPSET_UNPACKED_FLAGS		\
+	(IPSET_ADT_FLAGS		\
+	| IPSET_FLAG(IPSET_OPT_PACKETS)	\
+	| IPSET_FLAG(IPSET_OPT_BYTES))
+
+/* In restore mode the elements without extensions are sent
+ * in a packed array, when the kernel and the type support it */
+static inline bool
+may_pack_ad(struct ipset_session *session, const struct ipset_type *type)
+{
+	return session->lineno != 0 &&
+	       session->protocol >= IPSET_PROTOCOL_PACKED &&
+	       type->packed &&
+	       !ipset_data_flags_test(session->data,
+				      IPSET_UNPACKED_FLAGS & ~type->packed);
+}
+
+static int
+addattr_packed(struct ipset_session *session, struct nlmsghdr *nlh,
+	       const struct ipset_type *type)
+{
+	struct ipset_data *data = session->data;
+	uint8_t family = ipset_data_family(data);
+	size_t iplen = family == NFPROTO_IPV4 ? sizeof(uint32_t)
+					      : sizeof(struct in6_addr);
+	size_t alen = iplen;
+	uint8_t *elem;
+
+	if (type->packed & IPSET_FLAG(IPSET_OPT_CIDR))
+		alen += sizeof(uint32_t);
+	if (BUFFER_FULL(session->bufsize, nlh->nlmsg_len, 0, alen))
+		return 1;
+
+	/* The elements are multiple of 4 bytes long, so aligned */
+	elem = mnl_nlmsg_get_payload_tail(nlh);
+	memset(elem, 0, alen);
+	memcpy(elem, ipset_data_get(data, IPSET_OPT_IP), iplen);
+	if (type->packed & IPSET_FLAG(IPSET_OPT_CIDR))
+		elem[iplen] = ipset_data_test(data, IPSET_OPT_CIDR)
+			? *(const uint8_t *)ipset_data_get(data, IPSET_OPT_CIDR)
+			: iplen * 8;
+	if (type->packed & IPSET_FLAG(IPSET_OPT_NOMATCH) &&
+	    ipset_data_test(data, IPSET_OPT_NOMATCH))
+		elem[iplen + 1] = IPSET_FLAG_NOMATCH;
+	nlh->nlmsg_len += alen;
+	session->packed->nla_len += alen;
+	session->packed_lineno = session->lineno;
+
+	return 0;
+}
+
 static int
 build_msg(struct ipset_session *session, bool aggregate)
 {
@@ -1653,16 +1998,21 @@ build_msg(struct ipset_session *session, bool aggregate)
 	}
 	D("Protocol added, aggregate %s", aggregate ? "yes" : "no");
 	switch (session->cmd) {
-	case IPSET_CMD_CREATE: {
+	case IPSET_CMD_CREATE:
+	case IPSET_CMD_REPLACE: {
 		const struct ipset_type *type;
 
 		/* Sanity checkings */
 		if (!ipset_data_test(data, IPSET_SETNAME))
 			return ipset_err(session,
-				"Invalid create command: missing setname");
+				"Invalid %s command: missing setname",
+				session->cmd == IPSET_CMD_CREATE ? "create" :
+				"replace");
 		if (!ipset_data_test(data, IPSET_OPT_TYPE))
 			return ipset_err(session,
-				"Invalid create command: missing settype");
+				"Invalid %s command: missing settype",
+				session->cmd == IPSET_CMD_CREATE ? "create" :
+				"replace");
 
 		type = ipset_data_get(data, IPSET_OPT_TYPE);
 		/* Core attributes:
@@ -1691,20 +2041,27 @@ build_msg(struct ipset_session *session, bool aggregate)
 	}
 	case IPSET_CMD_DESTROY:
 	case IPSET_CMD_FLUSH:
-	case IPSET_CMD_SAVE:
+	case IPSET_CMD_COMPACT:
+	case IPSET_CMD_PUBLISH:
 		if (ipset_data_test(data, IPSET_SETNAME))
 			ADDATTR_SETNAME(session, nlh, data);
 		break;
-	case IPSET_CMD_LIST: {
+	case IPSET_CMD_LIST:
+	case IPSET_CMD_SAVE: {
 		uint32_t flags = 0;
 
-		if (session->envopts & IPSET_ENV_LIST_SETNAME)
-			flags |= IPSET_FLAG_LIST_SETNAME;
-		if (session->envopts & IPSET_ENV_LIST_HEADER)
-			flags |= IPSET_FLAG_LIST_HEADER;
+		if (session->cmd == IPSET_CMD_LIST &&
+		    session->mode != IPSET_LIST_SAVE) {
+			if (session->envopts & IPSET_ENV_LIST_SETNAME)
+				flags |= IPSET_FLAG_LIST_SETNAME;
+			if (session->envopts & IPSET_ENV_LIST_HEADER)
+				flags |= IPSET_FLAG_LIST_HEADER;
+		}
+		if (session->protocol >= IPSET_PROTOCOL_PACKED)
+			flags |= IPSET_FLAG_LIST_PACKED;
 		if (ipset_data_test(data, IPSET_SETNAME))
 			ADDATTR_SETNAME(session, nlh, data);
-		if (flags && session->mode != IPSET_LIST_SAVE) {
+		if (flags) {
 			ipset_data_set(data, IPSET_OPT_FLAGS, &flags);
 			ADDATTR(session, nlh, data, IPSET_ATTR_FLAGS,
 				NFPROTO_IPV4, cmd_attrs);
@@ -1731,6 +2088,19 @@ build_msg(struct ipset_session *session, bool aggregate)
 	case IPSET_CMD_ADD:
 	case IPSET_CMD_DEL: {
 		const struct ipset_type *type;
+		bool packed = false;
+
+		if (ipset_data_test(data, IPSET_OPT_TYPE)) {
+			type = ipset_data_get(data, IPSET_OPT_TYPE);
+			packed = may_pack_ad(session, type);
+		}
+		/* Packed elements must come from consecutive lines
+		 * and cannot be mixed with the other ones */
+		if (aggregate &&
+		    (packed != (session->packed != NULL) ||
+		     (packed &&
+		      session->lineno != session->packed_lineno + 1)))
+			return 1;
 
 		if (!aggregate) {
 			/* Setname, type not checked/added yet */
@@ -1748,16 +2118,33 @@ build_msg(struct ipset_session *session, bool aggregate)
 
 			/* Core options: setname */
 			ADDATTR_SETNAME(session, nlh, data);
+			if (STREQ(ipset_data_setname(data),
+				  session->replaced_setname)) {
+				uint32_t flags = IPSET_FLAG_SHADOW;
+
+				ADDATTR_RAW(session, nlh, &flags,
+					    IPSET_ATTR_FLAGS, cmd_attrs);
+			}
 			if (session->lineno != 0) {
 				/* Restore mode */
 				ADDATTR_RAW(session, nlh, &session->lineno,
 					    IPSET_ATTR_LINENO, cmd_attrs);
-				open_nested(session, nlh, IPSET_ATTR_ADT);
+				if (packed) {
+					/* Filled out by addattr_packed */
+					session->packed =
+						mnl_nlmsg_get_payload_tail(nlh);
+					mnl_attr_put(nlh, IPSET_ATTR_PACKED,
+						     0, NULL);
+				} else
+					open_nested(session, nlh,
+						    IPSET_ATTR_ADT);
 			}
 		}
 		type = ipset_data_get(data, IPSET_OPT_TYPE);
 		D("family: %u, type family %u",
 		  ipset_data_family(data), type->family);
+		if (packed)
+			return addattr_packed(session, nlh, type);
 		if (open_nested(session, nlh, IPSET_ATTR_DATA)) {
 			D("open_nested failed");
 			return 1;
@@ -1842,6 +2229,7 @@ ipset_commit(struct ipset_session *session)
 	for (i = session->nestid - 1; i >= 0; i--)
 		session->nested[i] = NULL;
 	session->nestid = 0;
+	session->packed = NULL;
 	nlh->nlmsg_len = 0;
 
 	D("ret: %d", ret);
@@ -2011,6 +2399,7 @@ ipset_session_init(ipset_outfn outfn)
 		return NULL;
 	session->bufsize = bufsize;
 	session->buffer = session + 1;
+	session->protocol = IPSET_PROTOCOL;
 
 	/* The single transport method yet */
 	session->transport = &ipset_mnl_transport;
@@ -398,6 +398,7 @@ ipset_type_get(struct ipset_session *session, enum ipset_cmd cmd)
 
 	switch (cmd) {
 	case IPSET_CMD_CREATE:
+	case IPSET_CMD_REPLACE:
 		return ipset_data_test(ipset_session_data(session),
 				       IPSET_OPT_TYPE)
 			? ipset_data_get(ipset_session_data(session),
@@ -30,6 +30,7 @@ static char program_version[] = PACKAGE_VERSION;
 
 static struct ipset_session *session;
 static uint32_t restore_line;
+static uint32_t restore_expect;
 static bool interactive;
 static char cmdline[1024];
 static char *newargv[255];
@@ -215,6 +216,60 @@ build_argv(char *buffer)
 /* Main parser function, workhorse */
 int parse_commandline(int argc, char *argv[]);
 
+static bool
+restore_match_cmd(const char *arg, enum ipset_cmd cmd)
+{
+	const struct ipset_commands *c;
+
+	for (c = ipset_commands; c->cmd; c++)
+		if (c->cmd == cmd)
+			return ipset_match_cmd(arg, c->name);
+	return false;
+}
+
+/*
+ * Count the add lines of the set, which follow its create or replace line
+ * in the restore input, so that the set can be presized.
+ * The line is already split into newargv, cmdline is reused.
+ * Non-seekable input (pipe) is not counted.
+ */
+static uint32_t
+restore_count_adds(FILE *rfd)
+{
+	char cmd[IPSET_MAXNAMELEN], setname[IPSET_MAXNAMELEN];
+	uint32_t count = 0;
+	long pos;
+	char *c;
+
+	if (newargc < 3 ||
+	    !(restore_match_cmd(newargv[1], IPSET_CMD_CREATE) ||
+	      restore_match_cmd(newargv[1], IPSET_CMD_REPLACE)))
+		return 0;
+	pos = ftell(rfd);
+	if (pos < 0)
+		return 0;
+
+	while (fgets(cmdline, sizeof(cmdline), rfd)) {
+		c = cmdline;
+		while (isspace(c[0]))
+			c++;
+		if (c[0] == '\0' || c[0] == '#')
+			continue;
+		if (sscanf(c, "%31s %31s", cmd, setname) != 2 ||
+		    !restore_match_cmd(cmd, IPSET_CMD_ADD) ||
+		    !STREQ(setname, newargv[2]))
+			break;
+		count++;
+	}
+	if (fseek(rfd, pos, SEEK_SET) < 0) {
+		exit_error(OTHER_PROBLEM,
+			   "Cannot seek back in the restore input: %s",
+			   strerror(errno));
+		return 0;
+	}
+	return count;
+}
+
 /*
  * Performs a restore from stdin
  */
@@ -254,9 +309,11 @@ restore(char *argv0)
 		}
 		/* Build faked argv, argc */
 		build_argv(c);
+		restore_expect = restore_count_adds(rfd);
 
 		/* Execute line */
 		ret = parse_commandline(newargc, newargv);
+		restore_expect = 0;
 		if (ret < 0)
 			handle_error();
 	}
@@ -350,6 +407,7 @@ cmd2cmd(int cmd)
 	case IPSET_CMD_TEST:
 		return IPSET_TEST;
 	case IPSET_CMD_CREATE:
+	case IPSET_CMD_REPLACE:
 		return IPSET_CREATE;
 	default:
 		return 0;
@@ -418,7 +476,7 @@ check_allowed(const struct ipset_type *type, enum ipset_cmd command)
 	uint64_t flags = ipset_data_flags(ipset_session_data(session));
 	enum ipset_adt cmd = cmd2cmd(command);
 	uint64_t allowed = type->full[cmd];
-	uint64_t cmdflags = command == IPSET_CMD_CREATE
+	uint64_t cmdflags = cmd2cmd(command) == IPSET_CREATE
 				? IPSET_CREATE_FLAGS : IPSET_ADT_FLAGS;
 	const struct ipset_arg *arg = type->args[cmd];
 	enum ipset_opt i;
@@ -703,6 +761,7 @@ parse_commandline(int argc, char *argv[])
 	/* Forth: parse command args and issue the command */
 	switch (cmd) {
 	case IPSET_CMD_CREATE:
+	case IPSET_CMD_REPLACE:
 		/* Args: setname typename [type specific options] */
 		ret = ipset_parse_setname(session, IPSET_SETNAME, arg0);
 		if (ret < 0)
@@ -730,6 +789,15 @@ parse_commandline(int argc, char *argv[])
 		else if (ret)
 			return ret;
 
+		/* Restore: presize the set for the add lines which follow */
+		if (restore_expect &&
+		    (type->full[IPSET_CREATE] & IPSET_FLAG(IPSET_OPT_EXPECT)) &&
+		    !ipset_data_test(ipset_session_data(session),
+				     IPSET_OPT_EXPECT)) {
+			ipset_data_set(ipset_session_data(session),
+				       IPSET_OPT_EXPECT, &restore_expect);
+		}
+
 		/* Check mandatory, then allowed options */
 		check_mandatory(type, cmd);
 		check_allowed(type, cmd);
@@ -748,6 +816,8 @@ parse_commandline(int argc, char *argv[])
 		}
 	case IPSET_CMD_DESTROY:
 	case IPSET_CMD_FLUSH:
+	case IPSET_CMD_COMPACT:
+	case IPSET_CMD_PUBLISH:
 		/* Args: [setname] */
 		if (arg0) {
 			ret = ipset_parse_setname(session,
@@ -99,6 +99,27 @@ const struct ipset_commands ipset_commands[] = {
 		.help = "FROM-SETNAME TO-SETNAME\n"
 			"        Swap the contect of two existing sets",
 	},
+	{	/* compact */
+		.cmd = IPSET_CMD_COMPACT,
+		.name = { "compact", NULL },
+		.has_arg = IPSET_OPTIONAL_ARG,
+		.help = "[SETNAME]\n"
+			"        Shrink the memory of a named set or all sets",
+	},
+	{	/* replace */
+		.cmd = IPSET_CMD_REPLACE,
+		.name = { "replace", NULL },
+		.has_arg = IPSET_MANDATORY_ARG2,
+		.help = "SETNAME TYPENAME [type-specific-options]\n"
+			"        Start to replace the content of a set",
+	},
+	{	/* publish */
+		.cmd = IPSET_CMD_PUBLISH,
+		.name = { "publish", NULL },
+		.has_arg = IPSET_MANDATORY_ARG,
+		.help = "SETNAME\n"
+			"        Publish the replaced content of a set",
+	},
 	{	/* h[elp, --help, -H */
 		.cmd = IPSET_CMD_HELP,
 		.name = { "help", "-h", "-H" },
@@ -208,6 +208,62 @@
 0 ./check_extensions test 2.0.0.10 700 13 12479
 # Counters and timeout: destroy set
 0 ipset x test
+# Expiry: create set with timeout
+0 ipset n test bitmap:ip range 10.0.0.0/16 timeout 4
+# Expiry: add element with short timeout
+0 ipset a test 10.0.0.1 timeout 1
+# Expiry: add element with long timeout
+0 ipset a test 10.0.0.2 timeout 100
+# Expiry: add permanent element
+0 ipset a test 10.0.255.3 timeout 0
+# Expiry: shorten the timeout of an element
+0 ipset a test 10.0.0.2 timeout 2 -exist
+# Expiry: sleep 4s so that elements can time out
+0 sleep 4
+# Expiry: test element with shortened timeout
+1 ipset t test 10.0.0.2
+# Expiry: test permanent element
+0 ipset t test 10.0.255.3
+# Expiry: check number of elements
+0 n=`ipset save test|wc -l` && test $n -eq 2
+# Expiry: readd expired element
+0 ipset a test 10.0.0.1
+# Expiry: test readded element
+0 ipset t test 10.0.0.1
+# Expiry: destroy set
+0 ipset x test
+# Replicas: create set with NUMA node replicas
+0 ipset n test bitmap:ip range 10.0.0.0/16 replicas
+# Replicas: check replicas flag in header
+0 ipset -L test | grep -q '^Header: .* replicas'
+# Replicas: add range of elements
+0 ipset a test 10.0.1.0/24
+# Replicas: test element
+0 ipset t test 10.0.1.100
+# Replicas: test not added element
+1 ipset t test 10.0.2.100
+# Replicas: delete element
+0 ipset d test 10.0.1.100
+# Replicas: test deleted element
+1 ipset t test 10.0.1.100
+# Replicas: flush set
+0 ipset f test
+# Replicas: test element after flush
+1 ipset t test 10.0.1.1
+# Replicas: destroy set
+0 ipset x test
+# Sparse: create set over a /16
+0 ipset n test bitmap:ip range 10.0.0.0/16
+# Sparse: add elements at word boundaries
+0 for x in 10.0.0.0 10.0.0.63 10.0.0.64 10.0.255.255; do ipset a test $x; done
+# Sparse: check listed elements
+0 ipset save test | awk '/^add/ { s = s " " $3 } END { exit s != " 10.0.0.0 10.0.0.63 10.0.0.64 10.0.255.255" }'
+# Sparse: delete elements
+0 for x in 10.0.0.0 10.0.0.63; do echo del test $x; done | ipset restore
+# Sparse: check listed elements after delete
+0 ipset save test | awk '/^add/ { s = s " " $3 } END { exit s != " 10.0.0.64 10.0.255.255" }'
+# Sparse: destroy set
+0 ipset x test
 # Counters: require sendip
 skip which sendip
 # Counters: create set
@@ -0,0 +1,49 @@
+#!/bin/bash
+
+# Lookup throughput of a hash:ip set with and without the Bloom filter
+# at different hit rates.
+#
+# Usage: bloom_bench.sh [elements [seconds]]
+#
+# The set stores the addresses 10.0.0.0/10 up to the given number of
+# elements, the packets are sent from random sources of a range of
+# which the given percentage is stored in the set.
+
+. ./pktgen.sh
+
+elems=${1:-1048576}
+secs=${2:-10}
+cpus=`nproc`
+
+pg_start
+pg_rule -p udp --dport 7 -m set --match-set bench src
+pg_rule -p udp --dport 7 -j DROP
+
+first=`ip2int 10.0.0.0`
+printf "%8s %8s %12s\n" filter "hit %" "tests/s"
+for filter in "" bloom; do
+	$ipset x bench 2>/dev/null || true
+	$ipset n bench hash:ip hashsize $elems maxelem $elems $filter
+	awk -v f=$first -v n=$elems 'BEGIN {
+		for (i = 0; i < n; i++)
+			printf "add bench %d.%d.%d.%d\n", (f + i) / 16777216 % 256,
+			       (f + i) / 65536 % 256, (f + i) / 256 % 256,
+			       (f + i) % 256
+	}' | $ipset restore
+	for hit in 0 1 10 50 90 100; do
+		# The sources cover the stored range at the hit rate
+		if [ $hit -eq 0 ]; then
+			min=`int2ip $((first + elems))`
+			max=`int2ip $((first + 2 * elems - 1))`
+		else
+			min=`int2ip $first`
+			max=`int2ip $((first + elems * 100 / hit - 1))`
+		fi
+		pg_reset
+		for cpu in `seq 0 $((cpus - 1))`; do
+			pg_thread $cpu $min $max 7
+		done
+		pg_run $secs
+		printf "%8s %8d %12d\n" "${filter:-none}" $hit `pg_pps 1 $secs`
+	done
+done
@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# Lookup throughput of a hash:net set with and without the recent
+# lookup cache, for uniformly and for Zipf distributed sources.
+#
+# Usage: cache_bench.sh [sources [seconds]]
+#
+# The set stores 10.0.0.0/8 and networks with /16, /20, /24, /28 and
+# /32 prefixes elsewhere, so that every lookup has to try all of the
+# prefixes before it matches 10.0.0.0/8. The packets are sent from the
+# given number (a power of two) of sources starting at 10.0.0.0.
+# For the Zipf distribution every thread runs one pktgen device per
+# nested range of the first 2^k sources, k = 0 .. log2(sources): as the
+# devices send in turn, the frequency of a source is roughly inversely
+# proportional to its rank.
+
+. ./pktgen.sh
+
+sources=${1:-65536}
+secs=${2:-10}
+cpus=`nproc`
+
+pg_start
+pg_rule -p udp --dport 7 -m set --match-set bench src
+pg_rule -p udp --dport 7 -j DROP
+
+first=`ip2int 10.0.0.0`
+printf "%8s %8s %12s\n" cache sources "tests/s"
+for cache in "" cache; do
+	$ipset x bench 2>/dev/null || true
+	$ipset n bench hash:net $cache
+	(echo "add bench 10.0.0.0/8"
+	 for cidr in 16 20 24 28 32; do
+		echo "add bench 172.16.0.0/$cidr"
+	 done) | $ipset restore
+	for dist in uniform zipf; do
+		pg_reset
+		for cpu in `seq 0 $((cpus - 1))`; do
+			if [ $dist = uniform ]; then
+				pg_thread $cpu `int2ip $first` \
+					  `int2ip $((first + sources - 1))` 7
+				continue
+			fi
+			k=0
+			while [ $((1 << k)) -le $sources ]; do
+				pg_device $cpu $((cpu * 32 + k)) \
+					  `int2ip $first` \
+					  `int2ip $((first + (1 << k) - 1))` 7
+				k=$((k + 1))
+			done
+		done
+		pg_run $secs
+		printf "%8s %8s %12d\n" "${cache:-none}" $dist `pg_pps 1 $secs`
+	done
+done
@@ -0,0 +1,127 @@
+# Range: Create a set over the whole address space
+0 ipset -N test cbitmap:ip range 0.0.0.0-255.255.255.255
+# Range: Add a range spanning two blocks
+0 ipset -A test 10.0.255.250-10.1.0.5
+# Range: Add a single address
+0 ipset -A test 192.168.0.1
+# Range: Add the highest address
+0 ipset -A test 255.255.255.255
+# Range: Test the last address of the first block
+0 ipset -T test 10.0.255.255
+# Range: Test the first address of the second block
+0 ipset -T test 10.1.0.0
+# Range: Test an address after the range
+1 ipset -T test 10.1.0.6
+# Range: Test the highest address
+0 ipset -T test 255.255.255.255
+# Range: Add an overlapping range
+1 ipset -A test 10.1.0.5-10.1.0.10
+# Range: The overlapping range is not added partially
+1 ipset -T test 10.1.0.6
+# Range: Add the overlapping range with -exist
+0 ipset -! -A test 10.1.0.5-10.1.0.10
+# Range: Delete a range with a missing address
+1 ipset -D test 10.1.0.10-10.1.0.11
+# Range: Delete an address splitting the range
+0 ipset -D test 10.1.0.0
+# Range: Delete the same address again
+1 ipset -D test 10.1.0.0
+# Range: Check the number of elements
+0 ipset -t l test | grep -q '^Number of entries: 18$'
+# Range: Check listed ranges
+0 ipset save test | awk '/^add/ { s = s " " $3 } END { exit s != " 10.0.255.250-10.0.255.255 10.1.0.1-10.1.0.10 192.168.0.1 255.255.255.255" }'
+# Range: Add a /8 network with -exist
+0 ipset -! -A test 10.0.0.0/8
+# Range: Check the number of elements
+0 ipset -t l test | grep -q '^Number of entries: 16777218$'
+# Range: Delete a /16 network
+0 ipset -D test 10.5.0.0/16
+# Range: Test an address of the deleted network
+1 ipset -T test 10.5.1.1
+# Range: Check the number of elements after delete
+0 ipset -t l test | grep -q '^Number of entries: 16711682$'
+# Range: Flush test set
+0 ipset -F test
+# Range: Check the number of elements after flush
+0 ipset -t l test | grep -q '^Number of entries: 0$'
+# Range: Destroy test set
+0 ipset -X test
+# Range: Create a set out of the allowed CIDR
+1 ipset -N test cbitmap:ip range 10.0.0.1/32
+# Timeout: Create a set with timeout and maxelem
+0 ipset -N test cbitmap:ip range 10.0.0.0/8 timeout 4 maxelem 4
+# Timeout: Add an address out of the range
+1 ipset -A test 11.0.0.1
+# Timeout: Add a range of three addresses
+0 ipset -A test 10.0.0.1-10.0.0.3
+# Timeout: Add an address with timeout 0
+0 ipset -A test 10.2.0.1 timeout 0
+# Timeout: Add one more address to the full set
+1 ipset -A test 10.3.0.1
+# Timeout: Add a network to the full set
+1 ipset -A test 10.0.0.0/8
+# Timeout: Re-add the members of the full set
+0 ipset -! -A test 10.0.0.1-10.0.0.3
+# Timeout: Test an address of the range
+0 ipset -T test 10.0.0.2
+# Timeout: Check listed elements
+0 ipset save test | awk '/^add/ { s = s " " $3 } END { exit s != " 10.0.0.1 10.0.0.2 10.0.0.3 10.2.0.1" }'
+# Timeout: Delete an address of the range
+0 ipset -D test 10.0.0.2
+# Timeout: Sleep 5s so that the elements can time out
+0 sleep 5
+# Timeout: Test a timed out address
+1 ipset -T test 10.0.0.1
+# Timeout: Test the address without timeout
+0 ipset -T test 10.2.0.1
+# Timeout: Add the timed out address again
+0 ipset -A test 10.0.0.1
+# Timeout: Check listed elements
+0 ipset save test | awk '/^add/ { s = s " " $3 } END { exit s != " 10.0.0.1 10.2.0.1" }'
+# Timeout: Destroy test set
+0 ipset -X test
+# Comment: Create a set with comment over the whole address space
+0 ipset -N test cbitmap:ip range 0.0.0.0-255.255.255.255 comment
+# Comment: Add a range converting the array to a bitmap
+0 ipset -A test 10.0.0.100-10.0.19.255 comment "range"
+# Comment: Add addresses in front of the stored elements
+0 ipset -A test 10.0.0.1-10.0.0.99 comment "front"
+# Comment: Add an address in another block
+0 ipset -A test 192.168.0.1 comment "single"
+# Comment: Check the number of elements
+0 ipset -t l test | grep -q '^Number of entries: 5120$'
+# Comment: Test an address added in front
+0 ipset -T test 10.0.0.50
+# Comment: Check the comment of the first element
+0 ipset save test | grep -q 'add test 10.0.0.1 comment "front"'
+# Comment: Check the comment of the last element of the range
+0 ipset save test | grep -q 'add test 10.0.19.255 comment "range"'
+# Comment: Delete a network from the middle
+0 ipset -D test 10.0.5.0/24
+# Comment: Test an address of the deleted network
+1 ipset -T test 10.0.5.1
+# Comment: Delete a range with a missing address
+1 ipset -D test 10.0.5.255-10.0.6.0
+# Comment: Check the number of elements after delete
+0 ipset -t l test | grep -q '^Number of entries: 4864$'
+# Comment: Check the comment after the deleted network
+0 ipset save test | grep -q 'add test 10.0.6.0 comment "range"'
+# Comment: Delete the whole address space with -exist
+0 ipset -! -D test 0.0.0.0/0
+# Comment: Check the number of elements after delete
+0 ipset -t l test | grep -q '^Number of entries: 0$'
+# Comment: Delete a network from the empty set
+1 ipset -D test 10.0.0.0/30
+# Comment: Destroy test set
+0 ipset -X test
+# Counters: Create a set with counters
+0 ipset -N test cbitmap:ip range 192.168.0.0-192.168.255.255 counters
+# Counters: Add an element with counters
+0 ipset -A test 192.168.1.1 packets 5 bytes 3456
+# Counters: Check the counters
+0 ipset save test | grep -q 'add test 192.168.1.1 packets 5 bytes 3456'
+# Counters: Delete the element
+0 ipset -D test 192.168.1.1
+# Counters: Destroy test set
+0 ipset -X test
+# eof
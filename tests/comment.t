@@ -154,4 +154,26 @@
 0 ipset f
 # Destroy sets
 0 ipset x
+# Shared comment: create first set
+0 ipset n test1 hash:ip comment
+# Shared comment: create second set
+0 ipset n test2 hash:ip comment
+# Shared comment: add element with comment to the first set
+0 ipset a test1 10.0.0.1 comment "shared"
+# Shared comment: add element with the same comment to the first set
+0 ipset a test1 10.0.0.2 comment "shared"
+# Shared comment: add element with the same comment to the second set
+0 ipset a test2 10.0.0.1 comment "shared"
+# Shared comment: delete element of the first set
+0 ipset d test1 10.0.0.1
+# Shared comment: destroy the first set
+0 ipset x test1
+# Shared comment: check the comment of the second set
+0 ipset l test2 | grep -q '^10.0.0.1 comment "shared"$'
+# Shared comment: re-add element with new comment
+0 ipset -! a test2 10.0.0.1 comment "other"
+# Shared comment: check new comment
+0 ipset l test2 | grep -q '^10.0.0.1 comment "other"$'
+# Shared comment: destroy set
+0 ipset x test2
 # eof
@@ -0,0 +1,34 @@
+#!/bin/bash
+
+# Match rate of a single, popular element of a hash:ip set with shared
+# and with per-CPU counters, when the packets are sent from 1, 8 and 32
+# CPUs. CPU counts above the number of the online CPUs are skipped.
+#
+# Usage: counters_bench.sh [seconds]
+
+. ./pktgen.sh
+
+secs=${1:-10}
+cpus=`nproc`
+
+pg_start
+pg_rule -p udp --dport 7 -m set --match-set bench src
+pg_rule -p udp --dport 7 -j DROP
+
+printf "%16s %6s %12s\n" counters cpus "matches/s"
+for counters in counters percpu-counters; do
+	$ipset x bench 2>/dev/null || true
+	$ipset n bench hash:ip $counters
+	$ipset a bench 10.0.0.1
+	for n in 1 8 32; do
+		test $n -le $cpus || continue
+		pg_reset
+		for cpu in `seq 0 $((n - 1))`; do
+			pg_thread $cpu 10.0.0.1 10.0.0.1 7
+		done
+		pg_run $secs
+		printf "%16s %6d %12d\n" $counters $n `pg_pps 1 $secs`
+	done
+	# The per-CPU copies must add up to the matched packets
+	$ipset l bench | grep -q '^10.0.0.1 packets [1-9]'
+done
@@ -184,6 +184,216 @@
 0 ./check_extensions test 2.0.0.10 700 13 12479
 # Counters and timeout: destroy set
 0 ipset x test
+# Bloom filter: create set
+0 ipset n test hash:ip bloom timeout 600
+# Bloom filter: check header
+0 ipset l test | grep -q '^Header: .* bloom'
+# Bloom filter: add elements in range notation
+0 ipset a test 10.0.0.0-10.0.3.255
+# Bloom filter: test element
+0 ipset t test 10.0.2.1
+# Bloom filter: test not added element
+1 ipset t test 10.0.4.1
+# Bloom filter: delete element
+0 ipset d test 10.0.2.1
+# Bloom filter: test deleted element
+1 ipset t test 10.0.2.1
+# Bloom filter: readd element with short timeout
+0 ipset a test 10.0.2.1 timeout 1
+# Bloom filter: test readded element
+0 ipset t test 10.0.2.1
+# Bloom filter: flush set
+0 ipset f test
+# Bloom filter: test element in flushed set
+1 ipset t test 10.0.1.1
+# Bloom filter: add element after flush
+0 ipset a test 10.0.1.1
+# Bloom filter: test element after flush
+0 ipset t test 10.0.1.1
+# Bloom filter: destroy set
+0 ipset x test
+# Expiry: create set with timeout
+0 ipset n test hash:ip timeout 4
+# Expiry: add element with short timeout
+0 ipset a test 10.0.0.1 timeout 1
+# Expiry: add element with long timeout
+0 ipset a test 10.0.0.2 timeout 100
+# Expiry: add permanent element
+0 ipset a test 10.0.0.3 timeout 0
+# Expiry: shorten the timeout of an element
+0 ipset a test 10.0.0.2 timeout 2 -exist
+# Expiry: sleep 4s so that elements can time out
+0 sleep 4
+# Expiry: test element with shortened timeout
+1 ipset t test 10.0.0.2
+# Expiry: test permanent element
+0 ipset t test 10.0.0.3
+# Expiry: check number of elements
+0 n=`ipset save test|wc -l` && test $n -eq 2
+# Expiry: readd expired element
+0 ipset a test 10.0.0.1
+# Expiry: test readded element
+0 ipset t test 10.0.0.1
+# Expiry: destroy set
+0 ipset x test
+# Compact: create set
+0 ipset n test hash:ip hashsize 64
+# Compact: add elements so that the hash is resized
+0 ipset a test 10.0.0.0-10.0.15.255
+# Compact: check that the hash is resized
+0 ipset l test | grep -q '^Header: .* hashsize [1-9][0-9][0-9][0-9]* '
+# Compact: delete most of the elements
+0 ipset d test 10.0.0.0-10.0.15.239
+# Compact: compact set
+0 ipset compact test
+# Compact: check hash size
+0 ipset l test | grep -q '^Header: .* hashsize 64 '
+# Compact: check number of elements
+0 n=`ipset save test|wc -l` && test $n -eq 17
+# Compact: test remaining element
+0 ipset t test 10.0.15.240
+# Compact: test deleted element
+1 ipset t test 10.0.15.239
+# Compact: compact all sets
+0 ipset compact
+# Compact: compact non-existent set
+1 ipset compact nonexistent
+# Compact: destroy set
+0 ipset x test
+# Eviction: create set without timeout
+1 ipset n test hash:ip maxelem 4 evict
+# Eviction: create set
+0 ipset n test hash:ip timeout 3 maxelem 4 evict
+# Eviction: fill up the set with elements with timeout
+0 for x in 1 2 3; do echo a test 10.0.0.$x timeout $((x * 100)); done | ipset restore
+# Eviction: add permanent element
+0 ipset a test 10.0.0.4 timeout 0
+# Eviction: add element to full set
+0 ipset a test 10.0.0.5 timeout 400
+# Eviction: test evicted element
+1 ipset t test 10.0.0.1
+# Eviction: test element with later timeout
+0 ipset t test 10.0.0.2
+# Eviction: add another element
+0 ipset a test 10.0.0.6 timeout 400
+# Eviction: test evicted element
+1 ipset t test 10.0.0.2
+# Eviction: test permanent element
+0 ipset t test 10.0.0.4
+# Eviction: check number of elements
+0 n=`ipset save test|wc -l` && test $n -eq 5
+# Eviction: check eviction counter
+0 ipset l test | grep -q '^Evictions: 2$'
+# Eviction: check that the option is saved
+0 ipset save test | grep -q '^create test hash:ip .* evict$'
+# Eviction: destroy set
+0 ipset x test
+# Per-CPU counters: create set
+0 ipset n test hash:ip percpu-counters
+# Per-CPU counters: add element with counter values
+0 ipset a test 10.0.0.1 packets 5 bytes 3456
+# Per-CPU counters: add element with default counters
+0 ipset a test 10.0.0.2
+# Per-CPU counters: check counter values
+0 ipset l test | grep -q '^10.0.0.1 packets 5 bytes 3456$'
+# Per-CPU counters: check zero counters
+0 ipset l test | grep -q '^10.0.0.2 packets 0 bytes 0$'
+# Per-CPU counters: re-add element with new values
+0 ipset -! a test 10.0.0.1 packets 1 bytes 64
+# Per-CPU counters: check new counter values
+0 ipset l test | grep -q '^10.0.0.1 packets 1 bytes 64$'
+# Per-CPU counters: check that the option is saved
+0 ipset save test | grep -q '^create test hash:ip .* percpu-counters$'
+# Per-CPU counters: destroy set
+0 ipset x test
+# Bucket allocator: create set with small hash size
+0 ipset n test hash:ip hashsize 64
+# Bucket allocator: fill up buckets beyond the inline slots
+0 for x in `seq 0 255`; do echo a test 10.0.0.$x; done | ipset restore
+# Bucket allocator: check allocated arrays in terse listing
+0 ipset -t l test | grep -q '^Bucket allocations: [1-9]'
+# Bucket allocator: statistics are not listed with the members
+1 ipset l test | grep -q '^Bucket allocations:'
+# Bucket allocator: flush set
+0 ipset f test
+# Bucket allocator: check that all arrays are freed
+0 ipset -t l test | awk '/^Bucket allocations:/ { a = $3 } /^Bucket frees:/ { f = $3 } END { exit a != f }'
+# Bucket allocator: destroy set
+0 ipset x test
+# Expect: create set presized for the expected elements
+0 ipset n test hash:ip expect 10000
+# Expect: check hash size
+0 ipset l test | grep -q '^Header: .* hashsize 8192 '
+# Expect: destroy set
+0 ipset x test
+# Expect: the hash size is not decreased
+0 ipset n test hash:ip hashsize 16384 expect 10
+# Expect: check hash size
+0 ipset l test | grep -q '^Header: .* hashsize 16384 '
+# Expect: destroy set
+0 ipset x test
+# Expect: restore file with create and add lines
+0 (echo create test hash:ip; for x in `seq 0 4999`; do echo add test 10.0.$((x / 256)).$((x % 256)); done) > .foo
+# Expect: restore counts the add lines
+0 ipset restore -f .foo
+# Expect: check hash size
+0 ipset l test | grep -q '^Header: .* hashsize 4096 '
+# Expect: check number of elements
+0 n=`ipset save test|wc -l` && test $n -eq 5001
+# Expect: destroy set
+0 ipset x test
+# IP: Save while the set is resized
+0 ./list_resize.sh
+# Statistics: enable runtime statistics for the new sets
+0 echo 1 > /sys/module/ip_set/parameters/stats
+# Statistics: create set
+0 ipset n test hash:ip
+# Statistics: add elements
+0 for x in 1 2; do echo a test 10.0.0.$x; done | ipset restore
+# Statistics: test element
+0 ipset t test 10.0.0.1
+# Statistics: check number of entries in terse listing
+0 ipset -t l test | grep -q '^Number of entries: 2$'
+# Statistics: check lookups in terse listing
+0 ipset -t l test | grep -q '^Lookups: [1-9]'
+# Statistics: statistics are not listed with the members
+1 ipset l test | grep -q '^Lookups:'
+# Statistics: destroy set
+0 ipset x test
+# Statistics: disable runtime statistics
+0 echo 0 > /sys/module/ip_set/parameters/stats
+# Statistics: no statistics without the parameter
+0 ipset n test hash:ip
+# Statistics: check that lookups are not listed
+1 ipset -t l test | grep -q '^Lookups:'
+# Statistics: destroy set
+0 ipset x test
+# Replicas: create set with NUMA node replicas and small hash size
+0 ipset n test hash:ip hashsize 64 replicas
+# Replicas: check replicas flag in header
+0 ipset -L test | grep -q '^Header: .* replicas'
+# Replicas: add range of elements so that the hash is resized
+0 ipset a test 10.0.0.0/22
+# Replicas: check that the hash size is increased
+1 ipset l test | grep -q '^Header: .* hashsize 64 '
+# Replicas: test element
+0 ipset t test 10.0.3.100
+# Replicas: test not added element
+1 ipset t test 10.0.4.100
+# Replicas: delete element
+0 ipset d test 10.0.3.100
+# Replicas: test deleted element
+1 ipset t test 10.0.3.100
+# Replicas: check number of entries against the elements
+0 ./check_elements test
+# Replicas: flush set
+0 ipset f test
+# Replicas: test element after flush
+1 ipset t test 10.0.0.1
+# Replicas: destroy set
+0 ipset x test
+# Replicas: create set with replicas and timeout
+1 ipset n test hash:ip timeout 10 replicas
 # Counters: require sendip
 skip which sendip
 # Counters: create set
@@ -206,4 +416,28 @@ skip which sendip
 0 ./check_extensions test 10.255.255.64 600 6 $((6*40))
 # Counters and timeout: destroy set
 0 ipset x test
+# Kernel side adds: require sendip
+skip which sendip
+# Kernel side adds: enable runtime statistics for the new sets
+0 echo 1 > /sys/module/ip_set/parameters/stats
+# Kernel side adds: create set with small hash size
+0 ipset n test hash:ip hashsize 64
+# Kernel side adds: add the source addresses from the packet path
+0 iptables -A INPUT -s 10.0.0.0/22 -j SET --add-set test src
+# Kernel side adds: send packets from 1024 addresses to fill up the buckets
+0 for x in `seq 0 1023`; do sendip -p ipv4 -id 127.0.0.1 -is 10.0.$((x / 256)).$((x % 256)) -p tcp -td 80 -ts 1025 127.0.0.1; done
+# Kernel side adds: delete the rule
+0 iptables -D INPUT -s 10.0.0.0/22 -j SET --add-set test src
+# Kernel side adds: disable runtime statistics
+0 echo 0 > /sys/module/ip_set/parameters/stats
+# Kernel side adds: sleep 2s so that the table can grow
+0 sleep 2
+# Kernel side adds: check that adds found their bucket full
+0 ipset -t l test | grep -q '^Adds to full buckets: [1-9]'
+# Kernel side adds: check that the hash size is increased
+1 ipset l test | grep -q '^Header: .* hashsize 64 '
+# Kernel side adds: check number of entries against the elements
+0 ./check_elements test
+# Kernel side adds: destroy set
+0 ipset x test
 # eof
@@ -166,4 +166,30 @@
 0 ./check_extensions test 2.0.0.0/25,2.0.0.0/25 700 13 12479
 # Counters and timeout: destroy set
 0 ipset x test
+# Prefix pairs: create set
+0 ipset n test hash:net,net
+# Prefix pairs: add /16,/16 element
+0 ipset a test 10.0.0.0/16,10.1.0.0/16
+# Prefix pairs: add /24,/8 element as nomatch
+0 ipset a test 10.0.1.0/24,10.0.0.0/8 nomatch
+# Prefix pairs: add /24,/24 element
+0 ipset a test 10.0.1.0/24,10.1.1.0/24
+# Prefix pairs: test host pair matching the /24,/24 element
+0 ipset t test 10.0.1.1,10.1.1.1
+# Prefix pairs: test host pair matching the nomatch element
+1 ipset t test 10.0.1.1,10.1.2.1
+# Prefix pairs: test host pair matching the /16,/16 element
+0 ipset t test 10.0.2.1,10.1.2.1
+# Prefix pairs: test host pair of a not present /16,/24 pair
+1 ipset t test 10.0.2.1,10.2.1.1
+# Prefix pairs: delete the nomatch element
+0 ipset d test 10.0.1.0/24,10.0.0.0/8
+# Prefix pairs: test host pair matching the /16,/16 element
+0 ipset t test 10.0.1.1,10.1.2.1
+# Prefix pairs: flush set
+0 ipset f test
+# Prefix pairs: test host pair in flushed set
+1 ipset t test 10.0.1.1,10.1.1.1
+# Prefix pairs: destroy set
+0 ipset x test
 # eof
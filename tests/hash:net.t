@@ -166,4 +166,56 @@
 0 ./check_extensions test 2.0.0.0/25 700 13 12479
 # Counters and timeout: destroy set
 0 ipset x test
+# Packed: restore elements with an error in the middle
+1 (echo "create test hash:net maxelem 4"; for x in 1 2 3 4 5 6; do echo "add test 10.0.$x.0/24"; done) | ipset -R
+# Packed: check returned error line number
+0 num=`grep 'in line' < .foo.err | sed 's/.* in line //' | cut -d : -f 1` && test $num -eq 6
+# Packed: check the elements added before the error
+0 n=`ipset save test | grep -c '^add test'` && test $n -eq 4
+# Packed: destroy set
+0 ipset x test
+# Packed listing: create set with counters
+0 ipset n test hash:net counters
+# Packed listing: add element with counters
+0 ipset a test 10.0.0.0/24 packets 5 bytes 3456
+# Packed listing: add element with nomatch flag
+0 ipset a test 10.0.1.0/25 nomatch
+# Packed listing: save set
+0 ipset save test > .foo0
+# Packed listing: destroy set
+0 ipset x test
+# Packed listing: restore saved set
+0 ipset restore < .foo0
+# Packed listing: save restored set
+0 ipset save test > .foo
+# Packed listing: compare the saves
+0 diff -u .foo0 .foo
+# Packed listing: check nomatch flag
+0 grep -q '^add test 10.0.1.0/25 .*nomatch' .foo
+# Packed listing: destroy set
+0 ipset x test
+# Cache: create set with lookup cache
+0 ipset n test hash:net cache
+# Cache: check cache flag in header
+0 ipset -L test | grep -q '^Header: .* cache'
+# Cache: add network
+0 ipset a test 10.0.0.0/8
+# Cache: test address, fills cache
+0 ipset t test 10.1.2.3
+# Cache: test address again, answered from cache
+0 ipset t test 10.1.2.3
+# Cache: add more specific nomatch network
+0 ipset a test 10.1.0.0/16 nomatch
+# Cache: address must not match after add
+1 ipset t test 10.1.2.3
+# Cache: delete nomatch network
+0 ipset d test 10.1.0.0/16
+# Cache: address matches again after del
+0 ipset t test 10.1.2.3
+# Cache: flush set
+0 ipset f test
+# Cache: address must not match after flush
+1 ipset t test 10.1.2.3
+# Cache: destroy set
+0 ipset x test
 # eof
@@ -0,0 +1,135 @@
+# Range: Create a set with timeout
+0 ipset -N test interval:ip timeout 5
+# Range: Add a range
+0 ipset -A test 192.168.1.10-192.168.1.99 timeout 0
+# Range: Add a network
+0 ipset -A test 10.0.0.0/8
+# Range: Add a single address
+0 ipset -A test 172.16.0.1 timeout 0
+# Range: Add an overlapping range
+1 ipset -A test 192.168.1.90-192.168.1.110
+# Range: Add a range containing an element
+1 ipset -A test 172.15.0.0-172.17.0.0
+# Range: Add the same range again
+1 ipset -A test 192.168.1.10-192.168.1.99
+# Range: Add the same range again with -exist
+0 ipset -! -A test 192.168.1.10-192.168.1.99 timeout 0
+# Range: Add an adjacent range
+0 ipset -A test 192.168.1.100-192.168.1.120 timeout 0
+# Range: Test the first address of a range
+0 ipset -T test 192.168.1.10
+# Range: Test the last address of a range
+0 ipset -T test 192.168.1.99
+# Range: Test an address inside a network
+0 ipset -T test 10.1.2.3
+# Range: Test a range inside an element
+0 ipset -T test 192.168.1.20-192.168.1.30
+# Range: Test a range spanning two elements
+1 ipset -T test 192.168.1.90-192.168.1.110
+# Range: Test an address below the elements
+1 ipset -T test 9.255.255.255
+# Range: Test an address between the elements
+1 ipset -T test 192.168.1.9
+# Range: Test an address above the elements
+1 ipset -T test 192.168.1.121
+# Range: Delete part of a range
+1 ipset -D test 192.168.1.10-192.168.1.20
+# Range: Delete the adjacent range
+0 ipset -D test 192.168.1.100-192.168.1.120
+# Range: Test the deleted range
+1 ipset -T test 192.168.1.110
+# Range: Delete it again
+1 ipset -D test 192.168.1.100-192.168.1.120
+# Range: List set
+0 ipset -L test | grep -v Revision: | sed 's/timeout ./timeout x/' > .foo0 && ./sort.sh .foo0
+# Range: Check listing
+0 diff -u -I 'Size in memory.*' .foo interval:ip.t.list0
+# Range: Save set
+0 ipset save test > interval:ip.t.restore
+# Sleep 5s so that element can time out
+0 sleep 5
+# Range: Test the timed out network
+1 ipset -T test 10.1.2.3
+# Range: Add a range overlapping the timed out network
+0 ipset -A test 10.1.0.0-10.1.255.255 timeout 0
+# Range: Test the new range
+0 ipset -T test 10.1.2.3
+# Range: Destroy set
+0 ipset x test
+# Range: Restore saved set
+0 ipset restore < interval:ip.t.restore && rm interval:ip.t.restore
+# Range: List set
+0 ipset -L test | grep -v Revision: | sed 's/timeout ./timeout x/' > .foo0 && ./sort.sh .foo0
+# Range: Check listing
+0 diff -u -I 'Size in memory.*' .foo interval:ip.t.list0
+# Range: Flush test set
+0 ipset -F test
+# Range: Test a flushed element
+1 ipset -T test 172.16.0.1
+# Range: Delete test set
+0 ipset -X test
+# Range: Create a set with maxelem
+0 ipset -N test interval:ip maxelem 2
+# Range: Add first element
+0 ipset -A test 1.1.1.1
+# Range: Add second element
+0 ipset -A test 2.2.2.0/24
+# Range: Add third element to a full set
+1 ipset -A test 3.3.3.3
+# Range: Delete a full set
+0 ipset -X test
+# Range: Create a set for many elements
+0 ipset -N test interval:ip
+# Range: Add elements, merged into the array in between
+0 for x in `seq 0 255`; do echo a test 10.$x.0.0/16; done | ipset restore
+# Range: Test an element of the middle
+0 ipset -T test 10.128.200.1
+# Range: Test the first element
+0 ipset -T test 10.0.0.0
+# Range: Test the last element
+0 ipset -T test 10.255.255.255
+# Range: Test an address out of the elements
+1 ipset -T test 11.0.0.0
+# Range: Check the number of the elements
+0 test `ipset -L test | grep -c '^10\.'` -eq 256
+# Range: Delete test set
+0 ipset -X test
+# Range6: Create a set
+0 ipset -N test interval:ip family inet6
+# Range6: Add a range
+0 ipset -A test 2001:db8::1-2001:db8::ff
+# Range6: Add a network
+0 ipset -A test 2001:db8:1::/48
+# Range6: Add an overlapping range
+1 ipset -A test 2001:db8::f0-2001:db8::100
+# Range6: Test an address inside the range
+0 ipset -T test 2001:db8::80
+# Range6: Test an address inside the network
+0 ipset -T test 2001:db8:1:ffff::1
+# Range6: Test an address between the elements
+1 ipset -T test 2001:db8::100
+# Range6: List set
+0 ipset -L test | grep -v Revision: > .foo0 && ./sort.sh .foo0
+# Range6: Check listing
+0 diff -u -I 'Size in memory.*' .foo interval:ip.t.list1
+# Range6: Delete the network
+0 ipset -D test 2001:db8:1::/48
+# Range6: Test the deleted network
+1 ipset -T test 2001:db8:1:ffff::1
+# Range6: Delete test set
+0 ipset -X test
+# Counters: create set
+0 ipset n test interval:ip counters
+# Counters: add element with packet, byte counters
+0 ipset a test 10.0.0.0/24 packets 5 bytes 3456
+# Counters: check element
+0 ipset t test 10.0.0.1
+# Counters: check counters
+0 ./check_counters test 10.0.0.0-10.0.0.255 5 3456
+# Counters: update counters
+0 ipset -! a test 10.0.0.0/24 packets 13 bytes 12479
+# Counters: check counters
+0 ./check_counters test 10.0.0.0-10.0.0.255 13 12479
+# Counters: destroy set
+0 ipset x test
+# eof
@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# Save a set while it is resized by adds running in parallel: every save
+# must contain the elements which were in the set before the adds were
+# started, and no element may be listed twice.
+
+set -e
+
+ipset=../src/ipset
+count=${1:-100000}
+
+$ipset x test 2>/dev/null || true
+$ipset n test hash:ip hashsize 64 maxelem $((count * 2))
+
+awk -v n=$count 'BEGIN {
+	for (i = 0; i < n; i++)
+		printf "add test 10.%d.%d.%d\n",
+			int(i / 65536) % 256, int(i / 256) % 256, i % 256
+}' | $ipset restore
+
+awk -v n=$count 'BEGIN {
+	for (i = 0; i < n; i++)
+		printf "add test 11.%d.%d.%d\n",
+			int(i / 65536) % 256, int(i / 256) % 256, i % 256
+}' | $ipset restore &
+pid=$!
+
+while kill -0 $pid 2>/dev/null; do
+	$ipset save test | grep '^add test ' > .list_resize
+	dup=`sort .list_resize | uniq -d | wc -l`
+	old=`grep -c '^add test 10\.' .list_resize || true`
+	if [ $dup -ne 0 -o $old -ne $count ]; then
+		echo "duplicated: $dup, listed: $old of $count"
+		kill $pid 2>/dev/null || true
+		exit 1
+	fi
+done
+wait $pid
+rm -f .list_resize
+$ipset x test
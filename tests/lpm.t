@@ -0,0 +1,87 @@
+# Create a set with longest prefix match index
+0 ipset create test hash:net lpm
+# Add a /8 network
+0 ipset add test 10.0.0.0/8
+# Add a /16 network
+0 ipset add test 10.1.0.0/16
+# Add a /24 network as nomatch
+0 ipset add test 10.1.1.0/24 nomatch
+# Add a /30 network
+0 ipset add test 10.1.1.0/30
+# Test address in the /8 network
+0 ipset test test 10.2.3.4
+# Test address in the /16 network
+0 ipset test test 10.1.2.3
+# Test address in the nomatch /24 network
+1 ipset test test 10.1.1.8
+# Test address in the /30 network
+0 ipset test test 10.1.1.2
+# Test address not covered by the set
+1 ipset test test 11.1.1.1
+# List set
+0 ipset -L test 2>/dev/null | grep -v Revision: > .foo0 && ./sort.sh .foo0
+# Check listing
+0 diff -u -I 'Size in memory.*' .foo lpm.t.list0
+# Delete the /30 network
+0 ipset del test 10.1.1.0/30
+# Test address in the former /30 network
+1 ipset test test 10.1.1.2
+# Delete the nomatch /24 network
+0 ipset del test 10.1.1.0/24
+# Test address in the former nomatch /24 network
+0 ipset test test 10.1.1.8
+# Delete the /16 network
+0 ipset del test 10.1.0.0/16
+# Test address in the /8 network again
+0 ipset test test 10.1.2.3
+# Flush test set
+0 ipset flush test
+# Test address in the flushed set
+1 ipset test test 10.1.2.3
+# Add networks in range notation after flush
+0 ipset add test 10.2.0.0-10.2.1.12
+# Test address in the range
+0 ipset test test 10.2.1.9
+# Test address beyond the range
+1 ipset test test 10.2.1.13
+# Delete test set
+0 ipset destroy test
+# Create an IPv6 set with longest prefix match index
+0 ipset create test hash:net family inet6 lpm
+# Add a /32 network
+0 ipset add test 2001:db8::/32
+# Add a /64 network as nomatch
+0 ipset add test 2001:db8:1:2::/64 nomatch
+# Add a /127 network
+0 ipset add test 2001:db8:1:2::/127
+# Test address in the /32 network
+0 ipset test test 2001:db8:ffff::1
+# Test address in the nomatch /64 network
+1 ipset test test 2001:db8:1:2::10
+# Test address in the /127 network
+0 ipset test test 2001:db8:1:2::1
+# Delete test set
+0 ipset destroy test
+# Create a hash:net,port set with longest prefix match index
+0 ipset create test hash:net,port lpm
+# Add a /16 network with port
+0 ipset add test 192.168.0.0/16,tcp:80
+# Add a /24 network with the same port as nomatch
+0 ipset add test 192.168.1.0/24,tcp:80 nomatch
+# Add a /24 network with another port
+0 ipset add test 192.168.1.0/24,tcp:443
+# Test address in the /16 network
+0 ipset test test 192.168.2.1,tcp:80
+# Test address in the nomatch network
+1 ipset test test 192.168.1.1,tcp:80
+# Test address with the other port
+0 ipset test test 192.168.1.1,tcp:443
+# Test address with a port not in the set
+1 ipset test test 192.168.2.1,tcp:443
+# Delete the network with the other port
+0 ipset del test 192.168.1.0/24,tcp:443
+# Test address in the nomatch network, still not matching
+1 ipset test test 192.168.1.1,tcp:80
+# Delete test set
+0 ipset destroy test
+# eof
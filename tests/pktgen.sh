@@ -0,0 +1,113 @@
+#!/bin/sh
+
+# Helper functions for the kernel side benchmarks.
+#
+# The packets are generated by pktgen on one end of a veth pair, one
+# thread per CPU, and are received on the same CPUs at the other end,
+# where the rules of the IPSBENCH chain of the raw table process them.
+# The benchmarks source this file: . ./pktgen.sh
+# and call pg_start, then use the set "bench".
+
+ipset=../src/ipset
+
+PG_DEV=ipsbench0
+PG_PEER=ipsbench1
+PG_DST=10.255.253.1
+PG_CHAIN=IPSBENCH
+
+pg_set() {
+	echo "$2" > /proc/net/pktgen/$1
+}
+
+pg_setup() {
+	modprobe pktgen
+	ip link add $PG_DEV type veth peer name $PG_PEER
+	ip addr add $PG_DST/24 dev $PG_PEER
+	ip link set $PG_DEV up
+	ip link set $PG_PEER up
+	PG_MAC=`cat /sys/class/net/$PG_PEER/address`
+	iptables -t raw -N $PG_CHAIN
+	iptables -t raw -I PREROUTING -i $PG_PEER -j $PG_CHAIN
+}
+
+pg_cleanup() {
+	test -e /proc/net/pktgen/pgctrl && pg_set pgctrl reset
+	iptables -t raw -D PREROUTING -i $PG_PEER -j $PG_CHAIN 2>/dev/null
+	iptables -t raw -F $PG_CHAIN 2>/dev/null
+	iptables -t raw -X $PG_CHAIN 2>/dev/null
+	ip link del $PG_DEV 2>/dev/null
+	:
+}
+
+# Remove the devices, the rules and the set of the benchmark
+pg_exit() {
+	pg_cleanup
+	$ipset x bench 2>/dev/null
+	:
+}
+
+# Set up the devices and the chain after cleaning up the leftovers
+# of an interrupted run, and clean up again when the benchmark exits
+pg_start() {
+	trap pg_exit EXIT
+	pg_exit
+	set -e
+	pg_setup
+}
+
+# Address conversions for the source ranges
+ip2int() {
+	echo $1 | awk -F. '{ print (($1 * 256 + $2) * 256 + $3) * 256 + $4 }'
+}
+
+int2ip() {
+	echo $1 | awk '{ printf "%d.%d.%d.%d", $1 / 16777216 % 256,
+			 $1 / 65536 % 256, $1 / 256 % 256, $1 % 256 }'
+}
+
+# Add a rule to the benchmark chain
+pg_rule() {
+	iptables -t raw -A $PG_CHAIN -i $PG_PEER "$@"
+}
+
+# Remove the pktgen devices from the threads and zero the counters
+pg_reset() {
+	pg_set pgctrl reset
+	iptables -t raw -Z $PG_CHAIN
+}
+
+# pg_device cpu id src-min src-max udp-dport [size]
+# Add a pktgen device with the unique id to the thread of the CPU,
+# which generates UDP packets from random sources in the range.
+# The devices of a thread send the packets in turn.
+pg_device() {
+	dev=$PG_DEV@$2
+
+	pg_set kpktgend_$1 "add_device $dev"
+	for cmd in "count 0" "delay 0" "pkt_size ${6:-60}" \
+		   "dst $PG_DST" "dst_mac $PG_MAC" \
+		   "src_min $3" "src_max $4" "flag IPSRC_RND" \
+		   "udp_dst_min $5" "udp_dst_max $5"; do
+		pg_set $dev "$cmd"
+	done
+}
+
+# pg_thread cpu src-min src-max udp-dport [size]
+# Generate UDP packets from random sources in the range on the CPU
+pg_thread() {
+	pg_device $1 $1 "$2" "$3" "$4" $5
+}
+
+# pg_run seconds
+pg_run() {
+	pg_set pgctrl start &
+	sleep $1
+	pg_set pgctrl stop
+	wait
+}
+
+# pg_pps rule-number seconds: packets per second processed by the rule
+pg_pps() {
+	iptables -t raw -L $PG_CHAIN -v -x -n | \
+		awk -v r=$1 -v s=$2 'NR == r + 2 { printf "%d", $1 / s }'
+}
@@ -0,0 +1,45 @@
+#!/bin/bash
+
+# Measure the latency of single adds while the set is resized
+# by a large restore running in parallel.
+#
+# Usage: resize_latency.sh [elements [samples]]
+
+ipset=../src/ipset
+count=${1:-2000000}
+samples=${2:-1000}
+
+$ipset x resize-test 2>/dev/null
+
+set -e
+
+$ipset n resize-test hash:ip hashsize 1024 maxelem $((count + samples))
+
+awk -v n=$count 'BEGIN {
+	for (i = 0; i < n; i++)
+		printf "add resize-test 10.%d.%d.%d\n",
+			int(i / 65536) % 256, int(i / 256) % 256, i % 256
+}' | $ipset restore &
+pid=$!
+
+i=0
+max=0
+sum=0
+while kill -0 $pid 2>/dev/null && [ $i -lt $samples ]; do
+	start=`date +%s%N`
+	$ipset a resize-test 192.168.$((i / 256 % 256)).$((i % 256))
+	end=`date +%s%N`
+	lat=$(((end - start) / 1000))
+	sum=$((sum + lat))
+	if [ $lat -gt $max ]; then
+		max=$lat
+	fi
+	i=$((i + 1))
+done
+wait $pid
+
+if [ $i -gt 0 ]; then
+	echo "adds: $i, max latency: $max us, avg latency: $((sum / i)) us"
+fi
+$ipset l resize-test | grep -e '^Size in memory' -e '^Header'
+$ipset x resize-test
@@ -6,4 +6,34 @@
 0 ipset x
 # Check auto-increasing maximal number of sets
 0 ./setlist_resize.sh
+# Replace: create set
+0 ipset n test hash:ip
+# Replace: add element
+0 ipset a test 10.0.0.1
+# Replace: publish without replace
+1 ipset publish test
+# Replace: replace with a set of different type
+1 (echo "replace test hash:net"; echo "add test 10.0.1.0/24") | ipset restore
+# Replace: build the new content of the set
+0 (echo "replace test hash:ip hashsize 128"; for x in 2 3 4; do echo "add test 10.0.0.$x"; done; echo "del test 10.0.0.4") | ipset restore
+# Replace: the old element is kept until publishing
+0 ipset test test 10.0.0.1
+# Replace: the old hash size is kept until publishing
+0 ipset list test | grep -q 'hashsize 1024'
+# Replace: publish the new content
+0 ipset publish test
+# Replace: check the old content is gone
+1 ipset test test 10.0.0.1
+# Replace: check the new elements
+0 n=`ipset save test | grep -c '^add test 10.0.0.[23]$'` && test $n -eq 2
+# Replace: check the new hash size
+0 ipset list test | grep -q 'hashsize 128'
+# Replace: replace and publish in one restore
+0 (echo "replace test hash:ip"; echo "add test 10.0.0.5"; echo "publish test") | ipset restore
+# Replace: check the number of published elements
+0 n=`ipset save test | grep -c '^add test'` && test $n -eq 1
+# Replace: test the published element
+0 ipset test test 10.0.0.5
+# Replace: destroy set
+0 ipset x test
 # eof
@@ -0,0 +1,57 @@
+#!/bin/bash
+
+# Restore a hash:ip set with many elements from a pipe, where the add
+# lines cannot be counted in advance and the set is grown step by step,
+# then from a file, where the set is presized for the add lines.
+# The number of resizes is counted when dynamic debug is available.
+#
+# Usage: restore_bench.sh [elements]
+
+ipset=../src/ipset
+count=${1:-1000000}
+file=.restore_bench
+ddebug=/sys/kernel/debug/dynamic_debug/control
+
+cleanup() {
+	test -w $ddebug && echo 'format "resized from" -p' > $ddebug
+	rm -f $file
+	$ipset x bench 2>/dev/null
+}
+trap cleanup EXIT
+
+cleanup
+set -e
+
+awk -v n=$count 'BEGIN {
+	print "create bench hash:ip maxelem " n
+	for (i = 0; i < n; i++)
+		printf "add bench 10.%d.%d.%d\n",
+			int(i / 65536) % 256, int(i / 256) % 256, i % 256
+}' > $file
+
+resizes() {
+	if test -w $ddebug; then
+		dmesg | grep -c "set bench resized from" || true
+	else
+		echo -
+	fi
+}
+
+printf "%8s %10s %8s %10s\n" input "time (ms)" resizes hashsize
+for input in pipe file; do
+	$ipset x bench 2>/dev/null || true
+	if test -w $ddebug; then
+		dmesg -C
+		echo 'format "resized from" +p' > $ddebug
+	fi
+	start=`date +%s%N`
+	if [ $input = pipe ]; then
+		cat $file | $ipset restore
+	else
+		$ipset restore -f $file
+	fi
+	end=`date +%s%N`
+	hashsize=`$ipset l bench | sed -n 's/^Header: .*hashsize \([0-9]*\) .*/\1/p'`
+	printf "%8s %10d %8s %10s\n" $input $(((end - start) / 1000000)) \
+		`resizes` $hashsize
+done
@@ -4,7 +4,7 @@
 
 tests="init"
 tests="$tests ipmap bitmap:ip"
-tests="$tests macipmap portmap"
+tests="$tests macipmap portmap cbitmap:ip"
 tests="$tests iphash hash:ip hash:ip6"
 tests="$tests ipporthash hash:ip,port hash:ip6,port"
 tests="$tests ipportiphash hash:ip,port,ip hash:ip6,port,ip6"
@@ -12,7 +12,8 @@ tests="$tests nethash hash:net hash:net6 hash:net,port hash:net6,port"
 tests="$tests hash:ip,port,net hash:ip6,port,net6 hash:net,net hash:net6,net6"
 tests="$tests hash:net,port,net hash:net6,port,net6"
 tests="$tests hash:net,iface.t"
-tests="$tests comment setlist restore"
+tests="$tests interval:ip"
+tests="$tests comment lpm setlist restore"
 # tests="$tests iptree iptreemap"
 
 # For correct sorting:
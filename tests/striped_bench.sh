@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# Scaling of the kernel side adds and tests of a hash:ip set
+# at different writer:reader ratios.
+#
+# Usage: striped_bench.sh [cpus [seconds]]
+#
+# Writer CPUs send packets which hit the SET target, reader CPUs
+# packets which are tested by the set match.
+
+. ./pktgen.sh
+
+cpus=${1:-`nproc`}
+secs=${2:-10}
+
+pg_start
+
+$ipset n bench hash:ip timeout 600 hashsize 1048576 maxelem 4194304
+pg_rule -p udp --dport 9 -j SET --add-set bench src --exist
+pg_rule -p udp --dport 9 -j DROP
+pg_rule -p udp --dport 7 -m set --match-set bench src
+pg_rule -p udp --dport 7 -j DROP
+
+printf "%8s %8s %12s %12s\n" writers readers "adds/s" "tests/s"
+for ratio in 0 25 50 75 100; do
+	writers=$((cpus * ratio / 100))
+	pg_reset
+	for cpu in `seq 0 $((cpus - 1))`; do
+		if [ $cpu -lt $writers ]; then
+			port=9
+		else
+			port=7
+		fi
+		pg_thread $cpu 10.0.0.0 10.63.255.255 $port
+	done
+	pg_run $secs
+	printf "%8d %8d %12d %12d\n" $writers $((cpus - writers)) \
+		`pg_pps 2 $secs` `pg_pps 4 $secs`
+done